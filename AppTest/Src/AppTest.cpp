@@ -1,6 +1,7 @@
 ﻿#include <iostream>
 #include <chrono>
 #include <thread>
+#include <format>
 #include "ModbusCppTcpClient.h"
 
 // 测试常量
@@ -151,6 +152,18 @@ bool testWriteAndReadData()
     return true;
 }
 
+// 输出客户端内置的统计数据
+void printStatistics()
+{
+    const ModbusCppStatisticsSnapshot _statistics = _client.getStatistics();
+    for (const auto& [_function, _s] : _statistics.functions)
+    {
+        std::cout << std::format("功能码 0x{:02X}: 请求 {}, 失败 {}, 重试 {}, 超时 {}, 异常 {}, 发送 {} 字节, 接收 {} 字节, 耗时 p50/p99/p999: {}/{}/{} 微秒\n",
+            _function, _s.requests, _s.failures, _s.retries, _s.timeouts, _s.exceptions, _s.bytesSent, _s.bytesReceived, _s.latency.p50, _s.latency.p99, _s.latency.p999);
+    }
+    std::cout << std::format("任务队列长度: {} (最大 {})\n", _statistics.queueDepth, _statistics.queueDepthMax);
+}
+
 int main()
 {
     // 连接服务器
@@ -200,5 +213,7 @@ int main()
         // 休眠(对某些PLC，读取间隔休眠，单次读取耗时会减小)
         std::this_thread::sleep_for(std::chrono::duration(std::chrono::milliseconds(SLEEP_TIME)));
     }
+
+    printStatistics();
 }
 
@@ -0,0 +1,1774 @@
+﻿#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <shared_mutex>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#if defined(_WIN32)
+#include <Windows.h>
+#else
+#include <sys/resource.h>
+#endif
+#include "ModbusCppTcpClient.h"
+#include "ModbusCppTcpServer.h"
+#include "ModbusCppTcpProxy.h"
+#include "ModbusCppRtuGateway.h"
+#include "ModbusCppRtuClient.h"
+#include "ModbusCppRtuScheduler.h"
+#include "ModbusCppRtuBusLoop.h"
+#include "ModbusCppCrc16.h"
+#include "modbus.h"
+#include "modbus-private.h"
+#include "LoopbackServer.h"
+#include "FaultInjectingServer.h"
+#include "LoadGenerator.h"
+#include "PtyRtuSlave.h"
+#include "RtuOverTcpServer.h"
+
+// 测试常量
+const std::string SERVER_HOST = "127.0.0.1";    // 回环服务器地址
+const uint16_t SERVER_PORT = 15502;             // 回环服务器端口
+const int SLAVE_ID = 1;                         // 服务器ID
+const int START_ADDRESS = 0;                    // 读写起始地址
+const int CLIENTS_MAX = 16;                     // 最多同时使用的客户端(连接)数
+const uint16_t FAULT_SERVER_PORT = 15503;       // 故障模拟服务器端口
+const int FAULT_TIMEOUT_MS = 100;               // 故障测试时客户端的响应超时
+const int FAULT_RETRIES = 3;                    // 故障测试时客户端的重试次数
+const uint16_t TCP_SERVER_PORT = 15504;         // ModbusCppTcpServer 端口
+const uint16_t THREAD_SERVER_PORT = 15505;      // 每连接一个线程的 libmodbus 服务器端口(对照组)
+const int LOAD_THREADS = 4;                     // 服务器测试时压测客户端的线程数
+const int THREAD_SERVER_CONNECTIONS_MAX = 64;   // 对照组只测到这个连接数，再多线程数太多
+const size_t RESPONSE_CACHE_SLOTS = 256;        // 开启响应缓存时每个线程的槽位数
+const int MAP_REGISTERS = 125;                  // 寄存器存储测试每次读写的寄存器数量(FC3 最大值)
+const uint32_t SPARSE_STRIDE = 1000;            // 稀疏地址测试中相邻两个点的地址间隔
+const size_t WRITE_EVENT_CAPACITY = 4096;       // 写入事件测试中每个线程的队列容量
+const char *const SHARED_MAP_NAME = "ModbusCppBenchmark";   // 共享内存寄存器存储测试使用的段名
+const uint16_t PROXY_UPSTREAM_PORT = 15506;     // 代理测试中模拟 PLC 的回环服务器端口
+const uint16_t PROXY_PORT = 15507;              // ModbusCppTcpProxy 下游端口
+const uint32_t PROXY_POLL_INTERVAL_MS = 100;    // 代理测试的轮询周期
+const uint16_t GATEWAY_PORT = 15508;            // ModbusCppRtuGateway 端口
+const size_t RTU_CHUNK_BYTES = 16;              // RTU 测试中模拟从站每次写入的字节数(相当于 UART FIFO)
+const uint8_t SCAN_SLAVES = 16;                 // 总线扫描测试的从站数量
+const uint32_t SCAN_PERIOD_MS = 200;            // 总线扫描测试中每个扫描项的周期
+const uint32_t SCAN_TIMEOUT_MS = 200;           // 总线扫描测试的响应超时
+const uint8_t BROADCAST_SLAVES = 40;            // 广播测试的从站数量
+const uint16_t SETPOINT_ADDRESS = 100;          // 广播测试写入的设定值地址
+const uint16_t RTU_TCP_PORT = 15509;            // RTU over TCP 测试服务器端口
+const uint16_t RTU_TCP_MBAP_PORT = 15510;       // RTU over TCP 测试中对照组(MBAP)回环服务器端口
+const uint16_t MULTIBUS_REGISTERS = 16;         // 多总线测试每次读取的寄存器数量(短帧，事件循环唤醒更频繁)
+
+// 测试用例
+struct BenchmarkCase
+{
+    std::string operation;  // read / write / write_read
+    bool        async;      // 同步接口还是异步接口
+    int         registers;  // 每次请求的寄存器数量
+    int         clients;    // 客户端(连接)数量
+    int         threads;    // 同步模式下每个客户端的调用线程数
+    int         depth;      // 异步模式下每个客户端未完成请求的数量
+};
+
+// 测试结果
+struct BenchmarkResult
+{
+    uint64_t    requests = 0;
+    uint64_t    failures = 0;
+    double      seconds = 0;
+    double      cpuUsecPerRequest = 0;
+    ModbusCppLatencySnapshot latency;
+};
+
+// 客户端在整个测试过程中复用，ModbusCppTcpClient 析构后工作线程仍会访问它，所以不释放
+std::vector<ModbusCppTcpClient*> _clients;
+int _durationMs = 1000;
+
+// 进程 CPU 时间(用户态 + 内核态)，包含进程内服务器的开销
+uint64_t processCpuUsec()
+{
+#if defined(_WIN32)
+    FILETIME _creation, _exit, _kernel, _user;
+    GetProcessTimes(GetCurrentProcess(), &_creation, &_exit, &_kernel, &_user);
+    const auto _toUsec = [](const FILETIME& t) {
+        return ((static_cast<uint64_t>(t.dwHighDateTime) << 32) | t.dwLowDateTime) / 10;
+    };
+    return _toUsec(_kernel) + _toUsec(_user);
+#else
+    struct rusage _usage;
+    getrusage(RUSAGE_SELF, &_usage);
+    return static_cast<uint64_t>(_usage.ru_utime.tv_sec + _usage.ru_stime.tv_sec) * 1000000 + _usage.ru_utime.tv_usec + _usage.ru_stime.tv_usec;
+#endif
+}
+
+// 同步发起一次请求
+bool requestSync(ModbusCppTcpClient *client, const BenchmarkCase& benchmarkCase, const std::vector<uint16_t>& data)
+{
+    if (benchmarkCase.operation == "read")
+    {
+        return client->readRegistersSync(START_ADDRESS, static_cast<uint8_t>(benchmarkCase.registers)).has_value();
+    }
+    if (benchmarkCase.operation == "write")
+    {
+        return client->writeRegistersSync(START_ADDRESS, data);
+    }
+    return client->writeAndReadRegistersSync(START_ADDRESS, data, START_ADDRESS, static_cast<uint8_t>(benchmarkCase.registers)).has_value();
+}
+
+// 异步发起一次请求
+bool requestAsync(ModbusCppTcpClient *client, const BenchmarkCase& benchmarkCase, const std::vector<uint16_t>& data)
+{
+    if (benchmarkCase.operation == "read")
+    {
+        return client->readRegistersAsync(START_ADDRESS, static_cast<uint8_t>(benchmarkCase.registers));
+    }
+    if (benchmarkCase.operation == "write")
+    {
+        return client->writeRegistersAsync(START_ADDRESS, data);
+    }
+    return client->writeAndReadRegistersAsync(START_ADDRESS, data, START_ADDRESS, static_cast<uint8_t>(benchmarkCase.registers));
+}
+
+// 同步模式: 每个客户端 threads 个线程循环调用同步接口
+BenchmarkResult runSync(const BenchmarkCase& benchmarkCase)
+{
+    const std::vector<uint16_t> _data(benchmarkCase.registers, 0x55AA);
+    ModbusCppLatencyHistogram _histogram;
+    std::atomic<uint64_t> _requests(0);
+    std::atomic<uint64_t> _failures(0);
+
+    const auto _start = std::chrono::steady_clock::now();
+    const uint64_t _cpuStart = processCpuUsec();
+    const auto _deadline = _start + std::chrono::milliseconds(_durationMs);
+    std::vector<std::thread> _threads;
+    for (int c = 0; c < benchmarkCase.clients; ++c)
+    {
+        for (int t = 0; t < benchmarkCase.threads; ++t)
+        {
+            _threads.emplace_back([&, c]() {
+                while (std::chrono::steady_clock::now() < _deadline)
+                {
+                    const auto _requestStart = std::chrono::steady_clock::now();
+                    const bool _ret = requestSync(_clients[c], benchmarkCase, _data);
+                    const auto _elapsed = std::chrono::steady_clock::now() - _requestStart;
+                    _requests += 1;
+                    if (_ret)
+                    {
+                        _histogram.record(std::chrono::duration_cast<std::chrono::microseconds>(_elapsed).count());
+                    }
+                    else
+                    {
+                        _failures += 1;
+                    }
+                }
+            });
+        }
+    }
+
+    for (auto& _thread : _threads)
+    {
+        _thread.join();
+    }
+
+    BenchmarkResult _result;
+    _result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - _start).count();
+    _result.requests = _requests;
+    _result.failures = _failures;
+    _result.cpuUsecPerRequest = _result.requests > 0 ? static_cast<double>(processCpuUsec() - _cpuStart) / _result.requests : 0;
+    _result.latency = _histogram.snapshot();
+    return _result;
+}
+
+// 异步模式: 每个客户端保持 depth 个未完成的请求，通过请求耗时回调得知请求完成
+BenchmarkResult runAsync(const BenchmarkCase& benchmarkCase)
+{
+    const std::vector<uint16_t> _data(benchmarkCase.registers, 0x55AA);
+    ModbusCppLatencyHistogram _histogram;
+    std::atomic<uint64_t> _requests(0);
+    std::atomic<uint64_t> _failures(0);
+    std::vector<int> _outstanding(benchmarkCase.clients, 0);
+    std::mutex _lock;
+    std::condition_variable _condition;
+
+    for (int c = 0; c < benchmarkCase.clients; ++c)
+    {
+        _clients[c]->setRequestTimingEnabled(true);
+        _clients[c]->setRequestTimingCallback([&, c](const ModbusCppRequestTiming& timing) {
+            _requests += 1;
+            if (timing.succeeded)
+            {
+                _histogram.record(timing.total);
+            }
+            else
+            {
+                _failures += 1;
+            }
+
+            std::lock_guard<std::mutex> _guard(_lock);
+            _outstanding[c] -= 1;
+            _condition.notify_all();
+        });
+    }
+
+    const auto _start = std::chrono::steady_clock::now();
+    const uint64_t _cpuStart = processCpuUsec();
+    const auto _deadline = _start + std::chrono::milliseconds(_durationMs);
+    std::vector<std::thread> _threads;
+    for (int c = 0; c < benchmarkCase.clients; ++c)
+    {
+        _threads.emplace_back([&, c]() {
+            std::unique_lock<std::mutex> _guard(_lock);
+            while (std::chrono::steady_clock::now() < _deadline)
+            {
+                _condition.wait_until(_guard, _deadline, [&]() { return _outstanding[c] < benchmarkCase.depth; });
+                while (_outstanding[c] < benchmarkCase.depth && std::chrono::steady_clock::now() < _deadline)
+                {
+                    _outstanding[c] += 1;
+                    _guard.unlock();
+                    const bool _queued = requestAsync(_clients[c], benchmarkCase, _data);
+                    _guard.lock();
+                    if (!_queued)
+                    {
+                        _outstanding[c] -= 1;
+                        _failures += 1;
+                    }
+                }
+            }
+
+            // 等待已入队的请求全部完成，避免影响下一个用例
+            _condition.wait_for(_guard, std::chrono::seconds(30), [&]() { return _outstanding[c] == 0; });
+        });
+    }
+
+    for (auto& _thread : _threads)
+    {
+        _thread.join();
+    }
+
+    BenchmarkResult _result;
+    _result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - _start).count();
+    _result.requests = _requests;
+    _result.failures = _failures;
+    _result.cpuUsecPerRequest = _result.requests > 0 ? static_cast<double>(processCpuUsec() - _cpuStart) / _result.requests : 0;
+    _result.latency = _histogram.snapshot();
+
+    for (int c = 0; c < benchmarkCase.clients; ++c)
+    {
+        _clients[c]->setRequestTimingCallback(nullptr);
+        _clients[c]->setRequestTimingEnabled(false);
+    }
+    return _result;
+}
+
+// 每个用例输出一行 JSON
+void printResult(const BenchmarkCase& benchmarkCase, const BenchmarkResult& result)
+{
+    std::ostringstream _line;
+    _line << "{\"operation\":\"" << benchmarkCase.operation << "\""
+        << ",\"mode\":\"" << (benchmarkCase.async ? "async" : "sync") << "\""
+        << ",\"registers\":" << benchmarkCase.registers
+        << ",\"clients\":" << benchmarkCase.clients
+        << ",\"threads\":" << benchmarkCase.threads
+        << ",\"depth\":" << benchmarkCase.depth
+        << ",\"requests\":" << result.requests
+        << ",\"failures\":" << result.failures
+        << ",\"requests_per_sec\":" << (result.seconds > 0 ? result.requests / result.seconds : 0)
+        << ",\"latency_us\":{\"min\":" << result.latency.min
+        << ",\"mean\":" << result.latency.mean
+        << ",\"p50\":" << result.latency.p50
+        << ",\"p99\":" << result.latency.p99
+        << ",\"p999\":" << result.latency.p999
+        << ",\"max\":" << result.latency.max << "}"
+        << ",\"cpu_us_per_request\":" << result.cpuUsecPerRequest
+        << "}";
+    std::cout << _line.str() << std::endl;
+}
+
+// 吞吐量/延迟测试矩阵
+void runThroughputSuite(const bool quick)
+{
+    const std::vector<std::string> _operations = { "read", "write", "write_read" };
+    const std::vector<int> _registers = quick ? std::vector<int>{ 1, 120 } : std::vector<int>{ 1, 32, 120 };
+    const std::vector<int> _clientCounts = quick ? std::vector<int>{ 1, 4 } : std::vector<int>{ 1, 4, CLIENTS_MAX };
+    const std::vector<int> _threadCounts = quick ? std::vector<int>{ 1 } : std::vector<int>{ 1, 4 };
+    const std::vector<int> _depths = quick ? std::vector<int>{ 8 } : std::vector<int>{ 1, 8, 32 };
+
+    for (const auto& _operation : _operations)
+    {
+        for (const int _registerCount : _registers)
+        {
+            for (const int _clientCount : _clientCounts)
+            {
+                for (const int _threadCount : _threadCounts)
+                {
+                    const BenchmarkCase _case = { _operation, false, _registerCount, _clientCount, _threadCount, 1 };
+                    printResult(_case, runSync(_case));
+                }
+                for (const int _depth : _depths)
+                {
+                    const BenchmarkCase _case = { _operation, true, _registerCount, _clientCount, 1, _depth };
+                    printResult(_case, runAsync(_case));
+                }
+            }
+        }
+    }
+}
+
+// 故障测试的配置列表
+std::vector<FaultProfile> faultProfiles()
+{
+    std::vector<FaultProfile> _profiles;
+
+    FaultProfile _profile;
+    _profile.name = "none";
+    _profiles.push_back(_profile);
+
+    _profile = FaultProfile();
+    _profile.name = "latency_uniform_0_2ms";
+    _profile.latency = FaultProfile::Latency::UNIFORM;
+    _profile.latencyMaxUs = 2000;
+    _profiles.push_back(_profile);
+
+    _profile = FaultProfile();
+    _profile.name = "latency_exponential_1ms";
+    _profile.latency = FaultProfile::Latency::EXPONENTIAL;
+    _profile.latencyMinUs = 100;
+    _profile.latencyMeanUs = 1000;
+    _profiles.push_back(_profile);
+
+    _profile = FaultProfile();
+    _profile.name = "drop_1pct";
+    _profile.dropProbability = 0.01;
+    _profiles.push_back(_profile);
+
+    _profile = FaultProfile();
+    _profile.name = "truncate_1pct";
+    _profile.truncateProbability = 0.01;
+    _profiles.push_back(_profile);
+
+    _profile = FaultProfile();
+    _profile.name = "wrong_tid_1pct";
+    _profile.wrongTransactionIdProbability = 0.01;
+    _profiles.push_back(_profile);
+
+    _profile = FaultProfile();
+    _profile.name = "exception_1pct";
+    _profile.exceptionProbability = 0.01;
+    _profiles.push_back(_profile);
+
+    _profile = FaultProfile();
+    _profile.name = "reset_0.5pct";
+    _profile.resetProbability = 0.005;
+    _profiles.push_back(_profile);
+
+    return _profiles;
+}
+
+// 故障测试: 单客户端循环同步读，统计吞吐量和从第一次失败到下一次成功的恢复时间
+void runFaultSuite()
+{
+    FaultInjectingServer _server;
+    if (!_server.start(SERVER_HOST, FAULT_SERVER_PORT))
+    {
+        std::cerr << "启动故障模拟服务器失败" << std::endl;
+        return;
+    }
+
+    ModbusCppTcpClient *_client = new ModbusCppTcpClient();
+    _client->setTimeout(FAULT_TIMEOUT_MS);
+    _client->setRetries(FAULT_RETRIES);
+    if (!_client->connectServer(SERVER_HOST, FAULT_SERVER_PORT, SLAVE_ID))
+    {
+        std::cerr << "连接故障模拟服务器失败" << std::endl;
+        return;
+    }
+
+    const uint8_t _registers = 32;
+    for (const auto& _profile : faultProfiles())
+    {
+        _server.setFaultProfile(_profile);
+        _client->resetStatistics();
+
+        ModbusCppLatencyHistogram _latency;
+        ModbusCppLatencyHistogram _recovery;
+        uint64_t _requests = 0;
+        uint64_t _failures = 0;
+        uint64_t _reconnects = 0;
+        bool _failing = false;
+        std::chrono::steady_clock::time_point _failedAt;
+
+        // 通过重试恢复的请求，恢复时间为整个请求的耗时
+        _client->setRequestTimingEnabled(true);
+        _client->setRequestTimingCallback([&_recovery](const ModbusCppRequestTiming& timing) {
+            if (timing.succeeded && timing.attempts > 1)
+            {
+                _recovery.record(timing.total);
+            }
+        });
+
+        const auto _start = std::chrono::steady_clock::now();
+        const auto _deadline = _start + std::chrono::milliseconds(_durationMs);
+        while (std::chrono::steady_clock::now() < _deadline)
+        {
+            const auto _requestStart = std::chrono::steady_clock::now();
+            const bool _ret = _client->readRegistersSync(START_ADDRESS, _registers).has_value();
+            const auto _now = std::chrono::steady_clock::now();
+            _requests += 1;
+
+            if (_ret)
+            {
+                _latency.record(std::chrono::duration_cast<std::chrono::microseconds>(_now - _requestStart).count());
+
+                // 重试耗尽后请求失败，恢复时间从第一次失败的请求开始计算
+                if (_failing)
+                {
+                    _recovery.record(std::chrono::duration_cast<std::chrono::microseconds>(_now - _failedAt).count());
+                    _failing = false;
+                }
+                continue;
+            }
+
+            _failures += 1;
+            if (!_failing)
+            {
+                _failing = true;
+                _failedAt = _requestStart;
+            }
+
+            // 连接被复位时重新连接
+            if (!_client->isConnected())
+            {
+                _reconnects += 1;
+                _client->connectServer(SERVER_HOST, FAULT_SERVER_PORT, SLAVE_ID);
+            }
+        }
+
+        _client->setRequestTimingCallback(nullptr);
+        _client->setRequestTimingEnabled(false);
+
+        const double _seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - _start).count();
+        const ModbusCppLatencySnapshot _latencySnapshot = _latency.snapshot();
+        const ModbusCppLatencySnapshot _recoverySnapshot = _recovery.snapshot();
+        const ModbusCppStatisticsSnapshot _statistics = _client->getStatistics();
+
+        std::ostringstream _line;
+        _line << "{\"suite\":\"faults\""
+            << ",\"profile\":\"" << _profile.name << "\""
+            << ",\"registers\":" << static_cast<int>(_registers)
+            << ",\"requests\":" << _requests
+            << ",\"failures\":" << _failures
+            << ",\"retries\":" << _statistics.total.retries
+            << ",\"timeouts\":" << _statistics.total.timeouts
+            << ",\"exceptions\":" << _statistics.total.exceptions
+            << ",\"reconnects\":" << _reconnects
+            << ",\"requests_per_sec\":" << (_seconds > 0 ? _requests / _seconds : 0)
+            << ",\"latency_us\":{\"p50\":" << _latencySnapshot.p50
+            << ",\"p99\":" << _latencySnapshot.p99
+            << ",\"p999\":" << _latencySnapshot.p999
+            << ",\"max\":" << _latencySnapshot.max << "}"
+            << ",\"recoveries\":" << _recoverySnapshot.count
+            << ",\"recovery_us\":{\"p50\":" << _recoverySnapshot.p50
+            << ",\"p99\":" << _recoverySnapshot.p99
+            << ",\"max\":" << _recoverySnapshot.max << "}"
+            << "}";
+        std::cout << _line.str() << std::endl;
+    }
+}
+
+// 服务器测试需要同时打开客户端和服务端两侧的套接字，把文件描述符上限提到允许的最大值
+void raiseFileLimit()
+{
+#if !defined(_WIN32)
+    rlimit _limit;
+    if (0 == getrlimit(RLIMIT_NOFILE, &_limit) && _limit.rlim_cur < _limit.rlim_max)
+    {
+        _limit.rlim_cur = _limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &_limit);
+    }
+#endif
+}
+
+// 压测一个服务器并输出一行 JSON，server 为 NULL 表示每连接一个线程的对照组
+void runServerCase(const uint16_t port, const ModbusCppTcpServer *server, const int serverThreads, const size_t cacheSlots, const int connections, const int depth, const int registers)
+{
+    LoadGeneratorConfig _config;
+    _config.host = SERVER_HOST;
+    _config.port = port;
+    _config.connections = connections;
+    _config.threads = LOAD_THREADS;
+    _config.depth = depth;
+    _config.registers = registers;
+    _config.durationMs = _durationMs;
+
+    const ModbusCppServerStatistics _statisticsStart = NULL != server ? server->getStatistics() : ModbusCppServerStatistics();
+    const uint64_t _cpuStart = processCpuUsec();
+    const LoadGeneratorResult _result = LoadGenerator::run(_config);
+    const uint64_t _cpuUsec = processCpuUsec() - _cpuStart;
+    const ModbusCppServerStatistics _statistics = NULL != server ? server->getStatistics() : ModbusCppServerStatistics();
+    const uint64_t _cacheHits = _statistics.cacheHits - _statisticsStart.cacheHits;
+    const uint64_t _cacheLookups = _cacheHits + _statistics.cacheMisses - _statisticsStart.cacheMisses;
+    const uint64_t _sends = _statistics.sends - _statisticsStart.sends;
+    const uint64_t _serverRequests = _statistics.requests - _statisticsStart.requests;
+    // 服务器收发和等待的系统调用次数: io_uring 每轮只有一次 io_uring_enter，事件循环是 epoll_wait + recv + send
+    const std::string _engine = NULL != server ? server->ioEngineName() : "";
+    const uint64_t _waits = _statistics.waits - _statisticsStart.waits;
+    const uint64_t _kernelCalls = _engine == "io_uring" ? _waits : _waits + (_statistics.receives - _statisticsStart.receives) + _sends;
+
+    std::ostringstream _line;
+    _line << "{\"suite\":\"server\""
+        << ",\"server\":\"" << (serverThreads > 0 ? "reactor" : "thread_per_connection") << "\""
+        << ",\"io_engine\":\"" << _engine << "\""
+        << ",\"server_threads\":" << serverThreads
+        << ",\"response_cache_slots\":" << cacheSlots
+        << ",\"cache_hit_rate\":" << (_cacheLookups > 0 ? static_cast<double>(_cacheHits) / _cacheLookups : 0)
+        << ",\"connections\":" << connections
+        << ",\"connected\":" << _result.connected
+        << ",\"depth\":" << depth
+        << ",\"registers\":" << registers
+        << ",\"requests\":" << _result.requests
+        << ",\"errors\":" << _result.errors
+        << ",\"requests_per_sec\":" << (_result.seconds > 0 ? _result.requests / _result.seconds : 0)
+        << ",\"latency_us\":{\"min\":" << _result.latency.min
+        << ",\"mean\":" << _result.latency.mean
+        << ",\"p50\":" << _result.latency.p50
+        << ",\"p99\":" << _result.latency.p99
+        << ",\"p999\":" << _result.latency.p999
+        << ",\"max\":" << _result.latency.max << "}"
+        << ",\"cpu_us_per_request\":" << (_result.requests > 0 ? static_cast<double>(_cpuUsec) / _result.requests : 0)
+        << ",\"requests_per_send\":" << (_sends > 0 ? static_cast<double>(_serverRequests) / _sends : 0)
+        << ",\"kernel_calls_per_request\":" << (_serverRequests > 0 ? static_cast<double>(_kernelCalls) / _serverRequests : 0)
+        << "}";
+    std::cout << _line.str() << std::endl;
+}
+
+// 服务器吞吐量测试: 原始套接字压测客户端分别压不同线程数(开/关响应缓存)的 ModbusCppTcpServer 和每连接一个线程的 libmodbus 服务器
+// 所有连接轮询同一段地址，开启缓存时除了第一次都会命中；ModbusCppTcpServer 分别使用事件循环和 io_uring 收发
+void runServerSuite(const bool quick)
+{
+    raiseFileLimit();
+
+    const std::vector<int> _serverThreadCounts = quick ? std::vector<int>{ 1, 4 } : std::vector<int>{ 1, 2, 4, 8 };
+    const std::vector<int> _connectionCounts = quick ? std::vector<int>{ 1, 64, 1000 } : std::vector<int>{ 1, 16, 64, 1000, 4000 };
+    const std::vector<int> _depths = quick ? std::vector<int>{ 1, 8 } : std::vector<int>{ 1, 8, 32 };
+    const std::vector<int> _registers = quick ? std::vector<int>{ 10 } : std::vector<int>{ 1, 10, 125 };
+    const std::vector<size_t> _cacheSlotCounts = { 0, RESPONSE_CACHE_SLOTS };
+
+    ModbusCppRegisterMap _registerMap;
+    _registerMap.addRange(ModbusCppRegisterMap::Table::HOLDING_REGISTERS, 0, 0x10000);
+    // 不支持 io_uring 时 start() 会退回事件循环，只测事件循环
+    std::vector<bool> _ioUringModes = { false };
+    {
+        ModbusCppTcpServer _probe;
+        _probe.setRegisterMap(&_registerMap);
+        _probe.setIoUringEnabled(true);
+        if (_probe.start(SERVER_HOST, TCP_SERVER_PORT) && std::string(_probe.ioEngineName()) == "io_uring")
+        {
+            _ioUringModes.push_back(true);
+        }
+        _probe.stop();
+    }
+
+    for (const bool _ioUring : _ioUringModes)
+    {
+        for (const int _serverThreads : _serverThreadCounts)
+        {
+            for (const size_t _cacheSlots : _cacheSlotCounts)
+            {
+                ModbusCppTcpServer _server;
+                _server.setRegisterMap(&_registerMap);
+                _server.setThreadCount(_serverThreads);
+                _server.setResponseCacheSlots(_cacheSlots);
+                _server.setIoUringEnabled(_ioUring);
+                if (!_server.start(SERVER_HOST, TCP_SERVER_PORT))
+                {
+                    std::cerr << "启动 ModbusCppTcpServer 失败" << std::endl;
+                    return;
+                }
+
+                for (const int _connectionCount : _connectionCounts)
+                {
+                    for (const int _depth : _depths)
+                    {
+                        for (const int _registerCount : _registers)
+                        {
+                            runServerCase(TCP_SERVER_PORT, &_server, _serverThreads, _cacheSlots, _connectionCount, _depth, _registerCount);
+                        }
+                    }
+                }
+                _server.stop();
+            }
+        }
+    }
+
+    LoopbackServer _threadServer;
+    if (!_threadServer.start(SERVER_HOST, THREAD_SERVER_PORT))
+    {
+        std::cerr << "启动回环服务器失败" << std::endl;
+        return;
+    }
+    for (const int _connectionCount : _connectionCounts)
+    {
+        if (_connectionCount > THREAD_SERVER_CONNECTIONS_MAX)
+        {
+            continue;
+        }
+        for (const int _depth : _depths)
+        {
+            for (const int _registerCount : _registers)
+            {
+                runServerCase(THREAD_SERVER_PORT, NULL, 0, 0, _connectionCount, _depth, _registerCount);
+            }
+        }
+    }
+    _threadServer.stop();
+}
+
+// 寄存器存储并发测试: readers 个线程不停读取 125 个寄存器，1 个线程不停把它们写成同一个值
+// 读到的值不全相同说明读到了写入一半的数据(torn)，ModbusCppRegisterMap 应该始终为 0
+// store: seqlock_pages(主机字节序) / seqlock_pages_wire(网络字节序，读取为整块拷贝) / seqlock_pages_shared(放在共享内存段中)
+// 对照组 shared_mutex_array 是读写锁保护的普通数组(相当于给 modbus_mapping_t 加一把全局锁)
+void runRegisterMapCase(const std::string& store, const int readers)
+{
+    const bool locked = store == "shared_mutex_array";
+    ModbusCppRegisterMap _registerMap(store == "seqlock_pages_wire" ? ModbusCppRegisterMap::ByteOrder::WIRE : ModbusCppRegisterMap::ByteOrder::HOST);
+    if (store == "seqlock_pages_shared")
+    {
+        // 上次异常退出可能留下同名的段
+        ModbusCppRegisterMap::removeShared(SHARED_MAP_NAME);
+        if (!_registerMap.attachShared(SHARED_MAP_NAME, true))
+        {
+            return;
+        }
+    }
+    _registerMap.addRange(ModbusCppRegisterMap::Table::HOLDING_REGISTERS, 0, 0x10000);
+    std::vector<uint16_t> _array(0x10000, 0);
+    std::shared_mutex _arrayLock;
+
+    // 起始地址跨页，覆盖跨页读写
+    const uint16_t _address = ModbusCppRegisterMap::PAGE_SIZE - 10;
+    std::atomic<bool> _running(true);
+    std::atomic<uint64_t> _reads(0);
+    std::atomic<uint64_t> _writes(0);
+    std::atomic<uint64_t> _torn(0);
+
+    std::vector<std::thread> _threads;
+    _threads.emplace_back([&]() {
+        std::vector<uint16_t> _values(MAP_REGISTERS);
+        uint64_t _count = 0;
+        while (_running)
+        {
+            std::fill(_values.begin(), _values.end(), static_cast<uint16_t>(_count));
+            if (locked)
+            {
+                std::unique_lock<std::shared_mutex> _lock(_arrayLock);
+                std::copy(_values.begin(), _values.end(), _array.begin() + _address);
+            }
+            else
+            {
+                _registerMap.writeRegisters(ModbusCppRegisterMap::Table::HOLDING_REGISTERS, _address, _values);
+            }
+            ++_count;
+        }
+        _writes += _count;
+    });
+    for (int r = 0; r < readers; ++r)
+    {
+        _threads.emplace_back([&]() {
+            uint8_t _bytes[MAP_REGISTERS * 2];
+            uint64_t _count = 0;
+            uint64_t _tornCount = 0;
+            while (_running)
+            {
+                if (locked)
+                {
+                    std::shared_lock<std::shared_mutex> _lock(_arrayLock);
+                    for (int i = 0; i < MAP_REGISTERS; ++i)
+                    {
+                        _bytes[i * 2] = static_cast<uint8_t>(_array[_address + i] >> 8);
+                        _bytes[i * 2 + 1] = static_cast<uint8_t>(_array[_address + i] & 0xFF);
+                    }
+                }
+                else
+                {
+                    _registerMap.readRegistersEncoded(ModbusCppRegisterMap::Table::HOLDING_REGISTERS, _address, MAP_REGISTERS, _bytes);
+                }
+                if (0 != memcmp(_bytes, _bytes + 2, sizeof(_bytes) - 2))
+                {
+                    ++_tornCount;
+                }
+                ++_count;
+            }
+            _reads += _count;
+            _torn += _tornCount;
+        });
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(_durationMs));
+    _running = false;
+    for (auto& _thread : _threads)
+    {
+        _thread.join();
+    }
+    if (_registerMap.isShared())
+    {
+        ModbusCppRegisterMap::removeShared(SHARED_MAP_NAME);
+    }
+
+    const double _seconds = _durationMs / 1000.0;
+    std::cout << "{\"suite\":\"registermap\""
+        << ",\"store\":\"" << store << "\""
+        << ",\"readers\":" << readers
+        << ",\"registers\":" << MAP_REGISTERS
+        << ",\"reads_per_sec\":" << _reads / _seconds
+        << ",\"writes_per_sec\":" << _writes / _seconds
+        << ",\"torn_reads\":" << _torn
+        << "}" << std::endl;
+}
+
+// 稀疏地址测试: 4 个表在整个 0-65535 范围内每隔 SPARSE_STRIDE 个地址有一个点
+// 比较 ModbusCppRegisterMap 实际占用的内存和 modbus_mapping_new 分配整个地址空间的内存，以及单线程编码一次 FC3 响应的耗时
+void runSparseMapCase()
+{
+    typedef ModbusCppRegisterMap::Table Table;
+    ModbusCppRegisterMap _registerMap;
+    modbus_mapping_t *_mapping = modbus_mapping_new(0x10000, 0x10000, 0x10000, 0x10000);
+    int _points = 0;
+    for (uint32_t _address = SPARSE_STRIDE / 2; _address < 0x10000; _address += SPARSE_STRIDE, ++_points)
+    {
+        for (const Table _table : { Table::COILS, Table::DISCRETE_INPUTS, Table::HOLDING_REGISTERS, Table::INPUT_REGISTERS })
+        {
+            _registerMap.addRange(_table, static_cast<uint16_t>(_address), 1);
+        }
+        _registerMap.writeBits(Table::COILS, static_cast<uint16_t>(_address), { 1 });
+        _registerMap.writeBits(Table::DISCRETE_INPUTS, static_cast<uint16_t>(_address), { 1 });
+        _registerMap.writeRegisters(Table::HOLDING_REGISTERS, static_cast<uint16_t>(_address), { static_cast<uint16_t>(_address) });
+        _registerMap.writeRegisters(Table::INPUT_REGISTERS, static_cast<uint16_t>(_address), { static_cast<uint16_t>(_address) });
+    }
+    // 另外定义一段连续地址用于读取测试，只写入其中一个点，其余页保持未分配
+    _registerMap.addRange(Table::HOLDING_REGISTERS, 0, MAP_REGISTERS);
+    const size_t _denseBytes = size_t(0x10000) * 2 + size_t(0x10000) * sizeof(uint16_t) * 2;
+
+    uint8_t _bytes[MAP_REGISTERS * 2];
+    const int _iterations = 1000000;
+    auto _start = std::chrono::steady_clock::now();
+    for (int i = 0; i < _iterations; ++i)
+    {
+        _registerMap.readRegistersEncoded(Table::HOLDING_REGISTERS, 0, MAP_REGISTERS, _bytes);
+    }
+    const double _sparseNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - _start).count() / _iterations;
+
+    // 对照: modbus_reply 编码 FC3 响应的方式，逐个寄存器从连续数组读出
+    volatile uint8_t _sink = 0;
+    _start = std::chrono::steady_clock::now();
+    for (int i = 0; i < _iterations; ++i)
+    {
+        for (int j = 0; j < MAP_REGISTERS; ++j)
+        {
+            _bytes[j * 2] = static_cast<uint8_t>(_mapping->tab_registers[j] >> 8);
+            _bytes[j * 2 + 1] = static_cast<uint8_t>(_mapping->tab_registers[j] & 0xFF);
+        }
+        _sink = _sink + _bytes[i % (MAP_REGISTERS * 2)];
+    }
+    const double _denseNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - _start).count() / _iterations;
+    modbus_mapping_free(_mapping);
+
+    std::ostringstream _line;
+    _line << "{\"suite\":\"registermap\""
+        << ",\"store\":\"sparse\""
+        << ",\"points_per_table\":" << _points
+        << ",\"sparse_bytes\":" << _registerMap.allocatedBytes()
+        << ",\"dense_mapping_bytes\":" << _denseBytes
+        << ",\"registers\":" << MAP_REGISTERS
+        << ",\"sparse_read_ns\":" << _sparseNs
+        << ",\"dense_read_ns\":" << _denseNs
+        << "}";
+    std::cout << _line.str() << std::endl;
+}
+
+void runRegisterMapSuite(const bool quick)
+{
+    const std::vector<int> _readerCounts = quick ? std::vector<int>{ 1, 4 } : std::vector<int>{ 1, 2, 4, 8 };
+    for (const int _readers : _readerCounts)
+    {
+        runRegisterMapCase("seqlock_pages", _readers);
+        runRegisterMapCase("seqlock_pages_wire", _readers);
+        runRegisterMapCase("seqlock_pages_shared", _readers);
+        runRegisterMapCase("shared_mutex_array", _readers);
+    }
+    runSparseMapCase();
+}
+
+// 写入事件测试: 压测客户端不停发送 FC16，每个事件循环线程配一个消费线程忙等读取写入事件
+// 统计事件数、丢弃数和从写入寄存器存储到消费线程取到事件的延迟
+void runWriteEventSuite(const bool quick)
+{
+    const std::vector<int> _serverThreadCounts = quick ? std::vector<int>{ 1 } : std::vector<int>{ 1, 4 };
+    ModbusCppRegisterMap _registerMap;
+    _registerMap.addRange(ModbusCppRegisterMap::Table::HOLDING_REGISTERS, 0, 0x10000);
+    for (const int _serverThreads : _serverThreadCounts)
+    {
+        ModbusCppTcpServer _server;
+        _server.setRegisterMap(&_registerMap);
+        _server.setThreadCount(_serverThreads);
+        _server.setWriteEventCapacity(WRITE_EVENT_CAPACITY);
+        if (!_server.start(SERVER_HOST, TCP_SERVER_PORT))
+        {
+            std::cerr << "启动 ModbusCppTcpServer 失败" << std::endl;
+            return;
+        }
+
+        std::atomic<bool> _stop(false);
+        std::atomic<uint64_t> _events(0);
+        ModbusCppLatencyHistogram _latency;
+        std::vector<std::thread> _consumers;
+        for (int i = 0; i < _serverThreads; ++i)
+        {
+            ModbusCppWriteEventRing *_ring = _server.writeEvents(i);
+            _consumers.emplace_back([&, _ring]() {
+                ModbusCppWriteEvent _event;
+                uint64_t _count = 0;
+                while (!_stop)
+                {
+                    if (!_ring->pop(_event))
+                    {
+                        std::this_thread::yield();
+                        continue;
+                    }
+                    const uint64_t _now = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+                    _latency.record(_now - _event.timestamp);
+                    ++_count;
+                }
+                _events += _count;
+                });
+        }
+
+        LoadGeneratorConfig _config;
+        _config.host = SERVER_HOST;
+        _config.port = TCP_SERVER_PORT;
+        _config.connections = THREAD_SERVER_CONNECTIONS_MAX;
+        _config.threads = LOAD_THREADS;
+        _config.registers = 10;
+        _config.write = true;
+        _config.durationMs = _durationMs;
+        const LoadGeneratorResult _result = LoadGenerator::run(_config);
+
+        // 等消费线程取完剩余事件
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        _stop = true;
+        for (auto& _consumer : _consumers)
+        {
+            _consumer.join();
+        }
+        uint64_t _dropped = 0;
+        for (int i = 0; i < _serverThreads; ++i)
+        {
+            _dropped += _server.writeEvents(i)->dropped();
+        }
+        _server.stop();
+
+        const ModbusCppLatencySnapshot _snapshot = _latency.snapshot();
+        std::ostringstream _line;
+        _line << "{\"suite\":\"writeevents\""
+            << ",\"server_threads\":" << _serverThreads
+            << ",\"connections\":" << _config.connections
+            << ",\"requests\":" << _result.requests
+            << ",\"errors\":" << _result.errors
+            << ",\"requests_per_sec\":" << (_result.seconds > 0 ? _result.requests / _result.seconds : 0)
+            << ",\"events\":" << _events
+            << ",\"dropped\":" << _dropped
+            << ",\"event_latency_us\":{\"min\":" << _snapshot.min
+            << ",\"mean\":" << _snapshot.mean
+            << ",\"p50\":" << _snapshot.p50
+            << ",\"p99\":" << _snapshot.p99
+            << ",\"p999\":" << _snapshot.p999
+            << ",\"max\":" << _snapshot.max << "}"
+            << "}";
+        std::cout << _line.str() << std::endl;
+    }
+}
+
+// 代理测试: 回环服务器模拟 PLC，ModbusCppTcpProxy 每 100ms 轮询一次，压测客户端以不同连接数从代理读取
+// 上游每秒请求数应该只由轮询周期决定，与下游连接数无关
+void runProxySuite(const bool quick)
+{
+    raiseFileLimit();
+
+    const std::vector<int> _connectionCounts = quick ? std::vector<int>{ 1, 64 } : std::vector<int>{ 1, 16, 64, 1000 };
+    LoopbackServer _upstream;
+    if (!_upstream.start(SERVER_HOST, PROXY_UPSTREAM_PORT))
+    {
+        std::cerr << "启动回环服务器失败" << std::endl;
+        return;
+    }
+
+    ModbusCppTcpProxy _proxy;
+    _proxy.setUpstream(SERVER_HOST, PROXY_UPSTREAM_PORT, SLAVE_ID);
+    _proxy.addPollBlock(START_ADDRESS, MAP_REGISTERS, PROXY_POLL_INTERVAL_MS);
+    if (!_proxy.start(SERVER_HOST, PROXY_PORT))
+    {
+        std::cerr << "启动 ModbusCppTcpProxy 失败" << std::endl;
+        return;
+    }
+
+    for (const int _connectionCount : _connectionCounts)
+    {
+        LoadGeneratorConfig _config;
+        _config.host = SERVER_HOST;
+        _config.port = PROXY_PORT;
+        _config.connections = _connectionCount;
+        _config.threads = LOAD_THREADS;
+        _config.registers = 10;
+        _config.durationMs = _durationMs;
+
+        const uint64_t _upstreamStart = _proxy.getUpstreamStatistics().total.requests;
+        const LoadGeneratorResult _result = LoadGenerator::run(_config);
+        const uint64_t _upstreamRequests = _proxy.getUpstreamStatistics().total.requests - _upstreamStart;
+
+        std::ostringstream _line;
+        _line << "{\"suite\":\"proxy\""
+            << ",\"poll_interval_ms\":" << PROXY_POLL_INTERVAL_MS
+            << ",\"connections\":" << _connectionCount
+            << ",\"connected\":" << _result.connected
+            << ",\"requests\":" << _result.requests
+            << ",\"errors\":" << _result.errors
+            << ",\"requests_per_sec\":" << (_result.seconds > 0 ? _result.requests / _result.seconds : 0)
+            << ",\"upstream_requests\":" << _upstreamRequests
+            << ",\"upstream_requests_per_sec\":" << (_result.seconds > 0 ? _upstreamRequests / _result.seconds : 0)
+            << ",\"latency_us\":{\"p50\":" << _result.latency.p50
+            << ",\"p99\":" << _result.latency.p99 << "}"
+            << "}";
+        std::cout << _line.str() << std::endl;
+    }
+
+    _proxy.stop();
+    _upstream.stop();
+}
+
+// 网关测试(仅 Linux): 伪终端模拟的 RTU 从站接在 ModbusCppRtuGateway 后面，不同数量的 TCP 主站同时读取 10 个寄存器
+// 总线一次只能执行一个请求，吞吐量受波特率限制，主站越多排队时间越长，总线利用率应接近 1
+void runGatewaySuite(const bool quick)
+{
+    const std::vector<int> _bauds = quick ? std::vector<int>{ 115200 } : std::vector<int>{ 19200, 115200 };
+    const std::vector<int> _connectionCounts = quick ? std::vector<int>{ 1, 16 } : std::vector<int>{ 1, 4, 16, 64 };
+
+    ModbusCppRegisterMap _registerMap;
+    _registerMap.addRange(ModbusCppRegisterMap::Table::HOLDING_REGISTERS, 0, 0x10000);
+    for (const int _baud : _bauds)
+    {
+        ModbusCppSerialConfig _serial;
+        _serial.baud = _baud;
+        PtyRtuSlave _slave;
+        if (!_slave.start(_serial, &_registerMap))
+        {
+            std::cerr << "创建伪终端失败(只支持 Linux)" << std::endl;
+            return;
+        }
+
+        _serial.device = _slave.devicePath();
+        ModbusCppRtuGateway _gateway;
+        _gateway.addBus(_serial);
+        if (!_gateway.start(SERVER_HOST, GATEWAY_PORT))
+        {
+            std::cerr << "启动 ModbusCppRtuGateway 失败" << std::endl;
+            return;
+        }
+
+        for (const int _connectionCount : _connectionCounts)
+        {
+            LoadGeneratorConfig _config;
+            _config.host = SERVER_HOST;
+            _config.port = GATEWAY_PORT;
+            _config.connections = _connectionCount;
+            _config.threads = 1;
+            _config.registers = 10;
+            _config.durationMs = _durationMs;
+
+            const ModbusCppGatewayBusStatistics _start = _gateway.getStatistics().buses[0];
+            const LoadGeneratorResult _result = LoadGenerator::run(_config);
+            const ModbusCppGatewayBusStatistics _bus = _gateway.getStatistics().buses[0];
+            const double _busySeconds = (_bus.busyUsec - _start.busyUsec) / 1e6;
+
+            std::ostringstream _line;
+            _line << "{\"suite\":\"gateway\""
+                << ",\"baud\":" << _baud
+                << ",\"connections\":" << _connectionCount
+                << ",\"requests\":" << _result.requests
+                << ",\"errors\":" << _result.errors
+                << ",\"requests_per_sec\":" << (_result.seconds > 0 ? _result.requests / _result.seconds : 0)
+                << ",\"bus_utilization\":" << (_result.seconds > 0 ? std::min(1.0, _busySeconds / _result.seconds) : 0)
+                << ",\"queue_depth_max\":" << _bus.queueDepthMax
+                << ",\"queue_wait_us\":{\"p50\":" << _bus.queueWait.p50
+                << ",\"p99\":" << _bus.queueWait.p99 << "}"
+                << ",\"transaction_us\":{\"p50\":" << _bus.transaction.p50
+                << ",\"p99\":" << _bus.transaction.p99 << "}"
+                << ",\"latency_us\":{\"p50\":" << _result.latency.p50
+                << ",\"p99\":" << _result.latency.p99 << "}"
+                << "}";
+            std::cout << _line.str() << std::endl;
+        }
+
+        _gateway.stop();
+        _slave.stop();
+    }
+}
+
+// RTU 客户端测试(仅 Linux): 伪终端模拟的从站按波特率分块回复，ModbusCppRtuClient 和 libmodbus 的 RTU 后端分别不停读取 125 个寄存器
+// wire_limit 是按帧间隔 + 请求和响应的传输时间算出的理论上限，libmodbus 不等帧间隔，可能略高于该值
+void runRtuSuite(const bool quick)
+{
+    const std::vector<int> _bauds = quick ? std::vector<int>{ 115200 } : std::vector<int>{ 19200, 115200, 921600 };
+    ModbusCppRegisterMap _registerMap;
+    _registerMap.addRange(ModbusCppRegisterMap::Table::HOLDING_REGISTERS, 0, 0x10000);
+    for (const int _baud : _bauds)
+    {
+        for (const std::string _client : { "modbuscpp", "libmodbus" })
+        {
+            ModbusCppSerialConfig _serial;
+            _serial.baud = _baud;
+            PtyRtuSlave _slave;
+            _slave.setChunkBytes(RTU_CHUNK_BYTES);
+            if (!_slave.start(_serial, &_registerMap))
+            {
+                std::cerr << "创建伪终端失败(只支持 Linux)" << std::endl;
+                return;
+            }
+            _serial.device = _slave.devicePath();
+
+            ModbusCppRtuClient _rtuClient;
+            modbus_t *_context = NULL;
+            if ("modbuscpp" == _client)
+            {
+                _rtuClient.open(_serial);
+            }
+            else
+            {
+                _context = modbus_new_rtu(_serial.device.c_str(), _baud, _serial.parity, _serial.dataBits, _serial.stopBits);
+                modbus_set_slave(_context, SLAVE_ID);
+                modbus_connect(_context);
+            }
+
+            uint64_t _requests = 0;
+            uint64_t _failures = 0;
+            uint16_t _values[MAP_REGISTERS];
+            const auto _start = std::chrono::steady_clock::now();
+            const auto _end = _start + std::chrono::milliseconds(_durationMs);
+            while (std::chrono::steady_clock::now() < _end)
+            {
+                const bool _ok = NULL == _context ? _rtuClient.readHoldingRegisters(SLAVE_ID, START_ADDRESS, MAP_REGISTERS).has_value()
+                    : MAP_REGISTERS == modbus_read_registers(_context, START_ADDRESS, MAP_REGISTERS, _values);
+                ++_requests;
+                _failures += _ok ? 0 : 1;
+            }
+            const double _seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - _start).count();
+            const ModbusCppRtuStatistics _statistics = _rtuClient.getStatistics();
+            if (NULL != _context)
+            {
+                modbus_close(_context);
+                modbus_free(_context);
+            }
+            _rtuClient.close();
+            _slave.stop();
+
+            // 请求 8 字节，响应 5 + 250 字节
+            const double _wireUsec = _serial.frameGapUsec() + static_cast<double>(_serial.frameUsec(8 + 5 + MAP_REGISTERS * 2));
+            std::ostringstream _line;
+            _line << "{\"suite\":\"rtu\""
+                << ",\"client\":\"" << _client << "\""
+                << ",\"baud\":" << _baud
+                << ",\"registers\":" << MAP_REGISTERS
+                << ",\"requests\":" << _requests
+                << ",\"failures\":" << _failures
+                << ",\"requests_per_sec\":" << _requests / _seconds
+                << ",\"wire_limit_per_sec\":" << 1e6 / _wireUsec;
+            if (NULL == _context)
+            {
+                _line << ",\"reads_per_request\":" << (_statistics.requests > 0 ? static_cast<double>(_statistics.readCalls) / _statistics.requests : 0);
+            }
+            _line << "}";
+            std::cout << _line.str() << std::endl;
+        }
+    }
+}
+
+// 总线扫描测试(仅 Linux): 115200 波特率的总线上有 16 个从站，其中 2 个不应答，每个从站 4 个扫描项(3 段保持寄存器 + 1 段输入寄存器)
+// roundrobin 按顺序逐项读取(离线从站每项都等到超时)，scheduler 为 ModbusCppRtuScheduler(合并相邻扫描项 + 离线退避)
+// cycle_ms 为在线从站同一扫描项两次成功读取的间隔，目标是等于扫描周期
+void runScanSuite(const bool quick)
+{
+    struct Scan
+    {
+        ModbusCppRegisterMap::Table table;
+        uint16_t startAddress;
+        uint16_t count;
+    };
+    const std::vector<Scan> _scans = {
+        { ModbusCppRegisterMap::Table::HOLDING_REGISTERS, 0, 10 },
+        { ModbusCppRegisterMap::Table::HOLDING_REGISTERS, 12, 10 },
+        { ModbusCppRegisterMap::Table::HOLDING_REGISTERS, 24, 4 },
+        { ModbusCppRegisterMap::Table::INPUT_REGISTERS, 0, 8 },
+    };
+    const std::vector<uint8_t> _silentSlaves = { 5, 12 };
+
+    ModbusCppRegisterMap _registerMap;
+    _registerMap.addRange(ModbusCppRegisterMap::Table::HOLDING_REGISTERS, 0, 64);
+    _registerMap.addRange(ModbusCppRegisterMap::Table::INPUT_REGISTERS, 0, 64);
+    const int _durationScanMs = std::max(_durationMs, quick ? 2000 : 5000);
+    for (const std::string _mode : { "roundrobin", "scheduler" })
+    {
+        ModbusCppSerialConfig _serial;
+        _serial.baud = 115200;
+        PtyRtuSlave _slave;
+        _slave.setUnits(1, SCAN_SLAVES);
+        _slave.setChunkBytes(RTU_CHUNK_BYTES);
+        for (const uint8_t _unit : _silentSlaves)
+        {
+            _slave.setSilent(_unit, true);
+        }
+        if (!_slave.start(_serial, &_registerMap))
+        {
+            std::cerr << "创建伪终端失败(只支持 Linux)" << std::endl;
+            return;
+        }
+        _serial.device = _slave.devicePath();
+
+        ModbusCppLatencyHistogram _cycle;
+        uint64_t _requests = 0;
+        uint64_t _timeouts = 0;
+        size_t _busRequests = 0;
+        double _utilization = 0;
+        if ("roundrobin" == _mode)
+        {
+            ModbusCppRtuClient _rtuClient;
+            _rtuClient.setResponseTimeout(SCAN_TIMEOUT_MS);
+            _rtuClient.open(_serial);
+            _busRequests = _scans.size() * SCAN_SLAVES;
+            // 每轮把所有扫描项读一遍，一轮不到周期就等到周期结束
+            auto _roundStart = std::chrono::steady_clock::now();
+            const auto _end = _roundStart + std::chrono::milliseconds(_durationScanMs);
+            auto _lastRound = _roundStart;
+            bool _first = true;
+            while (std::chrono::steady_clock::now() < _end)
+            {
+                _roundStart = std::chrono::steady_clock::now();
+                if (!_first)
+                {
+                    _cycle.record(std::chrono::duration_cast<std::chrono::microseconds>(_roundStart - _lastRound).count());
+                }
+                _first = false;
+                _lastRound = _roundStart;
+                for (uint8_t _unit = 1; _unit <= SCAN_SLAVES; ++_unit)
+                {
+                    for (const Scan& _scan : _scans)
+                    {
+                        const bool _ok = ModbusCppRegisterMap::Table::HOLDING_REGISTERS == _scan.table
+                            ? _rtuClient.readHoldingRegisters(_unit, _scan.startAddress, _scan.count).has_value()
+                            : _rtuClient.readInputRegisters(_unit, _scan.startAddress, _scan.count).has_value();
+                        ++_requests;
+                        _timeouts += !_ok && ModbusCppRtuClient::Result::TIMEOUT == _rtuClient.lastResult() ? 1 : 0;
+                    }
+                }
+                std::this_thread::sleep_until(_roundStart + std::chrono::milliseconds(SCAN_PERIOD_MS));
+            }
+            _rtuClient.close();
+        }
+        else
+        {
+            ModbusCppRtuScheduler _scheduler;
+            _scheduler.setResponseTimeout(SCAN_TIMEOUT_MS);
+            for (uint8_t _unit = 1; _unit <= SCAN_SLAVES; ++_unit)
+            {
+                for (const Scan& _scan : _scans)
+                {
+                    _scheduler.addScan(_unit, _scan.table, _scan.startAddress, _scan.count, SCAN_PERIOD_MS);
+                }
+            }
+            _scheduler.start(_serial);
+            std::this_thread::sleep_for(std::chrono::milliseconds(_durationScanMs));
+            const ModbusCppRtuSchedulerStatistics _statistics = _scheduler.getStatistics();
+            _scheduler.stop();
+
+            // 各在线从站里最差的周期
+            for (const ModbusCppRtuSlaveStatistics& _slaveStatistics : _statistics.slaves)
+            {
+                if (_slaveStatistics.online && _slaveStatistics.cycle.count > 0)
+                {
+                    _cycle.record(_slaveStatistics.cycle.p50);
+                    _cycle.record(_slaveStatistics.cycle.max);
+                }
+            }
+            _requests = _statistics.requests;
+            _timeouts = _statistics.client.timeouts;
+            _busRequests = _statistics.scanRequests;
+            _utilization = _statistics.utilization;
+        }
+        _slave.stop();
+
+        const ModbusCppLatencySnapshot _snapshot = _cycle.snapshot();
+        std::ostringstream _line;
+        _line << "{\"suite\":\"scan\""
+            << ",\"mode\":\"" << _mode << "\""
+            << ",\"slaves\":" << int(SCAN_SLAVES)
+            << ",\"silent_slaves\":" << _silentSlaves.size()
+            << ",\"period_ms\":" << SCAN_PERIOD_MS
+            << ",\"requests_per_cycle\":" << _busRequests
+            << ",\"requests\":" << _requests
+            << ",\"timeouts\":" << _timeouts
+            << ",\"cycle_ms\":{\"p50\":" << _snapshot.p50 / 1000.0
+            << ",\"max\":" << _snapshot.max / 1000.0 << "}";
+        if ("scheduler" == _mode)
+        {
+            _line << ",\"bus_utilization\":" << _utilization;
+        }
+        _line << "}";
+        std::cout << _line.str() << std::endl;
+    }
+}
+
+// 广播测试(仅 Linux): 给 40 个从站写同一组 4 个寄存器的设定值，逐个写入和一次广播(默认 100 毫秒广播延时)各自占用的总线时间
+// 两种方式最后都读一次从站 1，总线时间包含广播延时；之后由 ModbusCppRtuScheduler 广播并在扫描间隙回读校验所有从站
+void runBroadcastSuite(const bool quick)
+{
+    const std::vector<int> _bauds = quick ? std::vector<int>{ 19200 } : std::vector<int>{ 9600, 19200, 115200 };
+    ModbusCppRegisterMap _registerMap;
+    _registerMap.addRange(ModbusCppRegisterMap::Table::HOLDING_REGISTERS, 0, 128);
+    uint16_t _setpoint = 0;
+    for (const int _baud : _bauds)
+    {
+        ModbusCppSerialConfig _serial;
+        _serial.baud = _baud;
+        PtyRtuSlave _slave;
+        _slave.setUnits(1, BROADCAST_SLAVES);
+        if (!_slave.start(_serial, &_registerMap))
+        {
+            std::cerr << "创建伪终端失败(只支持 Linux)" << std::endl;
+            return;
+        }
+        _serial.device = _slave.devicePath();
+
+        double _busMs[2] = { 0, 0 };
+        bool _written[2] = { true, true };
+        ModbusCppRtuClient _rtuClient;
+        _rtuClient.open(_serial);
+        for (int _mode = 0; _mode < 2; ++_mode)
+        {
+            ++_setpoint;
+            const std::vector<uint16_t> _values(4, _setpoint);
+            const auto _start = std::chrono::steady_clock::now();
+            if (0 == _mode)
+            {
+                for (uint8_t _unit = 1; _unit <= BROADCAST_SLAVES; ++_unit)
+                {
+                    _written[_mode] = _rtuClient.writeRegisters(_unit, SETPOINT_ADDRESS, _values) && _written[_mode];
+                }
+            }
+            else
+            {
+                _written[_mode] = _rtuClient.writeRegisters(MODBUS_BROADCAST_ADDRESS, SETPOINT_ADDRESS, _values);
+            }
+            const std::optional<std::vector<uint16_t>> _readBack = _rtuClient.readHoldingRegisters(1, SETPOINT_ADDRESS, 4);
+            _busMs[_mode] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - _start).count();
+            _written[_mode] = _written[_mode] && _readBack && *_readBack == _values;
+        }
+        _rtuClient.close();
+
+        // 调度器: 每个从站每 2 秒扫描一次设定值(9600 波特率下总线约六成忙)，广播后在扫描间隙回读校验
+        ModbusCppRtuScheduler _scheduler;
+        _scheduler.setVerifyBroadcasts(true);
+        for (uint8_t _unit = 1; _unit <= BROADCAST_SLAVES; ++_unit)
+        {
+            _scheduler.addScan(_unit, ModbusCppRegisterMap::Table::HOLDING_REGISTERS, SETPOINT_ADDRESS, 4, 2000);
+        }
+        _scheduler.start(_serial);
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        ++_setpoint;
+        const auto _start = std::chrono::steady_clock::now();
+        _scheduler.broadcastRegisters(SETPOINT_ADDRESS, std::vector<uint16_t>(2, _setpoint));
+        _scheduler.broadcastRegisters(SETPOINT_ADDRESS + 2, std::vector<uint16_t>(2, _setpoint));
+        ModbusCppRtuSchedulerStatistics _statistics = _scheduler.getStatistics();
+        while (_statistics.verifications < BROADCAST_SLAVES && std::chrono::steady_clock::now() - _start < std::chrono::seconds(10))
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            _statistics = _scheduler.getStatistics();
+        }
+        const double _verifyMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - _start).count();
+        _scheduler.stop();
+        _slave.stop();
+
+        std::ostringstream _line;
+        _line << "{\"suite\":\"broadcast\""
+            << ",\"baud\":" << _baud
+            << ",\"slaves\":" << int(BROADCAST_SLAVES)
+            << ",\"unicast_bus_ms\":" << _busMs[0]
+            << ",\"broadcast_bus_ms\":" << _busMs[1]
+            << ",\"bus_time_saved\":" << (_busMs[0] > 0 ? 1 - _busMs[1] / _busMs[0] : 0)
+            << ",\"written\":" << (_written[0] && _written[1] ? "true" : "false")
+            << ",\"scheduler_broadcasts\":" << _statistics.broadcasts
+            << ",\"verifications\":" << _statistics.verifications
+            << ",\"verify_mismatches\":" << _statistics.verifyMismatches
+            << ",\"verify_ms\":" << _verifyMs
+            << "}";
+        std::cout << _line.str() << std::endl;
+    }
+}
+
+// 保存 CRC 计算结果，避免被编译器优化掉
+volatile uint32_t _crcSink = 0;
+
+// CRC 测试: 先用随机帧(0 ~ 256 字节)核对 modbusCrc16 与 libmodbus RTU 后端的 crc16()(通过 send_msg_pre 追加 CRC)逐位相同
+// 再对常见帧长度分别测两者每帧耗时和吞吐量
+void runCrcSuite(const bool quick)
+{
+    const size_t FRAME_MAX = MODBUS_RTU_MAX_ADU_LENGTH;
+    modbus_t *_context = modbus_new_rtu("crc", 9600, 'N', 8, 1);
+    if (NULL == _context)
+    {
+        std::cerr << "创建 RTU 上下文失败" << std::endl;
+        return;
+    }
+
+    uint8_t _frame[FRAME_MAX + 2];
+    uint32_t _seed = 12345;
+    auto _random = [&_seed]() {
+        _seed = _seed * 1103515245 + 12345;
+        return static_cast<uint8_t>(_seed >> 16);
+    };
+
+    uint64_t _checked = 0;
+    uint64_t _mismatches = 0;
+    const int _rounds = quick ? 200 : 2000;
+    for (int _round = 0; _round < _rounds; ++_round)
+    {
+        for (size_t _length = 0; _length <= FRAME_MAX; ++_length)
+        {
+            for (size_t i = 0; i < _length; ++i)
+            {
+                _frame[i] = _random();
+            }
+            _context->backend->send_msg_pre(_frame, static_cast<int>(_length));
+            const uint16_t _expected = static_cast<uint16_t>(_frame[_length] | (_frame[_length + 1] << 8));
+            _mismatches += modbusCrc16(_frame, _length) == _expected ? 0 : 1;
+            ++_checked;
+        }
+    }
+    std::cout << "{\"suite\":\"crc\",\"test\":\"equivalence\",\"frames\":" << _checked << ",\"mismatches\":" << _mismatches << "}" << std::endl;
+
+    for (const size_t _length : { 8, 64, 256 })
+    {
+        for (size_t i = 0; i < _length; ++i)
+        {
+            _frame[i] = _random();
+        }
+        for (const std::string _implementation : { "libmodbus", "modbuscpp" })
+        {
+            // 每帧改一个字节，避免计算被编译器提到循环外
+            uint64_t _frames = 0;
+            uint32_t _sink = 0;
+            const auto _start = std::chrono::steady_clock::now();
+            const auto _end = _start + std::chrono::milliseconds(quick ? 200 : 1000);
+            while (std::chrono::steady_clock::now() < _end)
+            {
+                for (int i = 0; i < 1000; ++i)
+                {
+                    _frame[0] = static_cast<uint8_t>(_frames + i);
+                    if ("libmodbus" == _implementation)
+                    {
+                        _context->backend->send_msg_pre(_frame, static_cast<int>(_length));
+                        _sink += _frame[_length];
+                    }
+                    else
+                    {
+                        _sink += modbusCrc16(_frame, _length);
+                    }
+                }
+                _frames += 1000;
+            }
+            const double _seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - _start).count();
+            _crcSink = _sink;
+
+            std::ostringstream _line;
+            _line << "{\"suite\":\"crc\""
+                << ",\"implementation\":\"" << _implementation << "\""
+                << ",\"frame_bytes\":" << _length
+                << ",\"ns_per_frame\":" << _seconds * 1e9 / _frames
+                << ",\"mb_per_sec\":" << _frames * _length / _seconds / 1e6
+                << "}";
+            std::cout << _line.str() << std::endl;
+        }
+    }
+    modbus_free(_context);
+}
+
+// RTU over TCP 测试: ModbusCppRtuClient 通过 TCP 连接进程内的 RtuOverTcpServer 连续读取 125 个寄存器，对照组为 libmodbus 通过 MBAP 读取回环服务器
+// chunked 模式下服务器把响应拆成 16 字节的报文段、段间隔 1 毫秒，模拟边收边转发的串口服务器，检查拆包后仍然整帧接收
+void runRtuTcpSuite(const bool quick)
+{
+    ModbusCppRegisterMap _registerMap;
+    _registerMap.addRange(ModbusCppRegisterMap::Table::HOLDING_REGISTERS, 0, MAP_REGISTERS);
+    LoopbackServer _loopback;
+    if (!_loopback.start(SERVER_HOST, RTU_TCP_MBAP_PORT))
+    {
+        std::cerr << "启动回环服务器失败" << std::endl;
+        return;
+    }
+
+    for (const std::string _mode : { "mbap", "rtu", "rtu_chunked" })
+    {
+        RtuOverTcpServer _server;
+        ModbusCppRtuClient _rtuClient;
+        modbus_t *_context = NULL;
+        if ("mbap" == _mode)
+        {
+            _context = modbus_new_tcp(SERVER_HOST.c_str(), RTU_TCP_MBAP_PORT);
+            modbus_set_slave(_context, SLAVE_ID);
+            if (-1 == modbus_connect(_context))
+            {
+                std::cerr << "连接回环服务器失败" << std::endl;
+                modbus_free(_context);
+                continue;
+            }
+        }
+        else
+        {
+            if ("rtu_chunked" == _mode)
+            {
+                _server.setChunking(16, 1000);
+            }
+            if (!_server.start(SERVER_HOST, RTU_TCP_PORT, &_registerMap) || !_rtuClient.connectTcp(SERVER_HOST, RTU_TCP_PORT))
+            {
+                std::cerr << "启动 RTU over TCP 服务器失败" << std::endl;
+                continue;
+            }
+        }
+
+        ModbusCppLatencyHistogram _latency;
+        uint64_t _requests = 0;
+        uint64_t _failures = 0;
+        uint16_t _values[MAP_REGISTERS];
+        const uint64_t _cpuStart = processCpuUsec();
+        const auto _start = std::chrono::steady_clock::now();
+        const auto _end = _start + std::chrono::milliseconds(quick ? std::min(_durationMs, 500) : _durationMs);
+        while (std::chrono::steady_clock::now() < _end)
+        {
+            const auto _requestStart = std::chrono::steady_clock::now();
+            const bool _ok = NULL == _context ? _rtuClient.readHoldingRegisters(SLAVE_ID, START_ADDRESS, MAP_REGISTERS).has_value()
+                : MAP_REGISTERS == modbus_read_registers(_context, START_ADDRESS, MAP_REGISTERS, _values);
+            _latency.record(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - _requestStart).count());
+            ++_requests;
+            _failures += _ok ? 0 : 1;
+        }
+        const double _seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - _start).count();
+        const uint64_t _cpuUsec = processCpuUsec() - _cpuStart;
+        const ModbusCppRtuStatistics _statistics = _rtuClient.getStatistics();
+        if (NULL != _context)
+        {
+            modbus_close(_context);
+            modbus_free(_context);
+        }
+        _rtuClient.close();
+        _server.stop();
+
+        const ModbusCppLatencySnapshot _snapshot = _latency.snapshot();
+        std::ostringstream _line;
+        _line << "{\"suite\":\"rtutcp\""
+            << ",\"mode\":\"" << _mode << "\""
+            << ",\"registers\":" << MAP_REGISTERS
+            << ",\"requests\":" << _requests
+            << ",\"failures\":" << _failures
+            << ",\"requests_per_sec\":" << _requests / _seconds
+            << ",\"cpu_us_per_request\":" << (_requests > 0 ? static_cast<double>(_cpuUsec) / _requests : 0)
+            << ",\"latency_us\":{\"p50\":" << _snapshot.p50
+            << ",\"p99\":" << _snapshot.p99 << "}";
+        if (NULL == _context)
+        {
+            _line << ",\"reads_per_request\":" << (_statistics.requests > 0 ? static_cast<double>(_statistics.readCalls) / _statistics.requests : 0)
+                << ",\"frame_errors\":" << _statistics.frameErrors;
+        }
+        _line << "}";
+        std::cout << _line.str() << std::endl;
+    }
+    _loopback.stop();
+}
+
+// 多总线测试(仅 Linux): N 条 115200 波特率的伪终端总线，每条总线上一个从站，请求一个接一个不间断地发送
+// threads 每条总线一个线程各自调用 ModbusCppRtuClient，loop 所有总线由一个 ModbusCppRtuBusLoop 线程驱动
+// cpu_us_per_request 为整个进程的 CPU 时间(含模拟从站的线程，两种方式相同)，wire_limit_per_sec 为所有总线的理论上限之和
+void runMultiBusSuite(const bool quick)
+{
+    const std::vector<int> _busCounts = quick ? std::vector<int>{ 4, 16 } : std::vector<int>{ 4, 16, 32 };
+    ModbusCppRegisterMap _registerMap;
+    _registerMap.addRange(ModbusCppRegisterMap::Table::HOLDING_REGISTERS, 0, MAP_REGISTERS);
+    for (const int _busCount : _busCounts)
+    {
+        for (const std::string _mode : { "threads", "loop" })
+        {
+            std::vector<PtyRtuSlave *> _slaves;
+            std::vector<ModbusCppSerialConfig> _serials;
+            for (int i = 0; i < _busCount; ++i)
+            {
+                ModbusCppSerialConfig _serial;
+                _serial.baud = 115200;
+                PtyRtuSlave *_slave = new PtyRtuSlave();
+                _slave->setChunkBytes(RTU_CHUNK_BYTES);
+                if (!_slave->start(_serial, &_registerMap))
+                {
+                    std::cerr << "创建伪终端失败(只支持 Linux)" << std::endl;
+                    delete _slave;
+                    break;
+                }
+                _serial.device = _slave->devicePath();
+                _slaves.push_back(_slave);
+                _serials.push_back(_serial);
+            }
+
+            std::atomic<uint64_t> _requests(0);
+            std::atomic<uint64_t> _failures(0);
+            std::atomic<bool> _running(true);
+            uint64_t _readCalls = 0;
+            uint64_t _busRequests = 0;
+            uint64_t _iterations = 0;
+            ModbusCppLatencySnapshot _latency;
+            const uint64_t _cpuStart = processCpuUsec();
+            const auto _start = std::chrono::steady_clock::now();
+            const auto _duration = std::chrono::milliseconds(quick ? std::min(_durationMs, 500) : _durationMs);
+            if ("threads" == _mode)
+            {
+                std::vector<ModbusCppRtuClient *> _rtuClients;
+                std::vector<std::thread> _threads;
+                for (const ModbusCppSerialConfig& _serial : _serials)
+                {
+                    ModbusCppRtuClient *_rtuClient = new ModbusCppRtuClient();
+                    _rtuClient->open(_serial);
+                    _rtuClients.push_back(_rtuClient);
+                    _threads.emplace_back([&, _rtuClient]()
+                        {
+                            while (_running)
+                            {
+                                const bool _ok = _rtuClient->readHoldingRegisters(SLAVE_ID, START_ADDRESS, MULTIBUS_REGISTERS).has_value();
+                                _requests.fetch_add(1, std::memory_order_relaxed);
+                                _failures.fetch_add(_ok ? 0 : 1, std::memory_order_relaxed);
+                            }
+                        });
+                }
+                std::this_thread::sleep_for(_duration);
+                _running = false;
+                for (std::thread& _thread : _threads)
+                {
+                    _thread.join();
+                }
+                for (ModbusCppRtuClient *_rtuClient : _rtuClients)
+                {
+                    const ModbusCppRtuStatistics _statistics = _rtuClient->getStatistics();
+                    _readCalls += _statistics.readCalls;
+                    _busRequests += _statistics.requests;
+                    if (_rtuClients.front() == _rtuClient)
+                    {
+                        _latency = _statistics.latency;
+                    }
+                    delete _rtuClient;
+                }
+            }
+            else
+            {
+                ModbusCppRtuBusLoop _loop;
+                for (const ModbusCppSerialConfig& _serial : _serials)
+                {
+                    _loop.addBus(_serial);
+                }
+                if (!_loop.start())
+                {
+                    std::cerr << "启动多总线事件循环失败" << std::endl;
+                }
+
+                // 每条总线保持一个未完成的请求，完成回调里发出下一个
+                std::function<void (const int)> _issue = [&](const int bus)
+                    {
+                        _loop.readHoldingRegisters(bus, SLAVE_ID, START_ADDRESS, MULTIBUS_REGISTERS,
+                            [&, bus](const ModbusCppRtuBusLoop::Result result, const std::vector<uint16_t> &)
+                            {
+                                // 停止后正在执行的请求以 IO_ERROR 完成，不计入结果
+                                if (!_running)
+                                {
+                                    return;
+                                }
+                                _requests.fetch_add(1, std::memory_order_relaxed);
+                                _failures.fetch_add(ModbusCppRtuBusLoop::Result::OK == result ? 0 : 1, std::memory_order_relaxed);
+                                _issue(bus);
+                            });
+                    };
+                for (int i = 0; i < static_cast<int>(_serials.size()); ++i)
+                {
+                    _issue(i);
+                }
+                std::this_thread::sleep_for(_duration);
+                _running = false;
+
+                const ModbusCppRtuBusLoopStatistics _statistics = _loop.getStatistics();
+                _iterations = _statistics.iterations;
+                for (const ModbusCppRtuBusStatistics& _bus : _statistics.buses)
+                {
+                    _readCalls += _bus.readCalls;
+                    _busRequests += _bus.requests;
+                }
+                if (!_statistics.buses.empty())
+                {
+                    _latency = _statistics.buses.front().latency;
+                }
+                _loop.stop();
+            }
+            const double _seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - _start).count();
+            const uint64_t _cpuUsec = processCpuUsec() - _cpuStart;
+            for (PtyRtuSlave *_slave : _slaves)
+            {
+                _slave->stop();
+                delete _slave;
+            }
+            if (_serials.empty())
+            {
+                return;
+            }
+
+            // 请求 8 字节，响应 5 + 32 字节
+            const ModbusCppSerialConfig& _serial = _serials.front();
+            const double _wireUsec = _serial.frameGapUsec() + static_cast<double>(_serial.frameUsec(8 + 5 + MULTIBUS_REGISTERS * 2));
+            std::ostringstream _line;
+            _line << "{\"suite\":\"multibus\""
+                << ",\"mode\":\"" << _mode << "\""
+                << ",\"buses\":" << _serials.size()
+                << ",\"client_threads\":" << ("threads" == _mode ? _serials.size() : 1)
+                << ",\"requests\":" << _requests.load()
+                << ",\"failures\":" << _failures.load()
+                << ",\"requests_per_sec\":" << _requests.load() / _seconds
+                << ",\"wire_limit_per_sec\":" << 1e6 / _wireUsec * _serials.size()
+                << ",\"cpu_us_per_request\":" << (_requests.load() > 0 ? static_cast<double>(_cpuUsec) / _requests.load() : 0)
+                << ",\"reads_per_request\":" << (_busRequests > 0 ? static_cast<double>(_readCalls) / _busRequests : 0)
+                << ",\"latency_us\":{\"p50\":" << _latency.p50
+                << ",\"p99\":" << _latency.p99 << "}";
+            if ("loop" == _mode)
+            {
+                _line << ",\"wakeups_per_request\":" << (_busRequests > 0 ? static_cast<double>(_iterations) / _busRequests : 0);
+            }
+            _line << "}";
+            std::cout << _line.str() << std::endl;
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    bool _quick = false;
+    std::string _suite = "all";
+    for (int i = 1; i < argc; ++i)
+    {
+        if (0 == strcmp(argv[i], "--duration-ms") && i + 1 < argc)
+        {
+            _durationMs = std::stoi(argv[++i]);
+        }
+        else if (0 == strcmp(argv[i], "--quick"))
+        {
+            _quick = true;
+        }
+        else if (0 == strcmp(argv[i], "--suite") && i + 1 < argc)
+        {
+            _suite = argv[++i];
+        }
+        else
+        {
+            std::cerr << "usage: Benchmark [--duration-ms N] [--quick] [--suite throughput|faults|server|registermap|writeevents|proxy|gateway|rtu|scan|broadcast|crc|rtutcp|multibus|all]" << std::endl;
+            return 1;
+        }
+    }
+
+    if (_suite == "throughput" || _suite == "all")
+    {
+        // 启动进程内服务器
+        LoopbackServer _server;
+        if (!_server.start(SERVER_HOST, SERVER_PORT))
+        {
+            std::cerr << "启动回环服务器失败" << std::endl;
+            return 1;
+        }
+
+        // 连接客户端
+        for (int i = 0; i < CLIENTS_MAX; ++i)
+        {
+            ModbusCppTcpClient *_client = new ModbusCppTcpClient();
+            if (!_client->connectServer(SERVER_HOST, SERVER_PORT, SLAVE_ID))
+            {
+                std::cerr << "连接回环服务器失败" << std::endl;
+                return 1;
+            }
+            _clients.push_back(_client);
+        }
+
+        runThroughputSuite(_quick);
+    }
+
+    if (_suite == "faults" || _suite == "all")
+    {
+        runFaultSuite();
+    }
+
+    if (_suite == "server" || _suite == "all")
+    {
+        runServerSuite(_quick);
+    }
+
+    if (_suite == "registermap" || _suite == "all")
+    {
+        runRegisterMapSuite(_quick);
+    }
+
+    if (_suite == "writeevents" || _suite == "all")
+    {
+        runWriteEventSuite(_quick);
+    }
+
+    if (_suite == "proxy" || _suite == "all")
+    {
+        runProxySuite(_quick);
+    }
+
+    if (_suite == "gateway" || _suite == "all")
+    {
+        runGatewaySuite(_quick);
+    }
+
+    if (_suite == "rtu" || _suite == "all")
+    {
+        runRtuSuite(_quick);
+    }
+
+    if (_suite == "scan" || _suite == "all")
+    {
+        runScanSuite(_quick);
+    }
+
+    if (_suite == "broadcast" || _suite == "all")
+    {
+        runBroadcastSuite(_quick);
+    }
+
+    if (_suite == "crc" || _suite == "all")
+    {
+        runCrcSuite(_quick);
+    }
+
+    if (_suite == "rtutcp" || _suite == "all")
+    {
+        runRtuTcpSuite(_quick);
+    }
+
+    if (_suite == "multibus" || _suite == "all")
+    {
+        runMultiBusSuite(_quick);
+    }
+
+    // 客户端的工作线程不会退出，直接结束进程
+    std::cout.flush();
+    std::quick_exit(0);
+}
@@ -0,0 +1,117 @@
+﻿#include "FaultInjectingServer.h"
+#include "modbus.h"
+#include <random>
+#include <algorithm>
+#include <cstring>
+#include <chrono>
+#include <thread>
+#if defined(_WIN32)
+#include <WinSock2.h>
+#else
+#include <sys/socket.h>
+#endif
+
+// 每个连接线程一个随机数发生器，避免加锁
+static thread_local std::mt19937_64 t_random(std::random_device{}());
+
+static bool happens(const double probability)
+{
+	return probability > 0 && std::uniform_real_distribution<double>(0, 1)(t_random) < probability;
+}
+
+void FaultInjectingServer::setFaultProfile(const FaultProfile& profile)
+{
+	std::lock_guard<std::mutex> _lock(m_profileLock);
+	m_profile = profile;
+}
+
+bool FaultInjectingServer::handleRequest(modbus_t *connection, const uint8_t *request, const int requestLength)
+{
+	m_profileLock.lock();
+	const FaultProfile _profile = m_profile;
+	m_profileLock.unlock();
+
+	// 模拟设备处理延迟
+	uint64_t _delayUs = 0;
+	switch (_profile.latency)
+	{
+	case FaultProfile::Latency::UNIFORM:
+		_delayUs = std::uniform_int_distribution<uint64_t>(_profile.latencyMinUs, std::max(_profile.latencyMinUs, _profile.latencyMaxUs))(t_random);
+		break;
+	case FaultProfile::Latency::EXPONENTIAL:
+		_delayUs = _profile.latencyMinUs;
+		if (_profile.latencyMeanUs > 0)
+		{
+			_delayUs += static_cast<uint64_t>(std::exponential_distribution<double>(1.0 / _profile.latencyMeanUs)(t_random));
+		}
+		break;
+	default:
+		break;
+	}
+	if (_delayUs > 0)
+	{
+		std::this_thread::sleep_for(std::chrono::microseconds(_delayUs));
+	}
+
+	// 复位连接: SO_LINGER 超时为 0 时 close 会发送 RST
+	if (happens(_profile.resetProbability))
+	{
+		struct linger _linger;
+		_linger.l_onoff = 1;
+		_linger.l_linger = 0;
+		setsockopt(modbus_get_socket(connection), SOL_SOCKET, SO_LINGER, (const char *)&_linger, sizeof(_linger));
+		return false;
+	}
+
+	// 丢弃请求，客户端只能等到超时
+	if (happens(_profile.dropProbability))
+	{
+		return true;
+	}
+
+	if (happens(_profile.truncateProbability))
+	{
+		sendTruncated(connection, request);
+		return true;
+	}
+
+	if (happens(_profile.exceptionProbability))
+	{
+		modbus_reply_exception(connection, request, _profile.exceptionCode);
+		return true;
+	}
+
+	// 回复的事务ID 取自请求，修改请求副本即可得到错误的事务ID
+	uint8_t _request[MODBUS_TCP_MAX_ADU_LENGTH];
+	memcpy(_request, request, requestLength);
+	if (happens(_profile.wrongTransactionIdProbability))
+	{
+		_request[1] ^= 0x5A;
+	}
+
+	std::lock_guard<std::mutex> _lock(m_mappingLock);
+	modbus_reply(connection, _request, requestLength, m_mapping);
+	return true;
+}
+
+// 只发送 MBAP 头和功能码，长度字段按完整响应填写，客户端会一直等待剩余数据
+void FaultInjectingServer::sendTruncated(modbus_t *connection, const uint8_t *request)
+{
+	const uint8_t _function = request[7];
+	uint16_t _pduLength = 5;
+	switch (_function)
+	{
+	case MODBUS_FC_READ_HOLDING_REGISTERS:
+	case MODBUS_FC_READ_INPUT_REGISTERS:
+	case MODBUS_FC_WRITE_AND_READ_REGISTERS:
+		// 读数量都在功能码之后第 3、4 字节
+		_pduLength = 2 + 2 * ((request[10] << 8) | request[11]);
+		break;
+	default:
+		break;
+	}
+
+	const uint16_t _length = _pduLength + 1;
+	const uint8_t _response[8] = { request[0], request[1], 0, 0, static_cast<uint8_t>(_length >> 8), static_cast<uint8_t>(_length & 0xFF), request[6], _function };
+	send(modbus_get_socket(connection), (const char *)_response, sizeof(_response), 0);
+}
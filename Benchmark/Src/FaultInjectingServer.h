@@ -0,0 +1,42 @@
+﻿#pragma once
+#include <string>
+#include "LoopbackServer.h"
+
+// 故障配置，概率取值 [0, 1]，每个请求独立抽样
+struct FaultProfile
+{
+    enum class Latency
+    {
+        NONE,           // 不增加延迟
+        UNIFORM,        // [latencyMinUs, latencyMaxUs] 均匀分布
+        EXPONENTIAL     // latencyMinUs + 均值为 latencyMeanUs 的指数分布
+    };
+
+    std::string name;                           // 配置名称，输出到测试结果
+    Latency     latency = Latency::NONE;
+    uint32_t    latencyMinUs = 0;
+    uint32_t    latencyMaxUs = 0;
+    uint32_t    latencyMeanUs = 0;
+    double      dropProbability = 0;            // 不回复
+    double      truncateProbability = 0;        // 只回复 MBAP 头和功能码
+    double      wrongTransactionIdProbability = 0;  // 回复错误的事务ID
+    double      exceptionProbability = 0;       // 回复异常响应
+    uint8_t     exceptionCode = 0x06;           // 默认 SLAVE_OR_SERVER_BUSY
+    double      resetProbability = 0;           // 直接复位(RST)连接
+};
+
+// 可注入故障的 Modbus TCP 模拟服务器，基于 LoopbackServer(libmodbus 服务器代码)
+class FaultInjectingServer : public LoopbackServer
+{
+public:
+    void setFaultProfile(const FaultProfile &profile);
+
+protected:
+    bool handleRequest(modbus_t *connection, const uint8_t *request, const int requestLength) override;
+
+private:
+    void sendTruncated(modbus_t *connection, const uint8_t *request);
+
+    FaultProfile            m_profile;
+    std::mutex              m_profileLock;
+};
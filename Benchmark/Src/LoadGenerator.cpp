@@ -0,0 +1,249 @@
+﻿#include "LoadGenerator.h"
+#include <vector>
+#include <array>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#if defined(_WIN32)
+#include <WinSock2.h>
+#include <WS2tcpip.h>
+#else
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+#if defined(_WIN32)
+typedef WSAPOLLFD PollFd;
+#define pollSockets WSAPoll
+#define closeSocket closesocket
+#else
+typedef struct pollfd PollFd;
+#define pollSockets poll
+#define closeSocket close
+#endif
+
+// MBAP 头长度
+static const int MBAP_LENGTH = 7;
+// 接收缓冲区，放得下多个最大长度的响应
+static const int INPUT_BUFFER_SIZE = 8192;
+// 最大流水线深度，发送时间按事务标识低 8 位记录
+static const int DEPTH_MAX = 256;
+
+// 单个连接的状态
+struct LoadConnection
+{
+	int         socket = -1;
+	uint16_t    nextTransactionId = 0;      // 下一个请求的事务标识
+	uint16_t    expectedTransactionId = 0;  // 下一个响应应该带的事务标识(服务器按顺序响应)
+	std::array<std::chrono::steady_clock::time_point, 256> sendTimes;  // 按事务标识低 8 位记录发送时间
+	uint8_t     input[INPUT_BUFFER_SIZE];
+	int         inputLength = 0;
+	std::vector<uint8_t> output;            // 一批请求的发送缓冲区
+};
+
+static int connectServer(const LoadGeneratorConfig& config)
+{
+	const int _socket = static_cast<int>(socket(AF_INET, SOCK_STREAM, 0));
+	if (-1 == _socket)
+	{
+		return -1;
+	}
+
+	sockaddr_in _address = {};
+	_address.sin_family = AF_INET;
+	_address.sin_port = htons(config.port);
+	inet_pton(AF_INET, config.host.c_str(), &_address.sin_addr);
+	if (0 != connect(_socket, reinterpret_cast<sockaddr *>(&_address), sizeof(_address)))
+	{
+		closeSocket(_socket);
+		return -1;
+	}
+
+	int _option = 1;
+	setsockopt(_socket, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char *>(&_option), sizeof(_option));
+	return _socket;
+}
+
+// 发送 count 个请求(FC3 读或 FC16 写，地址 0)，流水线中的多个请求合并成一次 send
+static bool sendRequests(LoadConnection& connection, const LoadGeneratorConfig& config, const int count)
+{
+	const int _pduLength = config.write ? 6 + config.registers * 2 : 5;
+	const int _requestLength = MBAP_LENGTH + _pduLength;
+	connection.output.resize(count * _requestLength);
+	const auto _now = std::chrono::steady_clock::now();
+	for (int i = 0; i < count; ++i)
+	{
+		const uint16_t _transactionId = connection.nextTransactionId++;
+		uint8_t *_request = connection.output.data() + i * _requestLength;
+		_request[0] = static_cast<uint8_t>(_transactionId >> 8);
+		_request[1] = static_cast<uint8_t>(_transactionId & 0xFF);
+		_request[2] = 0;
+		_request[3] = 0;
+		_request[4] = 0;
+		_request[5] = static_cast<uint8_t>(1 + _pduLength);
+		_request[6] = 1;
+		_request[7] = config.write ? 16 : 3;
+		_request[8] = 0;
+		_request[9] = 0;
+		_request[10] = 0;
+		_request[11] = static_cast<uint8_t>(config.registers);
+		if (config.write)
+		{
+			// 写入的值为事务标识
+			_request[12] = static_cast<uint8_t>(config.registers * 2);
+			for (int r = 0; r < config.registers; ++r)
+			{
+				_request[13 + r * 2] = _request[0];
+				_request[14 + r * 2] = _request[1];
+			}
+		}
+		connection.sendTimes[_transactionId & 0xFF] = _now;
+	}
+	const int _length = static_cast<int>(connection.output.size());
+	return _length == send(connection.socket, reinterpret_cast<const char *>(connection.output.data()), _length, 0);
+}
+
+LoadGeneratorResult LoadGenerator::run(const LoadGeneratorConfig& config)
+{
+	const int _threadCount = config.threads < config.connections ? config.threads : config.connections;
+	const int _depth = config.depth < DEPTH_MAX ? config.depth : DEPTH_MAX;
+	ModbusCppLatencyHistogram _histogram;
+	std::atomic<int> _connected(0);
+	std::atomic<int> _ready(0);
+	std::atomic<bool> _go(false);
+	std::atomic<uint64_t> _requests(0);
+	std::atomic<uint64_t> _errors(0);
+	std::chrono::steady_clock::time_point _deadline;
+
+	std::vector<std::thread> _threads;
+	for (int t = 0; t < _threadCount; ++t)
+	{
+		_threads.emplace_back([&, t]() {
+			// 先建立本线程负责的所有连接
+			std::vector<LoadConnection *> _connections;
+			for (int c = t; c < config.connections; c += _threadCount)
+			{
+				const int _socket = connectServer(config);
+				if (-1 == _socket)
+				{
+					continue;
+				}
+				LoadConnection *_connection = new LoadConnection();
+				_connection->socket = _socket;
+				_connections.push_back(_connection);
+			}
+			_connected += static_cast<int>(_connections.size());
+			_ready += 1;
+			while (!_go)
+			{
+				std::this_thread::yield();
+			}
+
+			std::vector<PollFd> _pollFds(_connections.size());
+			for (size_t i = 0; i < _connections.size(); ++i)
+			{
+				_pollFds[i].fd = _connections[i]->socket;
+				_pollFds[i].events = POLLIN;
+				sendRequests(*_connections[i], config, _depth);
+			}
+
+			uint64_t _completed = 0;
+			uint64_t _failed = 0;
+			while (std::chrono::steady_clock::now() < _deadline)
+			{
+				if (pollSockets(_pollFds.data(), static_cast<unsigned long>(_pollFds.size()), 100) <= 0)
+				{
+					continue;
+				}
+
+				const auto _now = std::chrono::steady_clock::now();
+				for (size_t i = 0; i < _pollFds.size(); ++i)
+				{
+					if (0 == _pollFds[i].revents || -1 == _pollFds[i].fd)
+					{
+						continue;
+					}
+
+					LoadConnection& _connection = *_connections[i];
+					const int _received = recv(_connection.socket, reinterpret_cast<char *>(_connection.input + _connection.inputLength), INPUT_BUFFER_SIZE - _connection.inputLength, 0);
+					if (_received <= 0)
+					{
+						// 连接断开，不再使用
+						_failed += 1;
+						_pollFds[i].fd = -1;
+						continue;
+					}
+					_connection.inputLength += _received;
+
+					// 解析所有完整的响应，收到几个响应就一次补发几个请求
+					int _offset = 0;
+					int _responses = 0;
+					while (_connection.inputLength - _offset >= MBAP_LENGTH)
+					{
+						const uint8_t *_frame = _connection.input + _offset;
+						const int _frameLength = MBAP_LENGTH - 1 + ((_frame[4] << 8) | _frame[5]);
+						if (_connection.inputLength - _offset < _frameLength)
+						{
+							break;
+						}
+
+						const uint16_t _transactionId = static_cast<uint16_t>((_frame[0] << 8) | _frame[1]);
+						if (_transactionId == _connection.expectedTransactionId && (config.write ? 16 : 3) == _frame[MBAP_LENGTH])
+						{
+							_completed += 1;
+							_histogram.record(std::chrono::duration_cast<std::chrono::microseconds>(_now - _connection.sendTimes[_transactionId & 0xFF]).count());
+						}
+						else
+						{
+							_failed += 1;
+						}
+						_connection.expectedTransactionId = _transactionId + 1;
+						_offset += _frameLength;
+						++_responses;
+					}
+					if (_responses > 0)
+					{
+						sendRequests(_connection, config, _responses);
+					}
+					memmove(_connection.input, _connection.input + _offset, _connection.inputLength - _offset);
+					_connection.inputLength -= _offset;
+				}
+			}
+
+			_requests += _completed;
+			_errors += _failed;
+			for (LoadConnection *_connection : _connections)
+			{
+				closeSocket(_connection->socket);
+				delete _connection;
+			}
+		});
+	}
+
+	// 所有连接建立后再开始计时
+	while (_ready < _threadCount)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	const auto _start = std::chrono::steady_clock::now();
+	_deadline = _start + std::chrono::milliseconds(config.durationMs);
+	_go = true;
+
+	for (auto& _thread : _threads)
+	{
+		_thread.join();
+	}
+
+	LoadGeneratorResult _result;
+	_result.connected = _connected;
+	_result.requests = _requests;
+	_result.errors = _errors;
+	_result.seconds = std::chrono::duration<double>(_deadline - _start).count();
+	_result.latency = _histogram.snapshot();
+	return _result;
+}
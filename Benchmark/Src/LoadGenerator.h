@@ -0,0 +1,35 @@
+﻿#pragma once
+#include <string>
+#include <cstdint>
+#include "ModbusCppStatistics.h"
+
+// 压测参数
+struct LoadGeneratorConfig
+{
+    std::string host;
+    uint16_t    port = 0;
+    int         connections = 1;    // 连接数
+    int         threads = 1;        // 驱动连接的线程数，连接平均分配到各线程
+    int         depth = 1;          // 每个连接未完成的请求数(流水线深度，最大 256)，同一批请求一次发送
+    int         registers = 1;      // 每次读写的寄存器数量
+    bool        write = false;      // true: FC16 写请求；false: FC3 读请求
+    int         durationMs = 1000;  // 测试时长
+};
+
+// 压测结果
+struct LoadGeneratorResult
+{
+    int         connected = 0;      // 成功建立的连接数
+    uint64_t    requests = 0;       // 收到正确响应的请求数
+    uint64_t    errors = 0;         // 异常响应、错误帧或断开的次数
+    double      seconds = 0;
+    ModbusCppLatencySnapshot latency;
+};
+
+// 用原始套接字直接收发 Modbus TCP 帧，少量线程用 poll 驱动大量连接
+// 不经过 ModbusCppTcpClient，用来测试服务器本身的吞吐量和连接数上限
+class LoadGenerator
+{
+public:
+    static LoadGeneratorResult run(const LoadGeneratorConfig &config);
+};
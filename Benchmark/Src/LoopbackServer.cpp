@@ -0,0 +1,129 @@
+﻿#include "LoopbackServer.h"
+#include "modbus.h"
+#if defined(_WIN32)
+#include <WinSock2.h>
+#else
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+LoopbackServer::LoopbackServer()
+	: m_port(0)
+	, m_listenContext(NULL)
+	, m_listenSocket(-1)
+	, m_running(false)
+	, m_mapping(NULL)
+{
+	// 覆盖 Modbus 全部地址范围，基准测试可以读写任意地址
+	m_mapping = modbus_mapping_new(MODBUS_MAX_READ_BITS, MODBUS_MAX_READ_BITS, 0x10000, 0x10000);
+}
+
+LoopbackServer::~LoopbackServer()
+{
+	stop();
+	modbus_mapping_free(m_mapping);
+}
+
+bool LoopbackServer::start(const std::string& host, const uint16_t port)
+{
+	if (m_running)
+	{
+		return false;
+	}
+
+	m_host = host;
+	m_port = port;
+	m_listenContext = modbus_new_tcp(host.c_str(), port);
+	if (NULL == m_listenContext)
+	{
+		return false;
+	}
+
+	m_listenSocket = modbus_tcp_listen(m_listenContext, 64);
+	if (-1 == m_listenSocket)
+	{
+		modbus_free(m_listenContext);
+		m_listenContext = NULL;
+		return false;
+	}
+
+	m_running = true;
+	m_acceptThread = std::thread(&LoopbackServer::acceptThread, this);
+	return true;
+}
+
+void LoopbackServer::stop()
+{
+	if (!m_running)
+	{
+		return;
+	}
+	m_running = false;
+
+	// 关闭监听套接字让 accept 返回
+#if defined(_WIN32)
+	closesocket(m_listenSocket);
+#else
+	shutdown(m_listenSocket, SHUT_RDWR);
+	close(m_listenSocket);
+#endif
+	m_listenSocket = -1;
+
+	if (m_acceptThread.joinable())
+	{
+		m_acceptThread.join();
+	}
+	modbus_free(m_listenContext);
+	m_listenContext = NULL;
+}
+
+void LoopbackServer::acceptThread()
+{
+	while (m_running)
+	{
+		modbus_t *_connection = modbus_new_tcp(m_host.c_str(), m_port);
+		if (NULL == _connection)
+		{
+			break;
+		}
+
+		if (-1 == modbus_tcp_accept(_connection, &m_listenSocket))
+		{
+			modbus_free(_connection);
+			break;
+		}
+
+		// 每个连接独占一个上下文，可以预读流水线请求
+		modbus_set_read_ahead(_connection, 1);
+
+		// 连接线程负责释放 _connection，客户端断开后退出
+		std::thread(&LoopbackServer::connectionThread, this, _connection).detach();
+	}
+}
+
+void LoopbackServer::connectionThread(modbus_t *connection)
+{
+	uint8_t _request[MODBUS_TCP_MAX_ADU_LENGTH];
+	while (true)
+	{
+		const int _length = modbus_receive(connection, _request);
+		if (-1 == _length)
+		{
+			break;
+		}
+		if (_length > 0 && !handleRequest(connection, _request, _length))
+		{
+			break;
+		}
+	}
+
+	modbus_close(connection);
+	modbus_free(connection);
+}
+
+bool LoopbackServer::handleRequest(modbus_t *connection, const uint8_t *request, const int requestLength)
+{
+	std::lock_guard<std::mutex> _lock(m_mappingLock);
+	modbus_reply(connection, request, requestLength, m_mapping);
+	return true;
+}
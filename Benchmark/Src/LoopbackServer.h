@@ -0,0 +1,38 @@
+﻿#pragma once
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+
+typedef struct _modbus modbus_t;
+typedef struct _modbus_mapping_t modbus_mapping_t;
+
+// 进程内的 Modbus TCP 回环服务器，直接使用 libmodbus 的 modbus_tcp_listen / modbus_reply
+// 每个连接一个线程，所有连接共享同一份寄存器映射
+class LoopbackServer
+{
+public:
+    LoopbackServer();
+    ~LoopbackServer();
+
+    bool start(const std::string &host, const uint16_t port);
+    void stop();
+
+protected:
+    // 处理一个已接收的请求，子类可以在这里注入故障；返回 false 时关闭连接
+    virtual bool handleRequest(modbus_t *connection, const uint8_t *request, const int requestLength);
+
+    void acceptThread();
+    void connectionThread(modbus_t *connection);
+
+    std::string             m_host;
+    uint16_t                m_port;
+    modbus_t                *m_listenContext;
+    int                     m_listenSocket;
+    std::atomic<bool>       m_running;
+    std::thread             m_acceptThread;
+
+    modbus_mapping_t        *m_mapping;
+    std::mutex              m_mappingLock;  // modbus_reply 读写映射时没有任何同步
+};
@@ -0,0 +1,220 @@
+﻿#include "PtyRtuSlave.h"
+#include "RtuFrame.h"
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+#if defined(__linux__)
+#include <pty.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#endif
+
+// 从站地址 + PDU + CRC
+static const size_t RTU_FRAME_MAX = 256;
+// 没有数据时检查退出标志的间隔
+static const int POLL_INTERVAL_MS = 50;
+
+PtyRtuSlave::PtyRtuSlave()
+	: m_registerMap(NULL)
+	, m_firstUnit(1)
+	, m_lastUnit(247)
+	, m_turnaroundUsec(0)
+	, m_chunkBytes(0)
+	, m_master(-1)
+	, m_slave(-1)
+	, m_running(false)
+	, m_requests(0)
+	, m_broadcasts(0)
+	, m_crcErrors(0)
+{
+	for (auto& _silent : m_silent)
+	{
+		_silent = false;
+	}
+}
+
+PtyRtuSlave::~PtyRtuSlave()
+{
+	stop();
+}
+
+void PtyRtuSlave::setUnits(const uint8_t firstUnit, const uint8_t lastUnit)
+{
+	if (!m_running)
+	{
+		m_firstUnit = firstUnit;
+		m_lastUnit = lastUnit;
+	}
+}
+
+void PtyRtuSlave::setTurnaroundUsec(const uint32_t usec)
+{
+	if (!m_running)
+	{
+		m_turnaroundUsec = usec;
+	}
+}
+
+void PtyRtuSlave::setChunkBytes(const size_t bytes)
+{
+	if (!m_running)
+	{
+		m_chunkBytes = bytes;
+	}
+}
+
+void PtyRtuSlave::setSilent(const uint8_t unit, const bool silent)
+{
+	m_silent[unit] = silent;
+}
+
+bool PtyRtuSlave::start(const ModbusCppSerialConfig& config, ModbusCppRegisterMap *registerMap)
+{
+#if defined(__linux__)
+	if (m_running || NULL == registerMap)
+	{
+		return false;
+	}
+
+	// 原始模式，不回显也不转换换行
+	termios _termios;
+	memset(&_termios, 0, sizeof(_termios));
+	cfmakeraw(&_termios);
+	char _name[128];
+	if (0 != openpty(&m_master, &m_slave, _name, &_termios, NULL))
+	{
+		return false;
+	}
+
+	m_config = config;
+	m_config.device = _name;
+	m_devicePath = _name;
+	m_registerMap = registerMap;
+	m_running = true;
+	m_thread = std::thread(&PtyRtuSlave::slaveThread, this);
+	return true;
+#else
+	return false;
+#endif
+}
+
+void PtyRtuSlave::stop()
+{
+	if (!m_running)
+	{
+		return;
+	}
+
+	m_running = false;
+	if (m_thread.joinable())
+	{
+		m_thread.join();
+	}
+#if defined(__linux__)
+	close(m_master);
+	close(m_slave);
+#endif
+	m_master = -1;
+	m_slave = -1;
+}
+
+const std::string& PtyRtuSlave::devicePath() const
+{
+	return m_devicePath;
+}
+
+uint64_t PtyRtuSlave::requests() const
+{
+	return m_requests;
+}
+
+uint64_t PtyRtuSlave::broadcasts() const
+{
+	return m_broadcasts;
+}
+
+uint64_t PtyRtuSlave::crcErrors() const
+{
+	return m_crcErrors;
+}
+
+void PtyRtuSlave::slaveThread()
+{
+#if defined(__linux__)
+	ModbusCppRequestProcessor _processor(m_registerMap);
+	uint8_t _buffer[RTU_FRAME_MAX * 4];
+	size_t _length = 0;
+	while (m_running)
+	{
+		pollfd _pollfd = { m_master, POLLIN, 0 };
+		const int _ready = poll(&_pollfd, 1, POLL_INTERVAL_MS);
+		if (_ready <= 0)
+		{
+			// 一段时间没有新数据，残留的半帧不会再完整，丢掉重新同步
+			_length = 0;
+			continue;
+		}
+
+		const ssize_t _received = read(m_master, _buffer + _length, sizeof(_buffer) - _length);
+		if (_received <= 0)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(POLL_INTERVAL_MS));
+			continue;
+		}
+		_length += _received;
+
+		while (_length > 0)
+		{
+			const int _frameLength = rtuRequestLength(_buffer, _length);
+			if (0 == _frameLength || (_frameLength > 0 && static_cast<size_t>(_frameLength) > _length))
+			{
+				break;
+			}
+			if (-1 == _frameLength || rtuCrc16(_buffer, _frameLength - 2) != static_cast<uint16_t>(_buffer[_frameLength - 2] | (_buffer[_frameLength - 1] << 8)))
+			{
+				// 帧边界已经无法确定
+				m_crcErrors.fetch_add(1, std::memory_order_relaxed);
+				_length = 0;
+				break;
+			}
+
+			const auto _arrived = std::chrono::steady_clock::now();
+			const uint8_t _unit = _buffer[0];
+			m_requests.fetch_add(1, std::memory_order_relaxed);
+			uint8_t _response[RTU_FRAME_MAX];
+			_response[0] = _unit;
+			const int _pduLength = _processor.process(_buffer + 1, _frameLength - 3, _response + 1, _unit);
+
+			if (MODBUS_BROADCAST_ADDRESS == _unit)
+			{
+				m_broadcasts.fetch_add(1, std::memory_order_relaxed);
+			}
+			else if (_unit >= m_firstUnit && _unit <= m_lastUnit && !m_silent[_unit])
+			{
+				const uint16_t _crc = rtuCrc16(_response, 1 + _pduLength);
+				_response[1 + _pduLength] = static_cast<uint8_t>(_crc & 0xFF);
+				_response[2 + _pduLength] = static_cast<uint8_t>(_crc >> 8);
+				const size_t _responseLength = 3 + _pduLength;
+
+				// 请求最后一个字节实际到达的时间 + 从站处理时间，之后每块在它最后一个字节传完时写入
+				const auto _replyStart = _arrived + std::chrono::microseconds(m_config.frameUsec(_frameLength) + m_turnaroundUsec);
+				const size_t _chunk = 0 == m_chunkBytes ? _responseLength : m_chunkBytes;
+				for (size_t _sent = 0; _sent < _responseLength;)
+				{
+					const size_t _size = std::min(_chunk, _responseLength - _sent);
+					std::this_thread::sleep_until(_replyStart + std::chrono::microseconds(m_config.frameUsec(_sent + _size)));
+					if (write(m_master, _response + _sent, _size) != static_cast<ssize_t>(_size))
+					{
+						break;
+					}
+					_sent += _size;
+				}
+			}
+
+			memmove(_buffer, _buffer + _frameLength, _length - _frameLength);
+			_length -= _frameLength;
+		}
+	}
+#endif
+}
@@ -0,0 +1,60 @@
+﻿#pragma once
+#include <string>
+#include <thread>
+#include <atomic>
+#include <array>
+
+#include "ModbusCppSerialConfig.h"
+#include "ModbusCppRegisterMap.h"
+#include "ModbusCppRequestProcessor.h"
+
+// 用伪终端模拟串口总线上的 RTU 从站(仅 Linux，其他平台 start() 返回 false)
+// 被测的网关/客户端打开 devicePath()，模拟器在主设备端按功能码拆帧、校验 CRC，用 ModbusCppRequestProcessor 应答
+// 伪终端没有波特率，应答前按配置的波特率补上请求和响应在线路上的传输时间，总线占用接近真实串口
+class PtyRtuSlave
+{
+public:
+    PtyRtuSlave();
+    ~PtyRtuSlave();
+
+    // 设置参数，必须在 start() 之前调用
+    // 应答 firstUnit ~ lastUnit 的请求，所有从站共用调用方提供的寄存器存储
+    void setUnits(const uint8_t firstUnit, const uint8_t lastUnit);
+    // 从站收到请求到开始回复的处理时间
+    void setTurnaroundUsec(const uint32_t usec);
+    // 响应分块写入的字节数，每块在最后一个字节到达的时间写入，模拟逐字节到达的串口；0 表示整帧一次写入
+    void setChunkBytes(const size_t bytes);
+    // 不应答该从站(模拟掉线)，可以在运行中调用
+    void setSilent(const uint8_t unit, const bool silent);
+
+    bool start(const ModbusCppSerialConfig &config, ModbusCppRegisterMap *registerMap);
+    void stop();
+
+    // 被测端打开的串口设备，如 /dev/pts/3
+    const std::string &devicePath() const;
+
+    uint64_t requests() const;      // 收到的完整请求数(含广播和不应答的)
+    uint64_t broadcasts() const;    // 收到的广播数
+    uint64_t crcErrors() const;     // CRC 错误或无法拆帧的次数
+
+private:
+    void slaveThread();
+
+    ModbusCppSerialConfig   m_config;
+    ModbusCppRegisterMap    *m_registerMap;
+    uint8_t                 m_firstUnit;
+    uint8_t                 m_lastUnit;
+    uint32_t                m_turnaroundUsec;
+    size_t                  m_chunkBytes;
+    std::array<std::atomic<bool>, 256> m_silent;
+
+    int                     m_master;           // 模拟器使用的主设备端
+    int                     m_slave;            // 从设备端，一直保持打开，被测端关闭后重新打开时线路不会挂断
+    std::string             m_devicePath;
+    std::thread             m_thread;
+    std::atomic<bool>       m_running;
+
+    std::atomic<uint64_t>   m_requests;
+    std::atomic<uint64_t>   m_broadcasts;
+    std::atomic<uint64_t>   m_crcErrors;
+};
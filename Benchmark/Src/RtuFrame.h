@@ -0,0 +1,52 @@
+﻿#pragma once
+#include <cstdint>
+#include <cstddef>
+#include "modbus.h"
+
+// 测试用的 RTU 拆帧工具，伪终端从站和 RTU over TCP 服务器共用
+
+// 标准 Modbus CRC16(多项式 0xA001，初值 0xFFFF)，逐位计算，与被测的查表实现相互独立
+inline uint16_t rtuCrc16(const uint8_t *data, const size_t length)
+{
+	uint16_t _crc = 0xFFFF;
+	for (size_t i = 0; i < length; ++i)
+	{
+		_crc ^= data[i];
+		for (int j = 0; j < 8; ++j)
+		{
+			_crc = (_crc & 1) ? static_cast<uint16_t>((_crc >> 1) ^ 0xA001) : static_cast<uint16_t>(_crc >> 1);
+		}
+	}
+	return _crc;
+}
+
+// 按功能码计算请求帧的总长度(含 CRC)；数据还不够判断时返回 0，不支持的功能码返回 -1
+inline int rtuRequestLength(const uint8_t *frame, const size_t available)
+{
+	if (available < 2)
+	{
+		return 0;
+	}
+	switch (frame[1])
+	{
+	case MODBUS_FC_READ_COILS:
+	case MODBUS_FC_READ_DISCRETE_INPUTS:
+	case MODBUS_FC_READ_HOLDING_REGISTERS:
+	case MODBUS_FC_READ_INPUT_REGISTERS:
+	case MODBUS_FC_WRITE_SINGLE_COIL:
+	case MODBUS_FC_WRITE_SINGLE_REGISTER:
+		return 8;
+	case MODBUS_FC_READ_EXCEPTION_STATUS:
+	case MODBUS_FC_REPORT_SLAVE_ID:
+		return 4;
+	case MODBUS_FC_MASK_WRITE_REGISTER:
+		return 10;
+	case MODBUS_FC_WRITE_MULTIPLE_COILS:
+	case MODBUS_FC_WRITE_MULTIPLE_REGISTERS:
+		return available < 7 ? 0 : 9 + frame[6];
+	case MODBUS_FC_WRITE_AND_READ_REGISTERS:
+		return available < 11 ? 0 : 13 + frame[10];
+	default:
+		return -1;
+	}
+}
@@ -0,0 +1,237 @@
+﻿#include "RtuOverTcpServer.h"
+#include "RtuFrame.h"
+#include "ModbusCppRequestProcessor.h"
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+#if defined(_WIN32)
+#include <WinSock2.h>
+#include <WS2tcpip.h>
+#else
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+#if defined(_WIN32)
+typedef WSAPOLLFD PollFd;
+#define pollSockets WSAPoll
+#define closeSocket closesocket
+#define SEND_FLAGS 0
+#else
+typedef struct pollfd PollFd;
+#define pollSockets poll
+#define closeSocket close
+#define SEND_FLAGS MSG_NOSIGNAL
+#endif
+
+// 从站地址 + PDU + CRC
+static const size_t RTU_FRAME_MAX = 256;
+// 没有数据时检查退出标志的间隔
+static const int POLL_INTERVAL_MS = 50;
+
+static bool waitReadable(const int socket, const int timeoutMs)
+{
+	PollFd _pollfd = {};
+	_pollfd.fd = socket;
+	_pollfd.events = POLLIN;
+	return pollSockets(&_pollfd, 1, timeoutMs) > 0;
+}
+
+RtuOverTcpServer::RtuOverTcpServer()
+	: m_registerMap(NULL)
+	, m_chunkBytes(0)
+	, m_chunkGapUsec(0)
+	, m_listenSocket(-1)
+	, m_running(false)
+	, m_generation(0)
+	, m_requests(0)
+	, m_crcErrors(0)
+	, m_connections(0)
+{
+}
+
+RtuOverTcpServer::~RtuOverTcpServer()
+{
+	stop();
+}
+
+void RtuOverTcpServer::setChunking(const size_t bytes, const uint32_t gapUsec)
+{
+	if (!m_running)
+	{
+		m_chunkBytes = bytes;
+		m_chunkGapUsec = gapUsec;
+	}
+}
+
+bool RtuOverTcpServer::start(const std::string& host, const uint16_t port, ModbusCppRegisterMap *registerMap)
+{
+	if (m_running || NULL == registerMap)
+	{
+		return false;
+	}
+
+#if defined(_WIN32)
+	WSADATA _data;
+	WSAStartup(MAKEWORD(2, 2), &_data);
+#endif
+	m_listenSocket = static_cast<int>(socket(AF_INET, SOCK_STREAM, 0));
+	if (-1 == m_listenSocket)
+	{
+		return false;
+	}
+
+	int _enable = 1;
+	sockaddr_in _address = {};
+	_address.sin_family = AF_INET;
+	_address.sin_port = htons(port);
+	if (0 != setsockopt(m_listenSocket, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char *>(&_enable), sizeof(_enable))
+		|| inet_pton(AF_INET, host.c_str(), &_address.sin_addr) <= 0
+		|| 0 != bind(m_listenSocket, reinterpret_cast<sockaddr *>(&_address), sizeof(_address))
+		|| 0 != listen(m_listenSocket, 16))
+	{
+		closeSocket(m_listenSocket);
+		m_listenSocket = -1;
+		return false;
+	}
+
+	m_registerMap = registerMap;
+	m_running = true;
+	m_acceptThread = std::thread(&RtuOverTcpServer::acceptThread, this);
+	return true;
+}
+
+void RtuOverTcpServer::stop()
+{
+	if (!m_running)
+	{
+		return;
+	}
+
+	m_running = false;
+	if (m_acceptThread.joinable())
+	{
+		m_acceptThread.join();
+	}
+	std::lock_guard<std::mutex> _lock(m_threadsLock);
+	for (std::thread& _thread : m_connectionThreads)
+	{
+		_thread.join();
+	}
+	m_connectionThreads.clear();
+	closeSocket(m_listenSocket);
+	m_listenSocket = -1;
+}
+
+void RtuOverTcpServer::dropConnections()
+{
+	m_generation.fetch_add(1);
+}
+
+uint64_t RtuOverTcpServer::requests() const
+{
+	return m_requests;
+}
+
+uint64_t RtuOverTcpServer::crcErrors() const
+{
+	return m_crcErrors;
+}
+
+uint64_t RtuOverTcpServer::connections() const
+{
+	return m_connections;
+}
+
+void RtuOverTcpServer::acceptThread()
+{
+	while (m_running)
+	{
+		if (!waitReadable(m_listenSocket, POLL_INTERVAL_MS))
+		{
+			continue;
+		}
+		const int _socket = static_cast<int>(accept(m_listenSocket, NULL, NULL));
+		if (-1 == _socket)
+		{
+			continue;
+		}
+
+		int _enable = 1;
+		setsockopt(_socket, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char *>(&_enable), sizeof(_enable));
+		m_connections.fetch_add(1, std::memory_order_relaxed);
+		std::lock_guard<std::mutex> _lock(m_threadsLock);
+		m_connectionThreads.emplace_back(&RtuOverTcpServer::connectionThread, this, _socket, m_generation.load());
+	}
+}
+
+void RtuOverTcpServer::connectionThread(const int socket, const uint64_t generation)
+{
+	ModbusCppRequestProcessor _processor(m_registerMap);
+	uint8_t _buffer[RTU_FRAME_MAX * 4];
+	size_t _length = 0;
+	while (m_running && m_generation == generation)
+	{
+		if (!waitReadable(socket, POLL_INTERVAL_MS))
+		{
+			continue;
+		}
+		const int _received = recv(socket, reinterpret_cast<char *>(_buffer + _length), static_cast<int>(sizeof(_buffer) - _length), 0);
+		if (_received <= 0)
+		{
+			break;
+		}
+		_length += _received;
+
+		while (_length > 0)
+		{
+			const int _frameLength = rtuRequestLength(_buffer, _length);
+			if (0 == _frameLength || (_frameLength > 0 && static_cast<size_t>(_frameLength) > _length))
+			{
+				break;
+			}
+			if (-1 == _frameLength || rtuCrc16(_buffer, _frameLength - 2) != static_cast<uint16_t>(_buffer[_frameLength - 2] | (_buffer[_frameLength - 1] << 8)))
+			{
+				// TCP 上不会丢字节，帧边界错了只能是客户端的问题，丢掉缓冲区
+				m_crcErrors.fetch_add(1, std::memory_order_relaxed);
+				_length = 0;
+				break;
+			}
+
+			const uint8_t _unit = _buffer[0];
+			uint8_t _response[RTU_FRAME_MAX];
+			_response[0] = _unit;
+			const int _pduLength = _processor.process(_buffer + 1, _frameLength - 3, _response + 1, _unit);
+			m_requests.fetch_add(1, std::memory_order_relaxed);
+			if (MODBUS_BROADCAST_ADDRESS != _unit)
+			{
+				const uint16_t _crc = rtuCrc16(_response, 1 + _pduLength);
+				_response[1 + _pduLength] = static_cast<uint8_t>(_crc & 0xFF);
+				_response[2 + _pduLength] = static_cast<uint8_t>(_crc >> 8);
+				const size_t _responseLength = 3 + _pduLength;
+				const size_t _chunk = 0 == m_chunkBytes ? _responseLength : m_chunkBytes;
+				for (size_t _sent = 0; _sent < _responseLength;)
+				{
+					if (_sent > 0 && m_chunkGapUsec > 0)
+					{
+						std::this_thread::sleep_for(std::chrono::microseconds(m_chunkGapUsec));
+					}
+					const size_t _size = std::min(_chunk, _responseLength - _sent);
+					if (send(socket, reinterpret_cast<const char *>(_response + _sent), static_cast<int>(_size), SEND_FLAGS) != static_cast<int>(_size))
+					{
+						break;
+					}
+					_sent += _size;
+				}
+			}
+
+			memmove(_buffer, _buffer + _frameLength, _length - _frameLength);
+			_length -= _frameLength;
+		}
+	}
+	closeSocket(socket);
+}
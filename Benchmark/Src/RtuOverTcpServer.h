@@ -0,0 +1,49 @@
+﻿#pragma once
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include "ModbusCppRegisterMap.h"
+
+// 进程内的 RTU over TCP 服务器，模拟透传模式的串口服务器: TCP 字节流中直接是 RTU 帧(带 CRC，没有 MBAP 头)
+// 按功能码拆帧、校验 CRC，用 ModbusCppRequestProcessor 应答任意从站地址；每个连接一个线程
+// 响应可以拆成几个报文段、段之间留出间隔发送，模拟串口服务器边从串口收边转发
+class RtuOverTcpServer
+{
+public:
+    RtuOverTcpServer();
+    ~RtuOverTcpServer();
+
+    // 设置参数，必须在 start() 之前调用
+    // 响应每个报文段的字节数(0 表示整帧一次发送)和段之间的间隔
+    void setChunking(const size_t bytes, const uint32_t gapUsec);
+
+    bool start(const std::string &host, const uint16_t port, ModbusCppRegisterMap *registerMap);
+    void stop();
+
+    // 关闭当前所有连接(模拟串口服务器重启)，客户端应在下一个请求时重连
+    void dropConnections();
+
+    uint64_t requests() const;      // 应答的请求数
+    uint64_t crcErrors() const;     // CRC 错误或无法拆帧的次数
+    uint64_t connections() const;   // 接受的连接数
+
+private:
+    void acceptThread();
+    void connectionThread(const int socket, const uint64_t generation);
+
+    ModbusCppRegisterMap    *m_registerMap;
+    size_t                  m_chunkBytes;
+    uint32_t                m_chunkGapUsec;
+    int                     m_listenSocket;
+    std::atomic<bool>       m_running;
+    std::atomic<uint64_t>   m_generation;       // dropConnections() 时加一，旧连接的线程看到后退出
+    std::thread             m_acceptThread;
+    std::vector<std::thread> m_connectionThreads;
+    std::mutex              m_threadsLock;
+
+    std::atomic<uint64_t>   m_requests;
+    std::atomic<uint64_t>   m_crcErrors;
+    std::atomic<uint64_t>   m_connections;
+};
@@ -162,3 +162,29 @@
 
 /* Define as `fork' if `vfork' does not work. */
 #define vfork fork
+
+/* The values above were generated for Windows. On other platforms the
+   POSIX headers and functions are available instead of Winsock. */
+#if !defined(_WIN32)
+#undef HAVE_WINSOCK2_H
+#define HAVE_ARPA_INET_H 1
+#define HAVE_GETADDRINFO 1
+#define HAVE_GETTIMEOFDAY 1
+#define HAVE_NETDB_H 1
+#define HAVE_NETINET_IN_H 1
+#define HAVE_NETINET_IP_H 1
+#define HAVE_NETINET_TCP_H 1
+#define HAVE_SELECT 1
+#define HAVE_SOCKET 1
+#define HAVE_STRINGS_H 1
+#define HAVE_SYS_IOCTL_H 1
+#define HAVE_SYS_SOCKET_H 1
+#define HAVE_SYS_TIME_H 1
+#define HAVE_TERMIOS_H 1
+#define HAVE_UNISTD_H 1
+#define HAVE_DECL_TIOCM_RTS 1
+#if defined(__linux__)
+#define HAVE_LINUX_SERIAL_H 1
+#define HAVE_DECL_TIOCSRS485 1
+#endif
+#endif
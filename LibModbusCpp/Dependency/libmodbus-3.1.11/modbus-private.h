@@ -38,6 +38,9 @@ MODBUS_BEGIN_DECLS
 
 #define _MODBUS_EXCEPTION_RSP_LENGTH 5
 
+/* Size of the read-ahead buffer, enough for a few pipelined messages */
+#define _MODBUS_RX_BUFFER_LENGTH 4096
+
 /* Timeouts in microsecond (0.5 s) */
 #define _RESPONSE_TIMEOUT 500000
 #define _BYTE_TIMEOUT     500000
@@ -90,7 +93,7 @@ typedef struct _modbus_backend {
     unsigned int (*is_connected)(modbus_t *ctx);
     void (*close)(modbus_t *ctx);
     int (*flush)(modbus_t *ctx);
-    int (*select)(modbus_t *ctx, fd_set *rset, struct timeval *tv, int msg_length);
+    int (*select)(modbus_t *ctx, struct timeval *tv, int msg_length);
     void (*free)(modbus_t *ctx);
 } modbus_backend_t;
 
@@ -107,11 +110,23 @@ struct _modbus {
     struct timeval indication_timeout;
     const modbus_backend_t *backend;
     void *backend_data;
+    modbus_trace_callback trace_callback;
+    void *trace_user_data;
+    /* Read-ahead buffer (TCP only, NULL unless enabled with
+       modbus_set_read_ahead): bytes received beyond the current message are
+       kept here for the next one */
+    uint8_t *rx_buffer;
+    int rx_start;
+    int rx_end;
 };
 
 void _modbus_init_common(modbus_t *ctx);
+void _modbus_trace(modbus_t *ctx, modbus_trace_event event, int length);
 void _error_print(modbus_t *ctx, const char *context);
 int _modbus_receive_msg(modbus_t *ctx, uint8_t *msg, msg_type_t msg_type);
+#ifndef _WIN32
+int _modbus_poll(int fd, short events, struct timeval *tv);
+#endif
 
 #ifndef HAVE_STRLCPY
 size_t strlcpy(char *dest, const char *src, size_t dest_size);
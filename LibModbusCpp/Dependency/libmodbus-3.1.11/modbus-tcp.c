@@ -26,6 +26,9 @@
 #include <signal.h>
 #include <sys/types.h>
 
+/* HAVE_NETINET_IN_H / HAVE_NETINET_IP_H are tested below */
+#include "config.h"
+
 #if defined(_WIN32)
 /* Already set in modbus-tcp.h but it seems order matters in VS2005 */
 # include <winsock2.h>
@@ -36,6 +39,7 @@
 #else
 # include <sys/socket.h>
 # include <sys/ioctl.h>
+# include <poll.h>
 
 #if defined(__OpenBSD__) || (defined(__FreeBSD__) && __FreeBSD__ < 5)
 # define OS_BSD
@@ -290,15 +294,21 @@ static int _connect(int sockfd,
 #else
     if (rc == -1 && errno == EINPROGRESS) {
 #endif
-        fd_set wset;
         int optval;
         socklen_t optlen = sizeof(optval);
         struct timeval tv = *ro_tv;
 
         /* Wait to be available in writing */
+#ifdef OS_WIN32
+        fd_set wset;
+
         FD_ZERO(&wset);
         FD_SET(sockfd, &wset);
         rc = select(sockfd + 1, NULL, &wset, NULL, &tv);
+#else
+        while ((rc = _modbus_poll(sockfd, POLLOUT, &tv)) == -1 && errno == EINTR)
+            ;
+#endif
         if (rc < 0) {
             /* Fail */
             return -1;
@@ -742,6 +752,10 @@ int modbus_tcp_accept(modbus_t *ctx, int *s)
         return -1;
     }
 
+    /* Nothing read ahead belongs to the new connection */
+    ctx->rx_start = 0;
+    ctx->rx_end = 0;
+
     if (ctx->debug) {
         char buf[INET_ADDRSTRLEN];
         if (inet_ntop(AF_INET, &(addr.sin_addr), buf, INET_ADDRSTRLEN) == NULL) {
@@ -776,6 +790,10 @@ int modbus_tcp_pi_accept(modbus_t *ctx, int *s)
         return -1;
     }
 
+    /* Nothing read ahead belongs to the new connection */
+    ctx->rx_start = 0;
+    ctx->rx_end = 0;
+
     if (ctx->debug) {
         char buf[INET6_ADDRSTRLEN];
         if (inet_ntop(AF_INET6, &(addr.sin6_addr), buf, INET6_ADDRSTRLEN) == NULL) {
@@ -788,22 +806,30 @@ int modbus_tcp_pi_accept(modbus_t *ctx, int *s)
     return ctx->s;
 }
 
-static int
-_modbus_tcp_select(modbus_t *ctx, fd_set *rset, struct timeval *tv, int length_to_read)
+static int _modbus_tcp_select(modbus_t *ctx, struct timeval *tv, int length_to_read)
 {
     int s_rc;
-    while ((s_rc = select(ctx->s + 1, rset, NULL, NULL, tv)) == -1) {
+#ifdef OS_WIN32
+    /* A Windows fd_set is a list of sockets, the value isn't limited */
+    fd_set rset;
+
+    FD_ZERO(&rset);
+    FD_SET(ctx->s, &rset);
+    s_rc = select(ctx->s + 1, &rset, NULL, NULL, tv);
+    if (s_rc == -1) {
+        return -1;
+    }
+#else
+    while ((s_rc = _modbus_poll(ctx->s, POLLIN, tv)) == -1) {
         if (errno == EINTR) {
             if (ctx->debug) {
                 fprintf(stderr, "A non blocked signal was caught\n");
             }
-            /* Necessary after an error */
-            FD_ZERO(rset);
-            FD_SET(ctx->s, rset);
         } else {
             return -1;
         }
     }
+#endif
 
     if (s_rc == 0) {
         errno = ETIMEDOUT;
@@ -17,6 +17,9 @@
 #ifndef _MSC_VER
 #include <unistd.h>
 #endif
+#ifndef _WIN32
+#include <poll.h>
+#endif
 
 #include "config.h"
 
@@ -118,6 +121,15 @@ int modbus_flush(modbus_t *ctx)
     }
 
     rc = ctx->backend->flush(ctx);
+    if (rc > 0) {
+        _modbus_trace(ctx, MODBUS_TRACE_RECEIVE, rc);
+    }
+    if (rc != -1) {
+        /* Bytes already read ahead are flushed too */
+        rc += ctx->rx_end - ctx->rx_start;
+    }
+    ctx->rx_start = 0;
+    ctx->rx_end = 0;
     if (rc != -1 && ctx->debug) {
         /* Not all backends are able to return the number of bytes flushed */
         printf("Bytes flushed (%d)\n", rc);
@@ -175,6 +187,8 @@ static int send_msg(modbus_t *ctx, uint8_t *msg, int msg_length)
         printf("\n");
     }
 
+    _modbus_trace(ctx, MODBUS_TRACE_SEND_BEGIN, 0);
+
     /* In recovery mode, the write command will be issued until to be
        successful! Disabled by default. */
     do {
@@ -212,6 +226,8 @@ static int send_msg(modbus_t *ctx, uint8_t *msg, int msg_length)
         }
     } while ((ctx->error_recovery & MODBUS_ERROR_RECOVERY_LINK) && rc == -1);
 
+    _modbus_trace(ctx, MODBUS_TRACE_SEND_END, rc > 0 ? rc : 0);
+
     if (rc > 0 && rc != msg_length) {
         errno = EMBBADDATA;
         return -1;
@@ -343,9 +359,85 @@ compute_data_length_after_meta(modbus_t *ctx, uint8_t *msg, msg_type_t msg_type)
     return length;
 }
 
+/* Copies up to length bytes from the read-ahead buffer to msg, returns the
+   number of bytes copied */
+static int _modbus_rx_take(modbus_t *ctx, uint8_t *msg, int length)
+{
+    int available = ctx->rx_end - ctx->rx_start;
+
+    if (length > available)
+        length = available;
+    memcpy(msg, ctx->rx_buffer + ctx->rx_start, length);
+    ctx->rx_start += length;
+    if (ctx->rx_start == ctx->rx_end) {
+        ctx->rx_start = 0;
+        ctx->rx_end = 0;
+    }
+    return length;
+}
+
+#ifndef _WIN32
+/* Waits until fd is ready for events (POLLIN or POLLOUT). Unlike select(),
+   poll() doesn't limit the value of the descriptor to FD_SETSIZE. As select()
+   does on Linux, the time not elapsed is stored back in tv so that a wait
+   restarted after EINTR doesn't extend the timeout. Returns 1 when ready, 0
+   on timeout or -1 on error. */
+int _modbus_poll(int fd, short events, struct timeval *tv)
+{
+    struct pollfd pfd;
+    struct timespec start, end;
+    long long timeout_us;
+    long long elapsed_us;
+    int timeout_ms;
+    int rc;
+
+    pfd.fd = fd;
+    pfd.events = events;
+    pfd.revents = 0;
+
+    if (tv == NULL) {
+        timeout_us = -1;
+        timeout_ms = -1;
+    } else {
+        timeout_us = (long long) tv->tv_sec * 1000000 + tv->tv_usec;
+        /* Rounded up, a timeout shorter than 1 ms must not become a busy loop */
+        if (timeout_us > (long long) INT_MAX * 1000) {
+            timeout_ms = INT_MAX;
+        } else {
+            timeout_ms = (int) ((timeout_us + 999) / 1000);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &start);
+    }
+
+    rc = poll(&pfd, 1, timeout_ms);
+
+    if (tv != NULL) {
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        elapsed_us = (long long) (end.tv_sec - start.tv_sec) * 1000000 +
+                     (end.tv_nsec - start.tv_nsec) / 1000;
+        timeout_us = (elapsed_us < timeout_us) ? timeout_us - elapsed_us : 0;
+        tv->tv_sec = (long) (timeout_us / 1000000);
+        tv->tv_usec = (long) (timeout_us % 1000000);
+    }
+
+    if (rc > 0 && (pfd.revents & POLLNVAL)) {
+        /* Same error as select() on a closed descriptor */
+        errno = EBADF;
+        return -1;
+    }
+
+    return rc;
+}
+#endif
+
 /* Waits a response from a modbus server or a request from a modbus client.
    This function blocks if there is no replies (3 timeouts).
 
+   With a read-ahead buffer (TCP), each read takes everything available on
+   the socket and the message is parsed from the buffer, so a message costs
+   one wait and one recv at most and pipelined messages already received
+   cost none. The buffer is only refilled once it is empty.
+
    The function shall return the number of received characters and the received
    message in an array of uint8_t if successful. Otherwise it shall return -1
    and errno is set to one of the values defined below:
@@ -358,7 +450,6 @@ compute_data_length_after_meta(modbus_t *ctx, uint8_t *msg, msg_type_t msg_type)
 int _modbus_receive_msg(modbus_t *ctx, uint8_t *msg, msg_type_t msg_type)
 {
     int rc;
-    fd_set rset;
     struct timeval tv;
     struct timeval *p_tv;
     unsigned int length_to_read;
@@ -383,10 +474,6 @@ int _modbus_receive_msg(modbus_t *ctx, uint8_t *msg, msg_type_t msg_type)
         return -1;
     }
 
-    /* Add a file descriptor to the set */
-    FD_ZERO(&rset);
-    FD_SET(ctx->s, &rset);
-
     /* We need to analyse the message step by step.  At the first step, we want
      * to reach the function code because all packets contain this
      * information. */
@@ -412,63 +499,83 @@ int _modbus_receive_msg(modbus_t *ctx, uint8_t *msg, msg_type_t msg_type)
     }
 
     while (length_to_read != 0) {
-        rc = ctx->backend->select(ctx, &rset, p_tv, length_to_read);
-        if (rc == -1) {
-            _error_print(ctx, "select");
-            if (ctx->error_recovery & MODBUS_ERROR_RECOVERY_LINK) {
+        if (ctx->rx_start != ctx->rx_end) {
+            /* The bytes are already there */
+            rc = _modbus_rx_take(ctx, msg + msg_length, length_to_read);
+        } else {
+            rc = ctx->backend->select(ctx, p_tv, length_to_read);
+            if (rc == -1) {
+                _error_print(ctx, "select");
+                if (ctx->error_recovery & MODBUS_ERROR_RECOVERY_LINK) {
 #ifdef _WIN32
-                wsa_err = WSAGetLastError();
+                    wsa_err = WSAGetLastError();
 
-                // no equivalent to ETIMEDOUT when select fails on Windows
-                if (wsa_err == WSAENETDOWN || wsa_err == WSAENOTSOCK) {
+                    // no equivalent to ETIMEDOUT when select fails on Windows
+                    if (wsa_err == WSAENETDOWN || wsa_err == WSAENOTSOCK) {
+                        modbus_close(ctx);
+                        modbus_connect(ctx);
+                    }
+#else
+                    int saved_errno = errno;
+
+                    if (errno == ETIMEDOUT) {
+                        _sleep_response_timeout(ctx);
+                        modbus_flush(ctx);
+                    } else if (errno == EBADF) {
+                        modbus_close(ctx);
+                        modbus_connect(ctx);
+                    }
+                    errno = saved_errno;
+#endif
+                }
+                return -1;
+            }
+
+            if (ctx->rx_buffer != NULL) {
+                rc = ctx->backend->recv(ctx, ctx->rx_buffer, _MODBUS_RX_BUFFER_LENGTH);
+            } else {
+                rc = ctx->backend->recv(ctx, msg + msg_length, length_to_read);
+            }
+            if (rc == 0) {
+                errno = ECONNRESET;
+                rc = -1;
+            }
+
+            if (rc == -1) {
+                _error_print(ctx, "read");
+#ifdef _WIN32
+                wsa_err = WSAGetLastError();
+                if ((ctx->error_recovery & MODBUS_ERROR_RECOVERY_LINK) &&
+                    (wsa_err == WSAENOTCONN || wsa_err == WSAENETRESET ||
+                     wsa_err == WSAENOTSOCK || wsa_err == WSAESHUTDOWN ||
+                     wsa_err == WSAECONNABORTED || wsa_err == WSAETIMEDOUT ||
+                     wsa_err == WSAECONNRESET)) {
                     modbus_close(ctx);
                     modbus_connect(ctx);
                 }
 #else
-                int saved_errno = errno;
-
-                if (errno == ETIMEDOUT) {
-                    _sleep_response_timeout(ctx);
-                    modbus_flush(ctx);
-                } else if (errno == EBADF) {
+                if ((ctx->error_recovery & MODBUS_ERROR_RECOVERY_LINK) &&
+                    (errno == ECONNRESET || errno == ECONNREFUSED || errno == EBADF)) {
+                    int saved_errno = errno;
                     modbus_close(ctx);
                     modbus_connect(ctx);
+                    /* Could be removed by previous calls */
+                    errno = saved_errno;
                 }
-                errno = saved_errno;
 #endif
+                return -1;
             }
-            return -1;
-        }
 
-        rc = ctx->backend->recv(ctx, msg + msg_length, length_to_read);
-        if (rc == 0) {
-            errno = ECONNRESET;
-            rc = -1;
+            _modbus_trace(ctx, MODBUS_TRACE_RECEIVE, rc);
+            if (ctx->rx_buffer != NULL) {
+                ctx->rx_start = 0;
+                ctx->rx_end = rc;
+                rc = _modbus_rx_take(ctx, msg + msg_length, length_to_read);
+            }
         }
 
-        if (rc == -1) {
-            _error_print(ctx, "read");
-#ifdef _WIN32
-            wsa_err = WSAGetLastError();
-            if ((ctx->error_recovery & MODBUS_ERROR_RECOVERY_LINK) &&
-                (wsa_err == WSAENOTCONN || wsa_err == WSAENETRESET ||
-                 wsa_err == WSAENOTSOCK || wsa_err == WSAESHUTDOWN ||
-                 wsa_err == WSAECONNABORTED || wsa_err == WSAETIMEDOUT ||
-                 wsa_err == WSAECONNRESET)) {
-                modbus_close(ctx);
-                modbus_connect(ctx);
-            }
-#else
-            if ((ctx->error_recovery & MODBUS_ERROR_RECOVERY_LINK) &&
-                (errno == ECONNRESET || errno == ECONNREFUSED || errno == EBADF)) {
-                int saved_errno = errno;
-                modbus_close(ctx);
-                modbus_connect(ctx);
-                /* Could be removed by previous calls */
-                errno = saved_errno;
-            }
-#endif
-            return -1;
+        if (msg_length == 0) {
+            _modbus_trace(ctx, MODBUS_TRACE_FIRST_BYTE, 0);
         }
 
         /* Display the hex code of each character received */
@@ -523,6 +630,8 @@ int _modbus_receive_msg(modbus_t *ctx, uint8_t *msg, msg_type_t msg_type)
     if (ctx->debug)
         printf("\n");
 
+    _modbus_trace(ctx, MODBUS_TRACE_RECEIVE_END, 0);
+
     return ctx->backend->check_integrity(ctx, msg, msg_length);
 }
 
@@ -1770,6 +1879,13 @@ void _modbus_init_common(modbus_t *ctx)
 
     ctx->indication_timeout.tv_sec = 0;
     ctx->indication_timeout.tv_usec = 0;
+
+    ctx->trace_callback = NULL;
+    ctx->trace_user_data = NULL;
+
+    ctx->rx_buffer = NULL;
+    ctx->rx_start = 0;
+    ctx->rx_end = 0;
 }
 
 /* Define the slave number */
@@ -1813,6 +1929,12 @@ int modbus_set_socket(modbus_t *ctx, int s)
         return -1;
     }
 
+    if (s != ctx->s) {
+        /* Bytes read ahead belong to the previous socket: callers sharing a
+           context between connections drain them first (modbus_get_pending) */
+        ctx->rx_start = 0;
+        ctx->rx_end = 0;
+    }
     ctx->s = s;
     return 0;
 }
@@ -1827,6 +1949,55 @@ int modbus_get_socket(modbus_t *ctx)
     return ctx->s;
 }
 
+/* Enables (TCP only) or disables the read-ahead buffer. When enabled, each
+   read takes everything available on the socket and the following messages
+   are served from the buffer, see modbus_get_pending(). Disabled by default.
+   It can't be disabled while bytes are still pending (EBUSY). */
+int modbus_set_read_ahead(modbus_t *ctx, int enable)
+{
+    if (ctx == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (enable) {
+        if (ctx->backend->backend_type != _MODBUS_BACKEND_TYPE_TCP) {
+            errno = EINVAL;
+            return -1;
+        }
+        if (ctx->rx_buffer == NULL) {
+            ctx->rx_buffer = (uint8_t *) malloc(_MODBUS_RX_BUFFER_LENGTH);
+            if (ctx->rx_buffer == NULL) {
+                errno = ENOMEM;
+                return -1;
+            }
+            ctx->rx_start = 0;
+            ctx->rx_end = 0;
+        }
+    } else if (ctx->rx_buffer != NULL) {
+        if (ctx->rx_start != ctx->rx_end) {
+            errno = EBUSY;
+            return -1;
+        }
+        free(ctx->rx_buffer);
+        ctx->rx_buffer = NULL;
+    }
+    return 0;
+}
+
+/* Returns the number of bytes already read ahead and not consumed yet. An
+   event loop calls modbus_receive() again while it is not zero, since the
+   socket won't be reported readable for these bytes. */
+int modbus_get_pending(modbus_t *ctx)
+{
+    if (ctx == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    return ctx->rx_end - ctx->rx_start;
+}
+
 /* Get the timeout interval used to wait for a response */
 int modbus_get_response_timeout(modbus_t *ctx, uint32_t *to_sec, uint32_t *to_usec)
 {
@@ -1946,6 +2117,8 @@ int modbus_connect(modbus_t *ctx)
         return -1;
     }
 
+    ctx->rx_start = 0;
+    ctx->rx_end = 0;
     return ctx->backend->connect(ctx);
 }
 
@@ -1955,6 +2128,8 @@ void modbus_close(modbus_t *ctx)
         return;
 
     ctx->backend->close(ctx);
+    ctx->rx_start = 0;
+    ctx->rx_end = 0;
 }
 
 void modbus_free(modbus_t *ctx)
@@ -1962,6 +2137,7 @@ void modbus_free(modbus_t *ctx)
     if (ctx == NULL)
         return;
 
+    free(ctx->rx_buffer);
     ctx->backend->free(ctx);
 }
 
@@ -1976,6 +2152,28 @@ int modbus_set_debug(modbus_t *ctx, int flag)
     return 0;
 }
 
+/* The callback is invoked synchronously at each stage of a message exchange
+   (see modbus_trace_event) so the caller can timestamp them and count the
+   bytes actually sent and received. Pass NULL to disable tracing. */
+int modbus_set_trace_callback(modbus_t *ctx, modbus_trace_callback callback, void *user_data)
+{
+    if (ctx == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    ctx->trace_callback = callback;
+    ctx->trace_user_data = user_data;
+    return 0;
+}
+
+void _modbus_trace(modbus_t *ctx, modbus_trace_event event, int length)
+{
+    if (ctx->trace_callback != NULL) {
+        ctx->trace_callback(ctx, event, length, ctx->trace_user_data);
+    }
+}
+
 /* Allocates 4 arrays to store bits, input bits, registers and inputs
    registers. The pointers are stored in modbus_mapping structure.
 
@@ -188,12 +188,31 @@ typedef enum {
     MODBUS_QUIRK_ALL = 0xFF
 } modbus_quirks;
 
+/* Stages of a message exchange reported to the trace callback. length is
+   the number of bytes written by the send (MODBUS_TRACE_SEND_END) or
+   returned by one read of the backend (MODBUS_TRACE_RECEIVE, also for the
+   bytes discarded by modbus_flush), 0 for the other events */
+typedef enum {
+    MODBUS_TRACE_SEND_BEGIN = 0,
+    MODBUS_TRACE_SEND_END,
+    MODBUS_TRACE_FIRST_BYTE,
+    MODBUS_TRACE_RECEIVE_END,
+    MODBUS_TRACE_RECEIVE
+} modbus_trace_event;
+
+typedef void (*modbus_trace_callback)(modbus_t *ctx,
+                                      modbus_trace_event event,
+                                      int length,
+                                      void *user_data);
+
 MODBUS_API int modbus_set_slave(modbus_t *ctx, int slave);
 MODBUS_API int modbus_get_slave(modbus_t *ctx);
 MODBUS_API int modbus_set_error_recovery(modbus_t *ctx,
                                          modbus_error_recovery_mode error_recovery);
 MODBUS_API int modbus_set_socket(modbus_t *ctx, int s);
 MODBUS_API int modbus_get_socket(modbus_t *ctx);
+MODBUS_API int modbus_set_read_ahead(modbus_t *ctx, int enable);
+MODBUS_API int modbus_get_pending(modbus_t *ctx);
 
 MODBUS_API int
 modbus_get_response_timeout(modbus_t *ctx, uint32_t *to_sec, uint32_t *to_usec);
@@ -218,6 +237,8 @@ MODBUS_API void modbus_free(modbus_t *ctx);
 
 MODBUS_API int modbus_flush(modbus_t *ctx);
 MODBUS_API int modbus_set_debug(modbus_t *ctx, int flag);
+MODBUS_API int
+modbus_set_trace_callback(modbus_t *ctx, modbus_trace_callback callback, void *user_data);
 
 MODBUS_API const char *modbus_strerror(int errnum);
 
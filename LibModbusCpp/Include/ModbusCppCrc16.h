@@ -0,0 +1,9 @@
+﻿#pragma once
+#include <cstdint>
+#include <cstddef>
+
+#include "ModbusCppGlobal.h"
+
+// Modbus RTU 的 CRC16(多项式 0xA001 反射，初值 0xFFFF)，返回值低字节先发送
+// 按 8 字节一组查 8 张表(slicing-by-8)，结果与 libmodbus 的 crc16() 逐位相同
+MODBUSCPP_API uint16_t modbusCrc16(const uint8_t *data, const size_t length);
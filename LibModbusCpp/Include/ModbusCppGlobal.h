@@ -0,0 +1,11 @@
+﻿#pragma once
+
+#if defined(_MSC_VER)
+    # if defined(DLLBUILD)
+    #  define MODBUSCPP_API __declspec(dllexport)
+    # else
+    #  define MODBUSCPP_API __declspec(dllimport)
+    # endif
+#else
+    # define MODBUSCPP_API
+#endif
@@ -0,0 +1,66 @@
+﻿#pragma once
+#include <cstdint>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <atomic>
+
+#include "ModbusCppGlobal.h"
+
+// 单线程事件循环: Linux 使用 epoll，其他平台使用 poll / WSAPoll，都没有 FD_SETSIZE 的限制
+// 除 wakeup() 外所有接口只能在运行 runOnce() 的线程中调用(或事件循环启动前调用)
+class MODBUSCPP_API ModbusCppReactor
+{
+public:
+    // 关注的事件
+    enum Event : uint32_t
+    {
+        READABLE = 0x01,
+        WRITABLE = 0x02,
+    };
+
+    // 事件回调，参数为就绪的事件；出错或对端关闭时按可读通知，由回调里的 recv 发现
+    typedef std::function<void (const uint32_t events)> Handler;
+
+    ModbusCppReactor();
+    ~ModbusCppReactor();
+
+    ModbusCppReactor(const ModbusCppReactor &) = delete;
+    ModbusCppReactor &operator=(const ModbusCppReactor &) = delete;
+
+    bool open();
+    void close();
+
+    // 注册/修改/注销套接字，回调里可以注销任何套接字(包括自己)
+    bool addSocket(const int socket, const uint32_t events, const Handler handler);
+    bool modifySocket(const int socket, const uint32_t events);
+    void removeSocket(const int socket);
+
+    // 等待并分发一轮事件，timeoutMs < 0 表示一直等待；返回分发的事件数，出错返回 -1
+    int runOnce(const int timeoutMs);
+
+    // 唤醒阻塞在 runOnce() 中的线程，可以在任意线程调用
+    void wakeup();
+
+    // 当前使用的后端名称: "epoll" 或 "poll"
+    const char *backendName() const;
+
+private:
+    struct Entry
+    {
+        int         socket;
+        uint32_t    events;
+        Handler     handler;
+        bool        removed;
+    };
+
+    struct Backend;
+
+    void drainWakeup();
+    void releaseRemoved();
+
+    Backend                 *m_backend;         // 平台相关的状态(epoll 句柄或 pollfd 数组、唤醒句柄)
+    std::unordered_map<int, Entry *> m_entries; // 套接字 -> 注册信息
+    std::vector<Entry *>    m_removed;          // 本轮分发结束后再释放，避免回调里注销后悬空
+    std::atomic<bool>       m_wakeupPending;    // 合并多次唤醒
+};
@@ -0,0 +1,114 @@
+﻿#pragma once
+#include <cstdint>
+#include <array>
+#include <vector>
+#include <optional>
+#include <atomic>
+#include <string>
+
+#include "ModbusCppGlobal.h"
+
+// 服务器端的寄存器存储，替代 modbus_mapping_t，可以被服务器线程和应用程序线程同时读写
+// 每个表按 64 个地址分页，每页一个顺序锁(seqlock): 读不加锁，读到写入中途的数据时重试；写按地址升序锁定涉及的页
+// 跨页的读写同样是原子的，FC3 一次读到的多个寄存器一定来自同一时刻
+// 存储是稀疏的: 页在第一次写入时才分配，没写过的页读出 0，地址分散在整个 0-65535 范围内也只占用写过的页
+// 也可以放在命名共享内存段中(attachShared)，多个进程直接读写同一份数据，跨进程同样由每页的顺序锁保证一致
+//
+// 共享内存段布局(版本 1，所有字段为创建者的主机字节序):
+//   偏移 0     SharedHeader(64 字节): magic 0x4D42524D("MBRM")、版本、头长度、每页字节数、每页地址数、每表页数、表数、存储字节序、初始化完成标志
+//   偏移 64    合法地址位图: uint64_t[4][1024]，表顺序同 Table，第 i 位对应页内偏移 i
+//   之后       页: Page[4][1024]，每页 192 字节(4 字节序号 + 128 字节数据，按 64 字节对齐)，序号为奇数时表示正在写入
+// 头中任何字段与本进程不一致时拒绝打开
+class MODBUSCPP_API ModbusCppRegisterMap
+{
+public:
+    enum class Table
+    {
+        COILS,              // 线圈(FC1/5/15)
+        DISCRETE_INPUTS,    // 离散输入(FC2)
+        HOLDING_REGISTERS,  // 保持寄存器(FC3/6/16/22/23)
+        INPUT_REGISTERS     // 输入寄存器(FC4)
+    };
+
+    // 寄存器表的存储字节序
+    enum class ByteOrder
+    {
+        HOST,   // 主机字节序: 应用程序读写直接拷贝，服务器编码/解码时逐个转换
+        WIRE    // 网络字节序(大端): 服务器读写 PDU 时整块拷贝，应用程序读写时逐个转换，适合高频轮询大块寄存器
+    };
+
+    explicit ModbusCppRegisterMap(const ByteOrder byteOrder = ByteOrder::HOST);
+    ~ModbusCppRegisterMap();
+
+    ModbusCppRegisterMap(const ModbusCppRegisterMap &) = delete;
+    ModbusCppRegisterMap &operator=(const ModbusCppRegisterMap &) = delete;
+
+    // 定义合法的地址范围，初始值为 0；可以多次调用，必须在服务器启动前完成
+    bool addRange(const Table table, const uint16_t startAddress, const uint32_t count);
+    bool contains(const Table table, const uint16_t startAddress, const uint32_t count) const;
+    ByteOrder byteOrder() const;
+    // 已分配的页占用的内存(字节)，共享内存时为整个段的大小
+    size_t allocatedBytes() const;
+
+    // 把存储放到命名共享内存段(POSIX shm_open + mmap，Windows CreateFileMapping)，必须在 addRange 和任何读写之前调用
+    // create 为 true 时创建并初始化(同名段已存在时失败)，字节序取自构造参数；否则打开已有的段，布局版本和字节序必须一致
+    // 合法地址范围保存在段中，通常由创建者定义，其他进程打开后直接使用
+    // 写入进程在持有页锁时崩溃会使读取该页的进程一直等待
+    bool attachShared(const std::string &name, const bool create);
+    bool isShared() const;
+    // 删除共享内存段的名字，已经映射的进程不受影响(Windows 上最后一个进程释放时自动删除)
+    static bool removeShared(const std::string &name);
+
+    // 应用程序接口(主机字节序)，地址不在范围内时失败
+    std::optional<std::vector<uint16_t>> readRegisters(const Table table, const uint16_t startAddress, const uint16_t count) const;
+    bool writeRegisters(const Table table, const uint16_t startAddress, const std::vector<uint16_t> &values);
+    std::optional<std::vector<uint8_t>> readBits(const Table table, const uint16_t startAddress, const uint16_t count) const;
+    bool writeBits(const Table table, const uint16_t startAddress, const std::vector<uint8_t> &values);
+
+    // 服务器接口，直接读写 PDU 中的编码: 寄存器为大端字节，位按低位在前打包
+    bool readRegistersEncoded(const Table table, const uint16_t startAddress, const uint16_t count, uint8_t *bytes) const;
+    bool writeRegistersEncoded(const Table table, const uint16_t startAddress, const uint16_t count, const uint8_t *bytes);
+    bool readBitsPacked(const Table table, const uint16_t startAddress, const uint16_t count, uint8_t *bytes) const;
+    bool writeBitsPacked(const Table table, const uint16_t startAddress, const uint16_t count, const uint8_t *bytes);
+
+    // 取出 [startAddress, startAddress + count) 涉及各页的版本号(写入一次加 2)，versions 至少要有跨越的页数个元素
+    // 版本号没有变化说明这段地址的内容没有变化，用于缓存编码后的响应；有页正在写入时返回 false
+    bool pageVersions(const Table table, const uint16_t startAddress, const uint32_t count, uint32_t *versions) const;
+
+    // FC22: 结果 = (当前值 AND andMask) OR (orMask AND NOT andMask)，读-改-写是原子的；result 不为 NULL 时返回写入后的值
+    bool maskWriteRegister(const uint16_t address, const uint16_t andMask, const uint16_t orMask, uint16_t *result = NULL);
+
+    static const int        PAGE_BITS = 6;
+    static const uint32_t   PAGE_SIZE = 1u << PAGE_BITS;            // 每页地址数
+    static const uint32_t   PAGE_COUNT = 0x10000 >> PAGE_BITS;      // 每个表的页数
+
+private:
+    struct Page;
+
+    struct SharedHeader;
+
+    struct TableData
+    {
+        std::array<std::atomic<Page *>, PAGE_COUNT> pages;  // 页表，下标为 地址 >> PAGE_BITS，没写过的页为 NULL
+        uint64_t                    *valid;                 // 每页合法地址的位图，第 i 位对应页内偏移 i，共享内存时指向段内
+    };
+
+    // 没分配的页用全 0 的共享页代替，它的序号始终为 0
+    static const Page *zeroPage();
+    static const Page *loadPage(const TableData &table, const uint32_t index);
+    static Page *allocatePage(TableData &table, const uint32_t index);
+
+    template <typename Copy>
+    bool readPages(const Table table, const uint16_t startAddress, const uint32_t count, Copy copy) const;
+    template <typename Modify>
+    bool writePages(const Table table, const uint16_t startAddress, const uint32_t count, Modify modify);
+
+    void releaseShared();
+
+    ByteOrder                   m_byteOrder;
+    std::array<TableData, 4>    m_tables;
+    uint64_t                    *m_localValid;      // 不使用共享内存时的位图
+    void                        *m_shared;          // 共享内存段的映射地址，NULL 表示未使用
+    size_t                      m_sharedSize;
+    void                        *m_sharedHandle;    // Windows 的文件映射句柄
+};
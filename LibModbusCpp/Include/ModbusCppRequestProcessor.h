@@ -0,0 +1,50 @@
+﻿#pragma once
+#include <cstdint>
+
+#include "ModbusCppGlobal.h"
+
+class ModbusCppRegisterMap;
+class ModbusCppWriteEventRing;
+typedef struct _modbus modbus_t;
+
+// 服务器端的请求处理: 输入请求 PDU(从功能码开始)，输出响应 PDU，行为与 libmodbus 的 modbus_reply 一致
+// process() 不依赖 modbus_t，不做任何 I/O，可以被不同的传输层(TCP 服务器、网关等)复用
+// 基于 modbus_receive 的 libmodbus 服务器可以用 reply() 代替 modbus_reply，把 modbus_mapping_t 换成寄存器存储
+class MODBUSCPP_API ModbusCppRequestProcessor
+{
+public:
+    // PDU 最大长度(功能码 + 252 字节数据)
+    static const int PDU_MAX_LENGTH = 253;
+
+    // 寄存器存储由调用方创建和释放
+    explicit ModbusCppRequestProcessor(ModbusCppRegisterMap *registerMap);
+
+    // 写入成功后把写入事件放进队列，NULL 表示不发布(默认)；队列由调用方创建和释放
+    void setWriteEventRing(ModbusCppWriteEventRing *writeEvents);
+
+    // 处理一个请求，返回响应 PDU 的长度；异常响应同样正常返回(功能码最高位为 1)
+    // response 至少要有 PDU_MAX_LENGTH 字节，unit 只用于写入事件
+    int process(const uint8_t *request, const int requestLength, uint8_t *response, const uint8_t unit = 0);
+
+    // 与 modbus_reply 用法相同: request 为 modbus_receive 收到的完整 ADU，返回发送的字节数，失败返回 -1
+    // RTU 广播请求只执行不回复
+    int reply(modbus_t *ctx, const uint8_t *request, const int requestLength);
+
+private:
+    int readBits(const uint8_t *request, const int requestLength, uint8_t *response);
+    int readRegisters(const uint8_t *request, const int requestLength, uint8_t *response);
+    int writeBit(const uint8_t *request, const int requestLength, uint8_t *response);
+    int writeRegister(const uint8_t *request, const int requestLength, uint8_t *response);
+    int writeBits(const uint8_t *request, const int requestLength, uint8_t *response);
+    int writeRegisters(const uint8_t *request, const int requestLength, uint8_t *response);
+    int reportSlaveId(const uint8_t *request, const int requestLength, uint8_t *response);
+    int maskWriteRegister(const uint8_t *request, const int requestLength, uint8_t *response);
+    int writeAndReadRegisters(const uint8_t *request, const int requestLength, uint8_t *response);
+
+    static int exception(const uint8_t function, const uint8_t code, uint8_t *response);
+    void publishWrite(const uint8_t function, const uint16_t address, const uint16_t count, const uint8_t *data, const int dataLength);
+
+    ModbusCppRegisterMap    *m_registerMap;
+    ModbusCppWriteEventRing *m_writeEvents;
+    uint8_t                 m_unit;             // 正在处理的请求的单元标识
+};
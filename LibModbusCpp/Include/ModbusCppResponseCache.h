@@ -0,0 +1,58 @@
+﻿#pragma once
+#include <cstdint>
+#include <vector>
+#include <atomic>
+
+#include "ModbusCppGlobal.h"
+#include "ModbusCppRegisterMap.h"
+
+// 读请求(FC1-4)的响应缓存: 按 (单元标识, 功能码, 起始地址, 数量) 缓存编码好的完整响应 ADU
+// 通过寄存器存储的页版本号判断是否失效，命中时只需要拷贝并改写事务标识
+// 直接映射表，冲突时覆盖旧条目；lookup()/store() 不是线程安全的，每个事件循环线程各用一个，hits()/misses() 可以在其他线程读取
+class MODBUSCPP_API ModbusCppResponseCache
+{
+public:
+    // slots 取 2 的幂
+    explicit ModbusCppResponseCache(const ModbusCppRegisterMap *registerMap, const size_t slots = 256);
+
+    ModbusCppResponseCache(const ModbusCppResponseCache &) = delete;
+    ModbusCppResponseCache &operator=(const ModbusCppResponseCache &) = delete;
+
+    // 查找请求 ADU(Modbus TCP，含 MBAP 头)的响应，命中时写入 response 并返回长度
+    // 未命中返回 0；如果请求可以缓存，会记下当前页版本，处理完请求后调用 store() 保存响应
+    int lookup(const uint8_t *request, const size_t requestLength, uint8_t *response);
+    void store(const uint8_t *response, const size_t responseLength);
+
+    uint64_t hits() const;
+    uint64_t misses() const;
+
+    // Modbus TCP ADU 最大长度
+    static const size_t ADU_MAX_LENGTH = 260;
+
+private:
+    // FC1 最多 2000 个位，跨越的页数最多
+    static const uint32_t VERSIONS_MAX = (2000 + ModbusCppRegisterMap::PAGE_SIZE - 1) / ModbusCppRegisterMap::PAGE_SIZE + 1;
+
+    struct Entry
+    {
+        uint64_t    key = 0;
+        bool        valid = false;
+        uint32_t    versions[VERSIONS_MAX];
+        size_t      responseLength = 0;
+        uint8_t     response[ADU_MAX_LENGTH];
+    };
+
+    const ModbusCppRegisterMap  *m_registerMap;
+    std::vector<Entry>          m_entries;
+
+    // lookup() 未命中时记下的待保存请求
+    bool                        m_pending;
+    uint64_t                    m_pendingKey;
+    ModbusCppRegisterMap::Table m_pendingTable;
+    uint16_t                    m_pendingAddress;
+    uint16_t                    m_pendingCount;
+    uint32_t                    m_pendingVersions[VERSIONS_MAX];
+
+    std::atomic<uint64_t>       m_hits;
+    std::atomic<uint64_t>       m_misses;
+};
@@ -0,0 +1,116 @@
+﻿#pragma once
+#include <string>
+#include <vector>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+
+#include "ModbusCppGlobal.h"
+#include "ModbusCppReactor.h"
+#include "ModbusCppSerialConfig.h"
+#include "ModbusCppStatistics.h"
+#include "ModbusCppRtuClient.h"
+
+// 事件循环中单条总线的统计
+struct ModbusCppRtuBusStatistics
+{
+    std::string device;
+    uint64_t    requests = 0;       // 发送的请求数(含广播)
+    uint64_t    broadcasts = 0;     // 广播请求数(不等待响应)
+    uint64_t    responses = 0;      // 收到的正确响应数(含异常响应)
+    uint64_t    exceptions = 0;     // 异常响应数
+    uint64_t    timeouts = 0;       // 响应超时次数
+    uint64_t    frameErrors = 0;    // CRC 错误、帧不完整、从站地址或功能码不符
+    uint64_t    bytesSent = 0;
+    uint64_t    bytesReceived = 0;
+    uint64_t    readCalls = 0;      // 串口读取次数
+    size_t      queueDepth = 0;     // 当前排队的请求数(不含正在执行的)
+    ModbusCppLatencySnapshot latency;   // 成功请求从发送到收完响应的时间
+};
+
+// 事件循环统计
+struct ModbusCppRtuBusLoopStatistics
+{
+    uint64_t    iterations = 0;     // 事件循环被唤醒的次数
+    uint64_t    timerFires = 0;     // 帧间隔、剩余字节、静默间隔和响应超时定时器触发的次数
+    std::vector<ModbusCppRtuBusStatistics> buses;
+};
+
+// 多条 RTU 串口总线共用一个事件循环线程: 串口和 TCP 一样注册到 ModbusCppReactor，不再每条总线一个阻塞线程
+// 每条总线一个状态机，帧间隔、剩余字节到达时间、帧结束的静默间隔和响应超时都由该总线的 timerfd 定时(绝对时间，微秒精度)
+// 接收方式与 ModbusCppRtuClient 相同: 按功能码推算帧长度，剩余字节在线路上传输期间不关注可读事件，传完后一次读出
+// 请求可以在任意线程提交，完成回调在事件循环线程中调用；仅支持 POSIX(Linux 上使用 timerfd，其他系统按最近的定时时间等待)
+class MODBUSCPP_API ModbusCppRtuBusLoop
+{
+public:
+    typedef ModbusCppRtuClient::Result Result;
+
+    // 请求完成回调，不要在里面阻塞；response 为响应 PDU(异常响应也给出)，广播和失败时为空
+    typedef std::function<void (const Result result, const uint8_t *response, const size_t length)> Completion;
+
+    ModbusCppRtuBusLoop();
+    ~ModbusCppRtuBusLoop();
+
+    ModbusCppRtuBusLoop(const ModbusCppRtuBusLoop &) = delete;
+    ModbusCppRtuBusLoop &operator=(const ModbusCppRtuBusLoop &) = delete;
+
+    // 设置参数，必须在 start() 之前调用
+    // 添加一条串口总线，返回总线序号，失败返回 -1
+    int addBus(const ModbusCppSerialConfig &config);
+    void setResponseTimeout(const uint32_t msec);
+    // 帧结束的静默间隔，默认 3.5 个字符
+    void setSilentInterval(const uint32_t usec);
+    // 广播后留给从站处理的时间，默认 100 毫秒
+    void setBroadcastDelay(const uint32_t msec);
+
+    // 打开所有串口并启动事件循环线程，任何一个打开失败都不会启动
+    bool start();
+    // 停止后还没有完成的请求以 IO_ERROR 完成
+    void stop();
+    bool isRunning() const;
+
+    // 提交请求 PDU，同一条总线上按提交顺序执行；参数不合法或没有运行时返回 false，不会调用回调
+    bool submit(const int bus, const uint8_t slave, const uint8_t *pdu, const size_t pduLength, const Completion completion);
+    bool readHoldingRegisters(const int bus, const uint8_t slave, const uint16_t startAddress, const uint16_t count,
+        const std::function<void (const Result result, const std::vector<uint16_t> &values)> completion);
+
+    ModbusCppRtuBusLoopStatistics getStatistics() const;
+
+private:
+    struct Bus;
+    struct Request;
+
+    void loopThread();
+    void takePending();
+    void release();
+    void startNext(Bus *bus);
+    void send(Bus *bus);
+    void onReadable(Bus *bus);
+    void onTimer(Bus *bus);
+    void receive(Bus *bus);
+    void frameReceived(Bus *bus, const size_t length);
+    void finish(Bus *bus, const Result result, const size_t length);
+    void closeBus(Bus *bus);
+    uint32_t silentIntervalUsec(const Bus *bus) const;
+    void setTimer(Bus *bus, const std::chrono::steady_clock::time_point &deadline);
+    void cancelTimer(Bus *bus);
+    void setReadable(Bus *bus, const bool readable);
+
+    std::vector<Bus *>      m_buses;
+    uint32_t                m_responseTimeoutUsec;
+    uint32_t                m_silentIntervalUsec;   // 0 表示使用 3.5 个字符
+    uint32_t                m_broadcastDelayUsec;
+
+    ModbusCppReactor        m_reactor;
+    std::thread             m_thread;
+    std::atomic<bool>       m_running;
+
+    // 其他线程提交的请求，事件循环醒来后分到各总线的队列
+    std::mutex              m_pendingLock;
+    std::vector<Request *>  m_pending;
+
+    std::atomic<uint64_t>   m_iterations;
+    std::atomic<uint64_t>   m_timerFires;
+};
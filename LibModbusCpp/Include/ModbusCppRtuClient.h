@@ -0,0 +1,120 @@
+﻿#pragma once
+#include <string>
+#include <vector>
+#include <optional>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+
+#include "ModbusCppGlobal.h"
+#include "ModbusCppSerialConfig.h"
+#include "ModbusCppStatistics.h"
+
+class ModbusCppRtuTransport;
+
+// RTU 客户端统计
+struct ModbusCppRtuStatistics
+{
+    uint64_t    requests = 0;       // 发送的请求数(含广播)
+    uint64_t    broadcasts = 0;     // 广播请求数(不等待响应)
+    uint64_t    responses = 0;      // 收到的正确响应数(含异常响应)
+    uint64_t    exceptions = 0;     // 异常响应数
+    uint64_t    timeouts = 0;       // 响应超时次数
+    uint64_t    frameErrors = 0;    // CRC 错误、帧不完整、从站地址或功能码不符
+    uint64_t    bytesSent = 0;
+    uint64_t    bytesReceived = 0;
+    uint64_t    readCalls = 0;      // 串口/套接字读取次数(每次可能包含一次等待)
+    uint64_t    reconnects = 0;     // RTU over TCP 断线后的重连次数
+    ModbusCppLatencySnapshot latency;   // 成功请求从发送到收完响应的时间
+};
+
+// Modbus RTU 客户端(主站): 直接读写串口，不经过 libmodbus 的 RTU 后端
+// 接收时一次读出串口缓冲区中已有的所有数据，按功能码和字节数推算帧长度，再等剩余字节在线路上传完后一次读出，整帧交给解析
+// 长度无法推算的功能码以静默间隔(默认 3.5 个字符)作为帧结束，所有帧都要通过 CRC 校验
+// 每个请求都指定从站地址，同一个客户端可以轮询总线上的任意从站；所有接口线程安全，同一时刻总线上只有一个请求
+// 也可以通过 TCP 连接串口服务器(透传模式，RTU over TCP): 帧格式和 CRC 不变，不加 MBAP 头；TCP 上不等帧间隔，断线后下一个请求自动重连
+// 写请求的从站地址为 0 时广播: 发完立即返回(成功只表示已发出)，下一个请求在帧传完并经过广播延时后才发送
+class MODBUSCPP_API ModbusCppRtuClient
+{
+public:
+    // 最后一次请求的结果
+    enum class Result
+    {
+        OK,             // 收到正常响应
+        EXCEPTION,      // 收到异常响应，异常码见 lastException()
+        TIMEOUT,        // 响应超时
+        FRAME_ERROR,    // CRC 错误、帧不完整、从站地址或功能码不符
+        IO_ERROR,       // 串口没有打开或读写失败
+        INVALID         // 参数不合法
+    };
+
+    ModbusCppRtuClient();
+    ~ModbusCppRtuClient();
+
+    ModbusCppRtuClient(const ModbusCppRtuClient &) = delete;
+    ModbusCppRtuClient &operator=(const ModbusCppRtuClient &) = delete;
+
+    bool open(const ModbusCppSerialConfig &config);
+    // RTU over TCP，host 为 IPv4 地址
+    bool connectTcp(const std::string &host, const uint16_t port, const uint32_t connectTimeoutMs = 3000);
+    void close();
+    bool isOpen() const;
+
+    // 设置参数
+    void setResponseTimeout(const uint32_t msec);
+    // 帧结束的静默间隔，默认 3.5 个字符(TCP 上默认 50 毫秒)；USB 转串口等有传输延迟的设备可以调大
+    void setSilentInterval(const uint32_t usec);
+    // 广播后留给从站处理的时间，默认 100 毫秒
+    void setBroadcastDelay(const uint32_t msec);
+
+    // 读写寄存器和线圈，失败时返回空/false，原因见 lastResult()
+    std::optional<std::vector<uint16_t>> readHoldingRegisters(const uint8_t slave, const uint16_t startAddress, const uint16_t count);
+    std::optional<std::vector<uint16_t>> readInputRegisters(const uint8_t slave, const uint16_t startAddress, const uint16_t count);
+    std::optional<std::vector<bool>> readCoils(const uint8_t slave, const uint16_t startAddress, const uint16_t count);
+    std::optional<std::vector<bool>> readDiscreteInputs(const uint8_t slave, const uint16_t startAddress, const uint16_t count);
+    bool writeRegister(const uint8_t slave, const uint16_t address, const uint16_t value);
+    bool writeRegisters(const uint8_t slave, const uint16_t startAddress, const std::vector<uint16_t> &values);
+    bool writeCoil(const uint8_t slave, const uint16_t address, const bool value);
+
+    // 发送任意请求 PDU，响应 PDU 写入 response(至少 253 字节)；返回响应 PDU 长度(异常响应也返回)，广播返回 0，失败返回 -1
+    int transact(const uint8_t slave, const uint8_t *pdu, const size_t pduLength, uint8_t *response);
+
+    Result lastResult() const;
+    uint8_t lastException() const;
+
+    ModbusCppRtuStatistics getStatistics() const;
+    void resetStatistics();
+
+private:
+    Result receive(const uint8_t slave, const uint8_t function, const size_t predictedLength, uint8_t *frame, size_t &frameLength);
+    std::optional<std::vector<uint16_t>> readRegisters(const uint8_t function, const uint8_t slave, const uint16_t startAddress, const uint16_t count);
+    std::optional<std::vector<bool>> readBits(const uint8_t function, const uint8_t slave, const uint16_t startAddress, const uint16_t count);
+    bool write(const uint8_t *pdu, const size_t pduLength, const uint8_t slave);
+
+    ModbusCppRtuTransport   *m_transport;
+    ModbusCppSerialConfig   m_config;
+    bool                    m_tcp;                  // 当前是 TCP 连接，重连时使用下面的地址
+    std::string             m_host;
+    uint16_t                m_tcpPort;
+    uint32_t                m_connectTimeoutMs;
+    uint32_t                m_responseTimeoutUsec;
+    uint32_t                m_silentIntervalUsec;   // 0 表示使用 3.5 个字符
+    uint32_t                m_broadcastDelayUsec;
+    std::chrono::steady_clock::time_point m_idleSince;  // 上一帧结束的时间
+    mutable std::mutex      m_lock;
+
+    std::atomic<Result>     m_lastResult;
+    std::atomic<uint8_t>    m_lastException;
+
+    std::atomic<uint64_t>   m_requests;
+    std::atomic<uint64_t>   m_broadcasts;
+    std::atomic<uint64_t>   m_responses;
+    std::atomic<uint64_t>   m_exceptions;
+    std::atomic<uint64_t>   m_timeouts;
+    std::atomic<uint64_t>   m_frameErrors;
+    std::atomic<uint64_t>   m_bytesSent;
+    std::atomic<uint64_t>   m_bytesReceived;
+    std::atomic<uint64_t>   m_readCalls;
+    std::atomic<uint64_t>   m_reconnects;
+    ModbusCppLatencyHistogram m_latency;
+};
@@ -0,0 +1,126 @@
+﻿#pragma once
+#include <string>
+#include <vector>
+#include <deque>
+#include <array>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+
+#include "ModbusCppGlobal.h"
+#include "ModbusCppReactor.h"
+#include "ModbusCppSerialConfig.h"
+#include "ModbusCppStatistics.h"
+
+typedef struct _modbus modbus_t;
+struct ModbusCppMbapCounters;
+class ModbusCppMbapAcceptor;
+
+// 单条串口总线的统计
+struct ModbusCppGatewayBusStatistics
+{
+    std::string device;
+    uint64_t    requests = 0;           // 在总线上执行的请求数(含广播)
+    uint64_t    broadcasts = 0;         // 广播请求数(不等待响应)
+    uint64_t    timeouts = 0;           // 从站没有响应
+    uint64_t    errors = 0;             // 发送失败、CRC 错误、响应与请求不匹配
+    uint64_t    rejected = 0;           // 队列已满被拒绝的请求(回复 SLAVE_OR_SERVER_BUSY)
+    size_t      queueDepth = 0;         // 当前排队的请求数
+    size_t      queueDepthMax = 0;      // 历史最大排队数
+    uint64_t    busyUsec = 0;           // 总线占用时间: 帧间隔 + 发送 + 等待响应(或广播后的等待)
+    double      utilization = 0;        // busyUsec / 启动以来的时间
+    ModbusCppLatencySnapshot queueWait;     // 请求从入队到开始执行的等待时间
+    ModbusCppLatencySnapshot transaction;   // 请求在总线上的耗时(不含帧间隔)
+};
+
+// 网关统计
+struct ModbusCppGatewayStatistics
+{
+    size_t      connections = 0;            // 当前 TCP 连接数
+    uint64_t    connectionsAccepted = 0;    // 累计接受的连接数
+    uint64_t    connectionsRejected = 0;    // 超过最大连接数或描述符用尽被拒绝的连接数
+    uint64_t    requests = 0;               // 收到的 TCP 请求数
+    uint64_t    unroutable = 0;             // 单元标识没有对应总线的请求(回复 GATEWAY_PATH)
+    uint64_t    protocolErrors = 0;         // MBAP 头非法被断开的连接数
+    std::vector<ModbusCppGatewayBusStatistics> buses;
+};
+
+// Modbus TCP 转 RTU 网关: 一个事件循环线程接受任意数量的 TCP 主站，请求按单元标识路由到串口总线
+// 每条总线一个线程和一个请求队列，用 libmodbus 的 RTU 后端依次执行，每帧之前保证 3.5 字符的帧间隔
+// 响应按请求的事务标识和单元标识封装成 MBAP 返回给发出请求的连接；从站无响应时回复 GATEWAY_TARGET 异常
+// 单元标识 0 的写请求作为广播发到所有总线，不回复 TCP 主站
+class MODBUSCPP_API ModbusCppRtuGateway
+{
+public:
+    ModbusCppRtuGateway();
+    ~ModbusCppRtuGateway();
+
+    ModbusCppRtuGateway(const ModbusCppRtuGateway &) = delete;
+    ModbusCppRtuGateway &operator=(const ModbusCppRtuGateway &) = delete;
+
+    // 设置参数，必须在 start() 之前调用
+    // 添加一条串口总线，单元标识 firstUnit ~ lastUnit 的请求转发到这条总线；返回总线序号，失败返回 -1
+    int addBus(const ModbusCppSerialConfig &config, const uint8_t firstUnit = 1, const uint8_t lastUnit = 247);
+    void setResponseTimeout(const uint32_t msec);
+    // 广播后等待从站处理完的时间，之后才发送下一帧
+    void setBroadcastDelay(const uint32_t msec);
+    // 每条总线最多排队的请求数，超过时直接回复 SLAVE_OR_SERVER_BUSY
+    void setQueueLimit(const size_t limit);
+    void setMaxConnections(const size_t maxConnections);
+
+    // 启动/停止网关，启动时打开所有串口，任何一个打开失败都不会启动
+    bool start(const std::string &host, const uint16_t port);
+    void stop();
+    bool isRunning() const;
+
+    ModbusCppGatewayStatistics getStatistics() const;
+
+private:
+    struct Bus;
+    struct Connection;
+    struct Request;
+
+    void release();
+    void reactorThread();
+    void busThread(Bus *bus);
+    void execute(Bus *bus, Request *request);
+    void complete(Request *request);
+    void deliverResponses();
+    void acceptConnections();
+    void acceptConnection(const int socket);
+    void onConnectionEvent(Connection *connection, const uint32_t events);
+    void route(Connection *connection, const uint8_t *frame, const size_t length);
+    void replyException(Connection *connection, const uint8_t *frame, const uint8_t exception);
+    void closeConnection(Connection *connection);
+
+    std::vector<Bus *>      m_buses;
+    std::array<int, 256>    m_routes;           // 单元标识 -> 总线序号，-1 表示没有对应总线
+    uint32_t                m_responseTimeoutMs;
+    uint32_t                m_broadcastDelayMs;
+    size_t                  m_queueLimit;
+    size_t                  m_maxConnections;
+
+    ModbusCppReactor        m_reactor;
+    modbus_t                *m_listenContext;
+    int                     m_listenSocket;
+    std::thread             m_thread;
+    std::atomic<bool>       m_running;
+    std::chrono::steady_clock::time_point m_startTime;
+
+    // 连接只在事件循环线程中访问，总线线程只通过连接编号引用，连接关闭后的响应直接丢弃
+    std::unordered_map<uint64_t, Connection *> m_connections;
+    uint64_t                m_nextConnectionId;
+    std::atomic<size_t>     m_connectionsCount;
+
+    // 总线线程完成的请求，由事件循环线程取出发送
+    std::vector<Request *>  m_completed;
+    std::mutex              m_completedLock;
+
+    ModbusCppMbapAcceptor   *m_acceptor;        // 描述符用尽时拒绝等待中的连接
+    ModbusCppMbapCounters   *m_counters;        // 连接数、收发字节数等，与 ModbusCppTcpServer 共用
+    std::atomic<uint64_t>   m_requests;
+    std::atomic<uint64_t>   m_unroutable;
+};
@@ -0,0 +1,169 @@
+﻿#pragma once
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+
+#include "ModbusCppGlobal.h"
+#include "ModbusCppSerialConfig.h"
+#include "ModbusCppRegisterMap.h"
+#include "ModbusCppRtuClient.h"
+#include "ModbusCppStatistics.h"
+
+// 单个从站的扫描统计
+struct ModbusCppRtuSlaveStatistics
+{
+    uint8_t     slave = 0;
+    bool        online = true;          // 连续失败达到阈值后离线，只按退避间隔探测
+    uint64_t    polls = 0;              // 发出的读请求数
+    uint64_t    failures = 0;           // 超时或帧错误次数
+    uint64_t    exceptions = 0;         // 异常响应次数(从站在线，但扫描项配置有误)
+    uint64_t    probes = 0;             // 离线期间的探测次数
+    ModbusCppLatencySnapshot cycle;     // 同一扫描请求两次成功读取的实际间隔(微秒)
+    ModbusCppLatencySnapshot lateness;  // 实际开始时间比计划时间晚多少(微秒)
+};
+
+// 调度器统计
+struct ModbusCppRtuSchedulerStatistics
+{
+    uint64_t    requests = 0;           // 总线上执行的请求数(扫描 + 写入)
+    uint64_t    writes = 0;             // 写请求数
+    uint64_t    writeFailures = 0;      // 失败的写请求数(含没有发出的广播)
+    uint64_t    broadcasts = 0;         // 发出的广播帧数(合并后)
+    uint64_t    verifications = 0;      // 广播后的回读校验次数
+    uint64_t    verifyMismatches = 0;   // 回读值不符、读取失败或从站离线的次数
+    size_t      scanRequests = 0;       // 扫描项合并后的请求数
+    uint64_t    busyUsec = 0;           // 总线占用时间(帧间隔 + 请求到响应结束)
+    double      utilization = 0;        // busyUsec / 启动以来的时间
+    std::vector<ModbusCppRtuSlaveStatistics> slaves;
+    ModbusCppRtuStatistics client;      // 底层 RTU 客户端的统计
+};
+
+// 多从站 RTU 总线调度器: 独占一个串口，按扫描表周期读取总线上的所有从站
+// 同一从站、同一数据表、同一周期的扫描项在 start() 时合并成尽量少的请求(中间空洞不超过 8 个地址)
+// 每次选计划时间最早的请求执行(写请求优先)；从站连续失败后离线，之后只用它的第一个请求按指数退避探测，不再让超时占满总线
+// 广播写入(从站地址 0)不等响应，只占用帧传输时间和广播延时；队首连续的广播可以合并，相邻地址合成一帧，同一地址取最后的值
+// 可选在广播后回读扫描表中每个在线从站的这些寄存器，回读只在没有到期的扫描请求时执行，不影响扫描周期
+// 读到的数据、写入结果和回读结果通过回调通知，回调在调度线程中执行
+class MODBUSCPP_API ModbusCppRtuScheduler
+{
+public:
+    typedef ModbusCppRegisterMap::Table Table;
+    // 寄存器为原值，线圈/离散输入每个值为 0 或 1
+    typedef std::function<void (const uint8_t slave, const Table table, const uint16_t startAddress, const std::vector<uint16_t> &values)> DataCallback;
+    // 广播的 slave 为 0，succeeded 只表示已经发出
+    typedef std::function<void (const uint8_t slave, const uint16_t startAddress, const bool succeeded)> WriteCallback;
+    typedef std::function<void (const uint8_t slave, const uint16_t startAddress, const bool matched)> VerifyCallback;
+
+    ModbusCppRtuScheduler();
+    ~ModbusCppRtuScheduler();
+
+    ModbusCppRtuScheduler(const ModbusCppRtuScheduler &) = delete;
+    ModbusCppRtuScheduler &operator=(const ModbusCppRtuScheduler &) = delete;
+
+    // 设置参数，必须在 start() 之前调用
+    bool addScan(const uint8_t slave, const Table table, const uint16_t startAddress, const uint16_t count, const uint32_t periodMs);
+    void setResponseTimeout(const uint32_t msec);
+    // 连续失败多少次后离线
+    void setOfflineThreshold(const uint32_t failures);
+    // 离线后的探测间隔，从 initialMs 开始每次失败加倍，最大 maxMs
+    void setBackoff(const uint32_t initialMs, const uint32_t maxMs);
+    // 广播后留给从站处理的时间，默认 100 毫秒
+    void setBroadcastDelay(const uint32_t msec);
+    // 合并排队中的广播，默认开启
+    void setBroadcastCoalescing(const bool enabled);
+    // 广播后回读校验，默认关闭
+    void setVerifyBroadcasts(const bool enabled);
+    void setDataCallback(const DataCallback callback);
+    void setWriteCallback(const WriteCallback callback);
+    void setVerifyCallback(const VerifyCallback callback);
+
+    bool start(const ModbusCppSerialConfig &config);
+    void stop();
+    bool isRunning() const;
+
+    // 运行中提交写请求(FC16)，排在下一个扫描请求之前执行
+    bool writeRegisters(const uint8_t slave, const uint16_t startAddress, const std::vector<uint16_t> &values);
+    // 运行中提交广播写入(FC16，从站地址 0)，和写请求按提交顺序执行
+    bool broadcastRegisters(const uint16_t startAddress, const std::vector<uint16_t> &values);
+
+    ModbusCppRtuSchedulerStatistics getStatistics() const;
+
+private:
+    struct ScanItem
+    {
+        uint8_t         slave;
+        Table           table;
+        uint16_t        startAddress;
+        uint16_t        count;
+        uint32_t        periodMs;
+    };
+
+    struct SlaveState;
+    struct ScanRequest;
+
+    struct WriteRequest
+    {
+        uint8_t         slave;          // 0 表示广播
+        uint16_t        startAddress;
+        std::vector<uint16_t> values;
+    };
+
+    // 等待回读校验的寄存器，values 为期望值
+    struct Verification
+    {
+        uint8_t         slave;
+        uint16_t        startAddress;
+        std::vector<uint16_t> values;
+    };
+
+    void buildRequests();
+    void clearRequests();
+    void splitRequest(ScanRequest *request);
+    void schedulerThread();
+    ScanRequest *nextRequest(std::chrono::steady_clock::time_point &due);
+    void poll(ScanRequest *request, const std::chrono::steady_clock::time_point &due);
+    void executeWrite(const WriteRequest &write);
+    void executeBroadcasts(const std::vector<WriteRequest> &broadcasts);
+    void updateVerifications(const uint8_t slave, const uint16_t startAddress, const std::vector<uint16_t> &values);
+    void verify(const Verification &verification);
+    void recordBusy(const std::chrono::steady_clock::time_point &start);
+
+    ModbusCppRtuClient      m_client;
+    ModbusCppSerialConfig   m_config;
+    std::vector<ScanItem>   m_items;
+    std::vector<ScanRequest *> m_requests;      // 只在调度线程中访问(start() 之前建立)
+    std::map<uint8_t, SlaveState *> m_slaves;   // start() 时建立，运行期间不再增删
+    uint32_t                m_offlineThreshold;
+    uint32_t                m_broadcastDelayMs;
+    bool                    m_broadcastCoalescing;
+    bool                    m_verifyBroadcasts;
+    std::chrono::milliseconds m_backoffInitial;
+    std::chrono::milliseconds m_backoffMax;
+    DataCallback            m_dataCallback;
+    WriteCallback           m_writeCallback;
+    VerifyCallback          m_verifyCallback;
+
+    std::deque<WriteRequest> m_writes;
+    std::deque<Verification> m_verifications;   // 只在调度线程中访问
+    std::mutex              m_lock;             // 保护 m_writes 和 m_running 的等待
+    std::condition_variable m_condition;
+    std::thread             m_thread;
+    std::atomic<bool>       m_running;
+    std::chrono::steady_clock::time_point m_startTime;
+
+    std::atomic<size_t>     m_scanRequestCount;
+    std::atomic<uint64_t>   m_requestsCount;
+    std::atomic<uint64_t>   m_writesCount;
+    std::atomic<uint64_t>   m_writeFailures;
+    std::atomic<uint64_t>   m_broadcastsCount;
+    std::atomic<uint64_t>   m_verificationsCount;
+    std::atomic<uint64_t>   m_verifyMismatches;
+    std::atomic<uint64_t>   m_busyUsec;
+};
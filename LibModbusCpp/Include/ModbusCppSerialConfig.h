@@ -0,0 +1,34 @@
+﻿#pragma once
+#include <cstdint>
+#include <string>
+
+#include "ModbusCppGlobal.h"
+
+// 串口参数及 RTU 帧时序
+struct ModbusCppSerialConfig
+{
+    std::string device;         // 串口设备，如 /dev/ttyUSB0、/dev/pts/3、COM3
+    int         baud = 9600;
+    char        parity = 'N';   // 'N' / 'E' / 'O'
+    int         dataBits = 8;
+    int         stopBits = 1;
+
+    // 一个字符的传输时间(微秒): 起始位 + 数据位 + 校验位 + 停止位
+    uint32_t characterUsec() const
+    {
+        const int _bits = 1 + dataBits + ('N' == parity ? 0 : 1) + stopBits;
+        return static_cast<uint32_t>((_bits * 1000000ULL + baud - 1) / baud);
+    }
+
+    // 帧间隔 3.5 个字符，波特率高于 19200 时规范规定固定为 1750us
+    uint32_t frameGapUsec() const
+    {
+        return baud > 19200 ? 1750 : (characterUsec() * 7 + 1) / 2;
+    }
+
+    // length 字节的帧在线路上的传输时间
+    uint64_t frameUsec(const size_t length) const
+    {
+        return static_cast<uint64_t>(characterUsec()) * length;
+    }
+};
@@ -0,0 +1,156 @@
+﻿#pragma once
+#include <cstdint>
+#include <atomic>
+#include <array>
+#include <map>
+
+#include "ModbusCppGlobal.h"
+
+// 延迟分布快照(单位: 微秒)
+struct ModbusCppLatencySnapshot
+{
+    uint64_t    count = 0;      // 样本数
+    uint64_t    min = 0;        // 最小值
+    uint64_t    max = 0;        // 最大值
+    double      mean = 0;       // 平均值
+    uint64_t    p50 = 0;        // 50 分位
+    uint64_t    p99 = 0;        // 99 分位
+    uint64_t    p999 = 0;       // 99.9 分位
+};
+
+// HDR 风格的延迟直方图(对数-线性分桶，相对误差 < 1/16)
+// record() 只做几次原子加，可以在 I/O 线程里随时调用；snapshot() 不会阻塞记录
+class MODBUSCPP_API ModbusCppLatencyHistogram
+{
+public:
+    ModbusCppLatencyHistogram();
+
+    void record(const uint64_t usec);
+    void reset();
+    ModbusCppLatencySnapshot snapshot() const;
+
+private:
+    static size_t bucketIndex(const uint64_t value);
+    static uint64_t bucketUpperBound(const size_t index);
+
+    static const int        SUB_BUCKET_BITS = 4;                                    // 每个 2 的幂区间再细分为 16 个桶
+    static const size_t     SUB_BUCKET_COUNT = size_t(1) << SUB_BUCKET_BITS;
+    static const int        MAGNITUDE_MAX = 40;                                     // 最大可记录约 2^40 微秒(12 天)
+    static const size_t     BUCKET_COUNT = SUB_BUCKET_COUNT * 2 + (MAGNITUDE_MAX - SUB_BUCKET_BITS - 1) * SUB_BUCKET_COUNT;
+
+    std::array<std::atomic<uint64_t>, BUCKET_COUNT> m_buckets;
+    std::atomic<uint64_t>   m_sum;
+    std::atomic<uint64_t>   m_min;
+    std::atomic<uint64_t>   m_max;
+};
+
+// 单个功能码的统计快照
+struct ModbusCppFunctionStatistics
+{
+    uint64_t    requests = 0;       // 请求次数(一次调用计一次，不含重试)
+    uint64_t    failures = 0;       // 重试耗尽后仍失败的次数
+    uint64_t    retries = 0;        // 重试次数
+    uint64_t    timeouts = 0;       // 响应超时次数(每次尝试单独计数)
+    uint64_t    exceptions = 0;     // 收到异常响应的次数
+    uint64_t    bytesSent = 0;      // 发送字节数(套接字实际写入，含失败的尝试)
+    uint64_t    bytesReceived = 0;  // 接收字节数(套接字实际读到，含超时前收到的部分响应和被丢弃的迟到数据)
+    ModbusCppLatencySnapshot latency;   // 成功请求的延迟分布
+};
+
+// 单个连接的统计快照
+struct ModbusCppStatisticsSnapshot
+{
+    ModbusCppFunctionStatistics total;                          // 所有功能码汇总(延迟分布除外)
+    std::map<uint8_t, ModbusCppFunctionStatistics> functions;  // 按功能码统计，只包含发生过请求的功能码
+    size_t      queueDepth = 0;                                 // 当前异步任务队列长度
+    size_t      queueDepthMax = 0;                              // 异步任务队列历史最大长度
+};
+
+// 单个连接的统计计数器，所有接口都是线程安全的
+class MODBUSCPP_API ModbusCppStatistics
+{
+public:
+    ModbusCppStatistics();
+    ~ModbusCppStatistics();
+
+    ModbusCppStatistics(const ModbusCppStatistics &) = delete;
+    ModbusCppStatistics &operator=(const ModbusCppStatistics &) = delete;
+
+    // 记录一次请求的结果
+    void addRequest(const uint8_t function, const bool succeeded, const uint64_t usec);
+    void addRetry(const uint8_t function);
+    void addTimeout(const uint8_t function);
+    void addException(const uint8_t function);
+    void addBytes(const uint8_t function, const uint64_t sent, const uint64_t received);
+
+    // 异步任务队列长度
+    void setQueueDepth(const size_t depth);
+
+    void reset();
+    ModbusCppStatisticsSnapshot snapshot() const;
+
+private:
+    struct FunctionCounters
+    {
+        std::atomic<uint64_t>       requests{ 0 };
+        std::atomic<uint64_t>       failures{ 0 };
+        std::atomic<uint64_t>       retries{ 0 };
+        std::atomic<uint64_t>       timeouts{ 0 };
+        std::atomic<uint64_t>       exceptions{ 0 };
+        std::atomic<uint64_t>       bytesSent{ 0 };
+        std::atomic<uint64_t>       bytesReceived{ 0 };
+        ModbusCppLatencyHistogram   latency;
+    };
+
+    FunctionCounters *counters(const uint8_t function);
+
+    // 标准功能码最大到 0x2B，超出范围的归到最后一个槽位
+    static const uint8_t    FUNCTION_MAX = 0x2B;
+
+    // 按需分配，未使用过的功能码不占用直方图内存
+    std::array<std::atomic<FunctionCounters *>, FUNCTION_MAX + 1> m_functions;
+    std::atomic<size_t>     m_queueDepth;
+    std::atomic<size_t>     m_queueDepthMax;
+};
+
+// 单次请求各阶段耗时(单位: 微秒)，重试时只统计最后一次尝试的收发阶段
+struct ModbusCppRequestTiming
+{
+    uint8_t     function = 0;       // 功能码
+    bool        succeeded = false;  // 请求是否成功
+    int         attempts = 0;       // 尝试次数
+    uint64_t    queueWait = 0;      // 在异步任务队列中的等待时间(同步调用为 0)
+    uint64_t    lockWait = 0;       // 等待连接锁的时间
+    uint64_t    send = 0;           // 发送请求耗时
+    uint64_t    firstByte = 0;      // 发送完成到收到第一个响应字节
+    uint64_t    reassembly = 0;     // 收到第一个字节到完整帧接收完成
+    uint64_t    total = 0;          // 从入队(或调用)到请求完成的总耗时
+};
+
+// 各阶段耗时分布快照
+struct ModbusCppRequestTimingSnapshot
+{
+    ModbusCppLatencySnapshot queueWait;
+    ModbusCppLatencySnapshot lockWait;
+    ModbusCppLatencySnapshot send;
+    ModbusCppLatencySnapshot firstByte;
+    ModbusCppLatencySnapshot reassembly;
+    ModbusCppLatencySnapshot total;
+};
+
+// 按设备(连接)汇总各阶段耗时
+class MODBUSCPP_API ModbusCppRequestTimingStatistics
+{
+public:
+    void record(const ModbusCppRequestTiming &timing);
+    void reset();
+    ModbusCppRequestTimingSnapshot snapshot() const;
+
+private:
+    ModbusCppLatencyHistogram m_queueWait;
+    ModbusCppLatencyHistogram m_lockWait;
+    ModbusCppLatencyHistogram m_send;
+    ModbusCppLatencyHistogram m_firstByte;
+    ModbusCppLatencyHistogram m_reassembly;
+    ModbusCppLatencyHistogram m_total;
+};
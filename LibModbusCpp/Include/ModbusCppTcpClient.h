@@ -8,16 +8,13 @@
 #include <queue>
 #include <mutex>
 #include <condition_variable>
+#include <thread>
+#include <stop_token>
+#include <chrono>
+#include <atomic>
 
-#if defined(_MSC_VER)
-    # if defined(DLLBUILD)
-    #  define MODBUSCPP_API __declspec(dllexport)
-    # else
-    #  define MODBUSCPP_API __declspec(dllimport)
-    # endif
-#else
-    # define MODBUSCPP_API
-#endif
+#include "ModbusCppGlobal.h"
+#include "ModbusCppStatistics.h"
 
 
 typedef struct _modbus modbus_t;
@@ -50,11 +47,26 @@ public:
     // 异步读写
     bool writeRegistersAsync(const uint16_t startAddress, const std::vector<uint16_t> &data);
     bool readRegistersAsync(const uint16_t startAddress, const uint8_t dataLen);
-    std::optional<std::vector<uint16_t>> writeAndReadRegistersAsync(const uint16_t writeStartAddress, const std::vector<uint16_t>& writeData, const uint16_t readStartAddress, const uint8_t readLen);
+    bool writeAndReadRegistersAsync(const uint16_t writeStartAddress, const std::vector<uint16_t>& writeData, const uint16_t readStartAddress, const uint8_t readLen);
+
+    // 统计数据(延迟分布、请求/重试/超时/异常次数、收发字节数、队列长度)
+    ModbusCppStatisticsSnapshot getStatistics() const;
+    void resetStatistics();
+
+    // 请求各阶段耗时(队列等待、锁等待、发送、首字节、帧接收)，默认关闭
+    void setRequestTimingEnabled(const bool enabled);
+    void setRequestTimingCallback(const std::function<void (const ModbusCppRequestTiming &timing)> callback);
+    ModbusCppRequestTimingSnapshot getRequestTiming() const;
 
 private:
-    void processMsgThread();
-    void checkConnectionStateThread();
+    void processMsgThread(std::stop_token stopToken);
+    void checkConnectionStateThread(std::stop_token stopToken);
+    bool checkSocket();
+    void closeContext();
+    void recordAttempt(const uint8_t function, const int attempt, const bool succeeded);
+    void beginRequestTiming(const uint8_t function, const std::chrono::steady_clock::time_point &lockRequested);
+    void finishRequestTiming(const bool succeeded, std::unique_lock<std::mutex> &lock);
+    void onTraceEvent(const int event, const int length);
 
     enum class MsgType
     {
@@ -77,6 +89,10 @@ private:
         ModbusMsg(const MsgType type, const uint16_t startAddress, const uint8_t len)
             : msgType(type), readStartAddress(startAddress), lenToRead(len) {}
 
+        // 写并读数据
+        ModbusMsg(const MsgType type, const uint16_t writeAddress, const std::vector<uint16_t> &data, const uint16_t readAddress, const uint8_t len)
+            : msgType(type), writeStartAddress(writeAddress), dataToWrite(data), readStartAddress(readAddress), lenToRead(len) {}
+
         MsgType                 msgType = MsgType::NONE;
 
         uint16_t                writeStartAddress = 0;
@@ -84,13 +100,30 @@ private:
 
         uint16_t                readStartAddress = 0;
         uint8_t                 lenToRead = 0;
+
+        std::chrono::steady_clock::time_point enqueueTime = std::chrono::steady_clock::now();
+    };
+
+    // 当前请求各阶段的时间点，受 m_lockTest 保护
+    struct RequestTimingState
+    {
+        bool                    active = false;
+        uint8_t                 function = 0;
+        int                     attempts = 0;
+        std::chrono::steady_clock::time_point enqueued;
+        std::chrono::steady_clock::time_point lockRequested;
+        std::chrono::steady_clock::time_point lockAcquired;
+        std::chrono::steady_clock::time_point sendBegin;
+        std::chrono::steady_clock::time_point sendEnd;
+        std::chrono::steady_clock::time_point firstByte;
+        std::chrono::steady_clock::time_point receiveEnd;
     };
 
     static const uint8_t    DATA_LEN_MAX = 125;
 
     bool                    m_connected;
     std::mutex              m_checkConnectionStateLock;
-    std::condition_variable m_checkConnectionStateCondition;
+    std::condition_variable_any m_checkConnectionStateCondition;
 
     uint16_t                m_readBuffer[DATA_LEN_MAX];
     uint16_t                m_writeBuffer[DATA_LEN_MAX];
@@ -101,12 +134,25 @@ private:
     int                     m_retries;
     std::queue<ModbusMsg>   m_tasksQueue;
     std::mutex              m_taskLock;
-    std::condition_variable m_taskCondition;
+    std::condition_variable_any m_taskCondition;
 
     std::function<void ()> m_requestFailedCallback;
     std::function<void (const uint16_t startAddress, const std::vector<uint16_t> &data)> m_receivedDataCallback;
     std::function<void (bool connected)> m_connectionStateChangedCallback;
 
     std::mutex m_lockTest;
+
+    ModbusCppStatistics m_statistics;
+
+    std::atomic<bool>   m_requestTimingEnabled;
+    RequestTimingState  m_requestTiming;
+    uint64_t            m_attemptBytesSent;         // 本次尝试 libmodbus 实际收发的字节数，受 m_lockTest 保护
+    uint64_t            m_attemptBytesReceived;
+    ModbusCppRequestTimingStatistics m_requestTimingStatistics;
+    std::function<void (const ModbusCppRequestTiming &timing)> m_requestTimingCallback;
+
+    // 工作线程使用 m_modbusClient，析构时先停止并等待退出，再释放上下文
+    std::jthread        m_checkConnectionStateThread;
+    std::jthread        m_processMsgThread;
 };
 
@@ -0,0 +1,112 @@
+﻿#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+
+#include "ModbusCppGlobal.h"
+#include "ModbusCppTcpClient.h"
+#include "ModbusCppTcpServer.h"
+#include "ModbusCppRegisterMap.h"
+
+// 代理运行统计
+struct ModbusCppProxyStatistics
+{
+    bool        upstreamConnected = false;  // 当前是否连接上游设备
+    uint64_t    reconnects = 0;             // 重新连接上游的次数
+    uint64_t    polls = 0;                  // 发往上游的读请求数
+    uint64_t    pollFailures = 0;           // 上游读请求失败次数(失败时下游继续读到上次的值)
+    uint64_t    writesReceived = 0;         // 下游主站的写入次数
+    uint64_t    writesDropped = 0;          // 写入事件队列满丢失的下游写入
+    uint64_t    writesForwarded = 0;        // 合并后发往上游的写请求数
+    uint64_t    writeFailures = 0;          // 上游写请求失败次数(失败的写入保留，下次继续转发，连续失败 3 次后放弃)
+};
+
+// Modbus TCP 缓存代理: 上游用 ModbusCppTcpClient 按固定周期轮询设备的保持寄存器，下游用 ModbusCppTcpServer 从缓存的映像回应任意数量的主站
+// 下游的写入先写入映像，再由代理线程合并后转发给上游: 同一寄存器只保留最后一次的值，相邻地址合并为一个 FC16 请求
+// 上游的请求量只取决于轮询块和写入，与下游主站的数量无关
+class MODBUSCPP_API ModbusCppTcpProxy
+{
+public:
+    ModbusCppTcpProxy();
+    ~ModbusCppTcpProxy();
+
+    ModbusCppTcpProxy(const ModbusCppTcpProxy &) = delete;
+    ModbusCppTcpProxy &operator=(const ModbusCppTcpProxy &) = delete;
+
+    // 设置参数，必须在 start() 之前调用
+    void setUpstream(const std::string &host, const uint16_t port, const int slaveId);
+    void setUpstreamTimeout(const uint64_t msec);
+    void setReconnectInterval(const uint32_t msec);
+    void setServerThreadCount(const size_t threadCount);
+    void setMaxConnections(const size_t maxConnections);
+    // 轮询的保持寄存器块，每 intervalMs 毫秒读一次；超过单个请求长度的块自动拆分，下游只能访问已添加的地址
+    bool addPollBlock(const uint16_t startAddress, const uint16_t count, const uint32_t intervalMs);
+
+    // 启动/停止代理，上游连接失败时仍会启动，代理线程按重连间隔继续尝试
+    bool start(const std::string &listenHost, const uint16_t listenPort);
+    void stop();
+    bool isRunning() const;
+
+    ModbusCppProxyStatistics getStatistics() const;
+    ModbusCppServerStatistics getServerStatistics() const;
+    ModbusCppStatisticsSnapshot getUpstreamStatistics() const;
+
+private:
+    struct PollBlock
+    {
+        uint16_t        startAddress = 0;
+        uint16_t        count = 0;
+        std::chrono::milliseconds interval{ 0 };
+        std::chrono::steady_clock::time_point due;
+    };
+
+    struct PendingWrite
+    {
+        uint16_t        value;
+        uint8_t         attempts;   // 已经转发失败的次数
+    };
+
+    void proxyThread();
+    void connectUpstream();
+    void collectWrites();
+    void forwardWrites();
+    void poll(PollBlock &block);
+
+    static const size_t     WRITE_EVENT_CAPACITY = 4096;
+    static const uint16_t   READ_COUNT_MAX = 125;       // ModbusCppTcpClient 单次读取的最大寄存器数
+    static const uint16_t   WRITE_COUNT_MAX = 123;      // FC16 单次写入的最大寄存器数
+
+    std::string             m_upstreamHost;
+    uint16_t                m_upstreamPort;
+    int                     m_upstreamSlaveId;
+    std::chrono::milliseconds m_reconnectInterval;
+    size_t                  m_serverThreadCount;
+
+    ModbusCppTcpClient      m_upstream;
+    ModbusCppRegisterMap    m_registerMap;
+    ModbusCppTcpServer      m_server;
+    std::vector<PollBlock>  m_blocks;
+
+    // 以下只在代理线程中访问
+    std::map<uint16_t, PendingWrite> m_pendingWrites;   // 待转发的写入: 地址 -> 最后一次写入的值
+    std::vector<uint16_t>   m_values;
+    std::chrono::steady_clock::time_point m_reconnectDue;
+
+    std::thread             m_thread;
+    std::mutex              m_stopLock;
+    std::condition_variable m_stopCondition;
+    std::atomic<bool>       m_running;
+
+    std::atomic<bool>       m_upstreamConnected;
+    std::atomic<uint64_t>   m_reconnects;
+    std::atomic<uint64_t>   m_polls;
+    std::atomic<uint64_t>   m_pollFailures;
+    std::atomic<uint64_t>   m_writesReceived;
+    std::atomic<uint64_t>   m_writesForwarded;
+    std::atomic<uint64_t>   m_writeFailures;
+};
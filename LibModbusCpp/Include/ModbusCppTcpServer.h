@@ -0,0 +1,109 @@
+﻿#pragma once
+#include <string>
+#include <vector>
+#include <atomic>
+
+#include "ModbusCppGlobal.h"
+#include "ModbusCppReactor.h"
+#include "ModbusCppRequestProcessor.h"
+#include "ModbusCppRegisterMap.h"
+#include "ModbusCppResponseCache.h"
+#include "ModbusCppWriteEventRing.h"
+
+typedef struct _modbus modbus_t;
+
+// 服务器运行统计(所有事件循环线程汇总)
+struct ModbusCppServerStatistics
+{
+    size_t      connections = 0;            // 当前连接数
+    uint64_t    connectionsAccepted = 0;    // 累计接受的连接数
+    uint64_t    connectionsRejected = 0;    // 超过最大连接数或描述符用尽被拒绝的连接数
+    uint64_t    requests = 0;               // 处理的请求数
+    uint64_t    exceptions = 0;             // 返回异常响应的请求数
+    uint64_t    protocolErrors = 0;         // MBAP 头非法被断开的连接数
+    uint64_t    bytesReceived = 0;          // 接收字节数
+    uint64_t    bytesSent = 0;              // 发送字节数
+    uint64_t    receives = 0;               // 接收调用次数(io_uring 为接收完成次数)
+    uint64_t    sends = 0;                  // 发送调用次数，流水线请求的响应合并发送，可能少于请求数
+    uint64_t    waits = 0;                  // 事件循环进入内核等待的次数(epoll_wait / poll / io_uring_enter)
+    uint64_t    cacheHits = 0;              // 响应缓存命中次数
+    uint64_t    cacheMisses = 0;            // 可缓存的读请求未命中次数
+};
+
+// Modbus TCP 服务器: 每个事件循环线程独立 accept 并服务自己的连接(非阻塞 accept，每个连接独立拼帧)
+// 多线程时 Linux 上每个线程有自己的 SO_REUSEPORT 监听套接字，由内核分配新连接；其他平台共享同一个监听套接字
+// 请求由 ModbusCppRequestProcessor 处理，所有线程共享同一个 ModbusCppRegisterMap
+// 开启 io_uring 时每个线程一个环: 所有连接的收发在一次 io_uring_enter 中批量提交，接收使用 multishot recv 和内核挑选的共享缓冲区
+class MODBUSCPP_API ModbusCppTcpServer
+{
+public:
+    ModbusCppTcpServer();
+    ~ModbusCppTcpServer();
+
+    ModbusCppTcpServer(const ModbusCppTcpServer &) = delete;
+    ModbusCppTcpServer &operator=(const ModbusCppTcpServer &) = delete;
+
+    // 设置参数，必须在 start() 之前调用；寄存器存储由调用方创建和释放，运行期间应用程序可以直接读写
+    void setRegisterMap(ModbusCppRegisterMap *registerMap);
+    void setMaxConnections(const size_t maxConnections);
+    void setThreadCount(const size_t threadCount);
+    // 每个线程的读响应缓存槽位数(2 的幂)，0 表示不缓存(默认)；适合大量客户端轮询相同地址范围的场景
+    void setResponseCacheSlots(const size_t slots);
+    // 每个线程的写入事件队列容量(不是 2 的幂时向上取整)，0 表示不发布写入事件(默认)
+    void setWriteEventCapacity(const size_t capacity);
+    // 使用 io_uring 收发(Linux 6.1 及以上，默认关闭)；内核不支持或被禁用时 start() 自动退回事件循环
+    void setIoUringEnabled(const bool enabled);
+
+    // 启动/停止服务
+    bool start(const std::string &host, const uint16_t port);
+    void stop();
+    bool isRunning() const;
+
+    ModbusCppServerStatistics getStatistics() const;
+    // 实际使用的收发引擎: "io_uring"、"epoll" 或 "poll"，服务未启动时返回空字符串
+    const char *ioEngineName() const;
+
+    // 第 thread 个事件循环线程的写入事件队列，没有开启或服务未启动时返回 NULL
+    // 每个队列只能由一个应用程序线程读取，stop() 之后队列被释放，不能再访问
+    ModbusCppWriteEventRing *writeEvents(const size_t thread) const;
+
+private:
+    struct Shard;
+    struct Connection;
+
+    void release();
+    void reactorThread(Shard *shard);
+    void acceptConnections(Shard *shard);
+    bool acceptConnection(Shard *shard, const int socket);
+    void onConnectionEvent(Connection *connection, const uint32_t events);
+    void processFrame(Connection *connection, const uint8_t *frame, const size_t length);
+    void closeConnection(Connection *connection);
+
+    bool openUrings();
+    void uringThread(Shard *shard);
+    void uringAccept(Shard *shard);
+    void uringReadWakeup(Shard *shard);
+    void uringReceive(Connection *connection);
+    void uringReceived(Connection *connection, const int result, const uint32_t flags);
+    bool uringProcessFrames(Connection *connection);
+    void uringSend(Connection *connection);
+    void uringSubmitSend(Connection *connection);
+    void uringSent(Connection *connection, const int result);
+    void uringUpdateReceive(Connection *connection);
+    void uringDefer(Connection *connection);
+    void uringSubmitDeferred(Shard *shard);
+
+    ModbusCppRegisterMap        *m_registerMap;
+    size_t                      m_maxConnections;
+    size_t                      m_threadCount;
+    size_t                      m_responseCacheSlots;
+    size_t                      m_writeEventCapacity;
+    bool                        m_ioUringEnabled;
+    bool                        m_ioUring;          // 本次启动实际使用 io_uring
+
+    modbus_t                    *m_listenContext;
+    int                         m_listenSocket;     // 各线程共享的监听套接字，使用 SO_REUSEPORT 时为 -1
+    std::vector<Shard *>        m_shards;
+    std::atomic<bool>           m_running;
+    std::atomic<size_t>         m_connectionsCount; // 所有线程的连接总数，用于限制最大连接数
+};
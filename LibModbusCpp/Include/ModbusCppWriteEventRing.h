@@ -0,0 +1,55 @@
+﻿#pragma once
+#include <cstdint>
+#include <vector>
+#include <atomic>
+
+#include "ModbusCppGlobal.h"
+
+// 服务器接受的一次写入(FC5/6/15/16/22/23)
+struct ModbusCppWriteEvent
+{
+    uint64_t    timestamp = 0;  // 写入寄存器存储后的时间(steady_clock，微秒)
+    uint8_t     unit = 0;       // 单元标识(RTU 为从站地址)
+    uint8_t     function = 0;   // 功能码
+    uint16_t    address = 0;    // 起始地址
+    uint16_t    count = 0;      // 写入的位数或寄存器数
+    uint8_t     data[246];      // 写入的值，与 PDU 编码相同: 寄存器为大端字节，位按低位在前打包；FC22 为写入后的寄存器值
+
+    // 第 index 个寄存器/位的值
+    uint16_t registerValue(const uint16_t index) const;
+    bool bitValue(const uint16_t index) const;
+};
+
+// 单生产者/单消费者的无锁环形队列: 服务器的每个事件循环线程写入，一个应用程序线程读取
+// 队列满时丢弃新事件并计数，不会阻塞服务器
+class MODBUSCPP_API ModbusCppWriteEventRing
+{
+public:
+    // capacity 不是 2 的幂时向上取整，最小为 2
+    explicit ModbusCppWriteEventRing(const size_t capacity);
+
+    ModbusCppWriteEventRing(const ModbusCppWriteEventRing &) = delete;
+    ModbusCppWriteEventRing &operator=(const ModbusCppWriteEventRing &) = delete;
+
+    // 生产者: reserve() 取得下一个空位直接填写，填好后 commit()；队列满时返回 NULL
+    ModbusCppWriteEvent *reserve();
+    void commit();
+
+    // 消费者: 取出一个事件，队列空时返回 false
+    bool pop(ModbusCppWriteEvent &event);
+
+    size_t size() const;
+    size_t capacity() const;
+    uint64_t dropped() const;
+
+private:
+    std::vector<ModbusCppWriteEvent> m_events;
+    size_t                      m_mask;
+
+    // 生产者和消费者各自的位置放在不同缓存行，另外各自缓存对方的位置，减少跨核读取
+    alignas(64) std::atomic<size_t> m_head;     // 下一个写入位置，只有生产者修改
+    size_t                      m_cachedTail;
+    std::atomic<uint64_t>       m_dropped;
+    alignas(64) std::atomic<size_t> m_tail;     // 下一个读取位置，只有消费者修改
+    size_t                      m_cachedHead;
+};
@@ -0,0 +1,53 @@
+﻿#include "ModbusCppCrc16.h"
+#include <array>
+
+typedef std::array<std::array<uint16_t, 256>, 8> CrcTables;
+
+// 第 0 张表是单字节查表；第 k 张表是一个字节后面再跟 k 个 0 字节时的 CRC，一次可以并行处理 8 个字节，编译期生成
+static constexpr CrcTables makeTables()
+{
+	CrcTables _tables = {};
+	for (uint32_t i = 0; i < 256; ++i)
+	{
+		uint16_t _crc = static_cast<uint16_t>(i);
+		for (int j = 0; j < 8; ++j)
+		{
+			_crc = (_crc & 1) ? static_cast<uint16_t>((_crc >> 1) ^ 0xA001) : static_cast<uint16_t>(_crc >> 1);
+		}
+		_tables[0][i] = _crc;
+	}
+	for (size_t k = 1; k < 8; ++k)
+	{
+		for (uint32_t i = 0; i < 256; ++i)
+		{
+			const uint16_t _previous = _tables[k - 1][i];
+			_tables[k][i] = static_cast<uint16_t>((_previous >> 8) ^ _tables[0][_previous & 0xFF]);
+		}
+	}
+	return _tables;
+}
+
+static constexpr CrcTables CRC_TABLES = makeTables();
+
+uint16_t modbusCrc16(const uint8_t *data, const size_t length)
+{
+	uint16_t _crc = 0xFFFF;
+	size_t i = 0;
+	// 当前 CRC 只有 16 位，只和每组的前两个字节异或，8 次查表之间没有依赖
+	for (; i + 8 <= length; i += 8)
+	{
+		_crc = static_cast<uint16_t>(CRC_TABLES[7][(data[i] ^ _crc) & 0xFF]
+			^ CRC_TABLES[6][data[i + 1] ^ (_crc >> 8)]
+			^ CRC_TABLES[5][data[i + 2]]
+			^ CRC_TABLES[4][data[i + 3]]
+			^ CRC_TABLES[3][data[i + 4]]
+			^ CRC_TABLES[2][data[i + 5]]
+			^ CRC_TABLES[1][data[i + 6]]
+			^ CRC_TABLES[0][data[i + 7]]);
+	}
+	for (; i < length; ++i)
+	{
+		_crc = static_cast<uint16_t>((_crc >> 8) ^ CRC_TABLES[0][(_crc ^ data[i]) & 0xFF]);
+	}
+	return _crc;
+}
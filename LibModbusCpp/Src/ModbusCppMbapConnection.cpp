@@ -0,0 +1,138 @@
+﻿#include "ModbusCppMbapConnection.h"
+
+bool ModbusCppMbapConnection::receive(ModbusCppMbapCounters& counters)
+{
+	const int _received = socketReceive(socket, input + inputEnd, MBAP_INPUT_BUFFER_SIZE - inputEnd);
+	counters.receives.fetch_add(1, std::memory_order_relaxed);
+	if (_received > 0)
+	{
+		inputEnd += _received;
+		counters.bytesReceived.fetch_add(_received, std::memory_order_relaxed);
+		return true;
+	}
+
+	// 0 为对端关闭
+	return _received < 0 && socketWouldBlock();
+}
+
+bool ModbusCppMbapConnection::flush(ModbusCppMbapCounters& counters)
+{
+	while (outputOffset < output.size())
+	{
+		const int _result = socketSend(socket, output.data() + outputOffset, output.size() - outputOffset);
+		if (_result < 0)
+		{
+			return socketWouldBlock();
+		}
+		outputOffset += _result;
+		counters.bytesSent.fetch_add(_result, std::memory_order_relaxed);
+		counters.sends.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	output.clear();
+	outputOffset = 0;
+	return true;
+}
+
+void ModbusCppMbapConnection::updateEvents(ModbusCppReactor& reactor)
+{
+	const size_t _pending = pendingOutput();
+	uint32_t _events = 0;
+	if (_pending < MBAP_OUTPUT_HIGH_WATER)
+	{
+		_events |= ModbusCppReactor::READABLE;
+	}
+	if (_pending > 0)
+	{
+		_events |= ModbusCppReactor::WRITABLE;
+	}
+	if (_events != events)
+	{
+		events = _events;
+		reactor.modifySocket(socket, _events);
+	}
+}
+
+size_t ModbusCppMbapConnection::pendingOutput() const
+{
+	return output.size() - outputOffset;
+}
+
+#if !defined(_WIN32)
+static int openSpare()
+{
+	return open("/dev/null", O_RDONLY | O_CLOEXEC);
+}
+#endif
+
+ModbusCppMbapAcceptor::ModbusCppMbapAcceptor()
+#if defined(_WIN32)
+	: m_spare(-1)
+#else
+	: m_spare(openSpare())
+#endif
+{
+}
+
+ModbusCppMbapAcceptor::~ModbusCppMbapAcceptor()
+{
+#if !defined(_WIN32)
+	if (-1 != m_spare)
+	{
+		close(m_spare);
+	}
+#endif
+}
+
+int ModbusCppMbapAcceptor::acceptConnection(const int listenSocket)
+{
+#if defined(__linux__)
+	return accept4(listenSocket, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
+	const int _socket = static_cast<int>(accept(listenSocket, NULL, NULL));
+	if (-1 != _socket)
+	{
+		socketSetNonBlocking(_socket);
+#if !defined(_WIN32)
+		fcntl(_socket, F_SETFD, FD_CLOEXEC);
+#endif
+	}
+	return _socket;
+#endif
+}
+
+bool ModbusCppMbapAcceptor::descriptorsExhausted()
+{
+#if defined(_WIN32)
+	return WSAEMFILE == WSAGetLastError();
+#else
+	return EMFILE == errno || ENFILE == errno;
+#endif
+}
+
+// 监听套接字是非阻塞的，没有等待的连接时 accept 立即失败
+// 预留的描述符被其他线程(ENFILE 时是其他进程)抢走时这一轮什么也做不了，下次可读时再试
+void ModbusCppMbapAcceptor::rejectConnections(const int listenSocket, ModbusCppMbapCounters &counters)
+{
+#if defined(_WIN32)
+	(void)listenSocket;
+	(void)counters;
+#else
+	while (true)
+	{
+		if (-1 == m_spare && -1 == (m_spare = openSpare()))
+		{
+			return;
+		}
+		close(m_spare);
+		const int _socket = accept(listenSocket, NULL, NULL);
+		m_spare = openSpare();
+		if (-1 == _socket)
+		{
+			return;
+		}
+		close(_socket);
+		counters.connectionsRejected.fetch_add(1, std::memory_order_relaxed);
+	}
+#endif
+}
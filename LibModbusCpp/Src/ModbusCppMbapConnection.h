@@ -0,0 +1,169 @@
+﻿#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+#include <atomic>
+
+#include "ModbusCppReactor.h"
+#include "ModbusCppSocket.h"
+#include "modbus.h"
+
+// 内部使用: Modbus TCP 服务端连接的公共部分(MBAP 拆帧、合并发送、背压)，ModbusCppTcpServer 和 ModbusCppRtuGateway 共用
+
+// MBAP 头长度(事务标识 2 + 协议标识 2 + 长度 2 + 单元标识 1)
+const size_t MBAP_LENGTH = 7;
+// MBAP 长度字段的取值范围(单元标识 + PDU)
+const uint16_t MBAP_LENGTH_FIELD_MIN = 2;
+const uint16_t MBAP_LENGTH_FIELD_MAX = 1 + MODBUS_MAX_PDU_LENGTH;
+// 每个连接的接收缓冲区，能放下多个最大长度的请求
+const size_t MBAP_INPUT_BUFFER_SIZE = 2048;
+// 待发送数据超过该值时暂停读取，防止不读响应的客户端占用大量内存
+const size_t MBAP_OUTPUT_HIGH_WATER = 64 * 1024;
+// 默认最大连接数
+const size_t MBAP_MAX_CONNECTIONS_DEFAULT = 10000;
+// listen 的等待队列长度
+const int MBAP_LISTEN_BACKLOG = 1024;
+
+// 连接统计，只有事件循环线程写入
+struct ModbusCppMbapCounters
+{
+    std::atomic<uint64_t>   connectionsAccepted{ 0 };
+    std::atomic<uint64_t>   connectionsRejected{ 0 };   // 超过最大连接数或描述符用尽被拒绝
+    std::atomic<uint64_t>   protocolErrors{ 0 };        // MBAP 头非法被断开
+    std::atomic<uint64_t>   bytesReceived{ 0 };
+    std::atomic<uint64_t>   bytesSent{ 0 };
+    std::atomic<uint64_t>   receives{ 0 };              // recv 调用次数
+    std::atomic<uint64_t>   sends{ 0 };                 // send 调用次数
+};
+
+// 一个 TCP 连接的收发缓冲区，只在所属的事件循环线程中访问
+// 返回 false 的操作表示连接出错或对端已关闭，由调用方关闭连接并释放
+struct ModbusCppMbapConnection
+{
+    int                     socket = -1;
+    uint32_t                events = 0;             // 当前在事件循环中关注的事件
+    uint8_t                 input[MBAP_INPUT_BUFFER_SIZE];
+    size_t                  inputBegin = 0;         // 未处理数据的起始位置
+    size_t                  inputEnd = 0;           // 未处理数据的结束位置
+    std::vector<uint8_t>    output;                 // 待发送的响应，发完后清空但保留容量
+    size_t                  outputOffset = 0;       // output 中已发送的长度
+
+    // 事件循环回调: 先发送积压的响应，再接收并处理请求，最后更新关注的事件
+    // 每个完整的请求调用一次 onFrame(frame, length)，响应追加到 output，全部处理完后一次发送
+    template <typename OnFrame>
+    bool onEvents(const uint32_t readyEvents, ModbusCppReactor &reactor, ModbusCppMbapCounters &counters, OnFrame &&onFrame);
+
+    // 每次可读只调用一次 recv，剩余数据由下一轮事件继续读取
+    bool receive(ModbusCppMbapCounters &counters);
+    // 取出缓冲区中所有完整的请求，不完整的帧移到缓冲区开头；MBAP 头非法时帧边界已经无法确定，返回 false
+    template <typename OnFrame>
+    bool takeFrames(ModbusCppMbapCounters &counters, OnFrame &&onFrame);
+    // 发送 output，发不完的部分等可写事件
+    bool flush(ModbusCppMbapCounters &counters);
+    // 有积压时关注可写事件，积压过多时暂停读取
+    void updateEvents(ModbusCppReactor &reactor);
+    size_t pendingOutput() const;
+};
+
+template <typename OnFrame>
+bool ModbusCppMbapConnection::onEvents(const uint32_t readyEvents, ModbusCppReactor &reactor, ModbusCppMbapCounters &counters, OnFrame &&onFrame)
+{
+	if ((readyEvents & ModbusCppReactor::WRITABLE) && !flush(counters))
+	{
+		return false;
+	}
+	if (readyEvents & ModbusCppReactor::READABLE)
+	{
+		// 之前的响应还没发完时已经在等可写事件，新响应排在后面
+		const bool _backlog = !output.empty();
+		if (!receive(counters) || !takeFrames(counters, onFrame) || (!_backlog && !flush(counters)))
+		{
+			return false;
+		}
+	}
+	updateEvents(reactor);
+	return true;
+}
+
+template <typename OnFrame>
+bool ModbusCppMbapConnection::takeFrames(ModbusCppMbapCounters &counters, OnFrame &&onFrame)
+{
+	while (inputEnd - inputBegin >= MBAP_LENGTH)
+	{
+		const uint8_t *_frame = input + inputBegin;
+		const uint16_t _protocol = static_cast<uint16_t>((_frame[2] << 8) | _frame[3]);
+		const uint16_t _length = static_cast<uint16_t>((_frame[4] << 8) | _frame[5]);
+		if (0 != _protocol || _length < MBAP_LENGTH_FIELD_MIN || _length > MBAP_LENGTH_FIELD_MAX)
+		{
+			counters.protocolErrors.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+
+		const size_t _frameLength = MBAP_LENGTH - 1 + _length;
+		if (inputEnd - inputBegin < _frameLength)
+		{
+			break;
+		}
+		onFrame(_frame, _frameLength);
+		inputBegin += _frameLength;
+	}
+
+	if (inputBegin == inputEnd)
+	{
+		inputBegin = 0;
+		inputEnd = 0;
+	}
+	else if (inputBegin > 0)
+	{
+		memmove(input, input + inputBegin, inputEnd - inputBegin);
+		inputEnd -= inputBegin;
+		inputBegin = 0;
+	}
+	return true;
+}
+
+// 监听套接字的 accept 循环，新连接都是非阻塞、exec 时关闭的
+// 描述符用尽(EMFILE/ENFILE)时等待中的连接取不出来，水平触发的事件循环会不停报告可读而空转:
+// 平时预留一个描述符，用尽时先关闭它腾出位置，取出等待的连接立即关闭，再重新占住
+class ModbusCppMbapAcceptor
+{
+public:
+    ModbusCppMbapAcceptor();
+    ~ModbusCppMbapAcceptor();
+    ModbusCppMbapAcceptor(const ModbusCppMbapAcceptor &) = delete;
+    ModbusCppMbapAcceptor &operator=(const ModbusCppMbapAcceptor &) = delete;
+
+    // 监听套接字可读: 一次取完所有等待中的连接，交给 onAccept(socket)
+    template <typename OnAccept>
+    void acceptConnections(const int listenSocket, ModbusCppMbapCounters &counters, OnAccept &&onAccept);
+    // accept 因描述符用尽失败后调用: 拒绝所有等待中的连接，计入 connectionsRejected
+    void rejectConnections(const int listenSocket, ModbusCppMbapCounters &counters);
+    // 上一次 accept 失败是否因为描述符用尽
+    static bool descriptorsExhausted();
+
+private:
+    // 取出一个连接，失败返回 -1
+    static int acceptConnection(const int listenSocket);
+
+    int m_spare;    // 预留的描述符，Windows 上不使用
+};
+
+template <typename OnAccept>
+void ModbusCppMbapAcceptor::acceptConnections(const int listenSocket, ModbusCppMbapCounters &counters, OnAccept &&onAccept)
+{
+	while (true)
+	{
+		const int _socket = acceptConnection(listenSocket);
+		if (-1 == _socket)
+		{
+			// 共享监听套接字时其他线程可能已经取走
+			if (descriptorsExhausted())
+			{
+				rejectConnections(listenSocket, counters);
+			}
+			return;
+		}
+		onAccept(_socket);
+	}
+}
@@ -0,0 +1,373 @@
+﻿#include "ModbusCppReactor.h"
+#include "ModbusCppSocket.h"
+#if defined(__linux__)
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#elif !defined(_WIN32)
+#include <poll.h>
+#endif
+
+#if !defined(__linux__)
+#if defined(_WIN32)
+typedef WSAPOLLFD PollFd;
+#define pollSockets WSAPoll
+#else
+typedef struct pollfd PollFd;
+#define pollSockets poll
+#endif
+#endif
+
+// 一次 epoll_wait 最多取回的事件数，取满后自动扩大
+static const size_t EVENTS_INITIAL = 256;
+
+// 关注的事件转换为 epoll / poll 的事件
+static uint32_t toPollEvents(const uint32_t events)
+{
+	uint32_t _events = 0;
+#if defined(__linux__)
+	if (events & ModbusCppReactor::READABLE) _events |= EPOLLIN;
+	if (events & ModbusCppReactor::WRITABLE) _events |= EPOLLOUT;
+#else
+	if (events & ModbusCppReactor::READABLE) _events |= POLLIN;
+	if (events & ModbusCppReactor::WRITABLE) _events |= POLLOUT;
+#endif
+	return _events;
+}
+
+// 就绪的 epoll / poll 事件转换为回调参数，出错和挂断都按可读通知
+static uint32_t fromPollEvents(const uint32_t events)
+{
+	uint32_t _events = 0;
+#if defined(__linux__)
+	if (events & (EPOLLIN | EPOLLERR | EPOLLHUP)) _events |= ModbusCppReactor::READABLE;
+	if (events & EPOLLOUT) _events |= ModbusCppReactor::WRITABLE;
+#else
+	if (events & (POLLIN | POLLERR | POLLHUP)) _events |= ModbusCppReactor::READABLE;
+	if (events & POLLOUT) _events |= ModbusCppReactor::WRITABLE;
+#endif
+	return _events;
+}
+
+struct ModbusCppReactor::Backend
+{
+#if defined(__linux__)
+	int                         epoll = -1;
+	int                         wakeup = -1;        // eventfd
+	std::vector<epoll_event>    events;
+#else
+	int                         wakeup = -1;        // 连接到自身的 UDP 套接字，发给自己一个字节即可唤醒 poll
+	std::vector<PollFd>         pollFds;
+	std::vector<Entry *>        pollEntries;        // 与 pollFds 一一对应，第 0 项是唤醒套接字
+	bool                        dirty = true;       // 注册信息变化后需要重建 pollFds
+#endif
+};
+
+ModbusCppReactor::ModbusCppReactor()
+	: m_backend(NULL)
+	, m_wakeupPending(false)
+{
+}
+
+ModbusCppReactor::~ModbusCppReactor()
+{
+	close();
+}
+
+bool ModbusCppReactor::open()
+{
+	if (NULL != m_backend)
+	{
+		return true;
+	}
+
+	Backend *_backend = new Backend();
+#if defined(__linux__)
+	_backend->epoll = epoll_create1(EPOLL_CLOEXEC);
+	_backend->wakeup = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (-1 == _backend->epoll || -1 == _backend->wakeup)
+	{
+		if (-1 != _backend->epoll) ::close(_backend->epoll);
+		if (-1 != _backend->wakeup) ::close(_backend->wakeup);
+		delete _backend;
+		return false;
+	}
+
+	// 唤醒句柄的 data.ptr 为空，以此和普通套接字区分
+	epoll_event _event = {};
+	_event.events = EPOLLIN;
+	_event.data.ptr = NULL;
+	epoll_ctl(_backend->epoll, EPOLL_CTL_ADD, _backend->wakeup, &_event);
+	_backend->events.resize(EVENTS_INITIAL);
+#else
+	// 绑定到回环地址的随机端口，再连接到自己
+	const int _socket = static_cast<int>(::socket(AF_INET, SOCK_DGRAM, 0));
+	sockaddr_in _address = {};
+	_address.sin_family = AF_INET;
+	_address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	_address.sin_port = 0;
+	socklen_t _addressLength = sizeof(_address);
+	if (-1 == _socket
+		|| 0 != bind(_socket, reinterpret_cast<sockaddr *>(&_address), sizeof(_address))
+		|| 0 != getsockname(_socket, reinterpret_cast<sockaddr *>(&_address), &_addressLength)
+		|| 0 != connect(_socket, reinterpret_cast<sockaddr *>(&_address), sizeof(_address))
+		|| !socketSetNonBlocking(_socket))
+	{
+		if (-1 != _socket) socketClose(_socket);
+		delete _backend;
+		return false;
+	}
+	_backend->wakeup = _socket;
+#endif
+
+	m_backend = _backend;
+	return true;
+}
+
+void ModbusCppReactor::close()
+{
+	if (NULL == m_backend)
+	{
+		return;
+	}
+
+#if defined(__linux__)
+	::close(m_backend->epoll);
+	::close(m_backend->wakeup);
+#else
+	socketClose(m_backend->wakeup);
+#endif
+	delete m_backend;
+	m_backend = NULL;
+
+	// 套接字本身由注册者负责关闭
+	for (auto& _entry : m_entries)
+	{
+		delete _entry.second;
+	}
+	m_entries.clear();
+	releaseRemoved();
+}
+
+bool ModbusCppReactor::addSocket(const int socket, const uint32_t events, const Handler handler)
+{
+	if (NULL == m_backend || m_entries.count(socket) > 0)
+	{
+		return false;
+	}
+
+	Entry *_entry = new Entry{ socket, events, handler, false };
+#if defined(__linux__)
+	epoll_event _event = {};
+	_event.events = toPollEvents(events);
+	_event.data.ptr = _entry;
+	if (0 != epoll_ctl(m_backend->epoll, EPOLL_CTL_ADD, socket, &_event))
+	{
+		delete _entry;
+		return false;
+	}
+#else
+	m_backend->dirty = true;
+#endif
+
+	m_entries.emplace(socket, _entry);
+	return true;
+}
+
+bool ModbusCppReactor::modifySocket(const int socket, const uint32_t events)
+{
+	auto _iterator = m_entries.find(socket);
+	if (NULL == m_backend || m_entries.end() == _iterator)
+	{
+		return false;
+	}
+
+	Entry *_entry = _iterator->second;
+	if (_entry->events == events)
+	{
+		return true;
+	}
+	_entry->events = events;
+#if defined(__linux__)
+	epoll_event _event = {};
+	_event.events = toPollEvents(events);
+	_event.data.ptr = _entry;
+	return 0 == epoll_ctl(m_backend->epoll, EPOLL_CTL_MOD, socket, &_event);
+#else
+	m_backend->dirty = true;
+	return true;
+#endif
+}
+
+// 必须在关闭套接字之前调用
+void ModbusCppReactor::removeSocket(const int socket)
+{
+	auto _iterator = m_entries.find(socket);
+	if (NULL == m_backend || m_entries.end() == _iterator)
+	{
+		return;
+	}
+
+	Entry *_entry = _iterator->second;
+	m_entries.erase(_iterator);
+#if defined(__linux__)
+	epoll_ctl(m_backend->epoll, EPOLL_CTL_DEL, socket, NULL);
+#else
+	m_backend->dirty = true;
+#endif
+
+	// 本轮可能还有该套接字的事件没有分发，先标记，分发结束后再释放
+	_entry->removed = true;
+	m_removed.push_back(_entry);
+}
+
+int ModbusCppReactor::runOnce(const int timeoutMs)
+{
+	if (NULL == m_backend)
+	{
+		return -1;
+	}
+
+	int _dispatched = 0;
+#if defined(__linux__)
+	std::vector<epoll_event>& _events = m_backend->events;
+	const int _count = epoll_wait(m_backend->epoll, _events.data(), static_cast<int>(_events.size()), timeoutMs);
+	if (_count < 0)
+	{
+		return EINTR == errno ? 0 : -1;
+	}
+
+	for (int i = 0; i < _count; ++i)
+	{
+		Entry *_entry = static_cast<Entry *>(_events[i].data.ptr);
+		if (NULL == _entry)
+		{
+			drainWakeup();
+			continue;
+		}
+		if (_entry->removed)
+		{
+			continue;
+		}
+
+		const uint32_t _ready = _events[i].events;
+		_entry->handler(fromPollEvents(_ready));
+		++_dispatched;
+	}
+
+	// 取满说明可能还有就绪事件没取到，扩大下一轮的容量
+	if (static_cast<size_t>(_count) == _events.size())
+	{
+		_events.resize(_events.size() * 2);
+	}
+#else
+	if (m_backend->dirty)
+	{
+		m_backend->pollFds.resize(m_entries.size() + 1);
+		m_backend->pollEntries.resize(m_entries.size() + 1);
+		m_backend->pollFds[0].fd = m_backend->wakeup;
+		m_backend->pollFds[0].events = POLLIN;
+		m_backend->pollEntries[0] = NULL;
+
+		size_t _index = 1;
+		for (const auto& _item : m_entries)
+		{
+			Entry *_entry = _item.second;
+			m_backend->pollFds[_index].fd = _entry->socket;
+			m_backend->pollFds[_index].events = static_cast<short>(toPollEvents(_entry->events));
+			m_backend->pollEntries[_index] = _entry;
+			++_index;
+		}
+		m_backend->dirty = false;
+	}
+
+	std::vector<PollFd>& _pollFds = m_backend->pollFds;
+	for (auto& _pollFd : _pollFds)
+	{
+		_pollFd.revents = 0;
+	}
+	const int _count = pollSockets(_pollFds.data(), static_cast<unsigned long>(_pollFds.size()), timeoutMs);
+	if (_count < 0)
+	{
+		return socketWouldBlock() ? 0 : -1;
+	}
+
+	// 回调里注册/注销会让 pollEntries 在下一轮重建，本轮仍按旧数组分发
+	const std::vector<Entry *> _entries = m_backend->pollEntries;
+	for (size_t i = 0; i < _pollFds.size(); ++i)
+	{
+		const short _ready = _pollFds[i].revents;
+		if (0 == _ready)
+		{
+			continue;
+		}
+
+		Entry *_entry = _entries[i];
+		if (NULL == _entry)
+		{
+			drainWakeup();
+			continue;
+		}
+		if (_entry->removed)
+		{
+			continue;
+		}
+
+		_entry->handler(fromPollEvents(static_cast<uint16_t>(_ready)));
+		++_dispatched;
+	}
+#endif
+
+	releaseRemoved();
+	return _dispatched;
+}
+
+void ModbusCppReactor::wakeup()
+{
+	// 上一次唤醒还没被处理时不用重复写
+	if (NULL == m_backend || m_wakeupPending.exchange(true))
+	{
+		return;
+	}
+
+#if defined(__linux__)
+	const uint64_t _value = 1;
+	const ssize_t _written = write(m_backend->wakeup, &_value, sizeof(_value));
+	(void)_written;
+#else
+	const uint8_t _value = 1;
+	socketSend(m_backend->wakeup, &_value, sizeof(_value));
+#endif
+}
+
+const char *ModbusCppReactor::backendName() const
+{
+#if defined(__linux__)
+	return "epoll";
+#else
+	return "poll";
+#endif
+}
+
+void ModbusCppReactor::drainWakeup()
+{
+	m_wakeupPending = false;
+#if defined(__linux__)
+	uint64_t _value = 0;
+	const ssize_t _read = read(m_backend->wakeup, &_value, sizeof(_value));
+	(void)_read;
+#else
+	uint8_t _buffer[64];
+	while (socketReceive(m_backend->wakeup, _buffer, sizeof(_buffer)) > 0)
+	{
+	}
+#endif
+}
+
+void ModbusCppReactor::releaseRemoved()
+{
+	for (Entry *_entry : m_removed)
+	{
+		delete _entry;
+	}
+	m_removed.clear();
+}
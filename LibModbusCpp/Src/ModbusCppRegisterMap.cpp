@@ -0,0 +1,601 @@
+﻿#include "ModbusCppRegisterMap.h"
+#include <iostream>
+#include <thread>
+#include <algorithm>
+#include <new>
+#include <cerrno>
+#include <cstring>
+#if defined(_WIN32)
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// 一页存储，按缓存行对齐，不同页的写入互不干扰
+struct alignas(64) ModbusCppRegisterMap::Page
+{
+	std::atomic<uint32_t>   sequence{ 0 };      // 偶数: 空闲；奇数: 正在写入
+	union
+	{
+		uint16_t            registers[PAGE_SIZE];       // 主机字节序存储
+		uint8_t             wire[PAGE_SIZE * 2];        // 网络字节序存储，每个寄存器高字节在前
+		uint8_t             bits[PAGE_SIZE];            // 每个地址一个字节，0 或 1
+	};
+};
+
+// 共享内存段头，布局见头文件
+struct ModbusCppRegisterMap::SharedHeader
+{
+	uint32_t                magic;
+	uint32_t                version;
+	uint32_t                headerSize;
+	uint32_t                pageBytes;      // sizeof(Page)
+	uint32_t                pageSize;       // 每页地址数
+	uint32_t                pageCount;      // 每个表的页数
+	uint32_t                tableCount;
+	uint32_t                byteOrder;      // 0: 主机字节序；1: 网络字节序
+	std::atomic<uint32_t>   ready;          // 创建者初始化完成后置 1
+};
+
+static const uint32_t SHARED_MAGIC = 0x4D42524D;
+static const uint32_t SHARED_VERSION = 1;
+static const size_t SHARED_HEADER_SIZE = 64;
+static const size_t TABLE_COUNT = 4;
+
+// 写入前锁定一页: 把序号从偶数改为奇数，返回原序号
+static uint32_t lockPage(std::atomic<uint32_t>& sequence)
+{
+	uint32_t _sequence = sequence.load(std::memory_order_relaxed);
+	for (int _spins = 0; ; ++_spins)
+	{
+		if (0 == (_sequence & 1) && sequence.compare_exchange_weak(_sequence, _sequence + 1, std::memory_order_acquire, std::memory_order_relaxed))
+		{
+			// 保证读者先看到奇数序号，再看到写入的数据
+			std::atomic_thread_fence(std::memory_order_release);
+			return _sequence;
+		}
+		if (_spins > 64)
+		{
+			std::this_thread::yield();
+		}
+		_sequence = sequence.load(std::memory_order_relaxed);
+	}
+}
+
+static void unlockPage(std::atomic<uint32_t>& sequence, const uint32_t locked)
+{
+	sequence.store(locked + 2, std::memory_order_release);
+}
+
+ModbusCppRegisterMap::ModbusCppRegisterMap(const ByteOrder byteOrder)
+	: m_byteOrder(byteOrder)
+	, m_localValid(new uint64_t[TABLE_COUNT * PAGE_COUNT]())
+	, m_shared(NULL)
+	, m_sharedSize(0)
+	, m_sharedHandle(NULL)
+{
+	for (size_t t = 0; t < TABLE_COUNT; ++t)
+	{
+		for (auto& _page : m_tables[t].pages)
+		{
+			_page.store(NULL, std::memory_order_relaxed);
+		}
+		m_tables[t].valid = m_localValid + t * PAGE_COUNT;
+	}
+}
+
+ModbusCppRegisterMap::~ModbusCppRegisterMap()
+{
+	// 共享内存中的页只解除映射，不释放
+	if (NULL != m_shared)
+	{
+		releaseShared();
+	}
+	for (auto& _table : m_tables)
+	{
+		for (auto& _page : _table.pages)
+		{
+			delete _page.load(std::memory_order_relaxed);
+		}
+	}
+	delete[] m_localValid;
+}
+
+bool ModbusCppRegisterMap::attachShared(const std::string& name, const bool create)
+{
+	static_assert(sizeof(SharedHeader) <= SHARED_HEADER_SIZE, "SharedHeader too large");
+	static_assert(SHARED_HEADER_SIZE % alignof(Page) == 0 && (TABLE_COUNT * PAGE_COUNT * sizeof(uint64_t)) % alignof(Page) == 0, "pages must stay aligned");
+
+	// 只能在定义地址范围和写入之前切换到共享内存
+	if (NULL != m_shared || name.empty() || 0 != allocatedBytes()
+		|| std::any_of(m_localValid, m_localValid + TABLE_COUNT * PAGE_COUNT, [](const uint64_t mask) { return 0 != mask; }))
+	{
+		return false;
+	}
+
+	const size_t _validBytes = TABLE_COUNT * PAGE_COUNT * sizeof(uint64_t);
+	const size_t _size = SHARED_HEADER_SIZE + _validBytes + TABLE_COUNT * PAGE_COUNT * sizeof(Page);
+#if defined(_WIN32)
+	HANDLE _handle = create
+		? CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, static_cast<DWORD>(_size), name.c_str())
+		: OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, name.c_str());
+	if (NULL != _handle && create && ERROR_ALREADY_EXISTS == GetLastError())
+	{
+		CloseHandle(_handle);
+		_handle = NULL;
+	}
+	void *_base = NULL != _handle ? MapViewOfFile(_handle, FILE_MAP_ALL_ACCESS, 0, 0, _size) : NULL;
+	if (NULL == _base)
+	{
+		std::cout << "open shared memory failed: " << name << ", error " << GetLastError() << std::endl;
+		if (NULL != _handle)
+		{
+			CloseHandle(_handle);
+		}
+		return false;
+	}
+	m_sharedHandle = _handle;
+#else
+	const std::string _name = '/' == name[0] ? name : "/" + name;
+	const int _fd = shm_open(_name.c_str(), create ? (O_RDWR | O_CREAT | O_EXCL) : O_RDWR, 0600);
+	struct stat _stat;
+	void *_base = MAP_FAILED;
+	if (-1 != _fd
+		&& (!create || 0 == ftruncate(_fd, static_cast<off_t>(_size)))
+		&& 0 == fstat(_fd, &_stat) && static_cast<size_t>(_stat.st_size) >= _size)
+	{
+		_base = mmap(NULL, _size, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+	}
+	if (MAP_FAILED == _base)
+	{
+		std::cout << "open shared memory failed: " << _name << ", " << strerror(errno) << std::endl;
+		if (-1 != _fd)
+		{
+			close(_fd);
+			if (create)
+			{
+				shm_unlink(_name.c_str());
+			}
+		}
+		return false;
+	}
+	close(_fd);
+#endif
+	m_shared = _base;
+	m_sharedSize = _size;
+
+	uint8_t *_bytes = static_cast<uint8_t *>(_base);
+	SharedHeader *_header = reinterpret_cast<SharedHeader *>(_bytes);
+	uint64_t *_valid = reinterpret_cast<uint64_t *>(_bytes + SHARED_HEADER_SIZE);
+	Page *_pages = reinterpret_cast<Page *>(_bytes + SHARED_HEADER_SIZE + _validBytes);
+	const uint32_t _byteOrder = ByteOrder::WIRE == m_byteOrder ? 1 : 0;
+	if (create)
+	{
+		// 新建的段内容全为 0，直接在上面构造页和头，最后置初始化完成标志
+		for (size_t i = 0; i < TABLE_COUNT * PAGE_COUNT; ++i)
+		{
+			new (&_pages[i]) Page();
+		}
+		new (_header) SharedHeader{ SHARED_MAGIC, SHARED_VERSION, SHARED_HEADER_SIZE, sizeof(Page), PAGE_SIZE, PAGE_COUNT, TABLE_COUNT, _byteOrder, { 0 } };
+		_header->ready.store(1, std::memory_order_release);
+	}
+	else if (1 != _header->ready.load(std::memory_order_acquire)
+		|| SHARED_MAGIC != _header->magic || SHARED_VERSION != _header->version
+		|| SHARED_HEADER_SIZE != _header->headerSize || sizeof(Page) != _header->pageBytes
+		|| PAGE_SIZE != _header->pageSize || PAGE_COUNT != _header->pageCount
+		|| TABLE_COUNT != _header->tableCount || _byteOrder != _header->byteOrder)
+	{
+		std::cout << "shared memory layout mismatch: " << name << std::endl;
+		releaseShared();
+		return false;
+	}
+
+	// 所有页都在段内，页表直接指向它们，不会再分配
+	for (size_t t = 0; t < TABLE_COUNT; ++t)
+	{
+		m_tables[t].valid = _valid + t * PAGE_COUNT;
+		for (uint32_t p = 0; p < PAGE_COUNT; ++p)
+		{
+			m_tables[t].pages[p].store(&_pages[t * PAGE_COUNT + p], std::memory_order_release);
+		}
+	}
+	return true;
+}
+
+void ModbusCppRegisterMap::releaseShared()
+{
+	for (size_t t = 0; t < TABLE_COUNT; ++t)
+	{
+		for (auto& _page : m_tables[t].pages)
+		{
+			_page.store(NULL, std::memory_order_relaxed);
+		}
+		m_tables[t].valid = m_localValid + t * PAGE_COUNT;
+	}
+
+#if defined(_WIN32)
+	UnmapViewOfFile(m_shared);
+	CloseHandle(static_cast<HANDLE>(m_sharedHandle));
+#else
+	munmap(m_shared, m_sharedSize);
+#endif
+	m_shared = NULL;
+	m_sharedSize = 0;
+	m_sharedHandle = NULL;
+}
+
+bool ModbusCppRegisterMap::isShared() const
+{
+	return NULL != m_shared;
+}
+
+bool ModbusCppRegisterMap::removeShared(const std::string& name)
+{
+#if defined(_WIN32)
+	return !name.empty();
+#else
+	const std::string _name = '/' == name[0] ? name : "/" + name;
+	return !name.empty() && 0 == shm_unlink(_name.c_str());
+#endif
+}
+
+const ModbusCppRegisterMap::Page *ModbusCppRegisterMap::zeroPage()
+{
+	static const Page _zero = {};
+	return &_zero;
+}
+
+const ModbusCppRegisterMap::Page *ModbusCppRegisterMap::loadPage(const TableData& table, const uint32_t index)
+{
+	const Page *_page = table.pages[index].load(std::memory_order_acquire);
+	return NULL != _page ? _page : zeroPage();
+}
+
+// 第一次写入时分配页，多个写者同时分配时只保留一个
+ModbusCppRegisterMap::Page *ModbusCppRegisterMap::allocatePage(TableData& table, const uint32_t index)
+{
+	Page *_page = table.pages[index].load(std::memory_order_acquire);
+	if (NULL != _page)
+	{
+		return _page;
+	}
+
+	Page *_created = new Page();
+	memset(_created->registers, 0, sizeof(_created->registers));
+	if (table.pages[index].compare_exchange_strong(_page, _created, std::memory_order_acq_rel))
+	{
+		return _created;
+	}
+	delete _created;
+	return _page;
+}
+
+bool ModbusCppRegisterMap::addRange(const Table table, const uint16_t startAddress, const uint32_t count)
+{
+	const uint32_t _end = startAddress + count;
+	if (0 == count || _end > 0x10000)
+	{
+		return false;
+	}
+
+	// 只标记合法地址，存储在第一次写入时分配
+	TableData& _table = m_tables[static_cast<int>(table)];
+	for (uint32_t _address = startAddress; _address < _end; ++_address)
+	{
+		_table.valid[_address >> PAGE_BITS] |= uint64_t(1) << (_address & (PAGE_SIZE - 1));
+	}
+	return true;
+}
+
+// 按页检查位图，开销只和跨越的页数有关，与定义了多少个地址范围无关
+bool ModbusCppRegisterMap::contains(const Table table, const uint16_t startAddress, const uint32_t count) const
+{
+	const uint32_t _end = startAddress + count;
+	if (0 == count || _end > 0x10000)
+	{
+		return false;
+	}
+
+	const TableData& _table = m_tables[static_cast<int>(table)];
+	for (uint32_t _address = startAddress; _address < _end; )
+	{
+		const uint32_t _offset = _address & (PAGE_SIZE - 1);
+		const uint32_t _count = std::min(PAGE_SIZE - _offset, _end - _address);
+		const uint64_t _mask = (_count == PAGE_SIZE ? ~uint64_t(0) : (uint64_t(1) << _count) - 1) << _offset;
+		if ((_table.valid[_address >> PAGE_BITS] & _mask) != _mask)
+		{
+			return false;
+		}
+		_address += _count;
+	}
+	return true;
+}
+
+size_t ModbusCppRegisterMap::allocatedBytes() const
+{
+	if (NULL != m_shared)
+	{
+		return m_sharedSize;
+	}
+
+	size_t _count = 0;
+	for (const auto& _table : m_tables)
+	{
+		for (const auto& _page : _table.pages)
+		{
+			if (NULL != _page.load(std::memory_order_relaxed))
+			{
+				++_count;
+			}
+		}
+	}
+	return _count * sizeof(Page);
+}
+
+ModbusCppRegisterMap::ByteOrder ModbusCppRegisterMap::byteOrder() const
+{
+	return m_byteOrder;
+}
+
+// 乐观读: 记下涉及各页的序号，拷贝数据，再确认序号没有变化；有写入冲突时重试
+// copy(page, 页内偏移, 数量, 已拷贝数量)
+template <typename Copy>
+bool ModbusCppRegisterMap::readPages(const Table table, const uint16_t startAddress, const uint32_t count, Copy copy) const
+{
+	if (0 == count || !contains(table, startAddress, count))
+	{
+		return false;
+	}
+
+	const TableData& _table = m_tables[static_cast<int>(table)];
+	const uint32_t _firstPage = startAddress >> PAGE_BITS;
+	const uint32_t _lastPage = (startAddress + count - 1) >> PAGE_BITS;
+	const Page *_pages[PAGE_COUNT];
+	uint32_t _sequences[PAGE_COUNT];
+	for (int _spins = 0; ; ++_spins)
+	{
+		bool _writing = false;
+		for (uint32_t p = _firstPage; p <= _lastPage && !_writing; ++p)
+		{
+			_pages[p - _firstPage] = loadPage(_table, p);
+			_sequences[p - _firstPage] = _pages[p - _firstPage]->sequence.load(std::memory_order_acquire);
+			_writing = 0 != (_sequences[p - _firstPage] & 1);
+		}
+
+		if (!_writing)
+		{
+			uint32_t _done = 0;
+			for (uint32_t p = _firstPage; p <= _lastPage; ++p)
+			{
+				const uint32_t _offset = (startAddress + _done) & (PAGE_SIZE - 1);
+				const uint32_t _count = std::min(PAGE_SIZE - _offset, count - _done);
+				copy(_pages[p - _firstPage], _offset, _count, _done);
+				_done += _count;
+			}
+
+			// 期间分配了新页(从全 0 页换成真实页)同样视为有写入
+			std::atomic_thread_fence(std::memory_order_acquire);
+			bool _changed = false;
+			for (uint32_t p = _firstPage; p <= _lastPage && !_changed; ++p)
+			{
+				_changed = loadPage(_table, p) != _pages[p - _firstPage]
+					|| _pages[p - _firstPage]->sequence.load(std::memory_order_relaxed) != _sequences[p - _firstPage];
+			}
+			if (!_changed)
+			{
+				return true;
+			}
+		}
+
+		if (_spins > 64)
+		{
+			std::this_thread::yield();
+		}
+	}
+}
+
+// 按页升序锁定涉及的所有页后修改，多个写者之间不会死锁
+// modify(page, 页内偏移, 数量, 已处理数量)
+template <typename Modify>
+bool ModbusCppRegisterMap::writePages(const Table table, const uint16_t startAddress, const uint32_t count, Modify modify)
+{
+	if (0 == count || !contains(table, startAddress, count))
+	{
+		return false;
+	}
+
+	TableData& _table = m_tables[static_cast<int>(table)];
+	const uint32_t _firstPage = startAddress >> PAGE_BITS;
+	const uint32_t _lastPage = (startAddress + count - 1) >> PAGE_BITS;
+	Page *_pages[PAGE_COUNT];
+	uint32_t _sequences[PAGE_COUNT];
+	for (uint32_t p = _firstPage; p <= _lastPage; ++p)
+	{
+		_pages[p - _firstPage] = allocatePage(_table, p);
+		_sequences[p - _firstPage] = lockPage(_pages[p - _firstPage]->sequence);
+	}
+
+	uint32_t _done = 0;
+	for (uint32_t p = _firstPage; p <= _lastPage; ++p)
+	{
+		const uint32_t _offset = (startAddress + _done) & (PAGE_SIZE - 1);
+		const uint32_t _count = std::min(PAGE_SIZE - _offset, count - _done);
+		modify(_pages[p - _firstPage], _offset, _count, _done);
+		_done += _count;
+	}
+
+	for (uint32_t p = _firstPage; p <= _lastPage; ++p)
+	{
+		unlockPage(_pages[p - _firstPage]->sequence, _sequences[p - _firstPage]);
+	}
+	return true;
+}
+
+std::optional<std::vector<uint16_t>> ModbusCppRegisterMap::readRegisters(const Table table, const uint16_t startAddress, const uint16_t count) const
+{
+	std::vector<uint16_t> _values(count);
+	const bool _wire = ByteOrder::WIRE == m_byteOrder;
+	const bool _ret = readPages(table, startAddress, count, [&_values, _wire](const Page *page, const uint32_t offset, const uint32_t n, const uint32_t done) {
+		if (!_wire)
+		{
+			memcpy(_values.data() + done, page->registers + offset, n * sizeof(uint16_t));
+			return;
+		}
+		for (uint32_t i = 0; i < n; ++i)
+		{
+			_values[done + i] = static_cast<uint16_t>((page->wire[(offset + i) * 2] << 8) | page->wire[(offset + i) * 2 + 1]);
+		}
+		});
+	if (!_ret)
+	{
+		return std::nullopt;
+	}
+	return _values;
+}
+
+bool ModbusCppRegisterMap::writeRegisters(const Table table, const uint16_t startAddress, const std::vector<uint16_t>& values)
+{
+	const bool _wire = ByteOrder::WIRE == m_byteOrder;
+	return writePages(table, startAddress, static_cast<uint32_t>(values.size()), [&values, _wire](Page *page, const uint32_t offset, const uint32_t n, const uint32_t done) {
+		if (!_wire)
+		{
+			memcpy(page->registers + offset, values.data() + done, n * sizeof(uint16_t));
+			return;
+		}
+		for (uint32_t i = 0; i < n; ++i)
+		{
+			page->wire[(offset + i) * 2] = static_cast<uint8_t>(values[done + i] >> 8);
+			page->wire[(offset + i) * 2 + 1] = static_cast<uint8_t>(values[done + i] & 0xFF);
+		}
+		});
+}
+
+std::optional<std::vector<uint8_t>> ModbusCppRegisterMap::readBits(const Table table, const uint16_t startAddress, const uint16_t count) const
+{
+	std::vector<uint8_t> _values(count);
+	const bool _ret = readPages(table, startAddress, count, [&_values](const Page *page, const uint32_t offset, const uint32_t n, const uint32_t done) {
+		memcpy(_values.data() + done, page->bits + offset, n);
+		});
+	if (!_ret)
+	{
+		return std::nullopt;
+	}
+	return _values;
+}
+
+bool ModbusCppRegisterMap::writeBits(const Table table, const uint16_t startAddress, const std::vector<uint8_t>& values)
+{
+	return writePages(table, startAddress, static_cast<uint32_t>(values.size()), [&values](Page *page, const uint32_t offset, const uint32_t n, const uint32_t done) {
+		for (uint32_t i = 0; i < n; ++i)
+		{
+			page->bits[offset + i] = values[done + i] ? 1 : 0;
+		}
+		});
+}
+
+bool ModbusCppRegisterMap::readRegistersEncoded(const Table table, const uint16_t startAddress, const uint16_t count, uint8_t *bytes) const
+{
+	// 网络字节序存储时整块拷贝
+	if (ByteOrder::WIRE == m_byteOrder)
+	{
+		return readPages(table, startAddress, count, [bytes](const Page *page, const uint32_t offset, const uint32_t n, const uint32_t done) {
+			memcpy(bytes + done * 2, page->wire + offset * 2, n * 2);
+			});
+	}
+	return readPages(table, startAddress, count, [bytes](const Page *page, const uint32_t offset, const uint32_t n, const uint32_t done) {
+		for (uint32_t i = 0; i < n; ++i)
+		{
+			const uint16_t _value = page->registers[offset + i];
+			bytes[(done + i) * 2] = static_cast<uint8_t>(_value >> 8);
+			bytes[(done + i) * 2 + 1] = static_cast<uint8_t>(_value & 0xFF);
+		}
+		});
+}
+
+bool ModbusCppRegisterMap::writeRegistersEncoded(const Table table, const uint16_t startAddress, const uint16_t count, const uint8_t *bytes)
+{
+	if (ByteOrder::WIRE == m_byteOrder)
+	{
+		return writePages(table, startAddress, count, [bytes](Page *page, const uint32_t offset, const uint32_t n, const uint32_t done) {
+			memcpy(page->wire + offset * 2, bytes + done * 2, n * 2);
+			});
+	}
+	return writePages(table, startAddress, count, [bytes](Page *page, const uint32_t offset, const uint32_t n, const uint32_t done) {
+		for (uint32_t i = 0; i < n; ++i)
+		{
+			page->registers[offset + i] = static_cast<uint16_t>((bytes[(done + i) * 2] << 8) | bytes[(done + i) * 2 + 1]);
+		}
+		});
+}
+
+bool ModbusCppRegisterMap::readBitsPacked(const Table table, const uint16_t startAddress, const uint16_t count, uint8_t *bytes) const
+{
+	memset(bytes, 0, (count + 7) / 8);
+	return readPages(table, startAddress, count, [bytes](const Page *page, const uint32_t offset, const uint32_t n, const uint32_t done) {
+		for (uint32_t i = 0; i < n; ++i)
+		{
+			// 重试时会重新拷贝，先清掉本位
+			const uint32_t _bit = done + i;
+			bytes[_bit / 8] = static_cast<uint8_t>((bytes[_bit / 8] & ~(1 << (_bit % 8))) | (page->bits[offset + i] << (_bit % 8)));
+		}
+		});
+}
+
+bool ModbusCppRegisterMap::writeBitsPacked(const Table table, const uint16_t startAddress, const uint16_t count, const uint8_t *bytes)
+{
+	return writePages(table, startAddress, count, [bytes](Page *page, const uint32_t offset, const uint32_t n, const uint32_t done) {
+		for (uint32_t i = 0; i < n; ++i)
+		{
+			const uint32_t _bit = done + i;
+			page->bits[offset + i] = (bytes[_bit / 8] >> (_bit % 8)) & 1;
+		}
+		});
+}
+
+bool ModbusCppRegisterMap::pageVersions(const Table table, const uint16_t startAddress, const uint32_t count, uint32_t *versions) const
+{
+	if (0 == count || !contains(table, startAddress, count))
+	{
+		return false;
+	}
+
+	const TableData& _table = m_tables[static_cast<int>(table)];
+	const uint32_t _firstPage = startAddress >> PAGE_BITS;
+	const uint32_t _lastPage = (startAddress + count - 1) >> PAGE_BITS;
+	for (uint32_t p = _firstPage; p <= _lastPage; ++p)
+	{
+		// 全 0 页和刚分配还没写入的页序号都是 0，内容也相同
+		versions[p - _firstPage] = loadPage(_table, p)->sequence.load(std::memory_order_acquire);
+		if (versions[p - _firstPage] & 1)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool ModbusCppRegisterMap::maskWriteRegister(const uint16_t address, const uint16_t andMask, const uint16_t orMask, uint16_t *result)
+{
+	const bool _wire = ByteOrder::WIRE == m_byteOrder;
+	return writePages(Table::HOLDING_REGISTERS, address, 1, [andMask, orMask, _wire, result](Page *page, const uint32_t offset, const uint32_t, const uint32_t) {
+		uint16_t _register = _wire ? static_cast<uint16_t>((page->wire[offset * 2] << 8) | page->wire[offset * 2 + 1]) : page->registers[offset];
+		_register = static_cast<uint16_t>((_register & andMask) | (orMask & ~andMask));
+		if (NULL != result)
+		{
+			*result = _register;
+		}
+		if (_wire)
+		{
+			page->wire[offset * 2] = static_cast<uint8_t>(_register >> 8);
+			page->wire[offset * 2 + 1] = static_cast<uint8_t>(_register & 0xFF);
+		}
+		else
+		{
+			page->registers[offset] = _register;
+		}
+		});
+}
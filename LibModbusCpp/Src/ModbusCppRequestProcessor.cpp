@@ -0,0 +1,338 @@
+﻿#include "ModbusCppRequestProcessor.h"
+#include "ModbusCppRegisterMap.h"
+#include "ModbusCppWriteEventRing.h"
+#include "modbus.h"
+#include <chrono>
+#include <cstring>
+
+// libmodbus 在 FC17 响应里使用的从站标识
+static const uint8_t REPORT_SLAVE_ID = 180;
+// Modbus TCP 的 MBAP 头长度
+static const int MODBUS_TCP_HEADER_LENGTH = 7;
+
+typedef ModbusCppRegisterMap::Table Table;
+
+// 读取大端 16 位整数
+static uint16_t readUint16(const uint8_t *data)
+{
+	return static_cast<uint16_t>((data[0] << 8) | data[1]);
+}
+
+ModbusCppRequestProcessor::ModbusCppRequestProcessor(ModbusCppRegisterMap *registerMap)
+	: m_registerMap(registerMap)
+	, m_writeEvents(NULL)
+	, m_unit(0)
+{
+}
+
+void ModbusCppRequestProcessor::setWriteEventRing(ModbusCppWriteEventRing *writeEvents)
+{
+	m_writeEvents = writeEvents;
+}
+
+int ModbusCppRequestProcessor::process(const uint8_t *request, const int requestLength, uint8_t *response, const uint8_t unit)
+{
+	if (requestLength < 1)
+	{
+		return 0;
+	}
+	m_unit = unit;
+
+	switch (request[0])
+	{
+	case MODBUS_FC_READ_COILS:
+	case MODBUS_FC_READ_DISCRETE_INPUTS:
+		return readBits(request, requestLength, response);
+	case MODBUS_FC_READ_HOLDING_REGISTERS:
+	case MODBUS_FC_READ_INPUT_REGISTERS:
+		return readRegisters(request, requestLength, response);
+	case MODBUS_FC_WRITE_SINGLE_COIL:
+		return writeBit(request, requestLength, response);
+	case MODBUS_FC_WRITE_SINGLE_REGISTER:
+		return writeRegister(request, requestLength, response);
+	case MODBUS_FC_WRITE_MULTIPLE_COILS:
+		return writeBits(request, requestLength, response);
+	case MODBUS_FC_WRITE_MULTIPLE_REGISTERS:
+		return writeRegisters(request, requestLength, response);
+	case MODBUS_FC_REPORT_SLAVE_ID:
+		return reportSlaveId(request, requestLength, response);
+	case MODBUS_FC_MASK_WRITE_REGISTER:
+		return maskWriteRegister(request, requestLength, response);
+	case MODBUS_FC_WRITE_AND_READ_REGISTERS:
+		return writeAndReadRegisters(request, requestLength, response);
+	default:
+		return exception(request[0], MODBUS_EXCEPTION_ILLEGAL_FUNCTION, response);
+	}
+}
+
+int ModbusCppRequestProcessor::reply(modbus_t *ctx, const uint8_t *request, const int requestLength)
+{
+	// TCP: 7 字节 MBAP 头，没有校验；RTU: 1 字节从站地址 + 2 字节 CRC
+	const int _headerLength = modbus_get_header_length(ctx);
+	const bool _tcp = MODBUS_TCP_HEADER_LENGTH == _headerLength;
+	const int _pduLength = requestLength - _headerLength - (_tcp ? 0 : 2);
+	if (_headerLength < 1 || _pduLength < 1)
+	{
+		return -1;
+	}
+
+	// 第一个字节为从站地址，后面是响应 PDU；由 libmodbus 加上 MBAP 头或 CRC
+	uint8_t _response[1 + PDU_MAX_LENGTH];
+	const uint8_t _slave = request[_headerLength - 1];
+	_response[0] = _slave;
+	const int _responseLength = process(request + _headerLength, _pduLength, _response + 1, _slave);
+	if (!_tcp && MODBUS_BROADCAST_ADDRESS == _slave)
+	{
+		return 0;
+	}
+
+	const int _transactionId = _tcp ? readUint16(request) : 0;
+	return modbus_send_raw_request_tid(ctx, _response, 1 + _responseLength, _transactionId);
+}
+
+int ModbusCppRequestProcessor::readBits(const uint8_t *request, const int requestLength, uint8_t *response)
+{
+	const Table _table = MODBUS_FC_READ_DISCRETE_INPUTS == request[0] ? Table::DISCRETE_INPUTS : Table::COILS;
+	if (requestLength != 5)
+	{
+		return exception(request[0], MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE, response);
+	}
+
+	const uint16_t _address = readUint16(request + 1);
+	const uint16_t _count = readUint16(request + 3);
+	if (_count < 1 || MODBUS_MAX_READ_BITS < _count)
+	{
+		return exception(request[0], MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE, response);
+	}
+
+	// 每个字节按低位在前打包 8 个位
+	if (!m_registerMap->readBitsPacked(_table, _address, _count, response + 2))
+	{
+		return exception(request[0], MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS, response);
+	}
+	const int _bytes = (_count + 7) / 8;
+	response[0] = request[0];
+	response[1] = static_cast<uint8_t>(_bytes);
+	return 2 + _bytes;
+}
+
+int ModbusCppRequestProcessor::readRegisters(const uint8_t *request, const int requestLength, uint8_t *response)
+{
+	const Table _table = MODBUS_FC_READ_INPUT_REGISTERS == request[0] ? Table::INPUT_REGISTERS : Table::HOLDING_REGISTERS;
+	if (requestLength != 5)
+	{
+		return exception(request[0], MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE, response);
+	}
+
+	const uint16_t _address = readUint16(request + 1);
+	const uint16_t _count = readUint16(request + 3);
+	if (_count < 1 || MODBUS_MAX_READ_REGISTERS < _count)
+	{
+		return exception(request[0], MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE, response);
+	}
+
+	if (!m_registerMap->readRegistersEncoded(_table, _address, _count, response + 2))
+	{
+		return exception(request[0], MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS, response);
+	}
+	response[0] = request[0];
+	response[1] = static_cast<uint8_t>(_count * 2);
+	return 2 + _count * 2;
+}
+
+int ModbusCppRequestProcessor::writeBit(const uint8_t *request, const int requestLength, uint8_t *response)
+{
+	if (requestLength != 5)
+	{
+		return exception(request[0], MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE, response);
+	}
+
+	const uint16_t _address = readUint16(request + 1);
+	if (!m_registerMap->contains(Table::COILS, _address, 1))
+	{
+		return exception(request[0], MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS, response);
+	}
+
+	// 只接受 0xFF00(ON) 和 0x0000(OFF)
+	const uint16_t _value = readUint16(request + 3);
+	if (0xFF00 != _value && 0 != _value)
+	{
+		return exception(request[0], MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE, response);
+	}
+
+	const uint8_t _bit = _value ? 1 : 0;
+	m_registerMap->writeBitsPacked(Table::COILS, _address, 1, &_bit);
+	publishWrite(request[0], _address, 1, &_bit, 1);
+	memcpy(response, request, requestLength);
+	return requestLength;
+}
+
+int ModbusCppRequestProcessor::writeRegister(const uint8_t *request, const int requestLength, uint8_t *response)
+{
+	if (requestLength != 5)
+	{
+		return exception(request[0], MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE, response);
+	}
+
+	const uint16_t _address = readUint16(request + 1);
+	if (!m_registerMap->writeRegistersEncoded(Table::HOLDING_REGISTERS, _address, 1, request + 3))
+	{
+		return exception(request[0], MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS, response);
+	}
+	publishWrite(request[0], _address, 1, request + 3, 2);
+	memcpy(response, request, requestLength);
+	return requestLength;
+}
+
+int ModbusCppRequestProcessor::writeBits(const uint8_t *request, const int requestLength, uint8_t *response)
+{
+	if (requestLength < 6)
+	{
+		return exception(request[0], MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE, response);
+	}
+
+	const uint16_t _address = readUint16(request + 1);
+	const uint16_t _count = readUint16(request + 3);
+	const int _bytes = request[5];
+	if (_count < 1 || MODBUS_MAX_WRITE_BITS < _count || _bytes * 8 < _count || requestLength != 6 + _bytes)
+	{
+		return exception(request[0], MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE, response);
+	}
+	if (!m_registerMap->writeBitsPacked(Table::COILS, _address, _count, request + 6))
+	{
+		return exception(request[0], MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS, response);
+	}
+	publishWrite(request[0], _address, _count, request + 6, (_count + 7) / 8);
+
+	// 响应: 功能码 + 起始地址 + 数量
+	memcpy(response, request, 5);
+	return 5;
+}
+
+int ModbusCppRequestProcessor::writeRegisters(const uint8_t *request, const int requestLength, uint8_t *response)
+{
+	if (requestLength < 6)
+	{
+		return exception(request[0], MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE, response);
+	}
+
+	const uint16_t _address = readUint16(request + 1);
+	const uint16_t _count = readUint16(request + 3);
+	const int _bytes = request[5];
+	if (_count < 1 || MODBUS_MAX_WRITE_REGISTERS < _count || _bytes != _count * 2 || requestLength != 6 + _bytes)
+	{
+		return exception(request[0], MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE, response);
+	}
+	if (!m_registerMap->writeRegistersEncoded(Table::HOLDING_REGISTERS, _address, _count, request + 6))
+	{
+		return exception(request[0], MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS, response);
+	}
+	publishWrite(request[0], _address, _count, request + 6, _bytes);
+
+	memcpy(response, request, 5);
+	return 5;
+}
+
+int ModbusCppRequestProcessor::reportSlaveId(const uint8_t *request, const int requestLength, uint8_t *response)
+{
+	if (requestLength != 1)
+	{
+		return exception(request[0], MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE, response);
+	}
+
+	// 与 libmodbus 相同: 从站标识 + 运行状态 + "LMB" + 版本号
+	static const char IDENTIFIER[] = "LMB" LIBMODBUS_VERSION_STRING;
+	const int _identifierLength = static_cast<int>(sizeof(IDENTIFIER) - 1);
+
+	response[0] = request[0];
+	response[1] = static_cast<uint8_t>(2 + _identifierLength);
+	response[2] = REPORT_SLAVE_ID;
+	response[3] = 0xFF;
+	memcpy(response + 4, IDENTIFIER, _identifierLength);
+	return 4 + _identifierLength;
+}
+
+int ModbusCppRequestProcessor::maskWriteRegister(const uint8_t *request, const int requestLength, uint8_t *response)
+{
+	if (requestLength != 7)
+	{
+		return exception(request[0], MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE, response);
+	}
+
+	// 结果 = (当前值 AND and) OR (or AND NOT and)
+	const uint16_t _address = readUint16(request + 1);
+	uint16_t _result = 0;
+	if (!m_registerMap->maskWriteRegister(_address, readUint16(request + 3), readUint16(request + 5), &_result))
+	{
+		return exception(request[0], MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS, response);
+	}
+	const uint8_t _value[2] = { static_cast<uint8_t>(_result >> 8), static_cast<uint8_t>(_result & 0xFF) };
+	publishWrite(request[0], _address, 1, _value, 2);
+
+	memcpy(response, request, requestLength);
+	return requestLength;
+}
+
+int ModbusCppRequestProcessor::writeAndReadRegisters(const uint8_t *request, const int requestLength, uint8_t *response)
+{
+	if (requestLength < 10)
+	{
+		return exception(request[0], MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE, response);
+	}
+
+	const uint16_t _readAddress = readUint16(request + 1);
+	const uint16_t _readCount = readUint16(request + 3);
+	const uint16_t _writeAddress = readUint16(request + 5);
+	const uint16_t _writeCount = readUint16(request + 7);
+	const int _writeBytes = request[9];
+	if (_writeCount < 1 || MODBUS_MAX_WR_WRITE_REGISTERS < _writeCount
+		|| _readCount < 1 || MODBUS_MAX_WR_READ_REGISTERS < _readCount
+		|| _writeBytes != _writeCount * 2 || requestLength != 10 + _writeBytes)
+	{
+		return exception(request[0], MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE, response);
+	}
+	if (!m_registerMap->contains(Table::HOLDING_REGISTERS, _readAddress, _readCount))
+	{
+		return exception(request[0], MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS, response);
+	}
+
+	// 先写后读
+	if (!m_registerMap->writeRegistersEncoded(Table::HOLDING_REGISTERS, _writeAddress, _writeCount, request + 10))
+	{
+		return exception(request[0], MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS, response);
+	}
+	publishWrite(request[0], _writeAddress, _writeCount, request + 10, _writeBytes);
+	m_registerMap->readRegistersEncoded(Table::HOLDING_REGISTERS, _readAddress, _readCount, response + 2);
+	response[0] = request[0];
+	response[1] = static_cast<uint8_t>(_readCount * 2);
+	return 2 + _readCount * 2;
+}
+
+// 直接写进队列的空位，队列满时丢弃
+void ModbusCppRequestProcessor::publishWrite(const uint8_t function, const uint16_t address, const uint16_t count, const uint8_t *data, const int dataLength)
+{
+	if (NULL == m_writeEvents)
+	{
+		return;
+	}
+
+	ModbusCppWriteEvent *_event = m_writeEvents->reserve();
+	if (NULL == _event)
+	{
+		return;
+	}
+	_event->timestamp = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	_event->unit = m_unit;
+	_event->function = function;
+	_event->address = address;
+	_event->count = count;
+	memcpy(_event->data, data, dataLength);
+	m_writeEvents->commit();
+}
+
+int ModbusCppRequestProcessor::exception(const uint8_t function, const uint8_t code, uint8_t *response)
+{
+	response[0] = static_cast<uint8_t>(function | 0x80);
+	response[1] = code;
+	return 2;
+}
@@ -0,0 +1,126 @@
+﻿#include "ModbusCppResponseCache.h"
+#include "modbus.h"
+#include <cstring>
+
+// 读请求 ADU 的长度: MBAP 头 7 字节 + 功能码 + 起始地址 + 数量
+static const size_t READ_REQUEST_LENGTH = 12;
+
+ModbusCppResponseCache::ModbusCppResponseCache(const ModbusCppRegisterMap *registerMap, const size_t slots)
+	: m_registerMap(registerMap)
+	, m_entries(slots)
+	, m_pending(false)
+	, m_pendingKey(0)
+	, m_pendingTable(ModbusCppRegisterMap::Table::HOLDING_REGISTERS)
+	, m_pendingAddress(0)
+	, m_pendingCount(0)
+	, m_hits(0)
+	, m_misses(0)
+{
+}
+
+int ModbusCppResponseCache::lookup(const uint8_t *request, const size_t requestLength, uint8_t *response)
+{
+	m_pending = false;
+	if (READ_REQUEST_LENGTH != requestLength)
+	{
+		return 0;
+	}
+
+	ModbusCppRegisterMap::Table _table;
+	switch (request[7])
+	{
+	case MODBUS_FC_READ_COILS:
+		_table = ModbusCppRegisterMap::Table::COILS;
+		break;
+	case MODBUS_FC_READ_DISCRETE_INPUTS:
+		_table = ModbusCppRegisterMap::Table::DISCRETE_INPUTS;
+		break;
+	case MODBUS_FC_READ_HOLDING_REGISTERS:
+		_table = ModbusCppRegisterMap::Table::HOLDING_REGISTERS;
+		break;
+	case MODBUS_FC_READ_INPUT_REGISTERS:
+		_table = ModbusCppRegisterMap::Table::INPUT_REGISTERS;
+		break;
+	default:
+		return 0;
+	}
+
+	const uint16_t _address = static_cast<uint16_t>((request[8] << 8) | request[9]);
+	const uint16_t _count = static_cast<uint16_t>((request[10] << 8) | request[11]);
+	const uint32_t _countMax = request[7] <= MODBUS_FC_READ_DISCRETE_INPUTS ? MODBUS_MAX_READ_BITS : MODBUS_MAX_READ_REGISTERS;
+	if (0 == _count || _count > _countMax)
+	{
+		return 0;
+	}
+
+	// 当前页版本，有页正在写入时不查也不存
+	uint32_t _versions[VERSIONS_MAX];
+	if (!m_registerMap->pageVersions(_table, _address, _count, _versions))
+	{
+		return 0;
+	}
+
+	// 键: 单元标识 | 功能码 | 起始地址 | 数量
+	const uint64_t _key = (uint64_t(request[6]) << 40) | (uint64_t(request[7]) << 32) | (uint64_t(_address) << 16) | _count;
+	const uint32_t _pages = ((_address + _count - 1u) >> ModbusCppRegisterMap::PAGE_BITS) - (_address >> ModbusCppRegisterMap::PAGE_BITS) + 1;
+	Entry& _entry = m_entries[(_key * 0x9E3779B97F4A7C15ull >> 40) & (m_entries.size() - 1)];
+	if (_entry.valid && _entry.key == _key && 0 == memcmp(_entry.versions, _versions, _pages * sizeof(uint32_t)))
+	{
+		// 命中: 只改写事务标识
+		memcpy(response, _entry.response, _entry.responseLength);
+		response[0] = request[0];
+		response[1] = request[1];
+		m_hits.fetch_add(1, std::memory_order_relaxed);
+		return static_cast<int>(_entry.responseLength);
+	}
+
+	m_misses.fetch_add(1, std::memory_order_relaxed);
+	m_pending = true;
+	m_pendingKey = _key;
+	m_pendingTable = _table;
+	m_pendingAddress = _address;
+	m_pendingCount = _count;
+	memcpy(m_pendingVersions, _versions, _pages * sizeof(uint32_t));
+	return 0;
+}
+
+void ModbusCppResponseCache::store(const uint8_t *response, const size_t responseLength)
+{
+	if (!m_pending)
+	{
+		return;
+	}
+	m_pending = false;
+
+	// 异常响应不缓存
+	if (responseLength > ADU_MAX_LENGTH || (response[7] & 0x80))
+	{
+		return;
+	}
+
+	// 处理期间页版本没有变化，响应才对应记下的版本
+	uint32_t _versions[VERSIONS_MAX];
+	const uint32_t _pages = ((m_pendingAddress + m_pendingCount - 1u) >> ModbusCppRegisterMap::PAGE_BITS) - (m_pendingAddress >> ModbusCppRegisterMap::PAGE_BITS) + 1;
+	if (!m_registerMap->pageVersions(m_pendingTable, m_pendingAddress, m_pendingCount, _versions)
+		|| 0 != memcmp(_versions, m_pendingVersions, _pages * sizeof(uint32_t)))
+	{
+		return;
+	}
+
+	Entry& _entry = m_entries[(m_pendingKey * 0x9E3779B97F4A7C15ull >> 40) & (m_entries.size() - 1)];
+	_entry.key = m_pendingKey;
+	_entry.valid = true;
+	memcpy(_entry.versions, m_pendingVersions, _pages * sizeof(uint32_t));
+	_entry.responseLength = responseLength;
+	memcpy(_entry.response, response, responseLength);
+}
+
+uint64_t ModbusCppResponseCache::hits() const
+{
+	return m_hits.load(std::memory_order_relaxed);
+}
+
+uint64_t ModbusCppResponseCache::misses() const
+{
+	return m_misses.load(std::memory_order_relaxed);
+}
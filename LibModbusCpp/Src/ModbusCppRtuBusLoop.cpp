@@ -0,0 +1,717 @@
+﻿#include "ModbusCppRtuBusLoop.h"
+#include "ModbusCppSerialPort.h"
+#include "ModbusCppCrc16.h"
+#include "ModbusCppRtuFrame.h"
+#include "modbus.h"
+#include <iostream>
+#include <algorithm>
+#include <deque>
+#include <cstring>
+#include <cerrno>
+#if defined(__linux__)
+#include <sys/timerfd.h>
+#endif
+#if !defined(_WIN32)
+#include <unistd.h>
+#endif
+
+// 从站地址 + PDU + CRC
+static const size_t RTU_FRAME_MAX = MODBUS_RTU_MAX_ADU_LENGTH;
+static const uint32_t RESPONSE_TIMEOUT_MS_DEFAULT = 500;
+static const uint32_t BROADCAST_DELAY_MS_DEFAULT = 100;
+
+typedef std::chrono::steady_clock::time_point TimePoint;
+
+// 当前线程运行的事件循环，用于判断 submit() 是否在完成回调里调用
+static thread_local const ModbusCppRtuBusLoop *t_currentLoop = NULL;
+
+static uint64_t elapsedUsec(const TimePoint& start, const TimePoint& end)
+{
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(end - start).count());
+}
+
+struct ModbusCppRtuBusLoop::Request
+{
+	int                     bus = -1;
+	uint8_t                 frame[RTU_FRAME_MAX];
+	size_t                  length = 0;
+	size_t                  predicted = 0;      // 按请求推算的响应长度，0 表示未知
+	Completion              completion;
+};
+
+struct ModbusCppRtuBusLoop::Bus
+{
+	// 总线状态，只有事件循环线程访问
+	enum State
+	{
+		IDLE,               // 没有请求
+		GAP,                // 等帧间隔结束后发送
+		WAIT_RESPONSE,      // 已发送，等第一批响应数据，定时器为响应超时
+		TAIL,               // 帧的剩余字节还在线路上，不关注可读事件，定时器为剩余字节传完的时间
+		SILENT,             // 长度未知或剩余字节没有按时到达，定时器为静默间隔
+	};
+
+	explicit Bus(const ModbusCppSerialConfig& serialConfig)
+		: config(serialConfig)
+	{
+	}
+
+	ModbusCppSerialConfig       config;
+	ModbusCppSerialPort         port;
+	int                         timer = -1;         // timerfd，其他系统为 -1
+	State                       state = IDLE;
+	std::deque<Request *>       queue;
+	Request                     *current = NULL;
+	uint8_t                     buffer[RTU_FRAME_MAX];
+	size_t                      received = 0;
+	bool                        readable = true;    // 当前是否关注可读事件
+	bool                        timerArmed = false;
+	TimePoint                   deadline;
+	TimePoint                   idleSince;          // 上一帧结束的时间
+	TimePoint                   sentAt;
+
+	ModbusCppLatencyHistogram   latency;
+	std::atomic<uint64_t>       requests{ 0 };
+	std::atomic<uint64_t>       broadcasts{ 0 };
+	std::atomic<uint64_t>       responses{ 0 };
+	std::atomic<uint64_t>       exceptions{ 0 };
+	std::atomic<uint64_t>       timeouts{ 0 };
+	std::atomic<uint64_t>       frameErrors{ 0 };
+	std::atomic<uint64_t>       bytesSent{ 0 };
+	std::atomic<uint64_t>       bytesReceived{ 0 };
+	std::atomic<uint64_t>       readCalls{ 0 };
+	std::atomic<size_t>         queueDepth{ 0 };    // 已提交还没开始执行的请求数
+};
+
+ModbusCppRtuBusLoop::ModbusCppRtuBusLoop()
+	: m_responseTimeoutUsec(RESPONSE_TIMEOUT_MS_DEFAULT * 1000)
+	, m_silentIntervalUsec(0)
+	, m_broadcastDelayUsec(BROADCAST_DELAY_MS_DEFAULT * 1000)
+	, m_running(false)
+	, m_iterations(0)
+	, m_timerFires(0)
+{
+}
+
+ModbusCppRtuBusLoop::~ModbusCppRtuBusLoop()
+{
+	stop();
+	for (Bus *_bus : m_buses)
+	{
+		delete _bus;
+	}
+}
+
+int ModbusCppRtuBusLoop::addBus(const ModbusCppSerialConfig& config)
+{
+	if (m_running || config.device.empty() || config.baud <= 0)
+	{
+		return -1;
+	}
+	m_buses.push_back(new Bus(config));
+	return static_cast<int>(m_buses.size() - 1);
+}
+
+void ModbusCppRtuBusLoop::setResponseTimeout(const uint32_t msec)
+{
+	if (!m_running && msec > 0)
+	{
+		m_responseTimeoutUsec = msec * 1000;
+	}
+}
+
+void ModbusCppRtuBusLoop::setSilentInterval(const uint32_t usec)
+{
+	if (!m_running)
+	{
+		m_silentIntervalUsec = usec;
+	}
+}
+
+void ModbusCppRtuBusLoop::setBroadcastDelay(const uint32_t msec)
+{
+	if (!m_running)
+	{
+		m_broadcastDelayUsec = msec * 1000;
+	}
+}
+
+bool ModbusCppRtuBusLoop::start()
+{
+	if (m_running || m_buses.empty())
+	{
+		return false;
+	}
+#if defined(_WIN32)
+	// Windows 的串口句柄不能注册到 WSAPoll
+	std::cout << "ModbusCppRtuBusLoop is not supported on Windows" << std::endl;
+	return false;
+#else
+	if (!m_reactor.open())
+	{
+		return false;
+	}
+
+	const TimePoint _now = std::chrono::steady_clock::now();
+	for (Bus *_bus : m_buses)
+	{
+		if (!_bus->port.open(_bus->config))
+		{
+			std::cout << "open " << _bus->config.device << " failed: " << strerror(errno) << std::endl;
+			release();
+			return false;
+		}
+		if (!m_reactor.addSocket(_bus->port.handle(), ModbusCppReactor::READABLE, [this, _bus](const uint32_t) { onReadable(_bus); }))
+		{
+			release();
+			return false;
+		}
+#if defined(__linux__)
+		_bus->timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+		if (-1 == _bus->timer || !m_reactor.addSocket(_bus->timer, ModbusCppReactor::READABLE, [this, _bus](const uint32_t)
+			{
+				uint64_t _expirations = 0;
+				if (sizeof(_expirations) == ::read(_bus->timer, &_expirations, sizeof(_expirations)))
+				{
+					onTimer(_bus);
+				}
+			}))
+		{
+			std::cout << "timerfd_create failed: " << strerror(errno) << std::endl;
+			release();
+			return false;
+		}
+#endif
+		_bus->state = Bus::IDLE;
+		_bus->readable = true;
+		_bus->timerArmed = false;
+		_bus->idleSince = _now;
+	}
+
+	m_running = true;
+	m_thread = std::thread(&ModbusCppRtuBusLoop::loopThread, this);
+	return true;
+#endif
+}
+
+void ModbusCppRtuBusLoop::stop()
+{
+	{
+		// 在锁内清除运行标志，之后 submit() 不会再放入请求
+		std::lock_guard<std::mutex> _lock(m_pendingLock);
+		if (!m_running)
+		{
+			return;
+		}
+		m_running = false;
+	}
+	m_reactor.wakeup();
+	if (m_thread.joinable())
+	{
+		m_thread.join();
+	}
+	release();
+}
+
+bool ModbusCppRtuBusLoop::isRunning() const
+{
+	return m_running;
+}
+
+// 事件循环线程已退出(或还没启动): 关闭串口和定时器，没有完成的请求以 IO_ERROR 完成
+void ModbusCppRtuBusLoop::release()
+{
+	std::vector<Request *> _pending;
+	{
+		std::lock_guard<std::mutex> _lock(m_pendingLock);
+		_pending.swap(m_pending);
+	}
+	for (Request *_request : _pending)
+	{
+		m_buses[_request->bus]->queue.push_back(_request);
+	}
+
+	for (Bus *_bus : m_buses)
+	{
+		if (-1 != _bus->timer)
+		{
+			m_reactor.removeSocket(_bus->timer);
+#if !defined(_WIN32)
+			::close(_bus->timer);
+#endif
+			_bus->timer = -1;
+		}
+		closeBus(_bus);
+		_bus->state = Bus::IDLE;
+	}
+	m_reactor.close();
+}
+
+bool ModbusCppRtuBusLoop::submit(const int bus, const uint8_t slave, const uint8_t *pdu, const size_t pduLength, const Completion completion)
+{
+	if (bus < 0 || static_cast<size_t>(bus) >= m_buses.size() || 0 == pduLength || pduLength > MODBUS_MAX_PDU_LENGTH
+		|| slave > 247 || (MODBUS_BROADCAST_ADDRESS == slave && !isWriteFunction(pdu[0])))
+	{
+		return false;
+	}
+
+	Request *_request = new Request();
+	_request->bus = bus;
+	_request->frame[0] = slave;
+	memcpy(_request->frame + 1, pdu, pduLength);
+	const uint16_t _crc = modbusCrc16(_request->frame, 1 + pduLength);
+	_request->frame[1 + pduLength] = static_cast<uint8_t>(_crc & 0xFF);
+	_request->frame[2 + pduLength] = static_cast<uint8_t>(_crc >> 8);
+	_request->length = 3 + pduLength;
+	_request->predicted = predictResponseLength(pdu, pduLength);
+	_request->completion = completion;
+
+	{
+		std::lock_guard<std::mutex> _lock(m_pendingLock);
+		if (!m_running)
+		{
+			delete _request;
+			return false;
+		}
+		m_pending.push_back(_request);
+	}
+	m_buses[bus]->queueDepth.fetch_add(1, std::memory_order_relaxed);
+	// 在事件循环线程里(完成回调中)提交时，takePending() 会一直取到队列为空，不需要唤醒
+	if (this != t_currentLoop)
+	{
+		m_reactor.wakeup();
+	}
+	return true;
+}
+
+bool ModbusCppRtuBusLoop::readHoldingRegisters(const int bus, const uint8_t slave, const uint16_t startAddress, const uint16_t count,
+	const std::function<void (const Result result, const std::vector<uint16_t> &values)> completion)
+{
+	if (0 == count || count > MODBUS_MAX_READ_REGISTERS)
+	{
+		return false;
+	}
+
+	const uint8_t _pdu[5] = { MODBUS_FC_READ_HOLDING_REGISTERS,
+		static_cast<uint8_t>(startAddress >> 8), static_cast<uint8_t>(startAddress & 0xFF),
+		static_cast<uint8_t>(count >> 8), static_cast<uint8_t>(count & 0xFF) };
+	return submit(bus, slave, _pdu, sizeof(_pdu), [count, completion](const Result result, const uint8_t *response, const size_t length)
+		{
+			std::vector<uint16_t> _values;
+			if (Result::OK != result)
+			{
+				completion(result, _values);
+				return;
+			}
+			if (length != 2u + count * 2u || response[1] != count * 2)
+			{
+				completion(Result::FRAME_ERROR, _values);
+				return;
+			}
+			_values.resize(count);
+			for (uint16_t i = 0; i < count; ++i)
+			{
+				_values[i] = static_cast<uint16_t>((response[2 + i * 2] << 8) | response[3 + i * 2]);
+			}
+			completion(result, _values);
+		});
+}
+
+ModbusCppRtuBusLoopStatistics ModbusCppRtuBusLoop::getStatistics() const
+{
+	ModbusCppRtuBusLoopStatistics _statistics;
+	_statistics.iterations = m_iterations.load(std::memory_order_relaxed);
+	_statistics.timerFires = m_timerFires.load(std::memory_order_relaxed);
+	for (const Bus *_bus : m_buses)
+	{
+		ModbusCppRtuBusStatistics _busStatistics;
+		_busStatistics.device = _bus->config.device;
+		_busStatistics.requests = _bus->requests.load(std::memory_order_relaxed);
+		_busStatistics.broadcasts = _bus->broadcasts.load(std::memory_order_relaxed);
+		_busStatistics.responses = _bus->responses.load(std::memory_order_relaxed);
+		_busStatistics.exceptions = _bus->exceptions.load(std::memory_order_relaxed);
+		_busStatistics.timeouts = _bus->timeouts.load(std::memory_order_relaxed);
+		_busStatistics.frameErrors = _bus->frameErrors.load(std::memory_order_relaxed);
+		_busStatistics.bytesSent = _bus->bytesSent.load(std::memory_order_relaxed);
+		_busStatistics.bytesReceived = _bus->bytesReceived.load(std::memory_order_relaxed);
+		_busStatistics.readCalls = _bus->readCalls.load(std::memory_order_relaxed);
+		_busStatistics.queueDepth = _bus->queueDepth.load(std::memory_order_relaxed);
+		_busStatistics.latency = _bus->latency.snapshot();
+		_statistics.buses.push_back(_busStatistics);
+	}
+	return _statistics;
+}
+
+void ModbusCppRtuBusLoop::loopThread()
+{
+	t_currentLoop = this;
+	while (m_running)
+	{
+		int _timeoutMs = -1;
+#if !defined(__linux__)
+		// 没有 timerfd: 按最近的定时时间等待，精度为毫秒
+		const TimePoint _now = std::chrono::steady_clock::now();
+		for (const Bus *_bus : m_buses)
+		{
+			if (_bus->timerArmed)
+			{
+				const int _waitMs = _bus->deadline <= _now ? 0 : static_cast<int>((elapsedUsec(_now, _bus->deadline) + 999) / 1000);
+				_timeoutMs = -1 == _timeoutMs ? _waitMs : std::min(_timeoutMs, _waitMs);
+			}
+		}
+#endif
+		if (m_reactor.runOnce(_timeoutMs) < 0)
+		{
+			std::cout << "reactor error" << std::endl;
+			break;
+		}
+		m_iterations.fetch_add(1, std::memory_order_relaxed);
+#if !defined(__linux__)
+		for (Bus *_bus : m_buses)
+		{
+			onTimer(_bus);
+		}
+#endif
+		takePending();
+	}
+	t_currentLoop = NULL;
+}
+
+// 把提交的请求分到各总线的队列，空闲的总线开始执行
+// startNext() 里可能执行完成回调(广播、关闭总线)，回调里提交的请求也在这里取走，直到没有新的请求
+void ModbusCppRtuBusLoop::takePending()
+{
+	std::vector<Request *> _pending;
+	while (true)
+	{
+		{
+			std::lock_guard<std::mutex> _lock(m_pendingLock);
+			if (m_pending.empty())
+			{
+				return;
+			}
+			_pending.swap(m_pending);
+		}
+		for (Request *_request : _pending)
+		{
+			m_buses[_request->bus]->queue.push_back(_request);
+		}
+		_pending.clear();
+		for (Bus *_bus : m_buses)
+		{
+			if (NULL == _bus->current && !_bus->queue.empty())
+			{
+				startNext(_bus);
+			}
+		}
+	}
+}
+
+// 取下一个请求: 帧间隔已经过去就立即发送，否则定时到帧间隔结束
+void ModbusCppRtuBusLoop::startNext(Bus *bus)
+{
+	if (!bus->port.isOpen())
+	{
+		closeBus(bus);
+		return;
+	}
+	if (NULL != bus->current)
+	{
+		return;
+	}
+	if (bus->queue.empty())
+	{
+		cancelTimer(bus);
+		return;
+	}
+
+	bus->current = bus->queue.front();
+	bus->queue.pop_front();
+	bus->queueDepth.fetch_sub(1, std::memory_order_relaxed);
+
+	const TimePoint _ready = bus->idleSince + std::chrono::microseconds(bus->config.frameGapUsec());
+	if (std::chrono::steady_clock::now() >= _ready)
+	{
+		send(bus);
+		return;
+	}
+	bus->state = Bus::GAP;
+	setTimer(bus, _ready);
+}
+
+void ModbusCppRtuBusLoop::send(Bus *bus)
+{
+	Request *_request = bus->current;
+	bus->requests.fetch_add(1, std::memory_order_relaxed);
+	bus->sentAt = std::chrono::steady_clock::now();
+	if (-1 == bus->port.write(_request->frame, _request->length))
+	{
+		std::cout << "write " << bus->config.device << " failed: " << strerror(errno) << std::endl;
+		closeBus(bus);
+		return;
+	}
+	bus->bytesSent.fetch_add(_request->length, std::memory_order_relaxed);
+
+	if (MODBUS_BROADCAST_ADDRESS == _request->frame[0])
+	{
+		// 广播没有响应: 立即完成，总线空闲时间推迟到帧发完再加上处理延时
+		bus->broadcasts.fetch_add(1, std::memory_order_relaxed);
+		bus->idleSince = bus->sentAt + std::chrono::microseconds(bus->config.frameUsec(_request->length) + m_broadcastDelayUsec);
+		bus->current = NULL;
+		bus->state = Bus::IDLE;
+		_request->completion(Result::OK, NULL, 0);
+		delete _request;
+		startNext(bus);
+		return;
+	}
+
+	// 请求本身还要在线路上传输，超时从帧发完开始计算
+	bus->received = 0;
+	bus->state = Bus::WAIT_RESPONSE;
+	setReadable(bus, true);
+	setTimer(bus, bus->sentAt + std::chrono::microseconds(bus->config.frameUsec(_request->length) + m_responseTimeoutUsec));
+}
+
+// 一次读出串口缓冲区中已有的所有数据
+void ModbusCppRtuBusLoop::onReadable(Bus *bus)
+{
+	bus->readCalls.fetch_add(1, std::memory_order_relaxed);
+	const bool _receiving = Bus::WAIT_RESPONSE == bus->state || Bus::TAIL == bus->state || Bus::SILENT == bus->state;
+	const size_t _offset = _receiving ? bus->received : 0;
+	const int _received = bus->port.read(bus->buffer + _offset, RTU_FRAME_MAX - _offset, 0);
+	if (_received < 0)
+	{
+		std::cout << "read " << bus->config.device << " failed: " << strerror(errno) << std::endl;
+		closeBus(bus);
+		return;
+	}
+	if (0 == _received)
+	{
+		return;
+	}
+
+	if (!_receiving)
+	{
+		// 没有请求时收到的数据是线路上的干扰，丢弃并重新计算帧间隔
+		bus->idleSince = std::chrono::steady_clock::now();
+		if (Bus::GAP == bus->state)
+		{
+			setTimer(bus, bus->idleSince + std::chrono::microseconds(bus->config.frameGapUsec()));
+		}
+		return;
+	}
+	bus->received += _received;
+	receive(bus);
+}
+
+void ModbusCppRtuBusLoop::onTimer(Bus *bus)
+{
+	// 定时器被重新设置过时，旧的触发直接忽略
+	if (!bus->timerArmed || std::chrono::steady_clock::now() < bus->deadline)
+	{
+		return;
+	}
+	bus->timerArmed = false;
+	m_timerFires.fetch_add(1, std::memory_order_relaxed);
+
+	switch (bus->state)
+	{
+	case Bus::GAP:
+		send(bus);
+		break;
+	case Bus::WAIT_RESPONSE:
+		finish(bus, Result::TIMEOUT, 0);
+		break;
+	case Bus::TAIL:
+	{
+		// 剩余字节应该已经传完，通常一次读取就能取完
+		bus->readCalls.fetch_add(1, std::memory_order_relaxed);
+		const int _received = bus->port.read(bus->buffer + bus->received, RTU_FRAME_MAX - bus->received, 0);
+		if (_received < 0)
+		{
+			closeBus(bus);
+			break;
+		}
+		if (_received > 0)
+		{
+			bus->received += _received;
+			receive(bus);
+			break;
+		}
+		// 没有按时到达(如 USB 转串口的缓冲延迟)，改为关注可读事件并以静默间隔结束
+		bus->state = Bus::SILENT;
+		setReadable(bus, true);
+		setTimer(bus, std::chrono::steady_clock::now() + std::chrono::microseconds(silentIntervalUsec(bus)));
+		break;
+	}
+	case Bus::SILENT:
+	{
+		// 静默间隔内没有新数据: 长度未知的帧到此结束，长度已知的帧不完整
+		const size_t _expected = responseLength(bus->buffer, bus->received);
+		if (0 == _expected && bus->received >= 4)
+		{
+			frameReceived(bus, bus->received);
+			break;
+		}
+		finish(bus, Result::FRAME_ERROR, 0);
+		break;
+	}
+	default:
+		break;
+	}
+}
+
+// 收到新数据后判断帧是否完整，不完整时决定下一步等待的方式
+void ModbusCppRtuBusLoop::receive(Bus *bus)
+{
+	const size_t _expected = responseLength(bus->buffer, bus->received);
+	if (0 != _expected && bus->received >= _expected)
+	{
+		frameReceived(bus, _expected);
+		return;
+	}
+	if (bus->received >= RTU_FRAME_MAX)
+	{
+		finish(bus, Result::FRAME_ERROR, 0);
+		return;
+	}
+
+	// 响应的字节数还没收到时先按请求推算
+	const size_t _target = 0 != _expected ? _expected : (bus->received < 3 ? bus->current->predicted : 0);
+	const TimePoint _now = std::chrono::steady_clock::now();
+	if (_target > bus->received)
+	{
+		// 剩余字节在线路上传输期间不关注可读事件，避免每到几个字节就唤醒一次
+		bus->state = Bus::TAIL;
+		setReadable(bus, false);
+		setTimer(bus, _now + std::chrono::microseconds(static_cast<uint64_t>(_target - bus->received) * bus->config.characterUsec()));
+		return;
+	}
+	bus->state = Bus::SILENT;
+	setReadable(bus, true);
+	setTimer(bus, _now + std::chrono::microseconds(silentIntervalUsec(bus)));
+}
+
+// 校验收到的帧: 帧后面多出的字节说明线路上有冲突
+void ModbusCppRtuBusLoop::frameReceived(Bus *bus, const size_t length)
+{
+	bus->bytesReceived.fetch_add(bus->received, std::memory_order_relaxed);
+	const uint8_t *_frame = bus->buffer;
+	const uint8_t *_request = bus->current->frame;
+	if (bus->received != length
+		|| modbusCrc16(_frame, length - 2) != static_cast<uint16_t>(_frame[length - 2] | (_frame[length - 1] << 8))
+		|| _frame[0] != _request[0] || (_frame[1] & 0x7F) != _request[1])
+	{
+		finish(bus, Result::FRAME_ERROR, 0);
+		return;
+	}
+	finish(bus, (_frame[1] & 0x80) ? Result::EXCEPTION : Result::OK, length);
+}
+
+// 完成当前请求并开始下一个，length 为响应帧长度
+void ModbusCppRtuBusLoop::finish(Bus *bus, const Result result, const size_t length)
+{
+	Request *_request = bus->current;
+	const TimePoint _now = std::chrono::steady_clock::now();
+	bus->current = NULL;
+	bus->state = Bus::IDLE;
+	bus->idleSince = _now;
+	setReadable(bus, true);
+
+	switch (result)
+	{
+	case Result::OK:
+	case Result::EXCEPTION:
+		bus->responses.fetch_add(1, std::memory_order_relaxed);
+		bus->latency.record(elapsedUsec(bus->sentAt, _now));
+		if (Result::EXCEPTION == result)
+		{
+			bus->exceptions.fetch_add(1, std::memory_order_relaxed);
+		}
+		_request->completion(result, bus->buffer + 1, length - 3);
+		break;
+	case Result::TIMEOUT:
+		// 丢掉已经到达的迟到响应，避免被下一个请求当成自己的响应
+		bus->timeouts.fetch_add(1, std::memory_order_relaxed);
+		bus->port.flush();
+		_request->completion(result, NULL, 0);
+		break;
+	case Result::FRAME_ERROR:
+		// 丢掉后面可能还在到达的半帧，避免和下一个响应粘在一起
+		bus->frameErrors.fetch_add(1, std::memory_order_relaxed);
+		bus->port.flush();
+		_request->completion(result, NULL, 0);
+		break;
+	default:
+		_request->completion(result, NULL, 0);
+		break;
+	}
+	delete _request;
+	startNext(bus);
+}
+
+// 串口读写出错(如 USB 转串口被拔出): 关闭串口，当前和排队的请求以 IO_ERROR 完成，之后该总线上的请求也都以 IO_ERROR 完成
+void ModbusCppRtuBusLoop::closeBus(Bus *bus)
+{
+	if (bus->port.isOpen())
+	{
+		m_reactor.removeSocket(bus->port.handle());
+		bus->port.close();
+	}
+	cancelTimer(bus);
+
+	std::deque<Request *> _requests;
+	_requests.swap(bus->queue);
+	bus->queueDepth.fetch_sub(_requests.size(), std::memory_order_relaxed);
+	if (NULL != bus->current)
+	{
+		_requests.push_front(bus->current);
+		bus->current = NULL;
+	}
+	for (Request *_request : _requests)
+	{
+		_request->completion(Result::IO_ERROR, NULL, 0);
+		delete _request;
+	}
+}
+
+uint32_t ModbusCppRtuBusLoop::silentIntervalUsec(const Bus *bus) const
+{
+	return 0 != m_silentIntervalUsec ? m_silentIntervalUsec : bus->config.frameGapUsec();
+}
+
+// 定时器使用绝对时间，steady_clock 和 timerfd 都基于 CLOCK_MONOTONIC
+void ModbusCppRtuBusLoop::setTimer(Bus *bus, const TimePoint& deadline)
+{
+	bus->deadline = deadline;
+	bus->timerArmed = true;
+#if defined(__linux__)
+	const uint64_t _nsec = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(deadline.time_since_epoch()).count());
+	itimerspec _value = {};
+	_value.it_value.tv_sec = static_cast<time_t>(_nsec / 1000000000);
+	_value.it_value.tv_nsec = static_cast<long>(_nsec % 1000000000);
+	timerfd_settime(bus->timer, TFD_TIMER_ABSTIME, &_value, NULL);
+#endif
+}
+
+void ModbusCppRtuBusLoop::cancelTimer(Bus *bus)
+{
+	if (!bus->timerArmed)
+	{
+		return;
+	}
+	bus->timerArmed = false;
+#if defined(__linux__)
+	const itimerspec _value = {};
+	timerfd_settime(bus->timer, 0, &_value, NULL);
+#endif
+}
+
+void ModbusCppRtuBusLoop::setReadable(Bus *bus, const bool readable)
+{
+	if (bus->readable != readable && bus->port.isOpen())
+	{
+		m_reactor.modifySocket(bus->port.handle(), readable ? static_cast<uint32_t>(ModbusCppReactor::READABLE) : 0u);
+	}
+	bus->readable = readable;
+}
@@ -0,0 +1,483 @@
+﻿#include "ModbusCppRtuClient.h"
+#include "ModbusCppSerialPort.h"
+#include "ModbusCppTcpStream.h"
+#include "ModbusCppCrc16.h"
+#include "ModbusCppRtuFrame.h"
+#include "modbus.h"
+#include <thread>
+#include <cstring>
+
+// 从站地址 + PDU + CRC
+static const size_t RTU_FRAME_MAX = MODBUS_RTU_MAX_ADU_LENGTH;
+static const uint32_t RESPONSE_TIMEOUT_MS_DEFAULT = 500;
+static const uint32_t BROADCAST_DELAY_MS_DEFAULT = 100;
+// TCP 连接上帧可能被串口服务器拆成几个报文段，默认的静默间隔要覆盖报文段之间的间隔
+static const uint32_t TCP_SILENT_INTERVAL_USEC_DEFAULT = 50000;
+
+static uint64_t elapsedUsec(const std::chrono::steady_clock::time_point& start)
+{
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+}
+
+static uint16_t readUint16(const uint8_t *data)
+{
+	return static_cast<uint16_t>((data[0] << 8) | data[1]);
+}
+
+static void writeUint16(uint8_t *data, const uint16_t value)
+{
+	data[0] = static_cast<uint8_t>(value >> 8);
+	data[1] = static_cast<uint8_t>(value & 0xFF);
+}
+
+ModbusCppRtuClient::ModbusCppRtuClient()
+	: m_transport(NULL)
+	, m_tcp(false)
+	, m_tcpPort(0)
+	, m_connectTimeoutMs(0)
+	, m_responseTimeoutUsec(RESPONSE_TIMEOUT_MS_DEFAULT * 1000)
+	, m_silentIntervalUsec(0)
+	, m_broadcastDelayUsec(BROADCAST_DELAY_MS_DEFAULT * 1000)
+	, m_lastResult(Result::OK)
+	, m_lastException(0)
+	, m_requests(0)
+	, m_broadcasts(0)
+	, m_responses(0)
+	, m_exceptions(0)
+	, m_timeouts(0)
+	, m_frameErrors(0)
+	, m_bytesSent(0)
+	, m_bytesReceived(0)
+	, m_readCalls(0)
+	, m_reconnects(0)
+{
+}
+
+ModbusCppRtuClient::~ModbusCppRtuClient()
+{
+	close();
+	delete m_transport;
+}
+
+bool ModbusCppRtuClient::open(const ModbusCppSerialConfig& config)
+{
+	std::lock_guard<std::mutex> _lock(m_lock);
+	delete m_transport;
+	m_transport = NULL;
+	ModbusCppSerialPort *_port = new ModbusCppSerialPort();
+	if (config.baud <= 0 || !_port->open(config))
+	{
+		delete _port;
+		return false;
+	}
+	m_transport = _port;
+	m_tcp = false;
+	m_config = config;
+	m_idleSince = std::chrono::steady_clock::now();
+	return true;
+}
+
+bool ModbusCppRtuClient::connectTcp(const std::string& host, const uint16_t port, const uint32_t connectTimeoutMs)
+{
+	std::lock_guard<std::mutex> _lock(m_lock);
+	delete m_transport;
+	m_transport = NULL;
+	ModbusCppTcpStream *_stream = new ModbusCppTcpStream();
+	if (!_stream->connect(host, port, connectTimeoutMs))
+	{
+		delete _stream;
+		return false;
+	}
+	m_transport = _stream;
+	m_tcp = true;
+	m_host = host;
+	m_tcpPort = port;
+	m_connectTimeoutMs = connectTimeoutMs;
+	m_idleSince = std::chrono::steady_clock::now();
+	return true;
+}
+
+void ModbusCppRtuClient::close()
+{
+	std::lock_guard<std::mutex> _lock(m_lock);
+	if (NULL != m_transport)
+	{
+		m_transport->close();
+	}
+}
+
+bool ModbusCppRtuClient::isOpen() const
+{
+	std::lock_guard<std::mutex> _lock(m_lock);
+	return NULL != m_transport && m_transport->isOpen();
+}
+
+void ModbusCppRtuClient::setResponseTimeout(const uint32_t msec)
+{
+	if (msec > 0)
+	{
+		std::lock_guard<std::mutex> _lock(m_lock);
+		m_responseTimeoutUsec = msec * 1000;
+	}
+}
+
+void ModbusCppRtuClient::setSilentInterval(const uint32_t usec)
+{
+	std::lock_guard<std::mutex> _lock(m_lock);
+	m_silentIntervalUsec = usec;
+}
+
+void ModbusCppRtuClient::setBroadcastDelay(const uint32_t msec)
+{
+	std::lock_guard<std::mutex> _lock(m_lock);
+	m_broadcastDelayUsec = msec * 1000;
+}
+
+std::optional<std::vector<uint16_t>> ModbusCppRtuClient::readHoldingRegisters(const uint8_t slave, const uint16_t startAddress, const uint16_t count)
+{
+	return readRegisters(MODBUS_FC_READ_HOLDING_REGISTERS, slave, startAddress, count);
+}
+
+std::optional<std::vector<uint16_t>> ModbusCppRtuClient::readInputRegisters(const uint8_t slave, const uint16_t startAddress, const uint16_t count)
+{
+	return readRegisters(MODBUS_FC_READ_INPUT_REGISTERS, slave, startAddress, count);
+}
+
+std::optional<std::vector<bool>> ModbusCppRtuClient::readCoils(const uint8_t slave, const uint16_t startAddress, const uint16_t count)
+{
+	return readBits(MODBUS_FC_READ_COILS, slave, startAddress, count);
+}
+
+std::optional<std::vector<bool>> ModbusCppRtuClient::readDiscreteInputs(const uint8_t slave, const uint16_t startAddress, const uint16_t count)
+{
+	return readBits(MODBUS_FC_READ_DISCRETE_INPUTS, slave, startAddress, count);
+}
+
+bool ModbusCppRtuClient::writeRegister(const uint8_t slave, const uint16_t address, const uint16_t value)
+{
+	uint8_t _pdu[5] = { MODBUS_FC_WRITE_SINGLE_REGISTER };
+	writeUint16(_pdu + 1, address);
+	writeUint16(_pdu + 3, value);
+	return write(_pdu, sizeof(_pdu), slave);
+}
+
+bool ModbusCppRtuClient::writeRegisters(const uint8_t slave, const uint16_t startAddress, const std::vector<uint16_t>& values)
+{
+	if (values.empty() || values.size() > MODBUS_MAX_WRITE_REGISTERS)
+	{
+		m_lastResult = Result::INVALID;
+		return false;
+	}
+
+	uint8_t _pdu[MODBUS_MAX_PDU_LENGTH];
+	_pdu[0] = MODBUS_FC_WRITE_MULTIPLE_REGISTERS;
+	writeUint16(_pdu + 1, startAddress);
+	writeUint16(_pdu + 3, static_cast<uint16_t>(values.size()));
+	_pdu[5] = static_cast<uint8_t>(values.size() * 2);
+	for (size_t i = 0; i < values.size(); ++i)
+	{
+		writeUint16(_pdu + 6 + i * 2, values[i]);
+	}
+	return write(_pdu, 6 + values.size() * 2, slave);
+}
+
+bool ModbusCppRtuClient::writeCoil(const uint8_t slave, const uint16_t address, const bool value)
+{
+	uint8_t _pdu[5] = { MODBUS_FC_WRITE_SINGLE_COIL };
+	writeUint16(_pdu + 1, address);
+	writeUint16(_pdu + 3, value ? 0xFF00 : 0x0000);
+	return write(_pdu, sizeof(_pdu), slave);
+}
+
+std::optional<std::vector<uint16_t>> ModbusCppRtuClient::readRegisters(const uint8_t function, const uint8_t slave, const uint16_t startAddress, const uint16_t count)
+{
+	if (0 == count || count > MODBUS_MAX_READ_REGISTERS)
+	{
+		m_lastResult = Result::INVALID;
+		return std::nullopt;
+	}
+
+	uint8_t _pdu[5] = { function };
+	writeUint16(_pdu + 1, startAddress);
+	writeUint16(_pdu + 3, count);
+	uint8_t _response[MODBUS_MAX_PDU_LENGTH];
+	const int _length = transact(slave, _pdu, sizeof(_pdu), _response);
+	if (_length < 0 || (_response[0] & 0x80))
+	{
+		return std::nullopt;
+	}
+	if (_length != 2 + count * 2 || _response[1] != count * 2)
+	{
+		m_lastResult = Result::FRAME_ERROR;
+		return std::nullopt;
+	}
+
+	std::vector<uint16_t> _values(count);
+	for (uint16_t i = 0; i < count; ++i)
+	{
+		_values[i] = readUint16(_response + 2 + i * 2);
+	}
+	return _values;
+}
+
+std::optional<std::vector<bool>> ModbusCppRtuClient::readBits(const uint8_t function, const uint8_t slave, const uint16_t startAddress, const uint16_t count)
+{
+	if (0 == count || count > MODBUS_MAX_READ_BITS)
+	{
+		m_lastResult = Result::INVALID;
+		return std::nullopt;
+	}
+
+	uint8_t _pdu[5] = { function };
+	writeUint16(_pdu + 1, startAddress);
+	writeUint16(_pdu + 3, count);
+	uint8_t _response[MODBUS_MAX_PDU_LENGTH];
+	const int _length = transact(slave, _pdu, sizeof(_pdu), _response);
+	if (_length < 0 || (_response[0] & 0x80))
+	{
+		return std::nullopt;
+	}
+	const int _bytes = (count + 7) / 8;
+	if (_length != 2 + _bytes || _response[1] != _bytes)
+	{
+		m_lastResult = Result::FRAME_ERROR;
+		return std::nullopt;
+	}
+
+	std::vector<bool> _values(count);
+	for (uint16_t i = 0; i < count; ++i)
+	{
+		_values[i] = 0 != (_response[2 + i / 8] & (1 << (i % 8)));
+	}
+	return _values;
+}
+
+// 写请求的正常响应是请求的回显(FC5/FC6)或地址和数量(FC15/FC16)，广播没有响应
+bool ModbusCppRtuClient::write(const uint8_t *pdu, const size_t pduLength, const uint8_t slave)
+{
+	uint8_t _response[MODBUS_MAX_PDU_LENGTH];
+	const int _length = transact(slave, pdu, pduLength, _response);
+	if (MODBUS_BROADCAST_ADDRESS == slave)
+	{
+		return 0 == _length;
+	}
+	if (_length < 0 || (_response[0] & 0x80))
+	{
+		return false;
+	}
+	if (_length != 5 || 0 != memcmp(_response + 1, pdu + 1, 4))
+	{
+		m_lastResult = Result::FRAME_ERROR;
+		return false;
+	}
+	return true;
+}
+
+int ModbusCppRtuClient::transact(const uint8_t slave, const uint8_t *pdu, const size_t pduLength, uint8_t *response)
+{
+	const bool _broadcast = MODBUS_BROADCAST_ADDRESS == slave;
+	if (0 == pduLength || pduLength > MODBUS_MAX_PDU_LENGTH || slave > 247 || (_broadcast && !isWriteFunction(pdu[0])))
+	{
+		m_lastResult = Result::INVALID;
+		return -1;
+	}
+
+	std::lock_guard<std::mutex> _lock(m_lock);
+	if (NULL == m_transport)
+	{
+		m_lastResult = Result::IO_ERROR;
+		return -1;
+	}
+	uint8_t _frame[RTU_FRAME_MAX];
+	_frame[0] = slave;
+	memcpy(_frame + 1, pdu, pduLength);
+	const uint16_t _crc = modbusCrc16(_frame, 1 + pduLength);
+	_frame[1 + pduLength] = static_cast<uint8_t>(_crc & 0xFF);
+	_frame[2 + pduLength] = static_cast<uint8_t>(_crc >> 8);
+	const size_t _requestLength = 3 + pduLength;
+
+	// 与上一帧之间至少间隔 3.5 个字符，TCP 上由串口服务器负责
+	std::this_thread::sleep_until(m_idleSince + std::chrono::microseconds(m_tcp ? 0 : m_config.frameGapUsec()));
+
+	// 丢掉上一个请求超时之后才到达的响应，否则会被当成这个请求的响应
+	// TCP 上串口服务器转发的迟到响应同样留在连接里；对端已经关闭的连接在 flush() 时发现，这里重连后再发送
+	m_transport->flush();
+	if (!m_transport->isOpen())
+	{
+		// TCP 连接断开后在下一个请求时重连一次，串口不自动重新打开
+		if (!m_tcp || !static_cast<ModbusCppTcpStream *>(m_transport)->connect(m_host, m_tcpPort, m_connectTimeoutMs))
+		{
+			m_lastResult = Result::IO_ERROR;
+			return -1;
+		}
+		m_reconnects.fetch_add(1, std::memory_order_relaxed);
+	}
+	const auto _start = std::chrono::steady_clock::now();
+	m_requests.fetch_add(1, std::memory_order_relaxed);
+	if (-1 == m_transport->write(_frame, _requestLength))
+	{
+		m_idleSince = std::chrono::steady_clock::now();
+		m_lastResult = Result::IO_ERROR;
+		return -1;
+	}
+	m_bytesSent.fetch_add(_requestLength, std::memory_order_relaxed);
+
+	if (_broadcast)
+	{
+		// 广播没有响应: 不在这里等待，把总线空闲时间推迟到帧发完再加上处理延时，下一个请求发送前自然会等够
+		m_broadcasts.fetch_add(1, std::memory_order_relaxed);
+		m_idleSince = _start + std::chrono::microseconds((m_tcp ? 0 : m_config.frameUsec(_requestLength)) + m_broadcastDelayUsec);
+		m_lastResult = Result::OK;
+		return 0;
+	}
+
+	size_t _responseLength = 0;
+	const Result _result = receive(slave, pdu[0], predictResponseLength(pdu, pduLength), _frame, _responseLength);
+	m_idleSince = std::chrono::steady_clock::now();
+	m_lastResult = _result;
+	switch (_result)
+	{
+	case Result::OK:
+	case Result::EXCEPTION:
+		break;
+	case Result::TIMEOUT:
+		m_timeouts.fetch_add(1, std::memory_order_relaxed);
+		return -1;
+	case Result::FRAME_ERROR:
+		// 丢掉后面可能还在到达的半帧，避免和下一个响应粘在一起
+		m_frameErrors.fetch_add(1, std::memory_order_relaxed);
+		m_transport->flush();
+		return -1;
+	default:
+		return -1;
+	}
+
+	m_responses.fetch_add(1, std::memory_order_relaxed);
+	m_latency.record(elapsedUsec(_start));
+	if (Result::EXCEPTION == _result)
+	{
+		m_exceptions.fetch_add(1, std::memory_order_relaxed);
+		m_lastException = _frame[2];
+	}
+	memcpy(response, _frame + 1, _responseLength - 3);
+	return static_cast<int>(_responseLength - 3);
+}
+
+// 接收一个响应帧: 等第一批数据到达后按帧长度等剩余字节传完再读，长度未知时以静默间隔结束
+ModbusCppRtuClient::Result ModbusCppRtuClient::receive(const uint8_t slave, const uint8_t function, const size_t predictedLength, uint8_t *frame, size_t &frameLength)
+{
+	// TCP 上没有波特率，不按字符时间等待，剩余字节靠静默间隔内的读取等到
+	const uint32_t _silentUsec = 0 != m_silentIntervalUsec ? m_silentIntervalUsec : (m_tcp ? TCP_SILENT_INTERVAL_USEC_DEFAULT : m_config.frameGapUsec());
+	const uint32_t _characterUsec = m_tcp ? 0 : m_config.characterUsec();
+
+	m_readCalls.fetch_add(1, std::memory_order_relaxed);
+	int _received = m_transport->read(frame, RTU_FRAME_MAX, m_responseTimeoutUsec);
+	if (_received < 0)
+	{
+		return Result::IO_ERROR;
+	}
+	if (0 == _received)
+	{
+		return Result::TIMEOUT;
+	}
+
+	size_t _length = _received;
+	size_t _expected = 0;
+	while (true)
+	{
+		_expected = responseLength(frame, _length);
+		// 响应的字节数还没收到时先按请求推算
+		const size_t _target = 0 != _expected ? _expected : (_length < 3 ? predictedLength : 0);
+		if (0 != _expected && _length >= _expected)
+		{
+			break;
+		}
+
+		// 剩余字节还在线路上，先等它们传完，通常一次读取就能取完；TCP 上无法推算到达时间，直接等待
+		_received = 0;
+		if (_target > _length && _characterUsec > 0)
+		{
+			std::this_thread::sleep_for(std::chrono::microseconds(static_cast<uint64_t>(_target - _length) * _characterUsec));
+			m_readCalls.fetch_add(1, std::memory_order_relaxed);
+			_received = m_transport->read(frame + _length, RTU_FRAME_MAX - _length, 0);
+		}
+		if (0 == _received)
+		{
+			m_readCalls.fetch_add(1, std::memory_order_relaxed);
+			_received = m_transport->read(frame + _length, RTU_FRAME_MAX - _length, _silentUsec);
+		}
+		if (_received < 0)
+		{
+			return Result::IO_ERROR;
+		}
+		if (0 == _received)
+		{
+			// 静默间隔内没有新数据: 长度未知的帧到此结束，长度已知的帧不完整
+			if (0 == _expected && _length >= 4)
+			{
+				_expected = _length;
+				break;
+			}
+			return Result::FRAME_ERROR;
+		}
+		_length += _received;
+		if (_length >= RTU_FRAME_MAX && (0 == _expected || _length < _expected))
+		{
+			return Result::FRAME_ERROR;
+		}
+	}
+	m_bytesReceived.fetch_add(_length, std::memory_order_relaxed);
+
+	// 帧后面多出的字节说明线路上有冲突
+	if (_length != _expected
+		|| modbusCrc16(frame, _expected - 2) != static_cast<uint16_t>(frame[_expected - 2] | (frame[_expected - 1] << 8))
+		|| frame[0] != slave || (frame[1] & 0x7F) != function)
+	{
+		return Result::FRAME_ERROR;
+	}
+
+	frameLength = _expected;
+	return (frame[1] & 0x80) ? Result::EXCEPTION : Result::OK;
+}
+
+ModbusCppRtuClient::Result ModbusCppRtuClient::lastResult() const
+{
+	return m_lastResult;
+}
+
+uint8_t ModbusCppRtuClient::lastException() const
+{
+	return m_lastException;
+}
+
+ModbusCppRtuStatistics ModbusCppRtuClient::getStatistics() const
+{
+	ModbusCppRtuStatistics _statistics;
+	_statistics.requests = m_requests.load(std::memory_order_relaxed);
+	_statistics.broadcasts = m_broadcasts.load(std::memory_order_relaxed);
+	_statistics.responses = m_responses.load(std::memory_order_relaxed);
+	_statistics.exceptions = m_exceptions.load(std::memory_order_relaxed);
+	_statistics.timeouts = m_timeouts.load(std::memory_order_relaxed);
+	_statistics.frameErrors = m_frameErrors.load(std::memory_order_relaxed);
+	_statistics.bytesSent = m_bytesSent.load(std::memory_order_relaxed);
+	_statistics.bytesReceived = m_bytesReceived.load(std::memory_order_relaxed);
+	_statistics.readCalls = m_readCalls.load(std::memory_order_relaxed);
+	_statistics.reconnects = m_reconnects.load(std::memory_order_relaxed);
+	_statistics.latency = m_latency.snapshot();
+	return _statistics;
+}
+
+void ModbusCppRtuClient::resetStatistics()
+{
+	m_requests = 0;
+	m_broadcasts = 0;
+	m_responses = 0;
+	m_exceptions = 0;
+	m_timeouts = 0;
+	m_frameErrors = 0;
+	m_bytesSent = 0;
+	m_bytesReceived = 0;
+	m_readCalls = 0;
+	m_reconnects = 0;
+	m_latency.reset();
+}
@@ -0,0 +1,84 @@
+﻿#pragma once
+#include <cstdint>
+#include <cstddef>
+
+#include "modbus.h"
+
+// 内部使用: RTU 主站按功能码推算帧长度，ModbusCppRtuClient 和 ModbusCppRtuBusLoop 共用
+
+// 只有写请求可以广播
+inline bool isWriteFunction(const uint8_t function)
+{
+	switch (function)
+	{
+	case MODBUS_FC_WRITE_SINGLE_COIL:
+	case MODBUS_FC_WRITE_SINGLE_REGISTER:
+	case MODBUS_FC_WRITE_MULTIPLE_COILS:
+	case MODBUS_FC_WRITE_MULTIPLE_REGISTERS:
+	case MODBUS_FC_MASK_WRITE_REGISTER:
+		return true;
+	default:
+		return false;
+	}
+}
+
+// 根据请求推算响应帧长度，推算不了返回 0
+inline size_t predictResponseLength(const uint8_t *pdu, const size_t pduLength)
+{
+	const size_t _count = pduLength < 5 ? 0 : static_cast<size_t>((pdu[3] << 8) | pdu[4]);
+	switch (pdu[0])
+	{
+	case MODBUS_FC_READ_COILS:
+	case MODBUS_FC_READ_DISCRETE_INPUTS:
+		return pduLength < 5 ? 0 : 5 + (_count + 7) / 8;
+	case MODBUS_FC_READ_HOLDING_REGISTERS:
+	case MODBUS_FC_READ_INPUT_REGISTERS:
+	case MODBUS_FC_WRITE_AND_READ_REGISTERS:
+		return pduLength < 5 ? 0 : 5 + 2 * _count;
+	case MODBUS_FC_WRITE_SINGLE_COIL:
+	case MODBUS_FC_WRITE_SINGLE_REGISTER:
+	case MODBUS_FC_WRITE_MULTIPLE_COILS:
+	case MODBUS_FC_WRITE_MULTIPLE_REGISTERS:
+		return 8;
+	case MODBUS_FC_MASK_WRITE_REGISTER:
+		return 10;
+	case MODBUS_FC_READ_EXCEPTION_STATUS:
+		return 5;
+	default:
+		return 0;
+	}
+}
+
+// 根据已收到的响应确定帧长度，数据还不够或功能码无法推算时返回 0
+inline size_t responseLength(const uint8_t *frame, const size_t length)
+{
+	if (length < 2)
+	{
+		return 0;
+	}
+	if (frame[1] & 0x80)
+	{
+		return 5;
+	}
+	switch (frame[1])
+	{
+	case MODBUS_FC_READ_COILS:
+	case MODBUS_FC_READ_DISCRETE_INPUTS:
+	case MODBUS_FC_READ_HOLDING_REGISTERS:
+	case MODBUS_FC_READ_INPUT_REGISTERS:
+	case MODBUS_FC_REPORT_SLAVE_ID:
+	case MODBUS_FC_WRITE_AND_READ_REGISTERS:
+		return length < 3 ? 0 : 5 + frame[2];
+	case MODBUS_FC_WRITE_SINGLE_COIL:
+	case MODBUS_FC_WRITE_SINGLE_REGISTER:
+	case MODBUS_FC_WRITE_MULTIPLE_COILS:
+	case MODBUS_FC_WRITE_MULTIPLE_REGISTERS:
+		return 8;
+	case MODBUS_FC_MASK_WRITE_REGISTER:
+		return 10;
+	case MODBUS_FC_READ_EXCEPTION_STATUS:
+		return 5;
+	default:
+		return 0;
+	}
+}
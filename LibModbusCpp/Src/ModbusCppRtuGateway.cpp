@@ -0,0 +1,575 @@
+﻿#include "ModbusCppRtuGateway.h"
+#include "ModbusCppSocket.h"
+#include "ModbusCppMbapConnection.h"
+#include "ModbusCppRtuFrame.h"
+#include "modbus.h"
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+
+// 默认参数
+static const uint32_t RESPONSE_TIMEOUT_MS_DEFAULT = 500;
+static const uint32_t BROADCAST_DELAY_MS_DEFAULT = 100;
+static const size_t QUEUE_LIMIT_DEFAULT = 256;
+
+static uint64_t elapsedUsec(const std::chrono::steady_clock::time_point& from, const std::chrono::steady_clock::time_point& to)
+{
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(to - from).count());
+}
+
+// 一条串口总线: 请求队列由事件循环线程写入，总线线程取出执行
+struct ModbusCppRtuGateway::Bus
+{
+	explicit Bus(const ModbusCppSerialConfig& serialConfig)
+		: config(serialConfig)
+	{
+	}
+
+	ModbusCppSerialConfig       config;
+	modbus_t                    *context = NULL;
+	std::thread                 thread;
+	std::deque<Request *>       queue;
+	std::mutex                  queueLock;
+	std::condition_variable     queueCondition;
+	std::chrono::steady_clock::time_point idleSince;   // 上一帧结束的时间，只有总线线程访问
+
+	ModbusCppLatencyHistogram   queueWait;
+	ModbusCppLatencyHistogram   transaction;
+	std::atomic<uint64_t>       requests{ 0 };
+	std::atomic<uint64_t>       broadcasts{ 0 };
+	std::atomic<uint64_t>       timeouts{ 0 };
+	std::atomic<uint64_t>       errors{ 0 };
+	std::atomic<uint64_t>       rejected{ 0 };
+	std::atomic<uint64_t>       busyUsec{ 0 };
+	std::atomic<size_t>         queueDepth{ 0 };
+	std::atomic<size_t>         queueDepthMax{ 0 };
+};
+
+struct ModbusCppRtuGateway::Connection : ModbusCppMbapConnection
+{
+	uint64_t                id = 0;
+};
+
+struct ModbusCppRtuGateway::Request
+{
+	uint64_t                connectionId = 0;       // 发出请求的连接
+	bool                    broadcast = false;
+	uint8_t                 header[MBAP_LENGTH];    // 原请求的 MBAP 头，响应沿用事务标识和单元标识
+	uint8_t                 frame[1 + MODBUS_MAX_PDU_LENGTH];  // 从站地址 + PDU
+	size_t                  length = 0;
+	uint8_t                 response[MBAP_LENGTH + MODBUS_MAX_PDU_LENGTH];
+	size_t                  responseLength = 0;
+	std::chrono::steady_clock::time_point enqueued;
+};
+
+ModbusCppRtuGateway::ModbusCppRtuGateway()
+	: m_responseTimeoutMs(RESPONSE_TIMEOUT_MS_DEFAULT)
+	, m_broadcastDelayMs(BROADCAST_DELAY_MS_DEFAULT)
+	, m_queueLimit(QUEUE_LIMIT_DEFAULT)
+	, m_maxConnections(MBAP_MAX_CONNECTIONS_DEFAULT)
+	, m_listenContext(NULL)
+	, m_listenSocket(-1)
+	, m_running(false)
+	, m_nextConnectionId(1)
+	, m_connectionsCount(0)
+	, m_acceptor(new ModbusCppMbapAcceptor())
+	, m_counters(new ModbusCppMbapCounters())
+	, m_requests(0)
+	, m_unroutable(0)
+{
+	m_routes.fill(-1);
+}
+
+ModbusCppRtuGateway::~ModbusCppRtuGateway()
+{
+	stop();
+	for (Bus *_bus : m_buses)
+	{
+		delete _bus;
+	}
+	delete m_acceptor;
+	delete m_counters;
+}
+
+int ModbusCppRtuGateway::addBus(const ModbusCppSerialConfig& config, const uint8_t firstUnit, const uint8_t lastUnit)
+{
+	if (m_running || config.device.empty() || config.baud <= 0 || 0 == firstUnit || firstUnit > lastUnit)
+	{
+		return -1;
+	}
+	for (int _unit = firstUnit; _unit <= lastUnit; ++_unit)
+	{
+		if (-1 != m_routes[_unit])
+		{
+			return -1;
+		}
+	}
+
+	const int _index = static_cast<int>(m_buses.size());
+	m_buses.push_back(new Bus(config));
+	for (int _unit = firstUnit; _unit <= lastUnit; ++_unit)
+	{
+		m_routes[_unit] = _index;
+	}
+	return _index;
+}
+
+void ModbusCppRtuGateway::setResponseTimeout(const uint32_t msec)
+{
+	if (!m_running && msec > 0)
+	{
+		m_responseTimeoutMs = msec;
+	}
+}
+
+void ModbusCppRtuGateway::setBroadcastDelay(const uint32_t msec)
+{
+	if (!m_running)
+	{
+		m_broadcastDelayMs = msec;
+	}
+}
+
+void ModbusCppRtuGateway::setQueueLimit(const size_t limit)
+{
+	if (!m_running && limit > 0)
+	{
+		m_queueLimit = limit;
+	}
+}
+
+void ModbusCppRtuGateway::setMaxConnections(const size_t maxConnections)
+{
+	if (!m_running)
+	{
+		m_maxConnections = maxConnections;
+	}
+}
+
+bool ModbusCppRtuGateway::start(const std::string& host, const uint16_t port)
+{
+	if (m_running || m_buses.empty() || host.empty())
+	{
+		return false;
+	}
+
+	for (Bus *_bus : m_buses)
+	{
+		const ModbusCppSerialConfig& _config = _bus->config;
+		_bus->context = modbus_new_rtu(_config.device.c_str(), _config.baud, _config.parity, _config.dataBits, _config.stopBits);
+		if (NULL == _bus->context
+			|| 0 != modbus_set_response_timeout(_bus->context, m_responseTimeoutMs / 1000, (m_responseTimeoutMs % 1000) * 1000)
+			|| -1 == modbus_connect(_bus->context))
+		{
+			std::cout << "open " << _config.device << " failed: " << modbus_strerror(errno) << std::endl;
+			release();
+			return false;
+		}
+	}
+
+	m_listenContext = modbus_new_tcp(host.c_str(), port);
+	if (NULL == m_listenContext)
+	{
+		release();
+		return false;
+	}
+	m_listenSocket = modbus_tcp_listen(m_listenContext, MBAP_LISTEN_BACKLOG);
+	if (-1 == m_listenSocket || !socketSetNonBlocking(m_listenSocket) || !m_reactor.open()
+		|| !m_reactor.addSocket(m_listenSocket, ModbusCppReactor::READABLE, [this](const uint32_t) { acceptConnections(); }))
+	{
+		std::cout << "listen failed: " << modbus_strerror(errno) << std::endl;
+		release();
+		return false;
+	}
+
+	m_running = true;
+	m_startTime = std::chrono::steady_clock::now();
+	for (Bus *_bus : m_buses)
+	{
+		_bus->idleSince = m_startTime;
+		_bus->thread = std::thread(&ModbusCppRtuGateway::busThread, this, _bus);
+	}
+	m_thread = std::thread(&ModbusCppRtuGateway::reactorThread, this);
+	return true;
+}
+
+void ModbusCppRtuGateway::stop()
+{
+	if (!m_running)
+	{
+		return;
+	}
+
+	// 先停总线线程(最多等当前请求超时)，它们完成请求时还会唤醒事件循环
+	m_running = false;
+	for (Bus *_bus : m_buses)
+	{
+		_bus->queueLock.lock();
+		_bus->queueLock.unlock();
+		_bus->queueCondition.notify_all();
+	}
+	for (Bus *_bus : m_buses)
+	{
+		if (_bus->thread.joinable())
+		{
+			_bus->thread.join();
+		}
+	}
+	m_reactor.wakeup();
+	if (m_thread.joinable())
+	{
+		m_thread.join();
+	}
+	release();
+}
+
+// 所有线程都已退出(或还没启动)，清理连接、队列和串口
+void ModbusCppRtuGateway::release()
+{
+	while (!m_connections.empty())
+	{
+		closeConnection(m_connections.begin()->second);
+	}
+	if (-1 != m_listenSocket)
+	{
+		m_reactor.removeSocket(m_listenSocket);
+		socketClose(m_listenSocket);
+		m_listenSocket = -1;
+	}
+	m_reactor.close();
+	if (NULL != m_listenContext)
+	{
+		modbus_free(m_listenContext);
+		m_listenContext = NULL;
+	}
+
+	for (Request *_request : m_completed)
+	{
+		delete _request;
+	}
+	m_completed.clear();
+
+	for (Bus *_bus : m_buses)
+	{
+		for (Request *_request : _bus->queue)
+		{
+			delete _request;
+		}
+		_bus->queue.clear();
+		_bus->queueDepth = 0;
+		if (NULL != _bus->context)
+		{
+			modbus_close(_bus->context);
+			modbus_free(_bus->context);
+			_bus->context = NULL;
+		}
+	}
+}
+
+bool ModbusCppRtuGateway::isRunning() const
+{
+	return m_running;
+}
+
+ModbusCppGatewayStatistics ModbusCppRtuGateway::getStatistics() const
+{
+	ModbusCppGatewayStatistics _statistics;
+	_statistics.connections = m_connectionsCount.load(std::memory_order_relaxed);
+	_statistics.connectionsAccepted = m_counters->connectionsAccepted.load(std::memory_order_relaxed);
+	_statistics.connectionsRejected = m_counters->connectionsRejected.load(std::memory_order_relaxed);
+	_statistics.requests = m_requests.load(std::memory_order_relaxed);
+	_statistics.unroutable = m_unroutable.load(std::memory_order_relaxed);
+	_statistics.protocolErrors = m_counters->protocolErrors.load(std::memory_order_relaxed);
+
+	const uint64_t _elapsedUsec = m_running ? elapsedUsec(m_startTime, std::chrono::steady_clock::now()) : 0;
+	for (const Bus *_bus : m_buses)
+	{
+		ModbusCppGatewayBusStatistics _busStatistics;
+		_busStatistics.device = _bus->config.device;
+		_busStatistics.requests = _bus->requests.load(std::memory_order_relaxed);
+		_busStatistics.broadcasts = _bus->broadcasts.load(std::memory_order_relaxed);
+		_busStatistics.timeouts = _bus->timeouts.load(std::memory_order_relaxed);
+		_busStatistics.errors = _bus->errors.load(std::memory_order_relaxed);
+		_busStatistics.rejected = _bus->rejected.load(std::memory_order_relaxed);
+		_busStatistics.queueDepth = _bus->queueDepth.load(std::memory_order_relaxed);
+		_busStatistics.queueDepthMax = _bus->queueDepthMax.load(std::memory_order_relaxed);
+		_busStatistics.busyUsec = _bus->busyUsec.load(std::memory_order_relaxed);
+		_busStatistics.utilization = _elapsedUsec > 0 ? std::min(1.0, static_cast<double>(_busStatistics.busyUsec) / _elapsedUsec) : 0;
+		_busStatistics.queueWait = _bus->queueWait.snapshot();
+		_busStatistics.transaction = _bus->transaction.snapshot();
+		_statistics.buses.push_back(_busStatistics);
+	}
+	return _statistics;
+}
+
+void ModbusCppRtuGateway::reactorThread()
+{
+	while (m_running)
+	{
+		if (m_reactor.runOnce(-1) < 0)
+		{
+			std::cout << "reactor error" << std::endl;
+			break;
+		}
+		deliverResponses();
+	}
+}
+
+// 总线线程: 按到达顺序逐个执行，同一时刻总线上只有一个请求
+void ModbusCppRtuGateway::busThread(Bus *bus)
+{
+	while (true)
+	{
+		Request *_request = NULL;
+		{
+			std::unique_lock<std::mutex> _lock(bus->queueLock);
+			bus->queueCondition.wait(_lock, [this, bus] { return !m_running || !bus->queue.empty(); });
+			if (!m_running)
+			{
+				return;
+			}
+			_request = bus->queue.front();
+			bus->queue.pop_front();
+			bus->queueDepth = bus->queue.size();
+		}
+
+		bus->queueWait.record(elapsedUsec(_request->enqueued, std::chrono::steady_clock::now()));
+		execute(bus, _request);
+		complete(_request);
+	}
+}
+
+void ModbusCppRtuGateway::execute(Bus *bus, Request *request)
+{
+	// 与上一帧之间至少间隔 3.5 个字符
+	const uint32_t _gapUsec = bus->config.frameGapUsec();
+	std::this_thread::sleep_until(bus->idleSince + std::chrono::microseconds(_gapUsec));
+
+	const uint8_t _unit = request->frame[0];
+	const uint8_t _function = request->frame[1];
+	const auto _start = std::chrono::steady_clock::now();
+	bus->requests.fetch_add(1, std::memory_order_relaxed);
+
+	uint8_t _exception = 0;
+	modbus_set_slave(bus->context, _unit);
+	if (-1 == modbus_send_raw_request(bus->context, request->frame, static_cast<int>(request->length)))
+	{
+		bus->errors.fetch_add(1, std::memory_order_relaxed);
+		_exception = MODBUS_EXCEPTION_GATEWAY_TARGET;
+	}
+	else if (request->broadcast)
+	{
+		// 广播没有响应，等从站处理完再发下一帧
+		bus->broadcasts.fetch_add(1, std::memory_order_relaxed);
+		std::this_thread::sleep_for(std::chrono::milliseconds(m_broadcastDelayMs));
+	}
+	else
+	{
+		// 从站地址 + PDU + CRC
+		uint8_t _response[MODBUS_RTU_MAX_ADU_LENGTH];
+		const int _length = modbus_receive_confirmation(bus->context, _response);
+		if (-1 == _length)
+		{
+			if (ETIMEDOUT == errno)
+			{
+				bus->timeouts.fetch_add(1, std::memory_order_relaxed);
+			}
+			else
+			{
+				bus->errors.fetch_add(1, std::memory_order_relaxed);
+			}
+			// 丢掉半帧，避免和下一个响应粘在一起
+			modbus_flush(bus->context);
+			_exception = MODBUS_EXCEPTION_GATEWAY_TARGET;
+		}
+		else if (_length < 5 || _response[0] != _unit || (_response[1] & 0x7F) != _function)
+		{
+			bus->errors.fetch_add(1, std::memory_order_relaxed);
+			modbus_flush(bus->context);
+			_exception = MODBUS_EXCEPTION_GATEWAY_TARGET;
+		}
+		else
+		{
+			const size_t _pduLength = _length - 3;
+			memcpy(request->response + MBAP_LENGTH, _response + 1, _pduLength);
+			request->responseLength = MBAP_LENGTH + _pduLength;
+		}
+	}
+
+	const auto _end = std::chrono::steady_clock::now();
+	bus->idleSince = _end;
+	bus->transaction.record(elapsedUsec(_start, _end));
+	bus->busyUsec.fetch_add(elapsedUsec(_start, _end) + _gapUsec, std::memory_order_relaxed);
+
+	if (0 != _exception)
+	{
+		request->response[MBAP_LENGTH] = _function | 0x80;
+		request->response[MBAP_LENGTH + 1] = _exception;
+		request->responseLength = MBAP_LENGTH + 2;
+	}
+	memcpy(request->response, request->header, MBAP_LENGTH);
+	request->response[4] = static_cast<uint8_t>((request->responseLength - MBAP_LENGTH + 1) >> 8);
+	request->response[5] = static_cast<uint8_t>((request->responseLength - MBAP_LENGTH + 1) & 0xFF);
+}
+
+// 总线线程调用: 交给事件循环线程发送，广播没有响应直接释放
+void ModbusCppRtuGateway::complete(Request *request)
+{
+	if (request->broadcast)
+	{
+		delete request;
+		return;
+	}
+
+	m_completedLock.lock();
+	m_completed.push_back(request);
+	m_completedLock.unlock();
+	m_reactor.wakeup();
+}
+
+// 事件循环线程: 把总线线程完成的响应追加到对应连接，连接已经关闭的直接丢弃
+void ModbusCppRtuGateway::deliverResponses()
+{
+	std::vector<Request *> _completed;
+	m_completedLock.lock();
+	_completed.swap(m_completed);
+	m_completedLock.unlock();
+
+	for (Request *_request : _completed)
+	{
+		auto _it = m_connections.find(_request->connectionId);
+		if (_it != m_connections.end())
+		{
+			Connection *_connection = _it->second;
+			_connection->output.insert(_connection->output.end(), _request->response, _request->response + _request->responseLength);
+			if (_connection->flush(*m_counters))
+			{
+				_connection->updateEvents(m_reactor);
+			}
+			else
+			{
+				closeConnection(_connection);
+			}
+		}
+		delete _request;
+	}
+}
+
+void ModbusCppRtuGateway::acceptConnections()
+{
+	m_acceptor->acceptConnections(m_listenSocket, *m_counters, [this](const int socket) { acceptConnection(socket); });
+}
+
+void ModbusCppRtuGateway::acceptConnection(const int socket)
+{
+	if (m_connections.size() >= m_maxConnections)
+	{
+		socketClose(socket);
+		m_counters->connectionsRejected.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	socketSetNoDelay(socket);
+
+	Connection *_connection = new Connection();
+	_connection->id = m_nextConnectionId++;
+	_connection->socket = socket;
+	_connection->events = ModbusCppReactor::READABLE;
+	if (!m_reactor.addSocket(socket, _connection->events, [this, _connection](const uint32_t events) { onConnectionEvent(_connection, events); }))
+	{
+		socketClose(socket);
+		delete _connection;
+		return;
+	}
+
+	m_connections.emplace(_connection->id, _connection);
+	m_connectionsCount = m_connections.size();
+	m_counters->connectionsAccepted.fetch_add(1, std::memory_order_relaxed);
+}
+
+// 拆出完整的请求放入对应总线的队列，不能转发的请求直接回复异常
+// 对端关闭或出错时关闭连接，已经排队的请求照常执行，响应丢弃
+void ModbusCppRtuGateway::onConnectionEvent(Connection *connection, const uint32_t events)
+{
+	if (!connection->onEvents(events, m_reactor, *m_counters, [this, connection](const uint8_t *frame, const size_t length) {
+		m_requests.fetch_add(1, std::memory_order_relaxed);
+		route(connection, frame, length);
+		}))
+	{
+		closeConnection(connection);
+	}
+}
+
+void ModbusCppRtuGateway::route(Connection *connection, const uint8_t *frame, const size_t length)
+{
+	const uint8_t _unit = frame[MBAP_LENGTH - 1];
+	const bool _broadcast = MODBUS_BROADCAST_ADDRESS == _unit;
+	if ((_broadcast && !isWriteFunction(frame[MBAP_LENGTH])) || (!_broadcast && -1 == m_routes[_unit]))
+	{
+		m_unroutable.fetch_add(1, std::memory_order_relaxed);
+		replyException(connection, frame, MODBUS_EXCEPTION_GATEWAY_PATH);
+		return;
+	}
+
+	const auto _now = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < m_buses.size(); ++i)
+	{
+		if (!_broadcast && static_cast<int>(i) != m_routes[_unit])
+		{
+			continue;
+		}
+
+		Bus *_bus = m_buses[i];
+		Request *_request = new Request();
+		_request->connectionId = connection->id;
+		_request->broadcast = _broadcast;
+		memcpy(_request->header, frame, MBAP_LENGTH);
+		_request->length = length - (MBAP_LENGTH - 1);
+		memcpy(_request->frame, frame + MBAP_LENGTH - 1, _request->length);
+		_request->enqueued = _now;
+
+		std::unique_lock<std::mutex> _lock(_bus->queueLock);
+		if (_bus->queue.size() >= m_queueLimit)
+		{
+			_lock.unlock();
+			delete _request;
+			_bus->rejected.fetch_add(1, std::memory_order_relaxed);
+			if (!_broadcast)
+			{
+				replyException(connection, frame, MODBUS_EXCEPTION_SLAVE_OR_SERVER_BUSY);
+			}
+			continue;
+		}
+		_bus->queue.push_back(_request);
+		const size_t _depth = _bus->queue.size();
+		_lock.unlock();
+		_bus->queueCondition.notify_one();
+
+		_bus->queueDepth = _depth;
+		if (_depth > _bus->queueDepthMax)
+		{
+			_bus->queueDepthMax = _depth;
+		}
+	}
+}
+
+void ModbusCppRtuGateway::replyException(Connection *connection, const uint8_t *frame, const uint8_t exception)
+{
+	const size_t _offset = connection->output.size();
+	connection->output.resize(_offset + MBAP_LENGTH + 2);
+	uint8_t *_response = connection->output.data() + _offset;
+	memcpy(_response, frame, MBAP_LENGTH);
+	_response[4] = 0;
+	_response[5] = 3;
+	_response[MBAP_LENGTH] = frame[MBAP_LENGTH] | 0x80;
+	_response[MBAP_LENGTH + 1] = exception;
+}
+
+void ModbusCppRtuGateway::closeConnection(Connection *connection)
+{
+	m_reactor.removeSocket(connection->socket);
+	socketClose(connection->socket);
+	m_connections.erase(connection->id);
+	m_connectionsCount = m_connections.size();
+	delete connection;
+}
@@ -0,0 +1,723 @@
+﻿#include "ModbusCppRtuScheduler.h"
+#include "modbus.h"
+#include <iostream>
+#include <algorithm>
+
+static const uint32_t RESPONSE_TIMEOUT_MS_DEFAULT = 200;
+static const uint32_t OFFLINE_THRESHOLD_DEFAULT = 3;
+static const uint32_t BACKOFF_INITIAL_MS_DEFAULT = 1000;
+static const uint32_t BACKOFF_MAX_MS_DEFAULT = 30000;
+static const uint32_t BROADCAST_DELAY_MS_DEFAULT = 100;
+// 相邻扫描项之间不超过这么多地址的空洞一起读: 多读几个寄存器比多一帧(帧间隔 + 请求 + 从站响应时间)便宜得多
+static const uint16_t MERGE_HOLE_MAX = 8;
+
+struct ModbusCppRtuScheduler::SlaveState
+{
+	uint8_t                 slave = 0;
+	std::atomic<bool>       online{ true };
+	uint32_t                consecutiveFailures = 0;
+	std::chrono::milliseconds backoff{ 0 };
+	std::chrono::steady_clock::time_point retryAt;
+	ScanRequest             *probe = NULL;      // 离线时用来探测的请求(该从站的第一个请求)
+
+	std::atomic<uint64_t>   polls{ 0 };
+	std::atomic<uint64_t>   failures{ 0 };
+	std::atomic<uint64_t>   exceptions{ 0 };
+	std::atomic<uint64_t>   probes{ 0 };
+	ModbusCppLatencyHistogram cycle;
+	ModbusCppLatencyHistogram lateness;
+};
+
+// 合并后实际发到总线上的读请求
+struct ModbusCppRtuScheduler::ScanRequest
+{
+	uint8_t                 slave = 0;
+	Table                   table = Table::HOLDING_REGISTERS;
+	uint16_t                startAddress = 0;
+	uint16_t                count = 0;
+	std::chrono::milliseconds period{ 0 };
+	std::chrono::steady_clock::time_point due;          // 下一次计划开始的时间
+	std::chrono::steady_clock::time_point lastSuccess;  // 上一次成功读取的开始时间
+	bool                    succeeded = false;
+	std::vector<size_t>     items;                      // 覆盖的扫描项(m_items 下标)
+	SlaveState              *state = NULL;
+};
+
+static uint64_t durationUsec(const std::chrono::steady_clock::duration& duration)
+{
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(duration).count());
+}
+
+static bool isBitTable(const ModbusCppRegisterMap::Table table)
+{
+	return ModbusCppRegisterMap::Table::COILS == table || ModbusCppRegisterMap::Table::DISCRETE_INPUTS == table;
+}
+
+ModbusCppRtuScheduler::ModbusCppRtuScheduler()
+	: m_offlineThreshold(OFFLINE_THRESHOLD_DEFAULT)
+	, m_broadcastDelayMs(BROADCAST_DELAY_MS_DEFAULT)
+	, m_broadcastCoalescing(true)
+	, m_verifyBroadcasts(false)
+	, m_backoffInitial(BACKOFF_INITIAL_MS_DEFAULT)
+	, m_backoffMax(BACKOFF_MAX_MS_DEFAULT)
+	, m_running(false)
+	, m_scanRequestCount(0)
+	, m_requestsCount(0)
+	, m_writesCount(0)
+	, m_writeFailures(0)
+	, m_broadcastsCount(0)
+	, m_verificationsCount(0)
+	, m_verifyMismatches(0)
+	, m_busyUsec(0)
+{
+	m_client.setResponseTimeout(RESPONSE_TIMEOUT_MS_DEFAULT);
+	m_client.setBroadcastDelay(BROADCAST_DELAY_MS_DEFAULT);
+}
+
+ModbusCppRtuScheduler::~ModbusCppRtuScheduler()
+{
+	stop();
+	clearRequests();
+}
+
+bool ModbusCppRtuScheduler::addScan(const uint8_t slave, const Table table, const uint16_t startAddress, const uint16_t count, const uint32_t periodMs)
+{
+	const uint16_t _countMax = isBitTable(table) ? MODBUS_MAX_READ_BITS : MODBUS_MAX_READ_REGISTERS;
+	if (m_running || 0 == slave || slave > 247 || 0 == count || count > _countMax || 0 == periodMs || uint32_t(startAddress) + count > 0x10000)
+	{
+		return false;
+	}
+
+	m_items.push_back({ slave, table, startAddress, count, periodMs });
+	return true;
+}
+
+void ModbusCppRtuScheduler::setResponseTimeout(const uint32_t msec)
+{
+	if (!m_running)
+	{
+		m_client.setResponseTimeout(msec);
+	}
+}
+
+void ModbusCppRtuScheduler::setOfflineThreshold(const uint32_t failures)
+{
+	if (!m_running && failures > 0)
+	{
+		m_offlineThreshold = failures;
+	}
+}
+
+void ModbusCppRtuScheduler::setBackoff(const uint32_t initialMs, const uint32_t maxMs)
+{
+	if (!m_running && initialMs > 0 && maxMs >= initialMs)
+	{
+		m_backoffInitial = std::chrono::milliseconds(initialMs);
+		m_backoffMax = std::chrono::milliseconds(maxMs);
+	}
+}
+
+void ModbusCppRtuScheduler::setBroadcastDelay(const uint32_t msec)
+{
+	if (!m_running)
+	{
+		m_broadcastDelayMs = msec;
+		m_client.setBroadcastDelay(msec);
+	}
+}
+
+void ModbusCppRtuScheduler::setBroadcastCoalescing(const bool enabled)
+{
+	if (!m_running)
+	{
+		m_broadcastCoalescing = enabled;
+	}
+}
+
+void ModbusCppRtuScheduler::setVerifyBroadcasts(const bool enabled)
+{
+	if (!m_running)
+	{
+		m_verifyBroadcasts = enabled;
+	}
+}
+
+void ModbusCppRtuScheduler::setDataCallback(const DataCallback callback)
+{
+	if (!m_running)
+	{
+		m_dataCallback = callback;
+	}
+}
+
+void ModbusCppRtuScheduler::setWriteCallback(const WriteCallback callback)
+{
+	if (!m_running)
+	{
+		m_writeCallback = callback;
+	}
+}
+
+void ModbusCppRtuScheduler::setVerifyCallback(const VerifyCallback callback)
+{
+	if (!m_running)
+	{
+		m_verifyCallback = callback;
+	}
+}
+
+bool ModbusCppRtuScheduler::start(const ModbusCppSerialConfig& config)
+{
+	if (m_running)
+	{
+		return true;
+	}
+
+	if (!m_client.open(config))
+	{
+		std::cout << "open serial port " << config.device << " failed" << std::endl;
+		return false;
+	}
+
+	m_config = config;
+	buildRequests();
+	m_client.resetStatistics();
+	m_requestsCount = 0;
+	m_writesCount = 0;
+	m_writeFailures = 0;
+	m_broadcastsCount = 0;
+	m_verificationsCount = 0;
+	m_verifyMismatches = 0;
+	m_busyUsec = 0;
+	m_verifications.clear();
+	m_startTime = std::chrono::steady_clock::now();
+	m_running = true;
+	m_thread = std::thread(&ModbusCppRtuScheduler::schedulerThread, this);
+	return true;
+}
+
+void ModbusCppRtuScheduler::stop()
+{
+	if (!m_running)
+	{
+		return;
+	}
+
+	m_lock.lock();
+	m_running = false;
+	m_writes.clear();
+	m_lock.unlock();
+	m_condition.notify_one();
+	if (m_thread.joinable())
+	{
+		m_thread.join();
+	}
+	m_client.close();
+}
+
+bool ModbusCppRtuScheduler::isRunning() const
+{
+	return m_running;
+}
+
+bool ModbusCppRtuScheduler::writeRegisters(const uint8_t slave, const uint16_t startAddress, const std::vector<uint16_t>& values)
+{
+	if (0 == slave || slave > 247 || values.empty() || values.size() > MODBUS_MAX_WRITE_REGISTERS || startAddress + values.size() > 0x10000)
+	{
+		return false;
+	}
+
+	{
+		std::lock_guard<std::mutex> _lock(m_lock);
+		if (!m_running)
+		{
+			return false;
+		}
+		m_writes.push_back({ slave, startAddress, values });
+	}
+	m_condition.notify_one();
+	return true;
+}
+
+bool ModbusCppRtuScheduler::broadcastRegisters(const uint16_t startAddress, const std::vector<uint16_t>& values)
+{
+	if (values.empty() || values.size() > MODBUS_MAX_WRITE_REGISTERS || startAddress + values.size() > 0x10000)
+	{
+		return false;
+	}
+
+	{
+		std::lock_guard<std::mutex> _lock(m_lock);
+		if (!m_running)
+		{
+			return false;
+		}
+		m_writes.push_back({ MODBUS_BROADCAST_ADDRESS, startAddress, values });
+	}
+	m_condition.notify_one();
+	return true;
+}
+
+ModbusCppRtuSchedulerStatistics ModbusCppRtuScheduler::getStatistics() const
+{
+	ModbusCppRtuSchedulerStatistics _statistics;
+	_statistics.requests = m_requestsCount;
+	_statistics.writes = m_writesCount;
+	_statistics.writeFailures = m_writeFailures;
+	_statistics.broadcasts = m_broadcastsCount;
+	_statistics.verifications = m_verificationsCount;
+	_statistics.verifyMismatches = m_verifyMismatches;
+	_statistics.scanRequests = m_scanRequestCount;
+	_statistics.busyUsec = m_busyUsec;
+	const uint64_t _elapsed = durationUsec(std::chrono::steady_clock::now() - m_startTime);
+	_statistics.utilization = 0 == _elapsed ? 0 : static_cast<double>(_statistics.busyUsec) / static_cast<double>(_elapsed);
+
+	// m_slaves 只在 start() 中重建，运行期间只读
+	for (const auto& _slave : m_slaves)
+	{
+		ModbusCppRtuSlaveStatistics _slaveStatistics;
+		_slaveStatistics.slave = _slave.first;
+		_slaveStatistics.online = _slave.second->online;
+		_slaveStatistics.polls = _slave.second->polls;
+		_slaveStatistics.failures = _slave.second->failures;
+		_slaveStatistics.exceptions = _slave.second->exceptions;
+		_slaveStatistics.probes = _slave.second->probes;
+		_slaveStatistics.cycle = _slave.second->cycle.snapshot();
+		_slaveStatistics.lateness = _slave.second->lateness.snapshot();
+		_statistics.slaves.push_back(_slaveStatistics);
+	}
+	_statistics.client = m_client.getStatistics();
+	return _statistics;
+}
+
+void ModbusCppRtuScheduler::clearRequests()
+{
+	for (ScanRequest *_request : m_requests)
+	{
+		delete _request;
+	}
+	m_requests.clear();
+	for (auto& _slave : m_slaves)
+	{
+		delete _slave.second;
+	}
+	m_slaves.clear();
+}
+
+// 把扫描项合并成请求: 同一从站、同一数据表、同一周期的扫描项按地址排序，空洞不超过 MERGE_HOLE_MAX 且总长度不超过单帧上限时合并
+void ModbusCppRtuScheduler::buildRequests()
+{
+	clearRequests();
+
+	std::vector<size_t> _order(m_items.size());
+	for (size_t i = 0; i < _order.size(); ++i)
+	{
+		_order[i] = i;
+	}
+	std::sort(_order.begin(), _order.end(), [this](const size_t a, const size_t b) {
+		const ScanItem& _a = m_items[a];
+		const ScanItem& _b = m_items[b];
+		if (_a.slave != _b.slave)
+		{
+			return _a.slave < _b.slave;
+		}
+		if (_a.table != _b.table)
+		{
+			return _a.table < _b.table;
+		}
+		if (_a.periodMs != _b.periodMs)
+		{
+			return _a.periodMs < _b.periodMs;
+		}
+		return _a.startAddress < _b.startAddress;
+	});
+
+	const std::chrono::steady_clock::time_point _now = std::chrono::steady_clock::now();
+	ScanRequest *_current = NULL;
+	for (const size_t _index : _order)
+	{
+		const ScanItem& _item = m_items[_index];
+		const uint32_t _countMax = isBitTable(_item.table) ? MODBUS_MAX_READ_BITS : MODBUS_MAX_READ_REGISTERS;
+		if (NULL != _current && _current->slave == _item.slave && _current->table == _item.table && _current->period.count() == _item.periodMs)
+		{
+			const uint32_t _end = uint32_t(_current->startAddress) + _current->count;
+			const uint32_t _itemEnd = uint32_t(_item.startAddress) + _item.count;
+			if (_item.startAddress <= _end + MERGE_HOLE_MAX && std::max(_end, _itemEnd) - _current->startAddress <= _countMax)
+			{
+				_current->count = static_cast<uint16_t>(std::max(_end, _itemEnd) - _current->startAddress);
+				_current->items.push_back(_index);
+				continue;
+			}
+		}
+
+		_current = new ScanRequest();
+		_current->slave = _item.slave;
+		_current->table = _item.table;
+		_current->startAddress = _item.startAddress;
+		_current->count = _item.count;
+		_current->period = std::chrono::milliseconds(_item.periodMs);
+		_current->due = _now;
+		_current->items.push_back(_index);
+
+		SlaveState *& _state = m_slaves[_item.slave];
+		if (NULL == _state)
+		{
+			_state = new SlaveState();
+			_state->slave = _item.slave;
+			_state->probe = _current;
+		}
+		_current->state = _state;
+		m_requests.push_back(_current);
+	}
+	m_scanRequestCount = m_requests.size();
+}
+
+// 合并读取时空洞里的地址在从站上不存在，拆回原来的扫描项
+void ModbusCppRtuScheduler::splitRequest(ScanRequest *request)
+{
+	std::cout << "slave " << int(request->slave) << " rejected merged read at " << request->startAddress << " x " << request->count << ", splitting" << std::endl;
+
+	std::vector<ScanRequest *> _parts;
+	for (const size_t _index : request->items)
+	{
+		const ScanItem& _item = m_items[_index];
+		ScanRequest *_part = new ScanRequest();
+		_part->slave = _item.slave;
+		_part->table = _item.table;
+		_part->startAddress = _item.startAddress;
+		_part->count = _item.count;
+		_part->period = request->period;
+		_part->due = request->due;
+		_part->items.push_back(_index);
+		_part->state = request->state;
+		_parts.push_back(_part);
+	}
+
+	if (request->state->probe == request)
+	{
+		request->state->probe = _parts.front();
+	}
+	auto _position = std::find(m_requests.begin(), m_requests.end(), request);
+	_position = m_requests.erase(_position);
+	m_requests.insert(_position, _parts.begin(), _parts.end());
+	m_scanRequestCount = m_requests.size();
+	delete request;
+}
+
+// 选出计划时间最早的请求(最早截止优先): 离线从站只参与探测，探测时间为退避结束的时间
+ModbusCppRtuScheduler::ScanRequest *ModbusCppRtuScheduler::nextRequest(std::chrono::steady_clock::time_point& due)
+{
+	ScanRequest *_next = NULL;
+	for (ScanRequest *_request : m_requests)
+	{
+		std::chrono::steady_clock::time_point _due = _request->due;
+		if (!_request->state->online)
+		{
+			if (_request->state->probe != _request)
+			{
+				continue;
+			}
+			_due = std::max(_due, _request->state->retryAt);
+		}
+		if (NULL == _next || _due < due)
+		{
+			_next = _request;
+			due = _due;
+		}
+	}
+	return _next;
+}
+
+void ModbusCppRtuScheduler::schedulerThread()
+{
+	std::unique_lock<std::mutex> _lock(m_lock);
+	while (m_running)
+	{
+		if (!m_writes.empty())
+		{
+			// 队首连续的广播一起取出合并，不越过中间的写请求，保证同一地址的写入顺序
+			std::vector<WriteRequest> _writes(1, m_writes.front());
+			m_writes.pop_front();
+			const bool _broadcast = MODBUS_BROADCAST_ADDRESS == _writes.front().slave;
+			while (_broadcast && m_broadcastCoalescing && !m_writes.empty() && MODBUS_BROADCAST_ADDRESS == m_writes.front().slave)
+			{
+				_writes.push_back(m_writes.front());
+				m_writes.pop_front();
+			}
+			_lock.unlock();
+			if (_broadcast)
+			{
+				executeBroadcasts(_writes);
+			}
+			else
+			{
+				executeWrite(_writes.front());
+			}
+			_lock.lock();
+			continue;
+		}
+
+		std::chrono::steady_clock::time_point _due;
+		ScanRequest *_request = nextRequest(_due);
+		if (!m_verifications.empty() && (NULL == _request || _due > std::chrono::steady_clock::now()))
+		{
+			// 回读校验的优先级最低，只用扫描请求之间的空闲时间
+			const Verification _verification = m_verifications.front();
+			m_verifications.pop_front();
+			_lock.unlock();
+			verify(_verification);
+			_lock.lock();
+			continue;
+		}
+		if (NULL == _request)
+		{
+			// 没有扫描项，只处理写请求
+			m_condition.wait(_lock);
+			continue;
+		}
+		if (_due > std::chrono::steady_clock::now())
+		{
+			// 等待期间有写请求或停止时提前醒来
+			m_condition.wait_until(_lock, _due);
+			continue;
+		}
+
+		_lock.unlock();
+		poll(_request, _due);
+		_lock.lock();
+	}
+}
+
+void ModbusCppRtuScheduler::poll(ScanRequest *request, const std::chrono::steady_clock::time_point& due)
+{
+	SlaveState *_state = request->state;
+	const bool _probe = !_state->online;
+	const std::chrono::steady_clock::time_point _start = std::chrono::steady_clock::now();
+	_state->polls.fetch_add(1, std::memory_order_relaxed);
+	_state->lateness.record(durationUsec(_start - due));
+	if (_probe)
+	{
+		_state->probes.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	std::vector<uint16_t> _values;
+	bool _succeeded = false;
+	if (isBitTable(request->table))
+	{
+		const std::optional<std::vector<bool>> _bits = Table::COILS == request->table
+			? m_client.readCoils(request->slave, request->startAddress, request->count)
+			: m_client.readDiscreteInputs(request->slave, request->startAddress, request->count);
+		if (_bits)
+		{
+			_values.assign(_bits->begin(), _bits->end());
+			_succeeded = true;
+		}
+	}
+	else
+	{
+		std::optional<std::vector<uint16_t>> _registers = Table::HOLDING_REGISTERS == request->table
+			? m_client.readHoldingRegisters(request->slave, request->startAddress, request->count)
+			: m_client.readInputRegisters(request->slave, request->startAddress, request->count);
+		if (_registers)
+		{
+			_values = std::move(*_registers);
+			_succeeded = true;
+		}
+	}
+	recordBusy(_start);
+
+	// 跳过已经错过的周期，保持原来的相位
+	const std::chrono::steady_clock::time_point _now = std::chrono::steady_clock::now();
+	request->due += request->period;
+	if (request->due <= _now)
+	{
+		request->due += ((_now - request->due) / request->period + 1) * request->period;
+	}
+
+	const ModbusCppRtuClient::Result _result = m_client.lastResult();
+	if (_succeeded || ModbusCppRtuClient::Result::EXCEPTION == _result)
+	{
+		// 异常响应也说明从站在线
+		_state->consecutiveFailures = 0;
+		if (!_state->online)
+		{
+			std::cout << "slave " << int(request->slave) << " back online" << std::endl;
+			_state->online = true;
+			_state->backoff = std::chrono::milliseconds(0);
+		}
+	}
+
+	if (!_succeeded)
+	{
+		if (ModbusCppRtuClient::Result::EXCEPTION == _result)
+		{
+			_state->exceptions.fetch_add(1, std::memory_order_relaxed);
+			if (MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS == m_client.lastException() && request->items.size() > 1)
+			{
+				splitRequest(request);
+			}
+			return;
+		}
+
+		_state->failures.fetch_add(1, std::memory_order_relaxed);
+		++_state->consecutiveFailures;
+		if (_state->online && _state->consecutiveFailures >= m_offlineThreshold)
+		{
+			std::cout << "slave " << int(request->slave) << " offline after " << _state->consecutiveFailures << " failures" << std::endl;
+			_state->online = false;
+			_state->backoff = m_backoffInitial;
+		}
+		else if (_probe)
+		{
+			_state->backoff = std::min(_state->backoff * 2, m_backoffMax);
+		}
+		if (!_state->online)
+		{
+			_state->retryAt = _now + _state->backoff;
+		}
+		return;
+	}
+
+	if (request->succeeded)
+	{
+		_state->cycle.record(durationUsec(_start - request->lastSuccess));
+	}
+	request->succeeded = true;
+	request->lastSuccess = _start;
+
+	if (m_dataCallback)
+	{
+		// 按原始扫描项分别回调，合并读取多出来的空洞不交给调用者
+		for (const size_t _index : request->items)
+		{
+			const ScanItem& _item = m_items[_index];
+			const size_t _offset = _item.startAddress - request->startAddress;
+			const std::vector<uint16_t> _slice(_values.begin() + _offset, _values.begin() + _offset + _item.count);
+			m_dataCallback(_item.slave, _item.table, _item.startAddress, _slice);
+		}
+	}
+}
+
+void ModbusCppRtuScheduler::executeWrite(const WriteRequest& write)
+{
+	const std::chrono::steady_clock::time_point _start = std::chrono::steady_clock::now();
+	const bool _succeeded = m_client.writeRegisters(write.slave, write.startAddress, write.values);
+	recordBusy(_start);
+
+	m_writesCount.fetch_add(1, std::memory_order_relaxed);
+	if (_succeeded)
+	{
+		updateVerifications(write.slave, write.startAddress, write.values);
+	}
+	else
+	{
+		m_writeFailures.fetch_add(1, std::memory_order_relaxed);
+	}
+	if (m_writeCallback)
+	{
+		m_writeCallback(write.slave, write.startAddress, _succeeded);
+	}
+}
+
+// 合并后按连续地址分段广播，每段最多 123 个寄存器
+void ModbusCppRtuScheduler::executeBroadcasts(const std::vector<WriteRequest>& broadcasts)
+{
+	std::map<uint16_t, uint16_t> _values;
+	for (const WriteRequest& _broadcast : broadcasts)
+	{
+		for (size_t i = 0; i < _broadcast.values.size(); ++i)
+		{
+			_values[static_cast<uint16_t>(_broadcast.startAddress + i)] = _broadcast.values[i];
+		}
+	}
+
+	bool _sent = true;
+	auto _iterator = _values.begin();
+	while (_iterator != _values.end())
+	{
+		const uint16_t _startAddress = _iterator->first;
+		std::vector<uint16_t> _run;
+		while (_iterator != _values.end() && _iterator->first == _startAddress + _run.size() && _run.size() < MODBUS_MAX_WRITE_REGISTERS)
+		{
+			_run.push_back(_iterator->second);
+			++_iterator;
+		}
+
+		// 调用立即返回，总线实际被占用的是帧传输时间加上广播延时
+		const bool _succeeded = m_client.writeRegisters(MODBUS_BROADCAST_ADDRESS, _startAddress, _run);
+		m_requestsCount.fetch_add(1, std::memory_order_relaxed);
+		if (!_succeeded)
+		{
+			m_writeFailures.fetch_add(1, std::memory_order_relaxed);
+			_sent = false;
+			continue;
+		}
+		m_broadcastsCount.fetch_add(1, std::memory_order_relaxed);
+		m_busyUsec.fetch_add(m_config.frameGapUsec() + m_config.frameUsec(9 + _run.size() * 2) + uint64_t(m_broadcastDelayMs) * 1000, std::memory_order_relaxed);
+
+		updateVerifications(MODBUS_BROADCAST_ADDRESS, _startAddress, _run);
+		if (m_verifyBroadcasts)
+		{
+			for (const auto& _slave : m_slaves)
+			{
+				m_verifications.push_back({ _slave.first, _startAddress, _run });
+			}
+		}
+	}
+
+	if (m_writeCallback)
+	{
+		for (const WriteRequest& _broadcast : broadcasts)
+		{
+			m_writeCallback(MODBUS_BROADCAST_ADDRESS, _broadcast.startAddress, _sent);
+		}
+	}
+}
+
+// 之后的写入覆盖了等待校验的寄存器时，改为校验新值
+void ModbusCppRtuScheduler::updateVerifications(const uint8_t slave, const uint16_t startAddress, const std::vector<uint16_t>& values)
+{
+	const uint32_t _end = uint32_t(startAddress) + values.size();
+	for (Verification& _verification : m_verifications)
+	{
+		if (MODBUS_BROADCAST_ADDRESS != slave && _verification.slave != slave)
+		{
+			continue;
+		}
+		const uint32_t _first = std::max<uint32_t>(startAddress, _verification.startAddress);
+		const uint32_t _last = std::min<uint32_t>(_end, uint32_t(_verification.startAddress) + _verification.values.size());
+		for (uint32_t _address = _first; _address < _last; ++_address)
+		{
+			_verification.values[_address - _verification.startAddress] = values[_address - startAddress];
+		}
+	}
+}
+
+void ModbusCppRtuScheduler::verify(const Verification& verification)
+{
+	bool _matched = false;
+	if (m_slaves.at(verification.slave)->online)
+	{
+		const std::chrono::steady_clock::time_point _start = std::chrono::steady_clock::now();
+		const std::optional<std::vector<uint16_t>> _values = m_client.readHoldingRegisters(verification.slave, verification.startAddress, static_cast<uint16_t>(verification.values.size()));
+		recordBusy(_start);
+		_matched = _values && *_values == verification.values;
+	}
+
+	// 离线从站不回读，直接算作校验失败
+	m_verificationsCount.fetch_add(1, std::memory_order_relaxed);
+	if (!_matched)
+	{
+		m_verifyMismatches.fetch_add(1, std::memory_order_relaxed);
+	}
+	if (m_verifyCallback)
+	{
+		m_verifyCallback(verification.slave, verification.startAddress, _matched);
+	}
+}
+
+void ModbusCppRtuScheduler::recordBusy(const std::chrono::steady_clock::time_point& start)
+{
+	m_requestsCount.fetch_add(1, std::memory_order_relaxed);
+	m_busyUsec.fetch_add(durationUsec(std::chrono::steady_clock::now() - start), std::memory_order_relaxed);
+}
@@ -0,0 +1,20 @@
+﻿#pragma once
+#include <cstdint>
+#include <cstddef>
+
+// 内部使用: RTU 帧的传输通道(串口或串口服务器的 TCP 连接)，ModbusCppRtuClient 通过它收发
+class ModbusCppRtuTransport
+{
+public:
+    virtual ~ModbusCppRtuTransport() {}
+
+    virtual void close() = 0;
+    virtual bool isOpen() const = 0;
+
+    // 写入全部数据，失败返回 -1
+    virtual int write(const uint8_t *data, const size_t length) = 0;
+    // 读取已经到达的数据；timeoutUsec > 0 时先等待数据到达，超时返回 0，出错返回 -1
+    virtual int read(uint8_t *data, const size_t length, const uint32_t timeoutUsec) = 0;
+    // 丢弃已经到达但未读取的数据
+    virtual void flush() = 0;
+};
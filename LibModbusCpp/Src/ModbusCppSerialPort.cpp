@@ -0,0 +1,310 @@
+﻿#include "ModbusCppSerialPort.h"
+#if defined(_WIN32)
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include <poll.h>
+#include <errno.h>
+#include <time.h>
+#endif
+#include <iostream>
+#include <cstring>
+
+#if !defined(_WIN32)
+// 波特率 -> termios 常量，平台不支持的波特率不在表中
+struct BaudRate
+{
+	int         baud;
+	speed_t     speed;
+};
+
+static const BaudRate BAUD_RATES[] = {
+	{ 1200, B1200 }, { 2400, B2400 }, { 4800, B4800 }, { 9600, B9600 }, { 19200, B19200 }, { 38400, B38400 },
+#ifdef B57600
+	{ 57600, B57600 },
+#endif
+#ifdef B115200
+	{ 115200, B115200 },
+#endif
+#ifdef B230400
+	{ 230400, B230400 },
+#endif
+#ifdef B460800
+	{ 460800, B460800 },
+#endif
+#ifdef B500000
+	{ 500000, B500000 },
+#endif
+#ifdef B921600
+	{ 921600, B921600 },
+#endif
+#ifdef B1000000
+	{ 1000000, B1000000 },
+#endif
+#ifdef B2000000
+	{ 2000000, B2000000 },
+#endif
+#ifdef B4000000
+	{ 4000000, B4000000 },
+#endif
+};
+#endif
+
+ModbusCppSerialPort::ModbusCppSerialPort()
+#if defined(_WIN32)
+	: m_handle(INVALID_HANDLE_VALUE)
+	, m_timeoutMs(0)
+#else
+	: m_handle(-1)
+#endif
+{
+}
+
+ModbusCppSerialPort::~ModbusCppSerialPort()
+{
+	close();
+}
+
+#if defined(_WIN32)
+bool ModbusCppSerialPort::open(const ModbusCppSerialConfig& config)
+{
+	close();
+
+	// COM10 以上必须使用 \\.\ 前缀
+	const std::string _device = 0 == config.device.compare(0, 4, "\\\\.\\") ? config.device : "\\\\.\\" + config.device;
+	HANDLE _handle = CreateFileA(_device.c_str(), GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
+	if (INVALID_HANDLE_VALUE == _handle)
+	{
+		std::cout << "open " << config.device << " failed: " << GetLastError() << std::endl;
+		return false;
+	}
+
+	DCB _dcb = {};
+	_dcb.DCBlength = sizeof(_dcb);
+	GetCommState(_handle, &_dcb);
+	_dcb.BaudRate = config.baud;
+	_dcb.ByteSize = static_cast<BYTE>(config.dataBits);
+	_dcb.Parity = 'E' == config.parity ? EVENPARITY : ('O' == config.parity ? ODDPARITY : NOPARITY);
+	_dcb.fParity = 'N' == config.parity ? FALSE : TRUE;
+	_dcb.StopBits = 2 == config.stopBits ? TWOSTOPBITS : ONESTOPBIT;
+	_dcb.fBinary = TRUE;
+	_dcb.fOutxCtsFlow = FALSE;
+	_dcb.fOutxDsrFlow = FALSE;
+	_dcb.fDtrControl = DTR_CONTROL_ENABLE;
+	_dcb.fRtsControl = RTS_CONTROL_ENABLE;
+	_dcb.fOutX = FALSE;
+	_dcb.fInX = FALSE;
+	_dcb.fAbortOnError = FALSE;
+	if (!SetCommState(_handle, &_dcb))
+	{
+		std::cout << "configure " << config.device << " failed: " << GetLastError() << std::endl;
+		CloseHandle(_handle);
+		return false;
+	}
+
+	m_handle = _handle;
+	m_timeoutMs = 0;
+	flush();
+	return true;
+}
+
+void ModbusCppSerialPort::close()
+{
+	if (INVALID_HANDLE_VALUE != m_handle)
+	{
+		CloseHandle(m_handle);
+		m_handle = INVALID_HANDLE_VALUE;
+	}
+}
+
+bool ModbusCppSerialPort::isOpen() const
+{
+	return INVALID_HANDLE_VALUE != m_handle;
+}
+
+int ModbusCppSerialPort::write(const uint8_t *data, const size_t length)
+{
+	DWORD _written = 0;
+	if (!WriteFile(m_handle, data, static_cast<DWORD>(length), &_written, NULL) || _written != length)
+	{
+		return -1;
+	}
+	return static_cast<int>(_written);
+}
+
+int ModbusCppSerialPort::read(uint8_t *data, const size_t length, const uint32_t timeoutUsec)
+{
+	// 间隔和乘数都取 MAXDWORD: 有数据时立即返回，没有数据时等待第一个字节最多 ReadTotalTimeoutConstant 毫秒
+	const uint32_t _timeoutMs = (timeoutUsec + 999) / 1000;
+	if (0 == m_timeoutMs || _timeoutMs != m_timeoutMs)
+	{
+		COMMTIMEOUTS _timeouts = {};
+		_timeouts.ReadIntervalTimeout = MAXDWORD;
+		_timeouts.ReadTotalTimeoutMultiplier = 0 == _timeoutMs ? 0 : MAXDWORD;
+		_timeouts.ReadTotalTimeoutConstant = _timeoutMs;
+		if (!SetCommTimeouts(m_handle, &_timeouts))
+		{
+			return -1;
+		}
+		m_timeoutMs = _timeoutMs;
+	}
+
+	DWORD _read = 0;
+	if (!ReadFile(m_handle, data, static_cast<DWORD>(length), &_read, NULL))
+	{
+		return -1;
+	}
+	return static_cast<int>(_read);
+}
+
+void ModbusCppSerialPort::flush()
+{
+	PurgeComm(m_handle, PURGE_RXCLEAR);
+}
+
+int ModbusCppSerialPort::handle() const
+{
+	return -1;
+}
+#else
+bool ModbusCppSerialPort::open(const ModbusCppSerialConfig& config)
+{
+	close();
+
+	speed_t _speed = 0;
+	for (const BaudRate& _rate : BAUD_RATES)
+	{
+		if (_rate.baud == config.baud)
+		{
+			_speed = _rate.speed;
+		}
+	}
+	if (0 == _speed)
+	{
+		std::cout << "unsupported baud rate " << config.baud << std::endl;
+		return false;
+	}
+
+	const int _handle = ::open(config.device.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+	if (-1 == _handle)
+	{
+		std::cout << "open " << config.device << " failed: " << strerror(errno) << std::endl;
+		return false;
+	}
+
+	termios _termios = {};
+	cfmakeraw(&_termios);
+	cfsetispeed(&_termios, _speed);
+	cfsetospeed(&_termios, _speed);
+	_termios.c_cflag |= CREAD | CLOCAL;
+	_termios.c_cflag &= ~(CSIZE | PARENB | PARODD | CSTOPB);
+	_termios.c_cflag |= 5 == config.dataBits ? CS5 : (6 == config.dataBits ? CS6 : (7 == config.dataBits ? CS7 : CS8));
+	if ('N' != config.parity)
+	{
+		_termios.c_cflag |= PARENB | ('O' == config.parity ? PARODD : 0);
+		_termios.c_iflag |= INPCK;
+	}
+	if (2 == config.stopBits)
+	{
+		_termios.c_cflag |= CSTOPB;
+	}
+	_termios.c_cc[VMIN] = 0;
+	_termios.c_cc[VTIME] = 0;
+	if (0 != tcsetattr(_handle, TCSANOW, &_termios))
+	{
+		std::cout << "configure " << config.device << " failed: " << strerror(errno) << std::endl;
+		::close(_handle);
+		return false;
+	}
+
+	m_handle = _handle;
+	flush();
+	return true;
+}
+
+void ModbusCppSerialPort::close()
+{
+	if (-1 != m_handle)
+	{
+		::close(m_handle);
+		m_handle = -1;
+	}
+}
+
+bool ModbusCppSerialPort::isOpen() const
+{
+	return -1 != m_handle;
+}
+
+int ModbusCppSerialPort::write(const uint8_t *data, const size_t length)
+{
+	size_t _written = 0;
+	while (_written < length)
+	{
+		const ssize_t _result = ::write(m_handle, data + _written, length - _written);
+		if (_result > 0)
+		{
+			_written += _result;
+			continue;
+		}
+		if (_result < 0 && EINTR == errno)
+		{
+			continue;
+		}
+		if (_result < 0 && EAGAIN == errno)
+		{
+			// 发送缓冲区已满，等到可写
+			pollfd _pollfd = { m_handle, POLLOUT, 0 };
+			poll(&_pollfd, 1, -1);
+			continue;
+		}
+		return -1;
+	}
+	return static_cast<int>(_written);
+}
+
+// 原始模式下 VMIN = VTIME = 0，没有数据时 read 返回 0 或 EAGAIN
+// 需要等待时先 poll 再读，调用方确定数据已经到达时传 0 只读一次
+int ModbusCppSerialPort::read(uint8_t *data, const size_t length, const uint32_t timeoutUsec)
+{
+	if (timeoutUsec > 0)
+	{
+		pollfd _pollfd = { m_handle, POLLIN, 0 };
+#if defined(__linux__)
+		const timespec _timeout = { static_cast<time_t>(timeoutUsec / 1000000), static_cast<long>(timeoutUsec % 1000000) * 1000 };
+		const int _ready = ppoll(&_pollfd, 1, &_timeout, NULL);
+#else
+		const int _ready = poll(&_pollfd, 1, static_cast<int>((timeoutUsec + 999) / 1000));
+#endif
+		if (_ready <= 0)
+		{
+			// 超时或被信号打断，都按没有数据处理
+			return _ready < 0 && EINTR != errno ? -1 : 0;
+		}
+		if (_pollfd.revents & (POLLERR | POLLNVAL))
+		{
+			return -1;
+		}
+	}
+
+	const ssize_t _result = ::read(m_handle, data, length);
+	if (_result < 0)
+	{
+		return EAGAIN == errno || EINTR == errno ? 0 : -1;
+	}
+	return static_cast<int>(_result);
+}
+
+void ModbusCppSerialPort::flush()
+{
+	tcflush(m_handle, TCIFLUSH);
+}
+
+int ModbusCppSerialPort::handle() const
+{
+	return m_handle;
+}
+#endif
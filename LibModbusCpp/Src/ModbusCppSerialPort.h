@@ -0,0 +1,40 @@
+﻿#pragma once
+#include <cstdint>
+#include <cstddef>
+
+#include "ModbusCppSerialConfig.h"
+#include "ModbusCppRtuTransport.h"
+
+// 内部使用的串口封装，屏蔽 Windows 和 POSIX 的差异
+// 串口以原始模式打开: 不回显、不转换字符、读取不阻塞，等待由 read() 的超时参数控制
+class ModbusCppSerialPort : public ModbusCppRtuTransport
+{
+public:
+    ModbusCppSerialPort();
+    ~ModbusCppSerialPort() override;
+
+    ModbusCppSerialPort(const ModbusCppSerialPort &) = delete;
+    ModbusCppSerialPort &operator=(const ModbusCppSerialPort &) = delete;
+
+    bool open(const ModbusCppSerialConfig &config);
+    void close() override;
+    bool isOpen() const override;
+
+    // 写入全部数据，失败返回 -1
+    int write(const uint8_t *data, const size_t length) override;
+    // 读取已经到达的数据；timeoutUsec > 0 时先等待数据到达，超时返回 0，出错返回 -1
+    int read(uint8_t *data, const size_t length, const uint32_t timeoutUsec) override;
+    // 丢弃输入缓冲区中未读取的数据
+    void flush() override;
+
+    // POSIX 上为文件描述符，可以注册到事件循环；Windows 上为 -1
+    int handle() const;
+
+private:
+#if defined(_WIN32)
+    void *m_handle;
+    uint32_t m_timeoutMs;   // 当前设置的读超时，只在变化时调用 SetCommTimeouts
+#else
+    int m_handle;
+#endif
+};
@@ -0,0 +1,74 @@
+﻿#pragma once
+#include <cstdint>
+#include <cstddef>
+// 内部使用的套接字工具函数，屏蔽 Windows 和 POSIX 的差异
+#if defined(_WIN32)
+#include <WinSock2.h>
+#include <WS2tcpip.h>
+#else
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+// 设置为非阻塞模式
+inline bool socketSetNonBlocking(const int socket)
+{
+#if defined(_WIN32)
+	u_long _mode = 1;
+	return 0 == ioctlsocket(socket, FIONBIO, &_mode);
+#else
+	const int _flags = fcntl(socket, F_GETFL, 0);
+	return -1 != _flags && -1 != fcntl(socket, F_SETFL, _flags | O_NONBLOCK);
+#endif
+}
+
+// 关闭 Nagle 算法，小报文立即发送
+inline void socketSetNoDelay(const int socket)
+{
+	int _option = 1;
+	setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char *>(&_option), sizeof(_option));
+}
+
+inline void socketClose(const int socket)
+{
+#if defined(_WIN32)
+	closesocket(socket);
+#else
+	close(socket);
+#endif
+}
+
+// 上一次套接字调用失败是否只是暂时没有数据/缓冲区已满
+inline bool socketWouldBlock()
+{
+#if defined(_WIN32)
+	const int _error = WSAGetLastError();
+	return WSAEWOULDBLOCK == _error || WSAEINTR == _error;
+#else
+	return EAGAIN == errno || EWOULDBLOCK == errno || EINTR == errno;
+#endif
+}
+
+// send 不产生 SIGPIPE
+inline int socketSend(const int socket, const uint8_t *data, const size_t length)
+{
+#if defined(_WIN32)
+	return send(socket, reinterpret_cast<const char *>(data), static_cast<int>(length), 0);
+#else
+	return static_cast<int>(send(socket, data, length, MSG_NOSIGNAL));
+#endif
+}
+
+inline int socketReceive(const int socket, uint8_t *data, const size_t length)
+{
+#if defined(_WIN32)
+	return recv(socket, reinterpret_cast<char *>(data), static_cast<int>(length), 0);
+#else
+	return static_cast<int>(recv(socket, data, length, 0));
+#endif
+}
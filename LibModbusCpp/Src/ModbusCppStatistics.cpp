@@ -0,0 +1,292 @@
+﻿#include "ModbusCppStatistics.h"
+#include <algorithm>
+#include <limits>
+
+ModbusCppLatencyHistogram::ModbusCppLatencyHistogram()
+	: m_sum(0)
+	, m_min(std::numeric_limits<uint64_t>::max())
+	, m_max(0)
+{
+	for (auto& _bucket : m_buckets)
+	{
+		_bucket.store(0, std::memory_order_relaxed);
+	}
+}
+
+// 计算值所在的桶: 小于 32 的值每个值一个桶，之后每个 2 的幂区间平均分成 16 个桶
+size_t ModbusCppLatencyHistogram::bucketIndex(const uint64_t value)
+{
+	if (value < SUB_BUCKET_COUNT * 2)
+	{
+		return static_cast<size_t>(value);
+	}
+
+	int _magnitude = 0;
+	for (uint64_t _v = value; _v > 1; _v >>= 1)
+	{
+		++_magnitude;
+	}
+	if (_magnitude >= MAGNITUDE_MAX)
+	{
+		return BUCKET_COUNT - 1;
+	}
+
+	const size_t _subBucket = static_cast<size_t>(value >> (_magnitude - SUB_BUCKET_BITS)) & (SUB_BUCKET_COUNT - 1);
+	return SUB_BUCKET_COUNT * 2 + (_magnitude - SUB_BUCKET_BITS - 1) * SUB_BUCKET_COUNT + _subBucket;
+}
+
+// 桶能表示的最大值
+uint64_t ModbusCppLatencyHistogram::bucketUpperBound(const size_t index)
+{
+	if (index < SUB_BUCKET_COUNT * 2)
+	{
+		return index;
+	}
+
+	const size_t _offset = index - SUB_BUCKET_COUNT * 2;
+	const int _magnitude = static_cast<int>(_offset / SUB_BUCKET_COUNT) + SUB_BUCKET_BITS + 1;
+	const uint64_t _subBucket = _offset % SUB_BUCKET_COUNT;
+	const uint64_t _lower = (SUB_BUCKET_COUNT + _subBucket) << (_magnitude - SUB_BUCKET_BITS);
+	return _lower + (uint64_t(1) << (_magnitude - SUB_BUCKET_BITS)) - 1;
+}
+
+void ModbusCppLatencyHistogram::record(const uint64_t usec)
+{
+	m_buckets[bucketIndex(usec)].fetch_add(1, std::memory_order_relaxed);
+	m_sum.fetch_add(usec, std::memory_order_relaxed);
+
+	uint64_t _min = m_min.load(std::memory_order_relaxed);
+	while (usec < _min && !m_min.compare_exchange_weak(_min, usec, std::memory_order_relaxed))
+	{
+	}
+
+	uint64_t _max = m_max.load(std::memory_order_relaxed);
+	while (usec > _max && !m_max.compare_exchange_weak(_max, usec, std::memory_order_relaxed))
+	{
+	}
+}
+
+void ModbusCppLatencyHistogram::reset()
+{
+	for (auto& _bucket : m_buckets)
+	{
+		_bucket.store(0, std::memory_order_relaxed);
+	}
+	m_sum.store(0, std::memory_order_relaxed);
+	m_min.store(std::numeric_limits<uint64_t>::max(), std::memory_order_relaxed);
+	m_max.store(0, std::memory_order_relaxed);
+}
+
+ModbusCppLatencySnapshot ModbusCppLatencyHistogram::snapshot() const
+{
+	// 先把桶拷贝出来，记录线程可以继续写入，快照只是近似一致
+	std::array<uint64_t, BUCKET_COUNT> _buckets;
+	uint64_t _count = 0;
+	for (size_t i = 0; i < BUCKET_COUNT; ++i)
+	{
+		_buckets[i] = m_buckets[i].load(std::memory_order_relaxed);
+		_count += _buckets[i];
+	}
+
+	ModbusCppLatencySnapshot _snapshot;
+	if (0 == _count)
+	{
+		return _snapshot;
+	}
+
+	_snapshot.count = _count;
+	_snapshot.min = m_min.load(std::memory_order_relaxed);
+	_snapshot.max = m_max.load(std::memory_order_relaxed);
+	_snapshot.mean = static_cast<double>(m_sum.load(std::memory_order_relaxed)) / static_cast<double>(_count);
+
+	// 依次找到 50 / 99 / 99.9 分位所在的桶
+	const uint64_t _ranks[3] = { (_count * 500 + 999) / 1000, (_count * 990 + 999) / 1000, (_count * 999 + 999) / 1000 };
+	uint64_t *_outputs[3] = { &_snapshot.p50, &_snapshot.p99, &_snapshot.p999 };
+	uint64_t _seen = 0;
+	size_t _next = 0;
+	for (size_t i = 0; i < BUCKET_COUNT && _next < 3; ++i)
+	{
+		_seen += _buckets[i];
+		while (_next < 3 && _seen >= _ranks[_next])
+		{
+			// 桶上界可能超过实际最大值，取较小者
+			*_outputs[_next] = std::min(bucketUpperBound(i), _snapshot.max);
+			++_next;
+		}
+	}
+
+	return _snapshot;
+}
+
+ModbusCppStatistics::ModbusCppStatistics()
+	: m_queueDepth(0)
+	, m_queueDepthMax(0)
+{
+	for (auto& _function : m_functions)
+	{
+		_function.store(nullptr, std::memory_order_relaxed);
+	}
+}
+
+ModbusCppStatistics::~ModbusCppStatistics()
+{
+	for (auto& _function : m_functions)
+	{
+		delete _function.load(std::memory_order_relaxed);
+	}
+}
+
+ModbusCppStatistics::FunctionCounters *ModbusCppStatistics::counters(const uint8_t function)
+{
+	std::atomic<FunctionCounters *>& _slot = m_functions[function > FUNCTION_MAX ? FUNCTION_MAX : function];
+	FunctionCounters *_counters = _slot.load(std::memory_order_acquire);
+	if (nullptr != _counters)
+	{
+		return _counters;
+	}
+
+	// 第一次使用该功能码，多个线程同时分配时只保留一个
+	FunctionCounters *_created = new FunctionCounters();
+	if (_slot.compare_exchange_strong(_counters, _created, std::memory_order_acq_rel))
+	{
+		return _created;
+	}
+	delete _created;
+	return _counters;
+}
+
+void ModbusCppStatistics::addRequest(const uint8_t function, const bool succeeded, const uint64_t usec)
+{
+	FunctionCounters *_counters = counters(function);
+	_counters->requests.fetch_add(1, std::memory_order_relaxed);
+	if (succeeded)
+	{
+		_counters->latency.record(usec);
+	}
+	else
+	{
+		_counters->failures.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+void ModbusCppStatistics::addRetry(const uint8_t function)
+{
+	counters(function)->retries.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ModbusCppStatistics::addTimeout(const uint8_t function)
+{
+	counters(function)->timeouts.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ModbusCppStatistics::addException(const uint8_t function)
+{
+	counters(function)->exceptions.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ModbusCppStatistics::addBytes(const uint8_t function, const uint64_t sent, const uint64_t received)
+{
+	FunctionCounters *_counters = counters(function);
+	_counters->bytesSent.fetch_add(sent, std::memory_order_relaxed);
+	_counters->bytesReceived.fetch_add(received, std::memory_order_relaxed);
+}
+
+void ModbusCppStatistics::setQueueDepth(const size_t depth)
+{
+	m_queueDepth.store(depth, std::memory_order_relaxed);
+
+	size_t _max = m_queueDepthMax.load(std::memory_order_relaxed);
+	while (depth > _max && !m_queueDepthMax.compare_exchange_weak(_max, depth, std::memory_order_relaxed))
+	{
+	}
+}
+
+void ModbusCppStatistics::reset()
+{
+	for (auto& _function : m_functions)
+	{
+		FunctionCounters *_counters = _function.load(std::memory_order_acquire);
+		if (nullptr == _counters)
+		{
+			continue;
+		}
+
+		_counters->requests.store(0, std::memory_order_relaxed);
+		_counters->failures.store(0, std::memory_order_relaxed);
+		_counters->retries.store(0, std::memory_order_relaxed);
+		_counters->timeouts.store(0, std::memory_order_relaxed);
+		_counters->exceptions.store(0, std::memory_order_relaxed);
+		_counters->bytesSent.store(0, std::memory_order_relaxed);
+		_counters->bytesReceived.store(0, std::memory_order_relaxed);
+		_counters->latency.reset();
+	}
+	m_queueDepthMax.store(m_queueDepth.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+ModbusCppStatisticsSnapshot ModbusCppStatistics::snapshot() const
+{
+	ModbusCppStatisticsSnapshot _snapshot;
+	for (size_t i = 0; i < m_functions.size(); ++i)
+	{
+		const FunctionCounters *_counters = m_functions[i].load(std::memory_order_acquire);
+		if (nullptr == _counters)
+		{
+			continue;
+		}
+
+		ModbusCppFunctionStatistics _function;
+		_function.requests = _counters->requests.load(std::memory_order_relaxed);
+		_function.failures = _counters->failures.load(std::memory_order_relaxed);
+		_function.retries = _counters->retries.load(std::memory_order_relaxed);
+		_function.timeouts = _counters->timeouts.load(std::memory_order_relaxed);
+		_function.exceptions = _counters->exceptions.load(std::memory_order_relaxed);
+		_function.bytesSent = _counters->bytesSent.load(std::memory_order_relaxed);
+		_function.bytesReceived = _counters->bytesReceived.load(std::memory_order_relaxed);
+		_function.latency = _counters->latency.snapshot();
+
+		_snapshot.total.requests += _function.requests;
+		_snapshot.total.failures += _function.failures;
+		_snapshot.total.retries += _function.retries;
+		_snapshot.total.timeouts += _function.timeouts;
+		_snapshot.total.exceptions += _function.exceptions;
+		_snapshot.total.bytesSent += _function.bytesSent;
+		_snapshot.total.bytesReceived += _function.bytesReceived;
+
+		_snapshot.functions.emplace(static_cast<uint8_t>(i), _function);
+	}
+	_snapshot.queueDepth = m_queueDepth.load(std::memory_order_relaxed);
+	_snapshot.queueDepthMax = m_queueDepthMax.load(std::memory_order_relaxed);
+	return _snapshot;
+}
+
+void ModbusCppRequestTimingStatistics::record(const ModbusCppRequestTiming& timing)
+{
+	m_queueWait.record(timing.queueWait);
+	m_lockWait.record(timing.lockWait);
+	m_send.record(timing.send);
+	m_firstByte.record(timing.firstByte);
+	m_reassembly.record(timing.reassembly);
+	m_total.record(timing.total);
+}
+
+void ModbusCppRequestTimingStatistics::reset()
+{
+	m_queueWait.reset();
+	m_lockWait.reset();
+	m_send.reset();
+	m_firstByte.reset();
+	m_reassembly.reset();
+	m_total.reset();
+}
+
+ModbusCppRequestTimingSnapshot ModbusCppRequestTimingStatistics::snapshot() const
+{
+	ModbusCppRequestTimingSnapshot _snapshot;
+	_snapshot.queueWait = m_queueWait.snapshot();
+	_snapshot.lockWait = m_lockWait.snapshot();
+	_snapshot.send = m_send.snapshot();
+	_snapshot.firstByte = m_firstByte.snapshot();
+	_snapshot.reassembly = m_reassembly.snapshot();
+	_snapshot.total = m_total.snapshot();
+	return _snapshot;
+}
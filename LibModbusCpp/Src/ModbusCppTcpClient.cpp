@@ -1,8 +1,21 @@
 ﻿#include "ModbusCppTcpClient.h"
 #include "modbus.h"
-#include <WinSock2.h>
-#include <Windows.h>
+#include "ModbusCppSocket.h"
+#if !defined(_WIN32)
+#include <poll.h>
+#endif
 #include <thread>
+#include <chrono>
+#include <cstring>
+
+// 异步任务的入队时间，由任务线程在执行任务前设置，用于统计队列等待时间
+static thread_local std::chrono::steady_clock::time_point t_taskEnqueueTime;
+
+// 从 start 到现在经过的微秒数
+static uint64_t elapsedUsec(const std::chrono::steady_clock::time_point& start)
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
 
 ModbusCppTcpClient::ModbusCppTcpClient()
 	: m_connected(false)
@@ -13,25 +26,30 @@ ModbusCppTcpClient::ModbusCppTcpClient()
 	, m_retries(5)
 	, m_requestFailedCallback(nullptr)
 	, m_receivedDataCallback(nullptr)
+	, m_requestTimingEnabled(false)
+	, m_attemptBytesSent(0)
+	, m_attemptBytesReceived(0)
 {
-	std::jthread _checkConnectionStateThread(&ModbusCppTcpClient::checkConnectionStateThread, this);
-	_checkConnectionStateThread.detach();
-
-	std::jthread _processMsgThread(&ModbusCppTcpClient::processMsgThread, this);
-	_processMsgThread.detach();
+	m_checkConnectionStateThread = std::jthread([this](std::stop_token stopToken) {
+		checkConnectionStateThread(stopToken);
+		});
+	m_processMsgThread = std::jthread([this](std::stop_token stopToken) {
+		processMsgThread(stopToken);
+		});
 }
 
 ModbusCppTcpClient::~ModbusCppTcpClient()
 {
+	// 先停止工作线程，正在执行的请求完成后线程退出，队列中未执行的异步任务被丢弃
+	m_checkConnectionStateThread.request_stop();
+	m_processMsgThread.request_stop();
+	m_checkConnectionStateThread.join();
+	m_processMsgThread.join();
+
 	if (NULL != m_modbusClient)
 	{
-		if (m_connected)
-		{
-			// 关闭连接
-			disconnectServer();
-		}
-
-		// 释放内存
+		// 关闭连接并释放内存
+		closeContext();
 		modbus_free(m_modbusClient);
 	}
 }
@@ -71,15 +89,41 @@ void ModbusCppTcpClient::setConnectionStateChangedCallback(const std::function<v
 	m_connectionStateChangedCallback = callback;
 }
 
+// 获取统计数据快照，不影响正在进行的请求
+ModbusCppStatisticsSnapshot ModbusCppTcpClient::getStatistics() const
+{
+	return m_statistics.snapshot();
+}
+
+void ModbusCppTcpClient::resetStatistics()
+{
+	m_statistics.reset();
+}
+
+void ModbusCppTcpClient::setRequestTimingEnabled(const bool enabled)
+{
+	m_requestTimingEnabled = enabled;
+}
+
+void ModbusCppTcpClient::setRequestTimingCallback(const std::function<void(const ModbusCppRequestTiming&)> callback)
+{
+	std::lock_guard<std::mutex> _lock(m_lockTest);
+	m_requestTimingCallback = callback;
+}
+
+ModbusCppRequestTimingSnapshot ModbusCppTcpClient::getRequestTiming() const
+{
+	return m_requestTimingStatistics.snapshot();
+}
+
 // 连接服务器
 bool ModbusCppTcpClient::connectServer(const std::string& serverHost, const uint16_t serverPort, const int slaveId)
 {
+	// 替换上下文期间持有 m_lockTest，状态检测线程不会访问到已释放的上下文
+	std::unique_lock<std::mutex> _lock(m_lockTest);
 	if (NULL != m_modbusClient)
 	{
-		if (m_connected)
-		{
-			disconnectServer();
-		}
+		closeContext();
 		modbus_free(m_modbusClient);
 	}
 
@@ -97,6 +141,14 @@ bool ModbusCppTcpClient::connectServer(const std::string& serverHost, const uint
 		return false;
 	}
 
+	// 记录收发各阶段的时间点
+	modbus_set_trace_callback(m_modbusClient, [](modbus_t*, modbus_trace_event event, int length, void* userData) {
+		static_cast<ModbusCppTcpClient*>(userData)->onTraceEvent(event, length);
+		}, this);
+
+	// 响应一次 recv 读完整，不再分成头部和数据两次读取
+	modbus_set_read_ahead(m_modbusClient, 1);
+
 	// 设置超时
 	_ret = modbus_set_response_timeout(m_modbusClient, m_timeoutSec, m_timeoutUsec);
 	if (0 != _ret)
@@ -113,8 +165,6 @@ bool ModbusCppTcpClient::connectServer(const std::string& serverHost, const uint
 	//if (0 != _ret)
 	if (-1 == _connected)
 	{
-		std::lock_guard<std::mutex> _lock(m_checkConnectionStateLock);
-		m_connected = false;
 		return false;
 	}
 
@@ -133,6 +183,7 @@ bool ModbusCppTcpClient::connectServer(const std::string& serverHost, const uint
 	m_connected = true;
 	m_checkConnectionStateLock.unlock();
 	m_checkConnectionStateCondition.notify_one();
+	_lock.unlock();
 
 	// 通知出去
 	if (nullptr != m_connectionStateChangedCallback)
@@ -145,23 +196,41 @@ bool ModbusCppTcpClient::connectServer(const std::string& serverHost, const uint
 // 断开连接
 void ModbusCppTcpClient::disconnectServer()
 {
-	if (NULL == m_modbusClient)
+	std::unique_lock<std::mutex> _lock(m_lockTest);
+	if (NULL == m_modbusClient || !m_connected)
 	{
 		return;
 	}
 
-	if (!m_connected)
+	closeContext();
+	_lock.unlock();
+
+	// 通知出去
+	if (nullptr != m_connectionStateChangedCallback)
 	{
-		return;
+		m_connectionStateChangedCallback(false);
 	}
+}
 
+// 关闭套接字并清除连接状态，调用前需持有 m_lockTest
+void ModbusCppTcpClient::closeContext()
+{
 	modbus_close(m_modbusClient);
+
+	std::lock_guard<std::mutex> _lock(m_checkConnectionStateLock);
+	m_connected = false;
 }
 
 // 检查连接状态
 bool ModbusCppTcpClient::isConnected()
 {
 	std::lock_guard<std::mutex> _lock(m_lockTest);
+	return checkSocket();
+}
+
+// 检查套接字是否仍然连接，调用前需持有 m_lockTest
+bool ModbusCppTcpClient::checkSocket()
+{
 	if (NULL == m_modbusClient)
 	{
 		return false;
@@ -173,32 +242,36 @@ bool ModbusCppTcpClient::isConnected()
 		return false;
 	}
 
-	fd_set read_fds;
-	FD_ZERO(&read_fds);         // 清空集合（所有位设为0）
-	FD_SET(_sock, &read_fds);   // 将套接字_sock加入read_fds（对应位设为1），表示要监视其“可读性”。 调用 select() 前需用 FD_SET 将目标套接字加入集合，调用后 select 会修改该集合（仅保留已准备好可读的套接字）
-
-	// _timeout 的 tv_sec 和 tv_usec 都是 0，表示非阻塞检查（立即返回）
-	struct timeval _timeout;
-	_timeout.tv_sec = 0;
-	_timeout.tv_usec = 0;
-
-	int rc = select((_sock + 1), &read_fds, NULL, NULL/*不监视异常（exceptfds）*/, &_timeout/*超时时间，指定select等待的最长时间*/);
+	// 用 poll 代替 select: fd_set 是固定大小的位图，套接字值超过 FD_SETSIZE(通常 1024) 时 FD_SET 会越界
+#if defined(_WIN32)
+	WSAPOLLFD _pollFd;
+#else
+	struct pollfd _pollFd;
+#endif
+	_pollFd.fd = _sock;
+	_pollFd.events = POLLIN;   // 监视套接字的“可读性”
+	_pollFd.revents = 0;
+
+	// 超时为 0，表示非阻塞检查（立即返回）
+#if defined(_WIN32)
+	int rc = WSAPoll(&_pollFd, 1, 0);
+#else
+	int rc = poll(&_pollFd, 1, 0);
+#endif
 	switch (rc)
 	{
 	case -1:
-		// select调用失败，未完成任何监视
-		std::cout << "select error -1" << std::endl;
+		// poll调用失败，未完成任何监视
+		std::cout << "poll error -1" << std::endl;
 		// return true;
 		return false;
 	case 0:
 		// 超时（未发生任何事件），可继续循环等待
-		// 正常连接状态，超时(在 _timeout 指定的时间内，没有任何被监视的套接字准备好可读)，对于 TCP 监听套接字：没有新的客户端连接请求； 对于已连接的 TCP 套接字：接收缓冲区中没有数据
+		// 正常连接状态，超时(套接字没有准备好可读)，对于 TCP 监听套接字：没有新的客户端连接请求； 对于已连接的 TCP 套接字：接收缓冲区中没有数据
 		return true;
 	default:
-		// 有 n 个被监视的套接字在 read_fds 集合中准备好可读（即这些套接字满足“可读”条件）
-		// 这时候需要用 FD_ISSET 来检查具体是哪个套接字
-		// read_fds是输入输出参数，调用前需要设置要监视的套接字，调用后会被修改为只包含准备好的套接字
-		if (FD_ISSET(_sock, &read_fds)) // FD_ISSET 是一个位检查宏，用于判断某个套接字是否在 select() 修改后的 fd_set 集合中
+		// 套接字准备好可读，或者出错/对方挂断(revents 中的 POLLERR / POLLHUP 即使没有请求也会返回)
+		if (0 != (_pollFd.revents & (POLLIN | POLLERR | POLLHUP)))
 		{
 			// 对于监听套接字（listen后的），可读意味着有新的连接请求；
 			// 对于已连接的 TCP 套接字，可读意味着接收缓冲区有数据，或者对方关闭了连接，进一步检测
@@ -235,7 +308,8 @@ bool ModbusCppTcpClient::isConnected()
 // 同步写数据
 bool ModbusCppTcpClient::writeRegistersSync(const uint16_t startAddress, const std::vector<uint16_t>& data)
 {
-	std::lock_guard<std::mutex> _lock(m_lockTest);
+	const auto _lockRequested = std::chrono::steady_clock::now();
+	std::unique_lock<std::mutex> _lock(m_lockTest);
 	// 检查是否已初始化成功
 	if (!m_connected)
 	{
@@ -255,21 +329,29 @@ bool ModbusCppTcpClient::writeRegistersSync(const uint16_t startAddress, const s
 	}
 
 	// 写入数据
+	beginRequestTiming(MODBUS_FC_WRITE_MULTIPLE_REGISTERS, _lockRequested);
+	const auto _start = std::chrono::steady_clock::now();
 	for (int i = 0; i < m_retries; ++i)
 	{
 		const int _writeNum = modbus_write_registers(m_modbusClient, startAddress, static_cast<int>(data.size()), m_writeBuffer);
 		if (_writeNum == data.size())
 		{
 			// 写入成功
+			recordAttempt(MODBUS_FC_WRITE_MULTIPLE_REGISTERS, i, true);
+			m_statistics.addRequest(MODBUS_FC_WRITE_MULTIPLE_REGISTERS, true, elapsedUsec(_start));
+			finishRequestTiming(true, _lock);
 			return true;
 		}
 		else
 		{
 			//std::cout << "写入失败" << std::endl;
+			recordAttempt(MODBUS_FC_WRITE_MULTIPLE_REGISTERS, i, false);
 		}
 	}
 
 	// 写入失败
+	m_statistics.addRequest(MODBUS_FC_WRITE_MULTIPLE_REGISTERS, false, elapsedUsec(_start));
+	finishRequestTiming(false, _lock);
 	if (nullptr != m_requestFailedCallback)
 	{
 		m_requestFailedCallback();
@@ -280,7 +362,8 @@ bool ModbusCppTcpClient::writeRegistersSync(const uint16_t startAddress, const s
 // 同步读数据
 std::optional<std::vector<uint16_t> > ModbusCppTcpClient::readRegistersSync(const uint16_t startAddress, const uint8_t dataLen)
 {
-	std::lock_guard<std::mutex> _lock(m_lockTest);
+	const auto _lockRequested = std::chrono::steady_clock::now();
+	std::unique_lock<std::mutex> _lock(m_lockTest);
 	// 检查是否已初始化成功
 	if (!m_connected)
 	{
@@ -295,6 +378,8 @@ std::optional<std::vector<uint16_t> > ModbusCppTcpClient::readRegistersSync(cons
 
 	// 读取数据
 	memset(m_readBuffer, 0, DATA_LEN_MAX);  // 清空缓存值
+	beginRequestTiming(MODBUS_FC_READ_HOLDING_REGISTERS, _lockRequested);
+	const auto _start = std::chrono::steady_clock::now();
 	for (int i = 0; i < m_retries; ++i)
 	{
 		const int _readNum = modbus_read_registers(m_modbusClient, startAddress, dataLen, m_readBuffer);
@@ -302,21 +387,28 @@ std::optional<std::vector<uint16_t> > ModbusCppTcpClient::readRegistersSync(cons
 		// 检查读取结果
 		if (_readNum == dataLen)
 		{
-			if (i > 0)
-			{
-				std::cout << "retry times: " << i + 1 << "read successed" << std::endl;
-			}
-			// 组装读到的数据，返回结果
+			recordAttempt(MODBUS_FC_READ_HOLDING_REGISTERS, i, true);
+			m_statistics.addRequest(MODBUS_FC_READ_HOLDING_REGISTERS, true, elapsedUsec(_start));
+			// 组装读到的数据，释放锁之前拷贝出读缓存
 			std::vector<uint16_t> _data;
 			for (size_t j = 0; j < dataLen; ++j)
 			{
 				_data.push_back(m_readBuffer[j]);
 			}
+			finishRequestTiming(true, _lock);
+			if (i > 0)
+			{
+				std::cout << "retry times: " << i + 1 << "read successed" << std::endl;
+			}
+			// 返回结果
 			return std::optional<std::vector<uint16_t>>(_data);
 		}
+		recordAttempt(MODBUS_FC_READ_HOLDING_REGISTERS, i, false);
 	}
 
 	// 服务器未响应请求
+	m_statistics.addRequest(MODBUS_FC_READ_HOLDING_REGISTERS, false, elapsedUsec(_start));
+	finishRequestTiming(false, _lock);
 	if (nullptr != m_requestFailedCallback)
 	{
 		m_requestFailedCallback();
@@ -333,7 +425,8 @@ std::optional<std::vector<uint16_t> > ModbusCppTcpClient::readRegistersSync(cons
 // 同步读写数据
 std::optional<std::vector<uint16_t> > ModbusCppTcpClient::writeAndReadRegistersSync(const uint16_t writeStartAddress, const std::vector<uint16_t>& writeData, const uint16_t readStartAddress, const uint8_t readLen)
 {
-	std::lock_guard<std::mutex> _lock(m_lockTest);
+	const auto _lockRequested = std::chrono::steady_clock::now();
+	std::unique_lock<std::mutex> _lock(m_lockTest);
 	// 检查是否已初始化成功
 	if (!m_connected)
 	{
@@ -356,6 +449,8 @@ std::optional<std::vector<uint16_t> > ModbusCppTcpClient::writeAndReadRegistersS
 	memset(m_readBuffer, 0, DATA_LEN_MAX);
 
 	// 读写数据
+	beginRequestTiming(MODBUS_FC_WRITE_AND_READ_REGISTERS, _lockRequested);
+	const auto _start = std::chrono::steady_clock::now();
 	for (int i = 0; i < m_retries; ++i)
 	{
 		int _readNum = modbus_write_and_read_registers(m_modbusClient, writeStartAddress, static_cast<int>(writeData.size()), m_writeBuffer, readStartAddress, readLen, m_readBuffer);
@@ -363,16 +458,23 @@ std::optional<std::vector<uint16_t> > ModbusCppTcpClient::writeAndReadRegistersS
 		// 检查读取结果
 		if (_readNum == readLen)
 		{
-			// 组装读到的数据，返回结果
+			recordAttempt(MODBUS_FC_WRITE_AND_READ_REGISTERS, i, true);
+			m_statistics.addRequest(MODBUS_FC_WRITE_AND_READ_REGISTERS, true, elapsedUsec(_start));
+			// 组装读到的数据，释放锁之前拷贝出读缓存
 			std::vector<uint16_t> _data;
 			for (int i = 0; i < readLen; ++i)
 			{
 				_data.push_back(m_readBuffer[i]);
 			}
+			finishRequestTiming(true, _lock);
+			// 返回结果
 			return std::optional<std::vector<uint16_t>>(_data);
 		}
+		recordAttempt(MODBUS_FC_WRITE_AND_READ_REGISTERS, i, false);
 	}
 
+	m_statistics.addRequest(MODBUS_FC_WRITE_AND_READ_REGISTERS, false, elapsedUsec(_start));
+	finishRequestTiming(false, _lock);
 	if (nullptr != m_requestFailedCallback)
 	{
 		m_requestFailedCallback();
@@ -396,7 +498,10 @@ bool ModbusCppTcpClient::writeRegistersAsync(const uint16_t startAddress, const
 	}
 
 	// 插入到任务队列
+	m_taskLock.lock();
 	m_tasksQueue.emplace(MsgType::WRITE, startAddress, data);
+	m_statistics.setQueueDepth(m_tasksQueue.size());
+	m_taskLock.unlock();
 	m_taskCondition.notify_one();
 	return true;
 }
@@ -419,71 +524,66 @@ bool ModbusCppTcpClient::readRegistersAsync(const uint16_t startAddress, uint8_t
 	}
 
 	// 插入到任务队列
+	m_taskLock.lock();
 	m_tasksQueue.emplace(MsgType::READ, startAddress, dataLen);
+	m_statistics.setQueueDepth(m_tasksQueue.size());
+	m_taskLock.unlock();
 	m_taskCondition.notify_one();
 	return true;
 }
 
 // 异步读写数据
-std::optional<std::vector<uint16_t>> ModbusCppTcpClient::writeAndReadRegistersAsync(const uint16_t writeStartAddress, const std::vector<uint16_t>& writeData, const uint16_t readStartAddress, const uint8_t readLen)
+bool ModbusCppTcpClient::writeAndReadRegistersAsync(const uint16_t writeStartAddress, const std::vector<uint16_t>& writeData, const uint16_t readStartAddress, const uint8_t readLen)
 {
 	// 检查是否已初始化成功
 	if (!m_connected)
 	{
-		return std::nullopt;
+		return false;
 	}
 
 	// 检查数据长度
 	if (writeData.size() > DATA_LEN_MAX || readLen > DATA_LEN_MAX)
 	{
-		return std::nullopt;
-	}
-
-	// 构造写数据
-	for (int i = 0; i < writeData.size(); ++i)
-	{
-		m_writeBuffer[i] = writeData.at(i);
-	}
-
-	// 清空读缓存
-	memset(m_readBuffer, 0, DATA_LEN_MAX);
-
-	// 读写数据
-	int _readNum = modbus_write_and_read_registers(m_modbusClient, writeStartAddress, static_cast<int>(writeData.size()), m_writeBuffer, readStartAddress, readLen, m_readBuffer);
-
-	// 检查读取结果
-	if (_readNum != readLen)
-	{
-		return std::nullopt;
+		return false;
 	}
 
-	// 组装读到的数据，返回结果
-	std::vector<uint16_t> _data;
-	for (int i = 0; i < readLen; ++i)
-	{
-		_data.push_back(m_readBuffer[i]);
-	}
-	return std::optional<std::vector<uint16_t>>(_data);
+	// 插入到任务队列，读到的数据通过 m_receivedDataCallback 通知出去
+	m_taskLock.lock();
+	m_tasksQueue.emplace(MsgType::WRITE_AND_READ, writeStartAddress, writeData, readStartAddress, readLen);
+	m_statistics.setQueueDepth(m_tasksQueue.size());
+	m_taskLock.unlock();
+	m_taskCondition.notify_one();
+	return true;
 }
 
-void ModbusCppTcpClient::checkConnectionStateThread()
+void ModbusCppTcpClient::checkConnectionStateThread(std::stop_token stopToken)
 {
-	while (true)
+	while (!stopToken.stop_requested())
 	{
 		// 因为检测 [未连接 -> 连接] 有点问题(当服务器，所以只检测 [连接 -> 断开] 的状态
 		std::unique_lock<std::mutex> _lock(m_checkConnectionStateLock);
-		m_checkConnectionStateCondition.wait(_lock, [this]() {
+		if (!m_checkConnectionStateCondition.wait(_lock, stopToken, [this]() {
 			return m_connected;
-			});
+			}))
+		{
+			return;
+		}
 		_lock.unlock();
 
-		bool _b = isConnected();
-		if (_b != m_connected)
+		// 检测和更新状态在 m_lockTest 内完成，不会覆盖同时发生的断开或重新连接
+		std::unique_lock<std::mutex> _testLock(m_lockTest);
+		const bool _b = checkSocket();
+		const bool _changed = !_b && m_connected;
+		if (_changed)
 		{
 			m_checkConnectionStateLock.lock();
-			m_connected = _b;
+			m_connected = false;
 			m_checkConnectionStateLock.unlock();
+		}
+		_testLock.unlock();
 
+		if (_changed)
+		{
 			// 通知出去
 			if (nullptr != m_connectionStateChangedCallback)
 			{
@@ -521,22 +621,28 @@ void ModbusCppTcpClient::checkConnectionStateThread()
 		const int _readNum = modbus_read_registers(m_modbusClient, 0, 1, &a);
 		std::cout << "error: " << errno << ", read num: " << _readNum << std::endl;
 		*/
-		std::this_thread::sleep_for(std::chrono::duration(std::chrono::milliseconds(500)));
+		_lock.lock();
+		m_checkConnectionStateCondition.wait_for(_lock, stopToken, std::chrono::milliseconds(500), []() { return false; });
 	}
 }
 
 // 执行异步任务的线程
-void ModbusCppTcpClient::processMsgThread()
+void ModbusCppTcpClient::processMsgThread(std::stop_token stopToken)
 {
 	while (true)
 	{
 		std::unique_lock<std::mutex> _lock(m_taskLock);
-		m_taskCondition.wait(_lock, [this] { return !m_tasksQueue.empty(); });
+		if (!m_taskCondition.wait(_lock, stopToken, [this] { return !m_tasksQueue.empty(); }))
+		{
+			return;
+		}
 
-		ModbusMsg _msg = m_tasksQueue.front();
+		ModbusMsg _msg = std::move(m_tasksQueue.front());
 		m_tasksQueue.pop();
+		m_statistics.setQueueDepth(m_tasksQueue.size());
 		_lock.unlock();
 
+		t_taskEnqueueTime = _msg.enqueueTime;
 		switch (_msg.msgType)
 		{
 		case MsgType::WRITE:
@@ -571,10 +677,157 @@ void ModbusCppTcpClient::processMsgThread()
 			break;
 		}
 		case MsgType::WRITE_AND_READ:
+		{
+			const auto _result = writeAndReadRegistersSync(_msg.writeStartAddress, _msg.dataToWrite, _msg.readStartAddress, _msg.lenToRead);
+			if (_result.has_value())
+			{
+				// 读写成功
+				if (nullptr != m_receivedDataCallback)
+				{
+					m_receivedDataCallback(_msg.readStartAddress, _result.value());
+				}
+			}
+			else
+			{
+				// 读写失败
+				std::cout << "write and read failed" << std::endl;
+			}
 			break;
+		}
 		default:
 			// error
 			std::cout << "error, unhandled msg type: " << (int)_msg.msgType << std::endl;
 		}
+		t_taskEnqueueTime = std::chrono::steady_clock::time_point();
+	}
+}
+
+// 记录一次请求尝试的统计数据，失败时根据 errno 区分超时和异常响应
+// 字节数取自 libmodbus 跟踪回调报告的实际收发长度，调用前需持有 m_lockTest
+void ModbusCppTcpClient::recordAttempt(const uint8_t function, const int attempt, const bool succeeded)
+{
+	if (attempt > 0)
+	{
+		m_statistics.addRetry(function);
+	}
+
+	if (!succeeded)
+	{
+		const int _error = errno;
+		if (ETIMEDOUT == _error)
+		{
+			m_statistics.addTimeout(function);
+		}
+		else if (_error > MODBUS_ENOBASE && _error < MODBUS_ENOBASE + MODBUS_EXCEPTION_MAX)
+		{
+			m_statistics.addException(function);
+		}
+	}
+
+	m_statistics.addBytes(function, m_attemptBytesSent, m_attemptBytesReceived);
+	m_attemptBytesSent = 0;
+	m_attemptBytesReceived = 0;
+}
+
+// 开始记录一次请求的各阶段时间点，调用前需持有 m_lockTest
+void ModbusCppTcpClient::beginRequestTiming(const uint8_t function, const std::chrono::steady_clock::time_point& lockRequested)
+{
+	m_requestTiming = RequestTimingState();
+	if (!m_requestTimingEnabled)
+	{
+		return;
+	}
+
+	m_requestTiming.active = true;
+	m_requestTiming.function = function;
+	m_requestTiming.lockRequested = lockRequested;
+	m_requestTiming.lockAcquired = std::chrono::steady_clock::now();
+
+	// 异步任务从入队开始计时，同步调用从请求锁开始计时
+	const bool _fromQueue = t_taskEnqueueTime != std::chrono::steady_clock::time_point();
+	m_requestTiming.enqueued = _fromQueue ? t_taskEnqueueTime : lockRequested;
+	t_taskEnqueueTime = std::chrono::steady_clock::time_point();
+}
+
+// libmodbus 收发过程中的阶段通知，length 为本次实际写入或读到的字节数
+void ModbusCppTcpClient::onTraceEvent(const int event, const int length)
+{
+	if (MODBUS_TRACE_SEND_END == event)
+	{
+		m_attemptBytesSent += length;
+	}
+	else if (MODBUS_TRACE_RECEIVE == event)
+	{
+		m_attemptBytesReceived += length;
+	}
+	if (!m_requestTiming.active)
+	{
+		return;
+	}
+
+	const auto _now = std::chrono::steady_clock::now();
+	switch (event)
+	{
+	case MODBUS_TRACE_SEND_BEGIN:
+		// 每次重试都重新记录收发阶段
+		m_requestTiming.attempts += 1;
+		m_requestTiming.sendBegin = _now;
+		m_requestTiming.sendEnd = _now;
+		m_requestTiming.firstByte = _now;
+		m_requestTiming.receiveEnd = _now;
+		break;
+	case MODBUS_TRACE_SEND_END:
+		m_requestTiming.sendEnd = _now;
+		m_requestTiming.firstByte = _now;
+		m_requestTiming.receiveEnd = _now;
+		break;
+	case MODBUS_TRACE_FIRST_BYTE:
+		m_requestTiming.firstByte = _now;
+		m_requestTiming.receiveEnd = _now;
+		break;
+	case MODBUS_TRACE_RECEIVE_END:
+		m_requestTiming.receiveEnd = _now;
+		break;
+	default:
+		break;
+	}
+}
+
+// 结束记录，汇总到统计数据并通知出去；返回时 lock(m_lockTest) 已经释放
+// 回调在锁外执行，回调里可以再次调用同步读写或 setRequestTimingCallback()
+void ModbusCppTcpClient::finishRequestTiming(const bool succeeded, std::unique_lock<std::mutex> &lock)
+{
+	if (!m_requestTiming.active)
+	{
+		lock.unlock();
+		return;
+	}
+	m_requestTiming.active = false;
+
+	const auto _usec = [](const std::chrono::steady_clock::time_point& from, const std::chrono::steady_clock::time_point& to) -> uint64_t {
+		return to > from ? std::chrono::duration_cast<std::chrono::microseconds>(to - from).count() : 0;
+	};
+
+	const RequestTimingState& _state = m_requestTiming;
+	ModbusCppRequestTiming _timing;
+	_timing.function = _state.function;
+	_timing.succeeded = succeeded;
+	_timing.attempts = _state.attempts;
+	_timing.queueWait = _usec(_state.enqueued, _state.lockRequested);
+	_timing.lockWait = _usec(_state.lockRequested, _state.lockAcquired);
+	if (_state.attempts > 0)
+	{
+		_timing.send = _usec(_state.sendBegin, _state.sendEnd);
+		_timing.firstByte = _usec(_state.sendEnd, _state.firstByte);
+		_timing.reassembly = _usec(_state.firstByte, _state.receiveEnd);
+	}
+	_timing.total = _usec(_state.enqueued, std::chrono::steady_clock::now());
+
+	m_requestTimingStatistics.record(_timing);
+	const std::function<void (const ModbusCppRequestTiming &timing)> _callback = m_requestTimingCallback;
+	lock.unlock();
+	if (nullptr != _callback)
+	{
+		_callback(_timing);
 	}
 }
@@ -0,0 +1,328 @@
+﻿#include "ModbusCppTcpProxy.h"
+#include "modbus.h"
+#include <iostream>
+#include <algorithm>
+
+// 没有轮询到期时最长的等待时间，下游写入最多延迟这么久才转发
+static const std::chrono::milliseconds WRITE_FLUSH_INTERVAL(5);
+// 同一个写入连续转发失败这么多次后放弃，之后的轮询会把映像恢复成设备的实际值
+static const uint8_t WRITE_ATTEMPTS_MAX = 3;
+
+ModbusCppTcpProxy::ModbusCppTcpProxy()
+	: m_upstreamPort(502)
+	, m_upstreamSlaveId(1)
+	, m_reconnectInterval(1000)
+	, m_serverThreadCount(1)
+	, m_registerMap(ModbusCppRegisterMap::ByteOrder::WIRE)
+	, m_running(false)
+	, m_upstreamConnected(false)
+	, m_reconnects(0)
+	, m_polls(0)
+	, m_pollFailures(0)
+	, m_writesReceived(0)
+	, m_writesForwarded(0)
+	, m_writeFailures(0)
+{
+	m_upstream.setConnectionStateChangedCallback([this](bool connected) {
+		m_upstreamConnected = connected;
+	});
+}
+
+ModbusCppTcpProxy::~ModbusCppTcpProxy()
+{
+	stop();
+}
+
+void ModbusCppTcpProxy::setUpstream(const std::string& host, const uint16_t port, const int slaveId)
+{
+	if (!m_running)
+	{
+		m_upstreamHost = host;
+		m_upstreamPort = port;
+		m_upstreamSlaveId = slaveId;
+	}
+}
+
+void ModbusCppTcpProxy::setUpstreamTimeout(const uint64_t msec)
+{
+	if (!m_running)
+	{
+		m_upstream.setTimeout(msec);
+	}
+}
+
+void ModbusCppTcpProxy::setReconnectInterval(const uint32_t msec)
+{
+	if (!m_running)
+	{
+		m_reconnectInterval = std::chrono::milliseconds(msec);
+	}
+}
+
+void ModbusCppTcpProxy::setServerThreadCount(const size_t threadCount)
+{
+	if (!m_running && threadCount > 0)
+	{
+		m_serverThreadCount = threadCount;
+	}
+}
+
+void ModbusCppTcpProxy::setMaxConnections(const size_t maxConnections)
+{
+	m_server.setMaxConnections(maxConnections);
+}
+
+bool ModbusCppTcpProxy::addPollBlock(const uint16_t startAddress, const uint16_t count, const uint32_t intervalMs)
+{
+	if (m_running || 0 == count || 0 == intervalMs || uint32_t(startAddress) + count > 0x10000)
+	{
+		return false;
+	}
+
+	if (!m_registerMap.addRange(ModbusCppRegisterMap::Table::HOLDING_REGISTERS, startAddress, count))
+	{
+		return false;
+	}
+
+	// 按单次请求的长度拆分，每一段单独轮询
+	for (uint32_t _offset = 0; _offset < count; _offset += READ_COUNT_MAX)
+	{
+		PollBlock _block;
+		_block.startAddress = static_cast<uint16_t>(startAddress + _offset);
+		_block.count = static_cast<uint16_t>(std::min<uint32_t>(READ_COUNT_MAX, count - _offset));
+		_block.interval = std::chrono::milliseconds(intervalMs);
+		m_blocks.push_back(_block);
+	}
+	return true;
+}
+
+bool ModbusCppTcpProxy::start(const std::string& listenHost, const uint16_t listenPort)
+{
+	if (m_running || m_blocks.empty() || m_upstreamHost.empty())
+	{
+		return false;
+	}
+
+	m_server.setRegisterMap(&m_registerMap);
+	m_server.setThreadCount(m_serverThreadCount);
+	m_server.setWriteEventCapacity(WRITE_EVENT_CAPACITY);
+	if (!m_server.start(listenHost, listenPort))
+	{
+		return false;
+	}
+
+	m_pendingWrites.clear();
+	m_upstreamConnected = false;
+	const auto _now = std::chrono::steady_clock::now();
+	for (PollBlock& _block : m_blocks)
+	{
+		_block.due = _now;
+	}
+	m_reconnectDue = _now;
+
+	m_running = true;
+	m_thread = std::thread(&ModbusCppTcpProxy::proxyThread, this);
+	return true;
+}
+
+void ModbusCppTcpProxy::stop()
+{
+	if (!m_running)
+	{
+		return;
+	}
+
+	m_stopLock.lock();
+	m_running = false;
+	m_stopLock.unlock();
+	m_stopCondition.notify_one();
+	if (m_thread.joinable())
+	{
+		m_thread.join();
+	}
+
+	// 代理线程已退出，队列里剩下的写入在服务器停止前最后转发一次
+	collectWrites();
+	forwardWrites();
+	m_server.stop();
+	m_upstream.disconnectServer();
+	m_upstreamConnected = false;
+}
+
+bool ModbusCppTcpProxy::isRunning() const
+{
+	return m_running;
+}
+
+ModbusCppProxyStatistics ModbusCppTcpProxy::getStatistics() const
+{
+	ModbusCppProxyStatistics _statistics;
+	_statistics.upstreamConnected = m_upstreamConnected.load(std::memory_order_relaxed);
+	_statistics.reconnects = m_reconnects.load(std::memory_order_relaxed);
+	_statistics.polls = m_polls.load(std::memory_order_relaxed);
+	_statistics.pollFailures = m_pollFailures.load(std::memory_order_relaxed);
+	_statistics.writesReceived = m_writesReceived.load(std::memory_order_relaxed);
+	_statistics.writesForwarded = m_writesForwarded.load(std::memory_order_relaxed);
+	_statistics.writeFailures = m_writeFailures.load(std::memory_order_relaxed);
+	for (size_t i = 0; i < m_serverThreadCount; ++i)
+	{
+		const ModbusCppWriteEventRing *_events = m_server.writeEvents(i);
+		if (NULL != _events)
+		{
+			_statistics.writesDropped += _events->dropped();
+		}
+	}
+	return _statistics;
+}
+
+ModbusCppServerStatistics ModbusCppTcpProxy::getServerStatistics() const
+{
+	return m_server.getStatistics();
+}
+
+ModbusCppStatisticsSnapshot ModbusCppTcpProxy::getUpstreamStatistics() const
+{
+	return m_upstream.getStatistics();
+}
+
+void ModbusCppTcpProxy::proxyThread()
+{
+	while (m_running)
+	{
+		auto _now = std::chrono::steady_clock::now();
+		if (!m_upstreamConnected && _now >= m_reconnectDue)
+		{
+			connectUpstream();
+			m_reconnectDue = _now + m_reconnectInterval;
+		}
+
+		// 先转发写入，再轮询，轮询结果才能反映刚写入的值
+		collectWrites();
+		if (m_upstreamConnected)
+		{
+			forwardWrites();
+		}
+
+		_now = std::chrono::steady_clock::now();
+		auto _wakeup = _now + WRITE_FLUSH_INTERVAL;
+		for (PollBlock& _block : m_blocks)
+		{
+			if (m_upstreamConnected && _now >= _block.due)
+			{
+				poll(_block);
+				// 按周期推进，处理不过来时不补发积压的轮询
+				_block.due += _block.interval;
+				if (_block.due < _now)
+				{
+					_block.due = _now + _block.interval;
+				}
+			}
+			_wakeup = std::min(_wakeup, _block.due);
+		}
+		if (!m_upstreamConnected)
+		{
+			_wakeup = std::min(_wakeup, std::max(m_reconnectDue, _now));
+		}
+
+		std::unique_lock<std::mutex> _lock(m_stopLock);
+		m_stopCondition.wait_until(_lock, _wakeup, [this] { return !m_running; });
+	}
+}
+
+void ModbusCppTcpProxy::connectUpstream()
+{
+	if (m_upstream.connectServer(m_upstreamHost, m_upstreamPort, m_upstreamSlaveId))
+	{
+		m_reconnects.fetch_add(1, std::memory_order_relaxed);
+	}
+	else
+	{
+		std::cout << "connect upstream " << m_upstreamHost << ":" << m_upstreamPort << " failed" << std::endl;
+	}
+}
+
+// 把所有事件循环线程的写入合并到待转发表
+void ModbusCppTcpProxy::collectWrites()
+{
+	ModbusCppWriteEvent _event;
+	for (size_t i = 0; i < m_serverThreadCount; ++i)
+	{
+		ModbusCppWriteEventRing *_events = m_server.writeEvents(i);
+		if (NULL == _events)
+		{
+			continue;
+		}
+
+		while (_events->pop(_event))
+		{
+			m_writesReceived.fetch_add(1, std::memory_order_relaxed);
+			// 只映射了保持寄存器，线圈写入会被服务器拒绝，不会出现在队列里
+			if (MODBUS_FC_WRITE_SINGLE_COIL == _event.function || MODBUS_FC_WRITE_MULTIPLE_COILS == _event.function)
+			{
+				continue;
+			}
+			// FC22 的事件里是屏蔽运算后的值，按普通写入转发
+			for (uint16_t j = 0; j < _event.count; ++j)
+			{
+				m_pendingWrites[static_cast<uint16_t>(_event.address + j)] = PendingWrite{ _event.registerValue(j), 0 };
+			}
+		}
+	}
+}
+
+// 地址连续的待转发写入合并成一个 FC16 请求，失败的保留到下次
+void ModbusCppTcpProxy::forwardWrites()
+{
+	auto _it = m_pendingWrites.begin();
+	while (_it != m_pendingWrites.end())
+	{
+		const auto _first = _it;
+		m_values.clear();
+		do
+		{
+			m_values.push_back(_it->second.value);
+			++_it;
+		} while (_it != m_pendingWrites.end() && m_values.size() < WRITE_COUNT_MAX
+			&& uint32_t(_it->first) == uint32_t(_first->first) + m_values.size());
+
+		m_writesForwarded.fetch_add(1, std::memory_order_relaxed);
+		if (m_upstream.writeRegistersSync(_first->first, m_values))
+		{
+			m_pendingWrites.erase(_first, _it);
+			continue;
+		}
+
+		m_writeFailures.fetch_add(1, std::memory_order_relaxed);
+		for (auto _write = _first; _write != _it;)
+		{
+			if (++_write->second.attempts >= WRITE_ATTEMPTS_MAX)
+			{
+				_write = m_pendingWrites.erase(_write);
+			}
+			else
+			{
+				++_write;
+			}
+		}
+	}
+}
+
+void ModbusCppTcpProxy::poll(PollBlock& block)
+{
+	m_polls.fetch_add(1, std::memory_order_relaxed);
+	std::optional<std::vector<uint16_t>> _values = m_upstream.readRegistersSync(block.startAddress, static_cast<uint8_t>(block.count));
+	if (!_values)
+	{
+		m_pollFailures.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	// 轮询期间下游又写入的值还没有到达设备，不能被读到的旧值覆盖
+	collectWrites();
+	const uint32_t _end = uint32_t(block.startAddress) + block.count;
+	for (auto _it = m_pendingWrites.lower_bound(block.startAddress); _it != m_pendingWrites.end() && _it->first < _end; ++_it)
+	{
+		(*_values)[_it->first - block.startAddress] = _it->second.value;
+	}
+	m_registerMap.writeRegisters(ModbusCppRegisterMap::Table::HOLDING_REGISTERS, block.startAddress, *_values);
+}
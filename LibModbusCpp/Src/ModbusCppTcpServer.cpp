@@ -0,0 +1,871 @@
+﻿#include "ModbusCppTcpServer.h"
+#include "ModbusCppSocket.h"
+#include "ModbusCppMbapConnection.h"
+#include "ModbusCppUring.h"
+#include "modbus.h"
+#include <algorithm>
+#include <iostream>
+#include <thread>
+#include <unordered_map>
+#include <cstring>
+#if defined(MODBUSCPP_HAVE_IO_URING)
+#include <sys/eventfd.h>
+#endif
+
+#if defined(MODBUSCPP_HAVE_IO_URING)
+// 每个线程的 io_uring 队列长度，完成队列溢出时内核暂存(IORING_FEAT_NODROP)，multishot 操作会结束并重新提交
+static const unsigned URING_SQ_ENTRIES = 1024;
+static const unsigned URING_CQ_ENTRIES = 8192;
+// 接收缓冲区: 数据拷贝到连接的 input 后立即归还；input 中剩下的不完整帧不超过一个最大帧，一半大小保证放得下
+static const uint16_t URING_BUFFER_GROUP = 0;
+static const unsigned URING_BUFFER_COUNT = 2048;
+static const unsigned URING_BUFFER_SIZE = MBAP_INPUT_BUFFER_SIZE / 2;
+// user_data 的低 3 位是操作类型，其余为连接指针(接收/发送)
+static const uint64_t URING_OP_MASK = 0x7;
+enum UringOp : uint64_t
+{
+	URING_ACCEPT = 1,
+	URING_WAKEUP = 2,
+	URING_RECEIVE = 3,
+	URING_SEND = 4,
+	URING_CANCEL = 5,
+};
+#endif
+
+// 一个事件循环线程及其连接，按缓存行对齐避免各线程的统计计数互相干扰
+struct alignas(64) ModbusCppTcpServer::Shard
+{
+	Shard(ModbusCppRegisterMap *registerMap, const size_t cacheSlots, const size_t writeEventCapacity)
+		: processor(registerMap)
+		, cache(cacheSlots > 0 ? new ModbusCppResponseCache(registerMap, cacheSlots) : NULL)
+		, writeEvents(writeEventCapacity > 0 ? new ModbusCppWriteEventRing(writeEventCapacity) : NULL)
+	{
+		processor.setWriteEventRing(writeEvents);
+	}
+
+	~Shard()
+	{
+		delete cache;
+		delete writeEvents;
+#if defined(MODBUSCPP_HAVE_IO_URING)
+		delete uring;
+		if (-1 != wakeupEvent)
+		{
+			close(wakeupEvent);
+		}
+#endif
+	}
+
+	ModbusCppReactor            reactor;
+	int                         listenSocket = -1;
+	ModbusCppMbapAcceptor       acceptor;
+	std::thread                 thread;
+	ModbusCppRequestProcessor   processor;
+	ModbusCppResponseCache      *cache;                 // 不缓存时为 NULL
+	ModbusCppWriteEventRing     *writeEvents;           // 不发布写入事件时为 NULL
+	std::unordered_map<int, Connection *> connections;  // 只在本线程中访问
+#if defined(MODBUSCPP_HAVE_IO_URING)
+	ModbusCppUring              *uring = NULL;          // 使用事件循环时为 NULL
+	int                         wakeupEvent = -1;       // stop() 写入该 eventfd 唤醒 io_uring 线程
+	uint64_t                    wakeupValue = 0;
+	// 提交队列满(内核返回 EBUSY/EAGAIN)时推迟的请求，收割完成事件后重试
+	bool                        acceptDeferred = false;
+	bool                        wakeupDeferred = false;
+	std::vector<Connection *>   deferred;
+#endif
+
+	// 统计，只有本线程写入
+	ModbusCppMbapCounters       counters;
+	std::atomic<uint64_t>       requests{ 0 };
+	std::atomic<uint64_t>       exceptions{ 0 };
+	std::atomic<uint64_t>       waits{ 0 };
+};
+
+struct ModbusCppTcpServer::Connection : ModbusCppMbapConnection
+{
+	Shard                   *shard = NULL;          // 所属的事件循环
+
+	// 以下只在 io_uring 模式使用: 内核发送 sending 期间新的响应追加到 output，发完后一起发送
+	std::vector<uint8_t>    sending;
+	size_t                  sendingOffset = 0;
+	bool                    receiving = false;      // multishot 接收还没有结束
+	bool                    sendPending = false;    // 有未完成的发送
+	bool                    cancelling = false;     // 积压过多，已经请求取消接收
+	bool                    closing = false;        // 已经 shutdown，等未完成的操作结束后释放
+	bool                    sendDeferred = false;   // 提交队列满时没能提交的发送，下一轮重试
+	bool                    receiveDeferred = false;// 提交队列满时没能提交的接收，下一轮重试
+	bool                    deferred = false;       // 已经在 Shard::deferred 中
+};
+
+#if defined(__linux__)
+// 与 modbus_tcp_listen 相同，只是在 bind 之前打开 SO_REUSEPORT，多个套接字可以监听同一端口
+static int listenReusePort(const std::string& host, const uint16_t port)
+{
+	const int _socket = socket(PF_INET, SOCK_STREAM | SOCK_CLOEXEC, IPPROTO_TCP);
+	if (-1 == _socket)
+	{
+		return -1;
+	}
+
+	int _enable = 1;
+	sockaddr_in _address = {};
+	_address.sin_family = AF_INET;
+	_address.sin_port = htons(port);
+	if ('0' == host[0])
+	{
+		_address.sin_addr.s_addr = htonl(INADDR_ANY);
+	}
+	if (0 != setsockopt(_socket, SOL_SOCKET, SO_REUSEADDR, &_enable, sizeof(_enable))
+		|| 0 != setsockopt(_socket, SOL_SOCKET, SO_REUSEPORT, &_enable, sizeof(_enable))
+		|| ('0' != host[0] && inet_pton(AF_INET, host.c_str(), &_address.sin_addr) <= 0)
+		|| 0 != bind(_socket, reinterpret_cast<sockaddr *>(&_address), sizeof(_address))
+		|| 0 != listen(_socket, MBAP_LISTEN_BACKLOG))
+	{
+		close(_socket);
+		return -1;
+	}
+	return _socket;
+}
+#endif
+
+ModbusCppTcpServer::ModbusCppTcpServer()
+	: m_registerMap(NULL)
+	, m_maxConnections(MBAP_MAX_CONNECTIONS_DEFAULT)
+	, m_threadCount(1)
+	, m_responseCacheSlots(0)
+	, m_writeEventCapacity(0)
+	, m_ioUringEnabled(false)
+	, m_ioUring(false)
+	, m_listenContext(NULL)
+	, m_listenSocket(-1)
+	, m_running(false)
+	, m_connectionsCount(0)
+{
+}
+
+ModbusCppTcpServer::~ModbusCppTcpServer()
+{
+	stop();
+}
+
+void ModbusCppTcpServer::setRegisterMap(ModbusCppRegisterMap *registerMap)
+{
+	if (!m_running)
+	{
+		m_registerMap = registerMap;
+	}
+}
+
+void ModbusCppTcpServer::setMaxConnections(const size_t maxConnections)
+{
+	if (!m_running)
+	{
+		m_maxConnections = maxConnections;
+	}
+}
+
+void ModbusCppTcpServer::setThreadCount(const size_t threadCount)
+{
+	if (!m_running && threadCount > 0)
+	{
+		m_threadCount = threadCount;
+	}
+}
+
+void ModbusCppTcpServer::setResponseCacheSlots(const size_t slots)
+{
+	if (!m_running && 0 == (slots & (slots - 1)))
+	{
+		m_responseCacheSlots = slots;
+	}
+}
+
+void ModbusCppTcpServer::setWriteEventCapacity(const size_t capacity)
+{
+	if (!m_running)
+	{
+		m_writeEventCapacity = capacity;
+	}
+}
+
+void ModbusCppTcpServer::setIoUringEnabled(const bool enabled)
+{
+	if (!m_running)
+	{
+		m_ioUringEnabled = enabled;
+	}
+}
+
+bool ModbusCppTcpServer::start(const std::string& host, const uint16_t port)
+{
+	if (m_running || NULL == m_registerMap || host.empty())
+	{
+		return false;
+	}
+
+	// 单线程或不支持 SO_REUSEPORT 负载均衡的平台，由 libmodbus 创建一个监听套接字供所有线程共享
+#if defined(__linux__)
+	const bool _reusePort = m_threadCount > 1;
+#else
+	const bool _reusePort = false;
+#endif
+	if (!_reusePort)
+	{
+		m_listenContext = modbus_new_tcp(host.c_str(), port);
+		if (NULL == m_listenContext)
+		{
+			return false;
+		}
+		m_listenSocket = modbus_tcp_listen(m_listenContext, MBAP_LISTEN_BACKLOG);
+		if (-1 == m_listenSocket || !socketSetNonBlocking(m_listenSocket))
+		{
+			std::cout << "listen failed: " << modbus_strerror(errno) << std::endl;
+			release();
+			return false;
+		}
+	}
+
+	for (size_t i = 0; i < m_threadCount; ++i)
+	{
+		Shard *_shard = new Shard(m_registerMap, m_responseCacheSlots, m_writeEventCapacity);
+		m_shards.push_back(_shard);
+#if defined(__linux__)
+		_shard->listenSocket = _reusePort ? listenReusePort(host, port) : m_listenSocket;
+#else
+		_shard->listenSocket = m_listenSocket;
+#endif
+		if (-1 == _shard->listenSocket || (_reusePort && !socketSetNonBlocking(_shard->listenSocket)))
+		{
+			std::cout << "listen failed: " << modbus_strerror(errno) << std::endl;
+			release();
+			return false;
+		}
+	}
+
+	// 任何一个线程的 io_uring 创建失败都退回事件循环
+	m_ioUring = m_ioUringEnabled && openUrings();
+	for (Shard *_shard : m_shards)
+	{
+		if (!m_ioUring && (!_shard->reactor.open()
+			|| !_shard->reactor.addSocket(_shard->listenSocket, ModbusCppReactor::READABLE, [this, _shard](const uint32_t) { acceptConnections(_shard); })))
+		{
+			std::cout << "listen failed: " << modbus_strerror(errno) << std::endl;
+			release();
+			return false;
+		}
+	}
+
+	m_running = true;
+	for (Shard *_shard : m_shards)
+	{
+#if defined(MODBUSCPP_HAVE_IO_URING)
+		if (m_ioUring)
+		{
+			_shard->thread = std::thread(&ModbusCppTcpServer::uringThread, this, _shard);
+			continue;
+		}
+#endif
+		_shard->thread = std::thread(&ModbusCppTcpServer::reactorThread, this, _shard);
+	}
+	return true;
+}
+
+void ModbusCppTcpServer::stop()
+{
+	if (!m_running)
+	{
+		return;
+	}
+
+	m_running = false;
+	for (Shard *_shard : m_shards)
+	{
+#if defined(MODBUSCPP_HAVE_IO_URING)
+		if (NULL != _shard->uring)
+		{
+			const uint64_t _value = 1;
+			const ssize_t _written = write(_shard->wakeupEvent, &_value, sizeof(_value));
+			(void)_written;
+			continue;
+		}
+#endif
+		_shard->reactor.wakeup();
+	}
+	for (Shard *_shard : m_shards)
+	{
+		if (_shard->thread.joinable())
+		{
+			_shard->thread.join();
+		}
+	}
+	release();
+}
+
+// 事件循环都已退出(或还没启动)，在当前线程清理所有连接和监听套接字
+void ModbusCppTcpServer::release()
+{
+	for (Shard *_shard : m_shards)
+	{
+#if defined(MODBUSCPP_HAVE_IO_URING)
+		// 先关闭 io_uring，内核放弃未完成的收发之后才能直接释放连接
+		// 内核异步回收环，multishot accept 会多持有监听套接字一段时间: 先 shutdown 停止监听，重新启动时端口可以立即绑定
+		if (NULL != _shard->uring)
+		{
+			if (-1 != _shard->listenSocket)
+			{
+				shutdown(_shard->listenSocket, SHUT_RDWR);
+			}
+			_shard->uring->close();
+		}
+#endif
+		while (!_shard->connections.empty())
+		{
+			closeConnection(_shard->connections.begin()->second);
+		}
+		if (-1 != _shard->listenSocket)
+		{
+			_shard->reactor.removeSocket(_shard->listenSocket);
+			if (_shard->listenSocket != m_listenSocket)
+			{
+				socketClose(_shard->listenSocket);
+			}
+		}
+		_shard->reactor.close();
+		delete _shard;
+	}
+	m_shards.clear();
+	m_ioUring = false;
+
+	if (-1 != m_listenSocket)
+	{
+		socketClose(m_listenSocket);
+		m_listenSocket = -1;
+	}
+	if (NULL != m_listenContext)
+	{
+		modbus_free(m_listenContext);
+		m_listenContext = NULL;
+	}
+}
+
+bool ModbusCppTcpServer::isRunning() const
+{
+	return m_running;
+}
+
+ModbusCppServerStatistics ModbusCppTcpServer::getStatistics() const
+{
+	ModbusCppServerStatistics _statistics;
+	_statistics.connections = m_connectionsCount.load(std::memory_order_relaxed);
+	for (const Shard *_shard : m_shards)
+	{
+		const ModbusCppMbapCounters& _counters = _shard->counters;
+		_statistics.connectionsAccepted += _counters.connectionsAccepted.load(std::memory_order_relaxed);
+		_statistics.connectionsRejected += _counters.connectionsRejected.load(std::memory_order_relaxed);
+		_statistics.requests += _shard->requests.load(std::memory_order_relaxed);
+		_statistics.exceptions += _shard->exceptions.load(std::memory_order_relaxed);
+		_statistics.protocolErrors += _counters.protocolErrors.load(std::memory_order_relaxed);
+		_statistics.bytesReceived += _counters.bytesReceived.load(std::memory_order_relaxed);
+		_statistics.bytesSent += _counters.bytesSent.load(std::memory_order_relaxed);
+		_statistics.receives += _counters.receives.load(std::memory_order_relaxed);
+		_statistics.sends += _counters.sends.load(std::memory_order_relaxed);
+		_statistics.waits += _shard->waits.load(std::memory_order_relaxed);
+		if (NULL != _shard->cache)
+		{
+			_statistics.cacheHits += _shard->cache->hits();
+			_statistics.cacheMisses += _shard->cache->misses();
+		}
+	}
+	return _statistics;
+}
+
+const char *ModbusCppTcpServer::ioEngineName() const
+{
+	if (m_shards.empty())
+	{
+		return "";
+	}
+	return m_ioUring ? "io_uring" : m_shards.front()->reactor.backendName();
+}
+
+ModbusCppWriteEventRing *ModbusCppTcpServer::writeEvents(const size_t thread) const
+{
+	return m_running && thread < m_shards.size() ? m_shards[thread]->writeEvents : NULL;
+}
+
+void ModbusCppTcpServer::reactorThread(Shard *shard)
+{
+	while (m_running)
+	{
+		shard->waits.fetch_add(1, std::memory_order_relaxed);
+		if (shard->reactor.runOnce(-1) < 0)
+		{
+			std::cout << "reactor error" << std::endl;
+			break;
+		}
+	}
+}
+
+void ModbusCppTcpServer::acceptConnections(Shard *shard)
+{
+	shard->acceptor.acceptConnections(shard->listenSocket, shard->counters, [this, shard](const int socket) { acceptConnection(shard, socket); });
+}
+
+// 接管一个新连接，超过最大连接数或注册失败时关闭
+bool ModbusCppTcpServer::acceptConnection(Shard *shard, const int socket)
+{
+	if (m_connectionsCount.fetch_add(1, std::memory_order_relaxed) >= m_maxConnections)
+	{
+		m_connectionsCount.fetch_sub(1, std::memory_order_relaxed);
+		socketClose(socket);
+		shard->counters.connectionsRejected.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	socketSetNoDelay(socket);
+
+	Connection *_connection = new Connection();
+	_connection->shard = shard;
+	_connection->socket = socket;
+	bool _registered = false;
+#if defined(MODBUSCPP_HAVE_IO_URING)
+	if (NULL != shard->uring)
+	{
+		// io_uring 自己等待就绪，套接字保持阻塞模式
+		uringReceive(_connection);
+		_registered = true;
+	}
+	else
+#endif
+	{
+		// ModbusCppMbapAcceptor 取出的连接已经是非阻塞的
+		_connection->events = ModbusCppReactor::READABLE;
+		_registered = shard->reactor.addSocket(socket, _connection->events, [this, _connection](const uint32_t events) { onConnectionEvent(_connection, events); });
+	}
+	if (!_registered)
+	{
+		m_connectionsCount.fetch_sub(1, std::memory_order_relaxed);
+		socketClose(socket);
+		delete _connection;
+		return false;
+	}
+
+	shard->connections.emplace(socket, _connection);
+	shard->counters.connectionsAccepted.fetch_add(1, std::memory_order_relaxed);
+	return true;
+}
+
+void ModbusCppTcpServer::onConnectionEvent(Connection *connection, const uint32_t events)
+{
+	Shard *_shard = connection->shard;
+	if (!connection->onEvents(events, _shard->reactor, _shard->counters, [this, connection](const uint8_t *frame, const size_t length) {
+		processFrame(connection, frame, length);
+		}))
+	{
+		closeConnection(connection);
+	}
+}
+
+// 处理一个完整的请求，响应直接追加到 output，一批请求处理完后一次发送
+// 客户端流水线发送多个请求时，一次 recv 和一次 send 就能完成一批请求
+void ModbusCppTcpServer::processFrame(Connection *connection, const uint8_t *frame, const size_t length)
+{
+	Shard *_shard = connection->shard;
+	const size_t _offset = connection->output.size();
+	connection->output.resize(_offset + MBAP_LENGTH + ModbusCppRequestProcessor::PDU_MAX_LENGTH);
+	uint8_t *_response = connection->output.data() + _offset;
+
+	// 命中缓存时直接得到完整响应，否则交给处理器，可缓存的响应处理完后放入缓存
+	int _responseLength = NULL != _shard->cache ? _shard->cache->lookup(frame, length, _response) : 0;
+	if (0 == _responseLength)
+	{
+		// 寄存器存储自身是线程安全的，各线程不需要额外加锁
+		const int _pduLength = _shard->processor.process(frame + MBAP_LENGTH, static_cast<int>(length - MBAP_LENGTH), _response + MBAP_LENGTH, frame[6]);
+
+		// 响应沿用请求的事务标识和单元标识
+		memcpy(_response, frame, 2);
+		_response[2] = 0;
+		_response[3] = 0;
+		_response[4] = static_cast<uint8_t>((_pduLength + 1) >> 8);
+		_response[5] = static_cast<uint8_t>((_pduLength + 1) & 0xFF);
+		_response[6] = frame[6];
+		_responseLength = static_cast<int>(MBAP_LENGTH) + _pduLength;
+		if (NULL != _shard->cache)
+		{
+			_shard->cache->store(_response, _responseLength);
+		}
+	}
+
+	_shard->requests.fetch_add(1, std::memory_order_relaxed);
+	if (_response[MBAP_LENGTH] & 0x80)
+	{
+		_shard->exceptions.fetch_add(1, std::memory_order_relaxed);
+	}
+	connection->output.resize(_offset + _responseLength);
+}
+
+void ModbusCppTcpServer::closeConnection(Connection *connection)
+{
+	Shard *_shard = connection->shard;
+#if defined(MODBUSCPP_HAVE_IO_URING)
+	// 推迟的请求不再提交
+	if (connection->deferred)
+	{
+		_shard->deferred.erase(std::find(_shard->deferred.begin(), _shard->deferred.end(), connection));
+		connection->deferred = false;
+		connection->sendDeferred = false;
+		connection->receiveDeferred = false;
+	}
+	// 内核还持有连接的缓冲区时不能释放: shutdown 让未完成的收发尽快结束，最后一个完成事件里再次调用时释放
+	if (NULL != _shard->uring && _shard->uring->isOpen() && (connection->receiving || connection->sendPending))
+	{
+		if (!connection->closing)
+		{
+			connection->closing = true;
+			shutdown(connection->socket, SHUT_RDWR);
+		}
+		return;
+	}
+#endif
+	_shard->reactor.removeSocket(connection->socket);
+	socketClose(connection->socket);
+	_shard->connections.erase(connection->socket);
+	m_connectionsCount.fetch_sub(1, std::memory_order_relaxed);
+	delete connection;
+}
+
+// 为每个线程创建 io_uring、注册接收缓冲区和唤醒用的 eventfd，任何一步失败都全部撤销
+bool ModbusCppTcpServer::openUrings()
+{
+#if defined(MODBUSCPP_HAVE_IO_URING)
+	for (Shard *_shard : m_shards)
+	{
+		_shard->uring = new ModbusCppUring();
+		_shard->wakeupEvent = eventfd(0, EFD_CLOEXEC);
+		if (!_shard->uring->open(URING_SQ_ENTRIES, URING_CQ_ENTRIES)
+			|| !_shard->uring->setupBuffers(URING_BUFFER_GROUP, URING_BUFFER_COUNT, URING_BUFFER_SIZE)
+			|| -1 == _shard->wakeupEvent)
+		{
+			for (Shard *_opened : m_shards)
+			{
+				delete _opened->uring;
+				_opened->uring = NULL;
+				if (-1 != _opened->wakeupEvent)
+				{
+					close(_opened->wakeupEvent);
+					_opened->wakeupEvent = -1;
+				}
+			}
+			std::cout << "io_uring unavailable, using " << m_shards.front()->reactor.backendName() << std::endl;
+			return false;
+		}
+	}
+	return true;
+#else
+	return false;
+#endif
+}
+
+#if defined(MODBUSCPP_HAVE_IO_URING)
+static uint64_t uringData(const void *pointer, const UringOp op)
+{
+	return reinterpret_cast<uint64_t>(pointer) | op;
+}
+
+// 每轮一次 io_uring_enter: 提交上一轮处理完成事件时产生的所有收发请求，并等待新的完成事件
+void ModbusCppTcpServer::uringThread(Shard *shard)
+{
+	ModbusCppUring *_uring = shard->uring;
+	if (!_uring->enable())
+	{
+		std::cout << "io_uring error" << std::endl;
+		return;
+	}
+	uringAccept(shard);
+	uringReadWakeup(shard);
+
+	while (m_running)
+	{
+		shard->waits.fetch_add(1, std::memory_order_relaxed);
+		if (_uring->submit(1) < 0)
+		{
+			std::cout << "io_uring error" << std::endl;
+			break;
+		}
+
+		io_uring_cqe *_cqe = NULL;
+		while (m_running && NULL != (_cqe = _uring->peekCqe()))
+		{
+			const uint64_t _data = _cqe->user_data;
+			const int _result = _cqe->res;
+			const uint32_t _flags = _cqe->flags;
+			_uring->seenCqe();
+
+			Connection *_connection = reinterpret_cast<Connection *>(_data & ~URING_OP_MASK);
+			switch (_data & URING_OP_MASK)
+			{
+			case URING_ACCEPT:
+				if (_result >= 0)
+				{
+					acceptConnection(shard, _result);
+				}
+				// 描述符用尽时等待的连接一直留在队列里，重新提交会立即再次失败
+				else if (-EMFILE == _result || -ENFILE == _result)
+				{
+					shard->acceptor.rejectConnections(shard->listenSocket, shard->counters);
+				}
+				// multishot accept 结束(出错或完成队列溢出)后重新提交
+				if (0 == (_flags & IORING_CQE_F_MORE))
+				{
+					uringAccept(shard);
+				}
+				break;
+			case URING_WAKEUP:
+				uringReadWakeup(shard);
+				break;
+			case URING_RECEIVE:
+				uringReceived(_connection, _result, _flags);
+				break;
+			case URING_SEND:
+				uringSent(_connection, _result);
+				break;
+			default:
+				// 取消请求自身的完成事件
+				break;
+			}
+		}
+		// 完成事件收割后提交队列和完成队列都有了空位
+		uringSubmitDeferred(shard);
+	}
+}
+
+void ModbusCppTcpServer::uringAccept(Shard *shard)
+{
+	io_uring_sqe *_sqe = shard->uring->getSqe();
+	if (NULL == _sqe)
+	{
+		shard->acceptDeferred = true;
+		return;
+	}
+	_sqe->opcode = IORING_OP_ACCEPT;
+	_sqe->fd = shard->listenSocket;
+	_sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+	_sqe->accept_flags = SOCK_CLOEXEC;
+	_sqe->user_data = uringData(NULL, URING_ACCEPT);
+}
+
+void ModbusCppTcpServer::uringReadWakeup(Shard *shard)
+{
+	io_uring_sqe *_sqe = shard->uring->getSqe();
+	if (NULL == _sqe)
+	{
+		shard->wakeupDeferred = true;
+		return;
+	}
+	_sqe->opcode = IORING_OP_READ;
+	_sqe->fd = shard->wakeupEvent;
+	_sqe->addr = reinterpret_cast<uint64_t>(&shard->wakeupValue);
+	_sqe->len = sizeof(shard->wakeupValue);
+	_sqe->user_data = uringData(NULL, URING_WAKEUP);
+}
+
+// multishot recv: 一次提交持续接收，每次数据到达由内核挑选一个共享缓冲区，空闲连接不占用接收缓冲区
+void ModbusCppTcpServer::uringReceive(Connection *connection)
+{
+	io_uring_sqe *_sqe = connection->shard->uring->getSqe();
+	if (NULL == _sqe)
+	{
+		connection->receiveDeferred = true;
+		uringDefer(connection);
+		return;
+	}
+	_sqe->opcode = IORING_OP_RECV;
+	_sqe->fd = connection->socket;
+	_sqe->ioprio = IORING_RECV_MULTISHOT;
+	_sqe->flags = IOSQE_BUFFER_SELECT;
+	_sqe->buf_group = URING_BUFFER_GROUP;
+	_sqe->user_data = uringData(connection, URING_RECEIVE);
+	connection->receiving = true;
+}
+
+void ModbusCppTcpServer::uringReceived(Connection *connection, const int result, const uint32_t flags)
+{
+	Shard *_shard = connection->shard;
+	if (0 == (flags & IORING_CQE_F_MORE))
+	{
+		connection->receiving = false;
+		connection->cancelling = false;
+	}
+
+	if (result > 0)
+	{
+		const uint16_t _buffer = static_cast<uint16_t>(flags >> IORING_CQE_BUFFER_SHIFT);
+		if (!connection->closing)
+		{
+			memcpy(connection->input + connection->inputEnd, _shard->uring->buffer(_buffer), result);
+			connection->inputEnd += result;
+			_shard->counters.bytesReceived.fetch_add(result, std::memory_order_relaxed);
+			_shard->counters.receives.fetch_add(1, std::memory_order_relaxed);
+		}
+		_shard->uring->recycleBuffer(_buffer);
+
+		// 返回 false 时连接已经关闭，不能再访问
+		if (!connection->closing && !uringProcessFrames(connection))
+		{
+			return;
+		}
+	}
+
+	// 对端关闭或出错；缓冲区用完(ENOBUFS)或因积压被取消时只是接收结束
+	if (connection->closing || 0 == result || (result < 0 && -ENOBUFS != result && -ECANCELED != result))
+	{
+		closeConnection(connection);
+		return;
+	}
+	uringUpdateReceive(connection);
+}
+
+// 处理收到的请求，响应交给 uringSend 发送；MBAP 头非法时关闭连接并返回 false
+bool ModbusCppTcpServer::uringProcessFrames(Connection *connection)
+{
+	if (!connection->takeFrames(connection->shard->counters, [this, connection](const uint8_t *frame, const size_t length) {
+		processFrame(connection, frame, length);
+		}))
+	{
+		closeConnection(connection);
+		return false;
+	}
+	uringSend(connection);
+	return true;
+}
+
+// 同一连接同时只有一个发送
+void ModbusCppTcpServer::uringSend(Connection *connection)
+{
+	if (connection->sendPending || connection->sendDeferred || connection->output.empty())
+	{
+		return;
+	}
+	connection->sending.swap(connection->output);
+	connection->sendingOffset = 0;
+	uringSubmitSend(connection);
+}
+
+void ModbusCppTcpServer::uringSubmitSend(Connection *connection)
+{
+	io_uring_sqe *_sqe = connection->shard->uring->getSqe();
+	if (NULL == _sqe)
+	{
+		connection->sendDeferred = true;
+		uringDefer(connection);
+		return;
+	}
+	_sqe->opcode = IORING_OP_SEND;
+	_sqe->fd = connection->socket;
+	_sqe->addr = reinterpret_cast<uint64_t>(connection->sending.data() + connection->sendingOffset);
+	_sqe->len = static_cast<uint32_t>(connection->sending.size() - connection->sendingOffset);
+	_sqe->msg_flags = MSG_NOSIGNAL;
+	_sqe->user_data = uringData(connection, URING_SEND);
+	connection->sendPending = true;
+}
+
+void ModbusCppTcpServer::uringSent(Connection *connection, const int result)
+{
+	Shard *_shard = connection->shard;
+	connection->sendPending = false;
+	if (connection->closing || result <= 0)
+	{
+		closeConnection(connection);
+		return;
+	}
+
+	connection->sendingOffset += result;
+	_shard->counters.bytesSent.fetch_add(result, std::memory_order_relaxed);
+	_shard->counters.sends.fetch_add(1, std::memory_order_relaxed);
+	if (connection->sendingOffset < connection->sending.size())
+	{
+		uringSubmitSend(connection);
+	}
+	else
+	{
+		// 清空但保留容量，下次和 output 交换
+		connection->sending.clear();
+		connection->sendingOffset = 0;
+		uringSend(connection);
+	}
+	uringUpdateReceive(connection);
+}
+
+// 与事件循环相同，待发送数据过多时暂停接收(取消 multishot recv)，发送完成后再恢复
+void ModbusCppTcpServer::uringUpdateReceive(Connection *connection)
+{
+	const size_t _pending = connection->output.size() + connection->sending.size() - connection->sendingOffset;
+	if (_pending < MBAP_OUTPUT_HIGH_WATER)
+	{
+		if (!connection->receiving && !connection->receiveDeferred)
+		{
+			uringReceive(connection);
+		}
+		return;
+	}
+
+	if (connection->receiving && !connection->cancelling)
+	{
+		io_uring_sqe *_sqe = connection->shard->uring->getSqe();
+		if (NULL == _sqe)
+		{
+			return;
+		}
+		_sqe->opcode = IORING_OP_ASYNC_CANCEL;
+		_sqe->fd = -1;
+		_sqe->addr = uringData(connection, URING_RECEIVE);
+		_sqe->user_data = uringData(NULL, URING_CANCEL);
+		connection->cancelling = true;
+	}
+}
+
+void ModbusCppTcpServer::uringDefer(Connection *connection)
+{
+	if (!connection->deferred)
+	{
+		connection->deferred = true;
+		connection->shard->deferred.push_back(connection);
+	}
+}
+
+// 重新提交推迟的请求，仍然没有空位的继续推迟到下一轮
+void ModbusCppTcpServer::uringSubmitDeferred(Shard *shard)
+{
+	if (shard->acceptDeferred)
+	{
+		shard->acceptDeferred = false;
+		uringAccept(shard);
+	}
+	if (shard->wakeupDeferred)
+	{
+		shard->wakeupDeferred = false;
+		uringReadWakeup(shard);
+	}
+	if (shard->deferred.empty())
+	{
+		return;
+	}
+
+	std::vector<Connection *> _deferred;
+	_deferred.swap(shard->deferred);
+	for (Connection *_connection : _deferred)
+	{
+		_connection->deferred = false;
+		if (_connection->sendDeferred)
+		{
+			_connection->sendDeferred = false;
+			uringSubmitSend(_connection);
+		}
+		if (_connection->receiveDeferred)
+		{
+			_connection->receiveDeferred = false;
+			uringUpdateReceive(_connection);
+		}
+	}
+}
+#endif
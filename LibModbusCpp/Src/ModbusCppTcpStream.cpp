@@ -0,0 +1,166 @@
+﻿#include "ModbusCppTcpStream.h"
+#include "ModbusCppSocket.h"
+#if !defined(_WIN32)
+#include <poll.h>
+#endif
+
+#if defined(_WIN32)
+typedef WSAPOLLFD PollFd;
+#define pollSockets WSAPoll
+#else
+typedef struct pollfd PollFd;
+#define pollSockets poll
+#endif
+
+// 发送缓冲区满时最多等待这么久
+static const int WRITE_TIMEOUT_MS = 1000;
+
+ModbusCppTcpStream::ModbusCppTcpStream()
+	: m_socket(-1)
+#if defined(_WIN32)
+	, m_winsockStarted(false)
+#endif
+{
+}
+
+ModbusCppTcpStream::~ModbusCppTcpStream()
+{
+	close();
+}
+
+bool ModbusCppTcpStream::connect(const std::string& host, const uint16_t port, const uint32_t timeoutMs)
+{
+	close();
+
+#if defined(_WIN32)
+	WSADATA _data;
+	if (0 != WSAStartup(MAKEWORD(2, 2), &_data))
+	{
+		return false;
+	}
+	m_winsockStarted = true;
+#endif
+
+	sockaddr_in _address = {};
+	_address.sin_family = AF_INET;
+	_address.sin_port = htons(port);
+	if (inet_pton(AF_INET, host.c_str(), &_address.sin_addr) <= 0)
+	{
+		close();
+		return false;
+	}
+
+	m_socket = static_cast<int>(::socket(AF_INET, SOCK_STREAM, 0));
+	if (-1 == m_socket || !socketSetNonBlocking(m_socket))
+	{
+		close();
+		return false;
+	}
+	socketSetNoDelay(m_socket);
+
+	// 非阻塞连接，等到可写后检查结果
+	if (0 != ::connect(m_socket, reinterpret_cast<sockaddr *>(&_address), sizeof(_address)))
+	{
+#if defined(_WIN32)
+		const bool _inProgress = WSAEWOULDBLOCK == WSAGetLastError();
+#else
+		const bool _inProgress = EINPROGRESS == errno;
+#endif
+		int _error = 0;
+		socklen_t _errorLength = sizeof(_error);
+		if (!_inProgress || !waitFor(POLLOUT, static_cast<int>(timeoutMs))
+			|| 0 != getsockopt(m_socket, SOL_SOCKET, SO_ERROR, reinterpret_cast<char *>(&_error), &_errorLength) || 0 != _error)
+		{
+			close();
+			return false;
+		}
+	}
+	return true;
+}
+
+void ModbusCppTcpStream::close()
+{
+	if (-1 != m_socket)
+	{
+		socketClose(m_socket);
+		m_socket = -1;
+	}
+#if defined(_WIN32)
+	if (m_winsockStarted)
+	{
+		WSACleanup();
+		m_winsockStarted = false;
+	}
+#endif
+}
+
+bool ModbusCppTcpStream::isOpen() const
+{
+	return -1 != m_socket;
+}
+
+// 等待套接字可读/可写，超时或出错返回 false
+bool ModbusCppTcpStream::waitFor(const short events, const int timeoutMs)
+{
+	PollFd _pollfd = {};
+	_pollfd.fd = m_socket;
+	_pollfd.events = events;
+	const int _ready = pollSockets(&_pollfd, 1, timeoutMs);
+	return _ready > 0 && 0 != (_pollfd.revents & (events | POLLHUP | POLLERR));
+}
+
+int ModbusCppTcpStream::write(const uint8_t *data, const size_t length)
+{
+	size_t _written = 0;
+	while (_written < length && -1 != m_socket)
+	{
+		const int _result = socketSend(m_socket, data + _written, length - _written);
+		if (_result > 0)
+		{
+			_written += _result;
+			continue;
+		}
+		if (_result < 0 && socketWouldBlock() && waitFor(POLLOUT, WRITE_TIMEOUT_MS))
+		{
+			continue;
+		}
+		close();
+		return -1;
+	}
+	return -1 == m_socket ? -1 : static_cast<int>(_written);
+}
+
+int ModbusCppTcpStream::read(uint8_t *data, const size_t length, const uint32_t timeoutUsec)
+{
+	if (-1 == m_socket)
+	{
+		return -1;
+	}
+	// poll 的精度是毫秒，向上取整
+	if (timeoutUsec > 0 && !waitFor(POLLIN, static_cast<int>((timeoutUsec + 999) / 1000)))
+	{
+		return 0;
+	}
+
+	const int _result = socketReceive(m_socket, data, length);
+	if (_result > 0)
+	{
+		return _result;
+	}
+	if (_result < 0 && socketWouldBlock())
+	{
+		return 0;
+	}
+	// 对端关闭或连接出错
+	close();
+	return -1;
+}
+
+void ModbusCppTcpStream::flush()
+{
+	// 对端已经关闭时 read() 会关闭套接字，调用方随后通过 isOpen() 发现并重连
+	uint8_t _discard[256];
+	while (read(_discard, sizeof(_discard), 0) > 0)
+	{
+	}
+}
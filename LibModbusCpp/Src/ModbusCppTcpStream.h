@@ -0,0 +1,35 @@
+﻿#pragma once
+#include <string>
+
+#include "ModbusCppRtuTransport.h"
+
+// 内部使用: 串口服务器(透传模式)的 TCP 连接，字节流中直接是 RTU 帧(带 CRC，没有 MBAP 头)
+// 套接字为非阻塞模式并关闭 Nagle 算法，一个请求帧一次 send 发出
+class ModbusCppTcpStream : public ModbusCppRtuTransport
+{
+public:
+    ModbusCppTcpStream();
+    ~ModbusCppTcpStream() override;
+
+    ModbusCppTcpStream(const ModbusCppTcpStream &) = delete;
+    ModbusCppTcpStream &operator=(const ModbusCppTcpStream &) = delete;
+
+    // host 为 IPv4 地址
+    bool connect(const std::string &host, const uint16_t port, const uint32_t timeoutMs);
+    void close() override;
+    bool isOpen() const override;
+
+    int write(const uint8_t *data, const size_t length) override;
+    // 对端关闭连接时关闭套接字并返回 -1
+    int read(uint8_t *data, const size_t length, const uint32_t timeoutUsec) override;
+    // 丢弃已经到达的数据，对端关闭或连接出错时同时关闭套接字
+    void flush() override;
+
+private:
+    bool waitFor(const short events, const int timeoutMs);
+
+    int m_socket;
+#if defined(_WIN32)
+    bool m_winsockStarted;
+#endif
+};
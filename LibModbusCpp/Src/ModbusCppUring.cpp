@@ -0,0 +1,267 @@
+﻿#include "ModbusCppUring.h"
+#if defined(MODBUSCPP_HAVE_IO_URING)
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+
+static int uringSetup(const unsigned entries, io_uring_params *params)
+{
+	return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+static int uringEnter(const int fd, const unsigned toSubmit, const unsigned minComplete, const unsigned flags)
+{
+	return static_cast<int>(syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, NULL, 0));
+}
+
+static int uringRegister(const int fd, const unsigned opcode, const void *arg, const unsigned count)
+{
+	return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, count));
+}
+
+// 与内核共享的队列下标
+static unsigned loadAcquire(unsigned *index)
+{
+	return std::atomic_ref<unsigned>(*index).load(std::memory_order_acquire);
+}
+
+static void storeRelease(unsigned *index, const unsigned value)
+{
+	std::atomic_ref<unsigned>(*index).store(value, std::memory_order_release);
+}
+
+ModbusCppUring::ModbusCppUring()
+	: m_fd(-1)
+	, m_ring(NULL)
+	, m_ringSize(0)
+	, m_sqes(NULL)
+	, m_sqesSize(0)
+	, m_sqHead(NULL)
+	, m_sqTail(NULL)
+	, m_sqMask(0)
+	, m_sqEntries(0)
+	, m_sqLocalTail(0)
+	, m_cqHead(NULL)
+	, m_cqTail(NULL)
+	, m_cqMask(0)
+	, m_cqes(NULL)
+	, m_bufferRing(NULL)
+	, m_bufferRingSize(0)
+	, m_buffers(NULL)
+	, m_buffersSize(0)
+	, m_bufferCount(0)
+	, m_bufferSize(0)
+	, m_bufferTail(0)
+{
+}
+
+ModbusCppUring::~ModbusCppUring()
+{
+	close();
+}
+
+bool ModbusCppUring::open(const unsigned sqEntries, const unsigned cqEntries)
+{
+	if (-1 != m_fd)
+	{
+		return true;
+	}
+
+	// DEFER_TASKRUN: 完成事件只在事件循环线程等待时处理，不打断正在处理请求的线程
+	io_uring_params _params = {};
+	_params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_R_DISABLED | IORING_SETUP_SUBMIT_ALL
+		| IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN;
+	_params.cq_entries = cqEntries;
+	m_fd = uringSetup(sqEntries, &_params);
+	if (-1 == m_fd)
+	{
+		return false;
+	}
+	if (0 == (_params.features & IORING_FEAT_SINGLE_MMAP) || 0 == (_params.features & IORING_FEAT_NODROP))
+	{
+		close();
+		return false;
+	}
+
+	const size_t _sqSize = _params.sq_off.array + _params.sq_entries * sizeof(unsigned);
+	const size_t _cqSize = _params.cq_off.cqes + _params.cq_entries * sizeof(io_uring_cqe);
+	m_ringSize = _sqSize > _cqSize ? _sqSize : _cqSize;
+	m_ring = mmap(NULL, m_ringSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQ_RING);
+	if (MAP_FAILED == m_ring)
+	{
+		m_ring = NULL;
+		close();
+		return false;
+	}
+	m_sqesSize = _params.sq_entries * sizeof(io_uring_sqe);
+	void *_sqes = mmap(NULL, m_sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQES);
+	if (MAP_FAILED == _sqes)
+	{
+		close();
+		return false;
+	}
+	m_sqes = static_cast<io_uring_sqe *>(_sqes);
+
+	uint8_t *_ring = static_cast<uint8_t *>(m_ring);
+	m_sqHead = reinterpret_cast<unsigned *>(_ring + _params.sq_off.head);
+	m_sqTail = reinterpret_cast<unsigned *>(_ring + _params.sq_off.tail);
+	m_sqMask = *reinterpret_cast<unsigned *>(_ring + _params.sq_off.ring_mask);
+	m_sqEntries = _params.sq_entries;
+	m_sqLocalTail = *m_sqTail;
+	m_cqHead = reinterpret_cast<unsigned *>(_ring + _params.cq_off.head);
+	m_cqTail = reinterpret_cast<unsigned *>(_ring + _params.cq_off.tail);
+	m_cqMask = *reinterpret_cast<unsigned *>(_ring + _params.cq_off.ring_mask);
+	m_cqes = reinterpret_cast<io_uring_cqe *>(_ring + _params.cq_off.cqes);
+
+	// SQ 下标数组固定为一一对应，之后直接按顺序使用 SQE
+	unsigned *_array = reinterpret_cast<unsigned *>(_ring + _params.sq_off.array);
+	for (unsigned i = 0; i < m_sqEntries; ++i)
+	{
+		_array[i] = i;
+	}
+	return true;
+}
+
+void ModbusCppUring::close()
+{
+	// 先关闭环，内核放弃所有未完成的操作并释放对缓冲区的引用
+	if (-1 != m_fd)
+	{
+		::close(m_fd);
+		m_fd = -1;
+	}
+	if (NULL != m_sqes)
+	{
+		munmap(m_sqes, m_sqesSize);
+		m_sqes = NULL;
+	}
+	if (NULL != m_ring)
+	{
+		munmap(m_ring, m_ringSize);
+		m_ring = NULL;
+	}
+	if (NULL != m_bufferRing)
+	{
+		munmap(m_bufferRing, m_bufferRingSize);
+		m_bufferRing = NULL;
+	}
+	if (NULL != m_buffers)
+	{
+		munmap(m_buffers, m_buffersSize);
+		m_buffers = NULL;
+	}
+}
+
+bool ModbusCppUring::isOpen() const
+{
+	return -1 != m_fd;
+}
+
+bool ModbusCppUring::setupBuffers(const uint16_t group, const unsigned count, const unsigned size)
+{
+	if (-1 == m_fd || NULL != m_bufferRing || 0 == count || 0 != (count & (count - 1)))
+	{
+		return false;
+	}
+
+	m_bufferRingSize = count * sizeof(io_uring_buf);
+	m_buffersSize = static_cast<size_t>(count) * size;
+	void *_ring = mmap(NULL, m_bufferRingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	void *_buffers = mmap(NULL, m_buffersSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	m_bufferRing = MAP_FAILED == _ring ? NULL : static_cast<io_uring_buf_ring *>(_ring);
+	m_buffers = MAP_FAILED == _buffers ? NULL : static_cast<uint8_t *>(_buffers);
+	if (NULL == m_bufferRing || NULL == m_buffers)
+	{
+		return false;
+	}
+
+	io_uring_buf_reg _register = {};
+	_register.ring_addr = reinterpret_cast<uint64_t>(m_bufferRing);
+	_register.ring_entries = count;
+	_register.bgid = group;
+	if (0 != uringRegister(m_fd, IORING_REGISTER_PBUF_RING, &_register, 1))
+	{
+		return false;
+	}
+
+	m_bufferCount = count;
+	m_bufferSize = size;
+	m_bufferTail = 0;
+	for (unsigned i = 0; i < count; ++i)
+	{
+		recycleBuffer(static_cast<uint16_t>(i));
+	}
+	return true;
+}
+
+uint8_t *ModbusCppUring::buffer(const uint16_t id) const
+{
+	return m_buffers + static_cast<size_t>(id) * m_bufferSize;
+}
+
+void ModbusCppUring::recycleBuffer(const uint16_t id)
+{
+	// 按 C++ 编译时 bufs 的偏移不是 0(__DECLARE_FLEX_ARRAY 中的空结构体占 1 字节)，直接按数组访问环
+	io_uring_buf& _buffer = reinterpret_cast<io_uring_buf *>(m_bufferRing)[m_bufferTail & (m_bufferCount - 1)];
+	_buffer.addr = reinterpret_cast<uint64_t>(buffer(id));
+	_buffer.len = m_bufferSize;
+	_buffer.bid = id;
+	++m_bufferTail;
+	std::atomic_ref<uint16_t>(m_bufferRing->tail).store(m_bufferTail, std::memory_order_release);
+}
+
+bool ModbusCppUring::enable()
+{
+	return 0 == uringRegister(m_fd, IORING_REGISTER_ENABLE_RINGS, NULL, 0);
+}
+
+io_uring_sqe *ModbusCppUring::getSqe()
+{
+	if (m_sqLocalTail - loadAcquire(m_sqHead) >= m_sqEntries && submit(0) <= 0)
+	{
+		return NULL;
+	}
+
+	io_uring_sqe *_sqe = &m_sqes[m_sqLocalTail & m_sqMask];
+	++m_sqLocalTail;
+	memset(_sqe, 0, sizeof(*_sqe));
+	return _sqe;
+}
+
+int ModbusCppUring::submit(const unsigned waitCount)
+{
+	// 内核在 io_uring_enter 中取走全部已提交的 SQE，被打断后重新调用时按 head 计算剩余数量
+	const unsigned _count = m_sqLocalTail - loadAcquire(m_sqHead);
+	if (0 == _count && 0 == waitCount)
+	{
+		return 0;
+	}
+
+	storeRelease(m_sqTail, m_sqLocalTail);
+	const int _result = uringEnter(m_fd, _count, waitCount, waitCount > 0 ? IORING_ENTER_GETEVENTS : 0);
+	if (_result < 0)
+	{
+		// 完成队列溢出时内核暂时不接收新的提交，先收割完成事件
+		return EINTR == errno || EAGAIN == errno || EBUSY == errno ? 0 : -1;
+	}
+	return _result;
+}
+
+io_uring_cqe *ModbusCppUring::peekCqe()
+{
+	const unsigned _head = *m_cqHead;
+	if (_head == loadAcquire(m_cqTail))
+	{
+		return NULL;
+	}
+	return &m_cqes[_head & m_cqMask];
+}
+
+void ModbusCppUring::seenCqe()
+{
+	storeRelease(m_cqHead, *m_cqHead + 1);
+}
+#endif
@@ -0,0 +1,74 @@
+﻿#pragma once
+#include <cstdint>
+#include <cstddef>
+#if defined(__linux__)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#endif
+#endif
+
+// 内核头文件太旧(没有 multishot recv)时不编译 io_uring 支持
+#if defined(IORING_RECV_MULTISHOT)
+#define MODBUSCPP_HAVE_IO_URING 1
+
+// 内部使用: 不依赖 liburing 的最小 io_uring 封装，直接使用系统调用
+// 环以 R_DISABLED 创建，可以在任意线程创建并注册缓冲区；enable() 之后只能在调用 enable() 的线程中提交和收割
+// 使用 SINGLE_ISSUER + DEFER_TASKRUN(Linux 6.1)，更早的内核、被 io_uring_disabled 或 seccomp 禁用时 open() 失败
+class ModbusCppUring
+{
+public:
+    ModbusCppUring();
+    ~ModbusCppUring();
+
+    ModbusCppUring(const ModbusCppUring &) = delete;
+    ModbusCppUring &operator=(const ModbusCppUring &) = delete;
+
+    bool open(const unsigned sqEntries, const unsigned cqEntries);
+    void close();
+    bool isOpen() const;
+
+    // 注册接收用的缓冲区组: count(2 的幂) 个 size 字节的缓冲区，由内核在数据到达时挑选
+    bool setupBuffers(const uint16_t group, const unsigned count, const unsigned size);
+    uint8_t *buffer(const uint16_t id) const;
+    // 缓冲区中的数据处理完后还给内核
+    void recycleBuffer(const uint16_t id);
+
+    // 在事件循环线程中调用一次
+    bool enable();
+
+    // 取一个清零的 SQE，提交队列满时先提交已有的；失败返回 NULL
+    io_uring_sqe *getSqe();
+    // 一次系统调用提交所有新的 SQE，并至少等待 waitCount 个完成事件；返回提交数，被信号打断时返回 0，出错返回 -1
+    int submit(const unsigned waitCount);
+
+    // 取下一个完成事件，没有时返回 NULL；处理前先拷贝字段再调用 seenCqe()，槽位随即可被内核复用
+    io_uring_cqe *peekCqe();
+    void seenCqe();
+
+private:
+    int             m_fd;
+    void            *m_ring;            // SQ 和 CQ 共用一次映射(IORING_FEAT_SINGLE_MMAP)
+    size_t          m_ringSize;
+    io_uring_sqe    *m_sqes;
+    size_t          m_sqesSize;
+
+    unsigned        *m_sqHead;
+    unsigned        *m_sqTail;
+    unsigned        m_sqMask;
+    unsigned        m_sqEntries;
+    unsigned        m_sqLocalTail;      // 已填好但还没有提交的 SQE 之后的位置
+
+    unsigned        *m_cqHead;
+    unsigned        *m_cqTail;
+    unsigned        m_cqMask;
+    io_uring_cqe    *m_cqes;
+
+    io_uring_buf_ring *m_bufferRing;
+    size_t          m_bufferRingSize;
+    uint8_t         *m_buffers;
+    size_t          m_buffersSize;
+    unsigned        m_bufferCount;
+    unsigned        m_bufferSize;
+    uint16_t        m_bufferTail;
+};
+#endif
@@ -0,0 +1,93 @@
+﻿#include "ModbusCppWriteEventRing.h"
+#include "modbus.h"
+#include <cstring>
+#include <algorithm>
+#include <bit>
+
+uint16_t ModbusCppWriteEvent::registerValue(const uint16_t index) const
+{
+	return static_cast<uint16_t>((data[index * 2] << 8) | data[index * 2 + 1]);
+}
+
+bool ModbusCppWriteEvent::bitValue(const uint16_t index) const
+{
+	return 0 != ((data[index / 8] >> (index % 8)) & 1);
+}
+
+// 位置按 m_mask 取模，容量必须是 2 的幂；容量为 1 时满和空无法区分，最小取 2
+static size_t ringCapacity(const size_t capacity)
+{
+	return std::bit_ceil(std::max<size_t>(capacity, 2));
+}
+
+ModbusCppWriteEventRing::ModbusCppWriteEventRing(const size_t capacity)
+	: m_events(ringCapacity(capacity))
+	, m_mask(m_events.size() - 1)
+	, m_head(0)
+	, m_cachedTail(0)
+	, m_dropped(0)
+	, m_tail(0)
+	, m_cachedHead(0)
+{
+}
+
+ModbusCppWriteEvent *ModbusCppWriteEventRing::reserve()
+{
+	const size_t _head = m_head.load(std::memory_order_relaxed);
+	if (_head - m_cachedTail > m_mask)
+	{
+		// 看起来满了，重新读取消费者的位置
+		m_cachedTail = m_tail.load(std::memory_order_acquire);
+		if (_head - m_cachedTail > m_mask)
+		{
+			m_dropped.fetch_add(1, std::memory_order_relaxed);
+			return NULL;
+		}
+	}
+	return &m_events[_head & m_mask];
+}
+
+void ModbusCppWriteEventRing::commit()
+{
+	m_head.store(m_head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+bool ModbusCppWriteEventRing::pop(ModbusCppWriteEvent& event)
+{
+	const size_t _tail = m_tail.load(std::memory_order_relaxed);
+	if (_tail == m_cachedHead)
+	{
+		m_cachedHead = m_head.load(std::memory_order_acquire);
+		if (_tail == m_cachedHead)
+		{
+			return false;
+		}
+	}
+
+	// 只拷贝有效的数据部分
+	const ModbusCppWriteEvent& _event = m_events[_tail & m_mask];
+	const bool _bits = MODBUS_FC_WRITE_SINGLE_COIL == _event.function || MODBUS_FC_WRITE_MULTIPLE_COILS == _event.function;
+	event.timestamp = _event.timestamp;
+	event.unit = _event.unit;
+	event.function = _event.function;
+	event.address = _event.address;
+	event.count = _event.count;
+	memcpy(event.data, _event.data, _bits ? (_event.count + 7) / 8 : _event.count * 2);
+	m_tail.store(_tail + 1, std::memory_order_release);
+	return true;
+}
+
+size_t ModbusCppWriteEventRing::size() const
+{
+	return m_head.load(std::memory_order_acquire) - m_tail.load(std::memory_order_acquire);
+}
+
+size_t ModbusCppWriteEventRing::capacity() const
+{
+	return m_events.size();
+}
+
+uint64_t ModbusCppWriteEventRing::dropped() const
+{
+	return m_dropped.load(std::memory_order_relaxed);
+}
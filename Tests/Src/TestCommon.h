@@ -0,0 +1,14 @@
+﻿#pragma once
+#include <cstdio>
+#include <cstdlib>
+
+// 测试程序共用的断言，失败时打印位置并以非 0 退出，由 ctest 判定失败
+#define TEST_CHECK(condition)                                                       \
+    do                                                                              \
+    {                                                                               \
+        if (!(condition))                                                           \
+        {                                                                           \
+            std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            std::exit(1);                                                           \
+        }                                                                           \
+    } while (0)
@@ -0,0 +1,44 @@
+﻿#include "ModbusCppCrc16.h"
+#include "TestCommon.h"
+#include <random>
+#include <vector>
+
+// 逐位计算的参考实现
+static uint16_t referenceCrc16(const uint8_t *data, const size_t length)
+{
+	uint16_t _crc = 0xFFFF;
+	for (size_t _i = 0; _i < length; ++_i)
+	{
+		_crc ^= data[_i];
+		for (int _bit = 0; _bit < 8; ++_bit)
+		{
+			_crc = (_crc & 1) ? (_crc >> 1) ^ 0xA001 : _crc >> 1;
+		}
+	}
+	return _crc;
+}
+
+int main()
+{
+	// 标准示例: 01 03 00 00 00 0A 的 CRC 为 C5 CD(低字节先发送)
+	const uint8_t _frame[] = { 0x01, 0x03, 0x00, 0x00, 0x00, 0x0A };
+	const uint16_t _crc = modbusCrc16(_frame, sizeof(_frame));
+	TEST_CHECK(0xC5 == (_crc & 0xFF));
+	TEST_CHECK(0xCD == (_crc >> 8));
+
+	// 各种长度(覆盖 8 字节分组的尾部)和起始对齐
+	std::mt19937 _random(1);
+	std::vector<uint8_t> _data(300);
+	for (auto &_byte : _data)
+	{
+		_byte = static_cast<uint8_t>(_random());
+	}
+	for (size_t _offset = 0; _offset < 8; ++_offset)
+	{
+		for (size_t _length = 0; _length + _offset <= _data.size(); ++_length)
+		{
+			TEST_CHECK(referenceCrc16(_data.data() + _offset, _length) == modbusCrc16(_data.data() + _offset, _length));
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,42 @@
+﻿#include "ModbusCppRegisterMap.h"
+#include "TestCommon.h"
+
+using Table = ModbusCppRegisterMap::Table;
+
+int main()
+{
+	ModbusCppRegisterMap _map;
+	TEST_CHECK(_map.addRange(Table::HOLDING_REGISTERS, 100, 200));
+	TEST_CHECK(_map.addRange(Table::COILS, 0, 16));
+	TEST_CHECK(0 == _map.allocatedBytes());
+
+	// 未写过的页读为 0，越界访问被拒绝
+	auto _values = _map.readRegisters(Table::HOLDING_REGISTERS, 100, 3);
+	TEST_CHECK(_values && (*_values)[0] == 0 && (*_values)[2] == 0);
+	TEST_CHECK(!_map.readRegisters(Table::HOLDING_REGISTERS, 99, 2));
+	TEST_CHECK(!_map.readRegisters(Table::HOLDING_REGISTERS, 299, 2));
+	TEST_CHECK(!_map.readRegisters(Table::INPUT_REGISTERS, 100, 1));
+
+	// 跨页写入后读回
+	std::vector<uint16_t> _written;
+	for (uint16_t _i = 0; _i < 100; ++_i)
+	{
+		_written.push_back(static_cast<uint16_t>(_i * 7 + 1));
+	}
+	TEST_CHECK(_map.writeRegisters(Table::HOLDING_REGISTERS, 120, _written));
+	_values = _map.readRegisters(Table::HOLDING_REGISTERS, 120, 100);
+	TEST_CHECK(_values && *_values == _written);
+	TEST_CHECK(0 != _map.allocatedBytes());
+
+	// 编码访问使用 PDU 字节序(大端)
+	uint8_t _bytes[4] = { 0 };
+	TEST_CHECK(_map.readRegistersEncoded(Table::HOLDING_REGISTERS, 121, 2, _bytes));
+	TEST_CHECK(0 == _bytes[0] && 8 == _bytes[1] && 0 == _bytes[2] && 15 == _bytes[3]);
+
+	// 线圈
+	TEST_CHECK(_map.writeBits(Table::COILS, 3, { 1, 0, 1 }));
+	auto _bits = _map.readBits(Table::COILS, 2, 5);
+	TEST_CHECK(_bits && *_bits == std::vector<uint8_t>({ 0, 1, 0, 1, 0 }));
+	TEST_CHECK(!_map.writeBits(Table::COILS, 15, { 1, 1 }));
+	return 0;
+}
@@ -0,0 +1,110 @@
+﻿#include "ModbusCppTcpProxy.h"
+#include "ModbusCppTcpServer.h"
+#include "ModbusCppRegisterMap.h"
+#include "modbus.h"
+#include "TestCommon.h"
+#include <thread>
+#include <chrono>
+#include <functional>
+
+using Table = ModbusCppRegisterMap::Table;
+
+static const uint16_t UPSTREAM_PORT = 15621;
+static const uint16_t PROXY_PORT = 15622;
+
+// 等待条件成立，超时返回 false
+static bool waitFor(const std::function<bool ()> &condition)
+{
+	const auto _deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+	while (std::chrono::steady_clock::now() < _deadline)
+	{
+		if (condition())
+		{
+			return true;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	return false;
+}
+
+// 从代理读取一个寄存器，失败返回 -1
+static int readProxy(const uint16_t address)
+{
+	modbus_t *_context = modbus_new_tcp("127.0.0.1", PROXY_PORT);
+	int _value = -1;
+	uint16_t _register = 0;
+	if (0 == modbus_connect(_context) && 1 == modbus_read_registers(_context, address, 1, &_register))
+	{
+		_value = _register;
+	}
+	modbus_close(_context);
+	modbus_free(_context);
+	return _value;
+}
+
+int main()
+{
+	// 上游设备
+	ModbusCppRegisterMap _device;
+	TEST_CHECK(_device.addRange(Table::HOLDING_REGISTERS, 0, 100));
+	TEST_CHECK(_device.writeRegisters(Table::HOLDING_REGISTERS, 0, { 11, 12, 13 }));
+	ModbusCppTcpServer _upstream;
+	_upstream.setRegisterMap(&_device);
+	TEST_CHECK(_upstream.start("127.0.0.1", UPSTREAM_PORT));
+
+	{
+		ModbusCppTcpProxy _proxy;
+		_proxy.setUpstream("127.0.0.1", UPSTREAM_PORT, 1);
+		_proxy.setReconnectInterval(50);
+		TEST_CHECK(_proxy.addPollBlock(0, 50, 20));
+
+		// 多次启动/停止，每次都重新连接上游并继续轮询和转发写入
+		for (uint16_t _round = 0; _round < 3; ++_round)
+		{
+			TEST_CHECK(_proxy.start("127.0.0.1", PROXY_PORT));
+			TEST_CHECK(waitFor([&]() { return _proxy.getStatistics().upstreamConnected; }));
+
+			TEST_CHECK(_device.writeRegisters(Table::HOLDING_REGISTERS, 1, { static_cast<uint16_t>(100 + _round) }));
+			TEST_CHECK(waitFor([&]() { return 100 + _round == readProxy(1); }));
+
+			modbus_t *_context = modbus_new_tcp("127.0.0.1", PROXY_PORT);
+			TEST_CHECK(0 == modbus_connect(_context));
+			TEST_CHECK(1 == modbus_write_register(_context, 2, 200 + _round));
+			modbus_close(_context);
+			modbus_free(_context);
+			TEST_CHECK(waitFor([&]() {
+				const auto _values = _device.readRegisters(Table::HOLDING_REGISTERS, 2, 1);
+				return _values && 200 + _round == (*_values)[0];
+				}));
+
+			_proxy.stop();
+			TEST_CHECK(!_proxy.isRunning());
+			TEST_CHECK(!_proxy.getStatistics().upstreamConnected);
+			TEST_CHECK(-1 == readProxy(1));
+		}
+
+		// 运行中直接析构，内部的客户端线程退出后才释放连接
+		TEST_CHECK(_proxy.start("127.0.0.1", PROXY_PORT));
+		TEST_CHECK(waitFor([&]() { return _proxy.getStatistics().upstreamConnected; }));
+	}
+
+	// 上游断开后代理按重连间隔重新连接
+	{
+		ModbusCppTcpProxy _proxy;
+		_proxy.setUpstream("127.0.0.1", UPSTREAM_PORT, 1);
+		_proxy.setReconnectInterval(50);
+		_proxy.setUpstreamTimeout(200);
+		TEST_CHECK(_proxy.addPollBlock(0, 10, 20));
+		TEST_CHECK(_proxy.start("127.0.0.1", PROXY_PORT));
+		TEST_CHECK(waitFor([&]() { return _proxy.getStatistics().upstreamConnected; }));
+		_upstream.stop();
+		TEST_CHECK(waitFor([&]() { return !_proxy.getStatistics().upstreamConnected; }));
+		TEST_CHECK(_upstream.start("127.0.0.1", UPSTREAM_PORT));
+		TEST_CHECK(waitFor([&]() { return _proxy.getStatistics().upstreamConnected; }));
+		TEST_CHECK(_device.writeRegisters(Table::HOLDING_REGISTERS, 3, { 300 }));
+		TEST_CHECK(waitFor([&]() { return 300 == readProxy(3); }));
+	}
+
+	_upstream.stop();
+	return 0;
+}
@@ -0,0 +1,178 @@
+﻿#include "ModbusCppTcpServer.h"
+#include "ModbusCppRegisterMap.h"
+#include "modbus.h"
+#include "TestCommon.h"
+#include <cstring>
+#include <string>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/resource.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <thread>
+#include <chrono>
+#include <vector>
+
+using Table = ModbusCppRegisterMap::Table;
+
+static int connectServer(const uint16_t port)
+{
+	const int _socket = socket(AF_INET, SOCK_STREAM, 0);
+	sockaddr_in _address{};
+	_address.sin_family = AF_INET;
+	_address.sin_port = htons(port);
+	inet_pton(AF_INET, "127.0.0.1", &_address.sin_addr);
+	if (0 != connect(_socket, reinterpret_cast<sockaddr *>(&_address), sizeof(_address)))
+	{
+		close(_socket);
+		return -1;
+	}
+	int _option = 1;
+	setsockopt(_socket, IPPROTO_TCP, TCP_NODELAY, &_option, sizeof(_option));
+	return _socket;
+}
+
+// 用 libmodbus 客户端写入并读回
+static void checkReadWrite(const uint16_t port)
+{
+	modbus_t *_context = modbus_new_tcp("127.0.0.1", port);
+	TEST_CHECK(0 == modbus_connect(_context));
+	uint16_t _written[100];
+	for (int _i = 0; _i < 100; ++_i)
+	{
+		_written[_i] = static_cast<uint16_t>(_i * 3);
+	}
+	TEST_CHECK(100 == modbus_write_registers(_context, 10, 100, _written));
+	uint16_t _read[100] = { 0 };
+	TEST_CHECK(100 == modbus_read_registers(_context, 10, 100, _read));
+	TEST_CHECK(0 == memcmp(_written, _read, sizeof(_read)));
+	// 非法地址返回异常
+	TEST_CHECK(-1 == modbus_read_registers(_context, 990, 20, _read));
+	TEST_CHECK(EMBXILADD == errno);
+	modbus_close(_context);
+	modbus_free(_context);
+}
+
+// 描述符用尽时等待中的连接被立即关闭(而不是留在队列里让事件循环空转)，恢复后照常服务
+// io_uring 在提交 accept 时就记下了描述符上限，所以这里真的占满描述符，而不是临时调低上限
+static void checkDescriptorsExhausted(ModbusCppTcpServer &server, const uint16_t port)
+{
+	int _sockets[4];
+	for (int &_socket : _sockets)
+	{
+		_socket = socket(AF_INET, SOCK_STREAM, 0);
+		TEST_CHECK(-1 != _socket);
+	}
+	std::vector<int> _fillers;
+	int _filler = -1;
+	while (-1 != (_filler = open("/dev/null", O_RDONLY)))
+	{
+		_fillers.push_back(_filler);
+	}
+	TEST_CHECK(EMFILE == errno);
+
+	const uint64_t _rejected = server.getStatistics().connectionsRejected;
+	sockaddr_in _address{};
+	_address.sin_family = AF_INET;
+	_address.sin_port = htons(port);
+	inet_pton(AF_INET, "127.0.0.1", &_address.sin_addr);
+	for (const int _socket : _sockets)
+	{
+		TEST_CHECK(0 == connect(_socket, reinterpret_cast<sockaddr *>(&_address), sizeof(_address)));
+	}
+	for (int _i = 0; _i < 200 && server.getStatistics().connectionsRejected < _rejected + 4; ++_i)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	TEST_CHECK(server.getStatistics().connectionsRejected == _rejected + 4);
+	for (const int _socket : _sockets)
+	{
+		uint8_t _buffer[16];
+		TEST_CHECK(0 >= recv(_socket, _buffer, sizeof(_buffer), 0));
+		close(_socket);
+	}
+
+	for (const int _descriptor : _fillers)
+	{
+		close(_descriptor);
+	}
+	checkReadWrite(port);
+}
+
+int main(int argc, char **argv)
+{
+	const bool _uring = argc > 1 && 0 == strcmp(argv[1], "uring");
+	const uint16_t _port = _uring ? 15612 : 15611;
+
+	// 测试描述符用尽时要占满所有描述符，上限很大时先调低
+	rlimit _limit{};
+	TEST_CHECK(0 == getrlimit(RLIMIT_NOFILE, &_limit));
+	if (_limit.rlim_cur > 1024)
+	{
+		_limit.rlim_cur = 1024;
+		TEST_CHECK(0 == setrlimit(RLIMIT_NOFILE, &_limit));
+	}
+
+	ModbusCppRegisterMap _map;
+	TEST_CHECK(_map.addRange(Table::HOLDING_REGISTERS, 0, 1000));
+	ModbusCppTcpServer _server;
+	_server.setRegisterMap(&_map);
+	_server.setIoUringEnabled(_uring);
+	TEST_CHECK(_server.start("127.0.0.1", _port));
+	std::printf("io engine %s\n", _server.ioEngineName());
+
+	checkReadWrite(_port);
+
+	// 32 个流水线请求按 7 字节拆开发送，响应按顺序返回
+	const int _socket = connectServer(_port);
+	TEST_CHECK(-1 != _socket);
+	uint8_t _requests[12 * 32];
+	for (int _i = 0; _i < 32; ++_i)
+	{
+		const uint8_t _frame[12] = { 0, static_cast<uint8_t>(_i), 0, 0, 0, 6, 1, 3, 0, 10, 0, 10 };
+		memcpy(_requests + 12 * _i, _frame, sizeof(_frame));
+	}
+	for (size_t _offset = 0; _offset < sizeof(_requests); _offset += 7)
+	{
+		const size_t _length = std::min<size_t>(7, sizeof(_requests) - _offset);
+		TEST_CHECK(static_cast<ssize_t>(_length) == send(_socket, _requests + _offset, _length, 0));
+	}
+	uint8_t _responses[29 * 32];
+	size_t _received = 0;
+	while (_received < sizeof(_responses))
+	{
+		const ssize_t _length = recv(_socket, _responses + _received, sizeof(_responses) - _received, 0);
+		TEST_CHECK(_length > 0);
+		_received += _length;
+	}
+	for (int _i = 0; _i < 32; ++_i)
+	{
+		const uint8_t *_response = _responses + 29 * _i;
+		TEST_CHECK(_i == _response[1] && 20 == _response[8] && 0 == _response[9] && 0 == _response[10]);
+	}
+
+	// 非法 MBAP 头(协议号不为 0)的连接被关闭
+	const int _badSocket = connectServer(_port);
+	const uint8_t _bad[12] = { 0, 1, 0, 5, 0, 6, 1, 3, 0, 0, 0, 2 };
+	send(_badSocket, _bad, sizeof(_bad), 0);
+	uint8_t _buffer[16];
+	TEST_CHECK(0 >= recv(_badSocket, _buffer, sizeof(_buffer), 0));
+	close(_badSocket);
+	close(_socket);
+
+	const ModbusCppServerStatistics _statistics = _server.getStatistics();
+	TEST_CHECK(_statistics.requests >= 35);
+	TEST_CHECK(1 == _statistics.protocolErrors);
+
+	checkDescriptorsExhausted(_server, _port);
+
+	// 停止后可以在同一端口重新启动
+	_server.stop();
+	TEST_CHECK(!_server.isRunning());
+	TEST_CHECK(_server.start("127.0.0.1", _port));
+	checkReadWrite(_port);
+	_server.stop();
+	return 0;
+}
@@ -0,0 +1,46 @@
+﻿#include "ModbusCppWriteEventRing.h"
+#include "TestCommon.h"
+
+// 写满队列，返回成功写入的事件数
+static size_t fill(ModbusCppWriteEventRing &ring, uint16_t &address)
+{
+	size_t _count = 0;
+	while (ModbusCppWriteEvent *_event = ring.reserve())
+	{
+		_event->address = address++;
+		ring.commit();
+		++_count;
+	}
+	return _count;
+}
+
+int main()
+{
+	// 容量向上取整为 2 的幂，最小为 2
+	const size_t _requested[] = { 0, 1, 2, 3, 5, 64, 1000 };
+	const size_t _expected[] = { 2, 2, 2, 4, 8, 64, 1024 };
+	for (size_t _i = 0; _i < sizeof(_requested) / sizeof(_requested[0]); ++_i)
+	{
+		ModbusCppWriteEventRing _ring(_requested[_i]);
+		TEST_CHECK(_expected[_i] == _ring.capacity());
+
+		// 满时丢弃并计数，绕回多圈后顺序不变
+		uint16_t _written = 0;
+		uint16_t _read = 0;
+		for (int _round = 0; _round < 3; ++_round)
+		{
+			TEST_CHECK(_ring.capacity() == fill(_ring, _written));
+			TEST_CHECK(_ring.capacity() == _ring.size());
+			TEST_CHECK(static_cast<uint64_t>(_round + 1) == _ring.dropped());
+
+			ModbusCppWriteEvent _event;
+			while (_ring.pop(_event))
+			{
+				TEST_CHECK(_read++ == _event.address);
+			}
+			TEST_CHECK(_written == _read);
+			TEST_CHECK(0 == _ring.size());
+		}
+	}
+	return 0;
+}